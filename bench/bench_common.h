@@ -0,0 +1,30 @@
+/*
+ * bench_common.h
+ * Setup shared by the benches.
+ */
+
+#ifndef BENCH_COMMON_H
+#define BENCH_COMMON_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <unistd.h>
+
+// Creates a fresh /tmp/<name>_XXXXXX directory and makes it the working
+// directory, so the files a bench writes (db.aof, snapshots) stay out of
+// the caller's. Returns its path, or an empty string after reporting the
+// failure. Remove it with rmdir() once the bench has deleted its files.
+inline std::string enter_scratch_dir(const std::string& name) {
+    std::string pattern = "/tmp/" + name + "_XXXXXX";
+    std::vector<char> dir(pattern.begin(), pattern.end());
+    dir.push_back('\0');
+    if (mkdtemp(dir.data()) == nullptr || chdir(dir.data()) != 0) {
+        std::cerr << "Failed to create a scratch directory" << std::endl;
+        return std::string();
+    }
+    return dir.data();
+}
+
+#endif // BENCH_COMMON_H
@@ -0,0 +1,98 @@
+/*
+ * collection_bench.cpp
+ * Cost of one LPUSH / RPUSH / LPOP / RPOP / LRANGE / SADD / HSET against a
+ * key that already holds a large collection.
+ *
+ * Usage: collection_bench [elements] [ops]
+ * Defaults: 1M elements, 1000 single-element writes per command.
+ * LRANGE reads 100 elements from the middle of the list.
+ *
+ * Each command gets a fresh EnhancedDB whose key is first grown to
+ * `elements` members in batches; the reported figure is the average time
+ * of the `ops` commands that follow; writes add or remove one element.
+ */
+
+#include "db.h"
+#include "bench_common.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <functional>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using Write = std::function<void(EnhancedDB& db, const std::string& key, size_t i)>;
+
+void run(const std::string& name, size_t elements, size_t ops, const Write& write) {
+    std::unique_ptr<EnhancedDB> db(new EnhancedDB(1024));
+    const std::string key = "big";
+    const size_t batch = 1000;
+
+    auto fill_start = Clock::now();
+    std::vector<std::string> members;
+    for (size_t i = 0; i < elements; i += batch) {
+        members.clear();
+        for (size_t j = i; j < i + batch && j < elements; ++j) members.push_back("member:" + std::to_string(j));
+        if (name == "HSET") {
+            for (const auto& member : members) db->hset(key, member, "value");
+        } else if (name == "SADD") {
+            db->sadd(key, members);
+        } else {
+            db->rpush(key, members);
+        }
+    }
+    double fill_secs = std::chrono::duration<double>(Clock::now() - fill_start).count();
+
+    auto start = Clock::now();
+    for (size_t i = 0; i < ops; ++i) write(*db, key, elements + i);
+    double us = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / ops;
+    std::cout << name << ": " << us << " us/op on a " << elements << "-element key (built in "
+              << fill_secs << " s)" << std::endl;
+}
+
+}
+
+int main(int argc, char** argv) {
+    size_t elements = argc > 1 ? std::stoul(argv[1]) : 1000000;
+    size_t ops = argc > 2 ? std::stoul(argv[2]) : 1000;
+
+    std::string dir = enter_scratch_dir("collection_bench");
+    if (dir.empty()) return 1;
+    AOFWriter::instance().configure("db.aof", AppendFsync::NO, false);
+
+    run("LPUSH", elements, ops, [](EnhancedDB& db, const std::string& key, size_t i) {
+        db.lpush(key, {"member:" + std::to_string(i)});
+    });
+    run("RPUSH", elements, ops, [](EnhancedDB& db, const std::string& key, size_t i) {
+        db.rpush(key, {"member:" + std::to_string(i)});
+    });
+    run("LPOP", elements, ops, [](EnhancedDB& db, const std::string& key, size_t) {
+        std::string value;
+        db.lpop(key, value);
+    });
+    run("RPOP", elements, ops, [](EnhancedDB& db, const std::string& key, size_t) {
+        std::string value;
+        db.rpop(key, value);
+    });
+    run("LRANGE", elements, ops, [elements](EnhancedDB& db, const std::string& key, size_t) {
+        std::vector<std::string> range;
+        int middle = static_cast<int>(elements / 2);
+        db.lrange(key, middle, middle + 99, range);
+    });
+    run("SADD", elements, ops, [](EnhancedDB& db, const std::string& key, size_t i) {
+        db.sadd(key, {"member:" + std::to_string(i)});
+    });
+    run("HSET", elements, ops, [](EnhancedDB& db, const std::string& key, size_t i) {
+        db.hset(key, "member:" + std::to_string(i), "value");
+    });
+
+    std::remove("db.aof");
+    rmdir(dir.c_str());
+    return 0;
+}
@@ -0,0 +1,100 @@
+/*
+ * counter_bench.cpp
+ * INCR / INCRBY / DECR on hot counter keys.
+ *
+ * Usage: counter_bench [counters] [ops]
+ * Defaults: 1000 counters, 10M operations per command.
+ *
+ * Each command runs `ops` times round-robin over `counters` keys, first
+ * straight against a Keyspace through DataOperations, then through an
+ * EnhancedDB (locking, LRU touch and AOF buffering included). The bench
+ * replaces the global operator new to count heap allocations per op.
+ */
+
+#include "db.h"
+#include "bench_common.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <functional>
+#include <atomic>
+#include <new>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+
+namespace {
+
+std::atomic<size_t> allocations{0};
+
+}
+
+void* operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+
+// Replaced as a set so every form frees what the matching new allocated.
+// Kept out of line: inlined, GCC pairs the free() with a new expression
+// and reports -Wmismatched-new-delete.
+#if defined(__GNUC__)
+#define NOINLINE __attribute__((noinline))
+#else
+#define NOINLINE
+#endif
+
+NOINLINE void operator delete(void* p) noexcept { std::free(p); }
+NOINLINE void operator delete(void* p, size_t) noexcept { std::free(p); }
+NOINLINE void operator delete[](void* p) noexcept { std::free(p); }
+NOINLINE void operator delete[](void* p, size_t) noexcept { std::free(p); }
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+void time_ops(const std::string& name, size_t ops, const std::function<void(size_t)>& op) {
+    size_t before = allocations.load();
+    auto start = Clock::now();
+    for (size_t i = 0; i < ops; ++i) op(i);
+    double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / ops;
+    double allocs = static_cast<double>(allocations.load() - before) / ops;
+    std::cout << name << ": " << ns << " ns/op, " << allocs << " allocations/op" << std::endl;
+}
+
+}
+
+int main(int argc, char** argv) {
+    size_t counters = argc > 1 ? std::stoul(argv[1]) : 1000;
+    size_t ops = argc > 2 ? std::stoul(argv[2]) : 10000000;
+
+    std::string dir = enter_scratch_dir("counter_bench");
+    if (dir.empty()) return 1;
+    AOFWriter::instance().configure("db.aof", AppendFsync::NO, false);
+
+    std::vector<std::string> keys;
+    for (size_t i = 0; i < counters; ++i) keys.push_back("counter:" + std::to_string(i));
+    int64_t result;
+
+    Keyspace storage;
+    for (const auto& key : keys) DataOperations::set_string(storage, key, "100");
+    time_ops("DataOperations INCR", ops, [&](size_t i) { DataOperations::incr(storage, keys[i % counters], result); });
+    time_ops("DataOperations INCRBY 7", ops, [&](size_t i) { DataOperations::incrby(storage, keys[i % counters], 7, result); });
+    time_ops("DataOperations DECR", ops, [&](size_t i) { DataOperations::decr(storage, keys[i % counters], result); });
+
+    std::unique_ptr<EnhancedDB> db(new EnhancedDB(counters * 2));
+    for (const auto& key : keys) db->set(key, "100");
+    time_ops("EnhancedDB INCR", ops, [&](size_t i) { db->incr(keys[i % counters], result); });
+    time_ops("EnhancedDB INCRBY 7", ops, [&](size_t i) { db->incrby(keys[i % counters], 7, result); });
+    std::string value;
+    time_ops("EnhancedDB GET", ops, [&](size_t i) { db->get(keys[i % counters], value); });
+
+    db.reset();
+    std::remove("db.aof");
+    rmdir(dir.c_str());
+    return 0;
+}
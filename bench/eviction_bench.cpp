@@ -0,0 +1,121 @@
+/*
+ * eviction_bench.cpp
+ * Hit ratio and cost of the EnhancedDB eviction policies on a Zipfian trace.
+ *
+ * Usage: eviction_bench [keys] [cache_size] [ops] [skew]
+ * Defaults: 1M distinct keys, 100k cached keys, 10M requests, skew 0.99.
+ *
+ * The trace draws key ranks from a Zipf distribution, with ranks shuffled
+ * over the key names. Every request is a GET, followed by a SET of the
+ * key on a miss, as a read-through cache would do. The same trace runs
+ * against exact LRU, the sampled LRU/LFU policies at several sample sizes,
+ * ARC and W-TinyLFU, each in a fresh DB with the same key-count capacity.
+ * A second, read-only pass over the trace then times GET alone, without
+ * evictions. Everything is repeated on a scan-heavy trace, where every
+ * fourth request instead reads the next key of a sequential scan over as
+ * many keys again, each read once per pass.
+ */
+
+#include "db.h"
+#include "bench_common.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+std::vector<uint32_t> zipf_trace(size_t keys, size_t ops, double skew) {
+    std::vector<double> cdf(keys);
+    double sum = 0;
+    for (size_t i = 0; i < keys; ++i) {
+        sum += 1.0 / std::pow(static_cast<double>(i + 1), skew);
+        cdf[i] = sum;
+    }
+    std::vector<uint32_t> names(keys);
+    for (size_t i = 0; i < keys; ++i) names[i] = static_cast<uint32_t>(i);
+    std::mt19937_64 rng(42);
+    std::shuffle(names.begin(), names.end(), rng);
+
+    std::uniform_real_distribution<double> uniform(0.0, sum);
+    std::vector<uint32_t> trace(ops);
+    for (auto& request : trace) {
+        size_t rank = std::lower_bound(cdf.begin(), cdf.end(), uniform(rng)) - cdf.begin();
+        request = names[std::min(rank, keys - 1)];
+    }
+    return trace;
+}
+
+void run(const std::string& name, EvictionPolicy policy, size_t samples, size_t cache_size,
+         const std::vector<std::string>& keys, const std::vector<uint32_t>& trace) {
+    std::unique_ptr<EnhancedDB> db(new EnhancedDB(cache_size));
+    db->set_eviction_policy(policy, samples);
+    std::string value;
+    size_t hits = 0;
+    auto start = Clock::now();
+    for (uint32_t request : trace) {
+        const std::string& key = keys[request];
+        if (db->get(key, value)) {
+            hits++;
+        } else {
+            db->set(key, key);
+        }
+    }
+    double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / trace.size();
+
+    start = Clock::now();
+    for (uint32_t request : trace) db->get(keys[request], value);
+    double get_ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / trace.size();
+
+    char line[160];
+    snprintf(line, sizeof(line), "%-24s hit ratio %6.2f%%, %6.1f ns/request, read-only %6.1f ns/GET",
+             name.c_str(), 100.0 * hits / trace.size(), ns, get_ns);
+    std::cout << line << std::endl;
+}
+
+}
+
+int main(int argc, char** argv) {
+    size_t key_count = argc > 1 ? std::stoul(argv[1]) : 1000000;
+    size_t cache_size = argc > 2 ? std::stoul(argv[2]) : 100000;
+    size_t ops = argc > 3 ? std::stoul(argv[3]) : 10000000;
+    double skew = argc > 4 ? std::stod(argv[4]) : 0.99;
+
+    std::string dir = enter_scratch_dir("eviction_bench");
+    if (dir.empty()) return 1;
+    AOFWriter::instance().configure("db.aof", AppendFsync::NO, false);
+
+    std::vector<std::string> keys;
+    for (size_t i = 0; i < 2 * key_count; ++i) keys.push_back("key:" + std::to_string(i));
+    std::vector<uint32_t> zipf = zipf_trace(key_count, ops, skew);
+    std::vector<uint32_t> scans = zipf;
+    for (size_t i = 0; i < scans.size(); i += 4) scans[i] = static_cast<uint32_t>(key_count + (i / 4) % key_count);
+
+    for (const auto* trace : {&zipf, &scans}) {
+        std::cout << (trace == &zipf ? "Zipf trace" : "Zipf trace with scans") << std::endl;
+        run("exact LRU", EvictionPolicy::LRU, 0, cache_size, keys, *trace);
+        for (size_t samples : {3, 5, 10}) {
+            run("sampled LRU, " + std::to_string(samples) + " samples", EvictionPolicy::SAMPLED_LRU, samples,
+                cache_size, keys, *trace);
+        }
+        for (size_t samples : {5, 10}) {
+            run("sampled LFU, " + std::to_string(samples) + " samples", EvictionPolicy::SAMPLED_LFU, samples,
+                cache_size, keys, *trace);
+        }
+        run("ARC", EvictionPolicy::ARC, 0, cache_size, keys, *trace);
+        run("W-TinyLFU", EvictionPolicy::TINY_LFU, 0, cache_size, keys, *trace);
+    }
+
+    std::remove("db.aof");
+    rmdir(dir.c_str());
+    return 0;
+}
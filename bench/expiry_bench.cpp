@@ -0,0 +1,104 @@
+/*
+ * expiry_bench.cpp
+ * Cost of TTLs on reads, and how quickly expired keys are reclaimed.
+ *
+ * Usage: expiry_bench [keys] [policy...]
+ * Defaults: 1M keys; policies ENHANCED, LRU and LFU.
+ *
+ * For each policy:
+ *   get   - every key carries a one-hour TTL; average GET latency
+ *   reclaim - TTLs spread over two seconds; active_expire() is driven at
+ *           10 Hz like the server's expire loop, and the bench reports
+ *           keys expired per second and the lag past each deadline.
+ */
+
+#include "db.h"
+#include "bench_common.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <thread>
+#include <random>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+void get_latency(const std::string& policy, size_t keys) {
+    std::unique_ptr<DB> db(create_db(policy, keys * 2));
+    for (size_t i = 0; i < keys; ++i) {
+        std::string key = "key:" + std::to_string(i);
+        db->set(key, "value");
+        db->expire(key, 3600);
+    }
+
+    std::mt19937_64 rng(42);
+    const size_t gets = 1000000;
+    std::string value;
+    size_t hits = 0;
+    auto start = Clock::now();
+    for (size_t i = 0; i < gets; ++i) {
+        hits += db->get("key:" + std::to_string(rng() % keys), value);
+    }
+    double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / gets;
+    std::cout << policy << " get: " << keys << " keys with TTL, " << static_cast<size_t>(ns)
+              << " ns/GET (" << hits << " hits)" << std::endl;
+}
+
+void reclaim(const std::string& policy, size_t keys) {
+    std::unique_ptr<DB> db(create_db(policy, keys * 2));
+    // EXPIRE takes whole seconds; spread the keys over 1 s and 2 s.
+    for (size_t i = 0; i < keys; ++i) {
+        std::string key = "key:" + std::to_string(i);
+        db->set(key, "value");
+        db->expire(key, 1 + static_cast<int>(i % 2));
+    }
+
+    const size_t keys_per_step = 2000;
+    auto start = Clock::now();
+    auto period = std::chrono::milliseconds(100);
+    double busy_ms = 0;
+    while (db->expiry_stats().expired < keys && Clock::now() - start < std::chrono::seconds(30)) {
+        std::this_thread::sleep_for(period);
+        auto cycle_start = Clock::now();
+        auto cycle_end = cycle_start + period / 4;
+        while (db->active_expire(keys_per_step) >= keys_per_step && Clock::now() < cycle_end) {
+        }
+        busy_ms += std::chrono::duration<double, std::milli>(Clock::now() - cycle_start).count();
+    }
+    double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+    ExpiryStats stats = db->expiry_stats();
+    double avg_lag = stats.active_expired ? stats.total_lag.count() / 1e6 / stats.active_expired : 0.0;
+    std::cout << policy << " reclaim: " << stats.expired << "/" << keys << " expired in " << elapsed
+              << " s, " << static_cast<size_t>(stats.expired / (busy_ms / 1000.0 + 1e-9))
+              << " keys/s of expire-loop time, lag avg " << avg_lag << " ms, max "
+              << stats.max_lag.count() / 1e6 << " ms" << std::endl;
+}
+
+}
+
+int main(int argc, char** argv) {
+    size_t keys = argc > 1 ? std::stoul(argv[1]) : 1000000;
+    std::vector<std::string> policies;
+    for (int i = 2; i < argc; ++i) policies.push_back(argv[i]);
+    if (policies.empty()) policies = {"ENHANCED", "LRU", "LFU"};
+
+    std::string dir = enter_scratch_dir("expiry_bench");
+    if (dir.empty()) return 1;
+    AOFWriter::instance().configure("db.aof", AppendFsync::NO, false);
+
+    for (const auto& policy : policies) {
+        get_latency(policy, keys);
+        reclaim(policy, keys);
+    }
+
+    std::remove("db.aof");
+    rmdir(dir.c_str());
+    return 0;
+}
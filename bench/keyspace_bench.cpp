@@ -0,0 +1,112 @@
+/*
+ * keyspace_bench.cpp
+ * The keyspace table (SwissTable) against std::unordered_map: insert
+ * throughput, lookup latency and heap bytes per key.
+ *
+ * Usage: keyspace_bench [max_keys] [lookups]
+ * Defaults: 1M and 10M keys; 5M lookups per size. Pass 100000000 for the
+ * 100M-key size, which needs about 20 GB.
+ *
+ * Each table is filled with "key:<n>" keys and empty KeyEntry values, as
+ * the EnhancedDB shards hold them, without reserving. Lookups then probe
+ * random present keys and as many absent ones. Heap bytes are counted by
+ * this binary's operator new with malloc's rounding, so they include
+ * every node, bucket array and key buffer the table allocates.
+ */
+
+#include "data_types.h"
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <memory>
+#include <chrono>
+#include <random>
+#include <charconv>
+#include <new>
+#include <cstdio>
+#include <cstdlib>
+#include <malloc.h>
+
+namespace {
+
+size_t heap_live = 0;
+
+}
+
+void* operator new(size_t size) {
+    void* p = std::malloc(size ? size : 1);
+    if (!p) throw std::bad_alloc();
+    heap_live += malloc_usable_size(p);
+    return p;
+}
+
+void operator delete(void* p) noexcept {
+    if (!p) return;
+    heap_live -= malloc_usable_size(p);
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept { operator delete(p); }
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Writes "<prefix><n>" into `key`, reusing its buffer.
+void make_key(std::string& key, const char* prefix, size_t n) {
+    char buf[32];
+    size_t len = 0;
+    while (prefix[len]) buf[len] = prefix[len], ++len;
+    char* end = std::to_chars(buf + len, buf + sizeof(buf), n).ptr;
+    key.assign(buf, end - buf);
+}
+
+template <typename Table>
+void run(const char* name, size_t keys, size_t lookups) {
+    std::string key;
+    size_t heap_before = heap_live;
+    std::unique_ptr<Table> table(new Table());
+    auto start = Clock::now();
+    for (size_t i = 0; i < keys; ++i) {
+        make_key(key, "key:", i);
+        (*table)[key];
+    }
+    double insert_s = std::chrono::duration<double>(Clock::now() - start).count();
+    double bytes_per_key = static_cast<double>(heap_live - heap_before) / keys;
+
+    std::mt19937_64 rng(7);
+    size_t found = 0;
+    start = Clock::now();
+    for (size_t i = 0; i < lookups; ++i) {
+        make_key(key, "key:", rng() % keys);
+        found += table->find(key) != table->end();
+    }
+    double hit_ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / lookups;
+
+    start = Clock::now();
+    for (size_t i = 0; i < lookups; ++i) {
+        make_key(key, "miss:", rng() % keys);
+        found += table->find(key) != table->end();
+    }
+    double miss_ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / lookups;
+    if (found != lookups) std::cerr << "unexpected lookup results" << std::endl;
+
+    char line[192];
+    snprintf(line, sizeof(line),
+             "%-20s %9zu keys: insert %6.2f M/s, hit %6.1f ns, miss %6.1f ns, %6.1f bytes/key",
+             name, keys, keys / insert_s / 1e6, hit_ns, miss_ns, bytes_per_key);
+    std::cout << line << std::endl;
+}
+
+}
+
+int main(int argc, char** argv) {
+    size_t max_keys = argc > 1 ? std::stoul(argv[1]) : 10000000;
+    size_t lookups = argc > 2 ? std::stoul(argv[2]) : 5000000;
+    std::cout << "KeyEntry is " << sizeof(KeyEntry) << " bytes" << std::endl;
+    for (size_t keys = 1000000; keys <= max_keys; keys *= 10) {
+        run<std::unordered_map<std::string, KeyEntry>>("std::unordered_map", keys, lookups);
+        run<Keyspace>("SwissTable", keys, lookups);
+    }
+    return 0;
+}
@@ -0,0 +1,63 @@
+/*
+ * lfu_bench.cpp
+ * GET and eviction latency of LFUCache as the cache grows.
+ *
+ * Usage: lfu_bench [max_keys] [ops]
+ * Defaults: sizes 10k, 100k, 1M and 10M keys; 2M operations per size.
+ *
+ * For each size a single LFUCache is filled to capacity. The bench then
+ * times GETs of random cached keys drawn from a skewed distribution (so
+ * the keys spread over many frequency buckets), followed by PUTs of new
+ * keys, each of which evicts one key.
+ */
+
+#include "lfu_cache.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <random>
+#include <cstdio>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+void run(size_t keys, size_t ops) {
+    std::unique_ptr<LFUCache> cache(new LFUCache(keys));
+    for (size_t i = 0; i < keys; ++i) cache->put("key:" + std::to_string(i), "value");
+
+    // Square of a uniform variable: low indexes come up far more often.
+    std::mt19937_64 rng(7);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    std::vector<std::string> requests;
+    requests.reserve(ops);
+    for (size_t i = 0; i < ops; ++i) {
+        double u = uniform(rng);
+        requests.push_back("key:" + std::to_string(static_cast<size_t>(u * u * keys)));
+    }
+
+    std::string value;
+    auto start = Clock::now();
+    for (const auto& key : requests) cache->get(key, value);
+    double get_ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / ops;
+
+    for (size_t i = 0; i < ops; ++i) requests[i] = "new:" + std::to_string(i);
+    start = Clock::now();
+    for (const auto& key : requests) cache->put(key, "value");
+    double put_ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / ops;
+
+    char line[128];
+    snprintf(line, sizeof(line), "%9zu keys: GET %6.1f ns/op, PUT with eviction %6.1f ns/op", keys, get_ns, put_ns);
+    std::cout << line << std::endl;
+}
+
+}
+
+int main(int argc, char** argv) {
+    size_t max_keys = argc > 1 ? std::stoul(argv[1]) : 10000000;
+    size_t ops = argc > 2 ? std::stoul(argv[2]) : 2000000;
+    for (size_t keys = 10000; keys <= max_keys; keys *= 10) run(keys, ops);
+    return 0;
+}
@@ -0,0 +1,180 @@
+/*
+ * memory_bench.cpp
+ * Resident memory per key of EnhancedDB.
+ *
+ * Usage: memory_bench [strings|hashes|lists|small|maxmemory|all] [count] [fields_per_hash]
+ * Defaults: 1M small strings; 10k hashes with 100 fields each; 1000 lists
+ * of 1000 elements each (the third argument also sets the list length);
+ * 500k session hashes of 5 fields and 500k sets of 10 small integers;
+ * 1M writes of mixed sizes under a 64 MB maxmemory.
+ *
+ * Each workload runs in a fresh DB; the number reported is the growth of
+ * RSS divided by the number of keys, so it includes allocator overhead.
+ * The lists workload runs in forked children, once through the DB and
+ * once as plain std::vector<std::string> (the previous LIST type), and
+ * reports bytes per element for both. The small workload also runs in
+ * forked children, each starting from an empty heap. The maxmemory
+ * workload mixes small strings, 4 KB strings and 200-field hashes and
+ * reports the accounted memory next to RSS and the number of evictions.
+ */
+
+#include "db.h"
+#include "bench_common.h"
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <memory>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+size_t rss_bytes() {
+    std::ifstream statm("/proc/self/statm");
+    size_t pages = 0, resident = 0;
+    statm >> pages >> resident;
+    return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+void report(const std::string& name, size_t keys, size_t before, size_t after) {
+    double per_key = keys ? static_cast<double>(after - before) / keys : 0.0;
+    std::cout << name << ": " << keys << " keys, RSS +" << (after - before) / (1024 * 1024)
+              << " MB, " << static_cast<size_t>(per_key) << " bytes/key" << std::endl;
+}
+
+void small_strings(size_t count) {
+    size_t before = rss_bytes();
+    std::unique_ptr<EnhancedDB> db(new EnhancedDB(count * 2));
+    for (size_t i = 0; i < count; ++i) {
+        db->set("key:" + std::to_string(i), "value:" + std::to_string(i));
+    }
+    report("small strings", db->dbsize(), before, rss_bytes());
+}
+
+void large_hashes(size_t count, size_t fields) {
+    size_t before = rss_bytes();
+    std::unique_ptr<EnhancedDB> db(new EnhancedDB(count * 2));
+    for (size_t i = 0; i < count; ++i) {
+        std::string key = "hash:" + std::to_string(i);
+        for (size_t f = 0; f < fields; ++f) {
+            db->hset(key, "field:" + std::to_string(f), "value:" + std::to_string(f));
+        }
+    }
+    report("hashes x" + std::to_string(fields) + " fields", db->dbsize(), before, rss_bytes());
+}
+
+// Runs `step` in a child so its RSS growth is not hidden by memory an
+// earlier workload freed.
+template <typename Step>
+void in_child(Step step) {
+    std::cout.flush();
+    pid_t pid = fork();
+    if (pid == 0) {
+        step();
+        std::cout.flush();
+        std::_Exit(0);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+}
+
+void report_elements(const std::string& name, size_t elements, size_t before, size_t after) {
+    double per_element = elements ? static_cast<double>(after - before) / elements : 0.0;
+    std::cout << name << ": " << elements << " elements, RSS +" << (after - before) / (1024 * 1024)
+              << " MB, " << per_element << " bytes/element" << std::endl;
+}
+
+void lists(size_t count, size_t length) {
+    in_child([&]() {
+        size_t before = rss_bytes();
+        std::unique_ptr<EnhancedDB> db(new EnhancedDB(count * 2));
+        for (size_t i = 0; i < count; ++i) {
+            std::string key = "list:" + std::to_string(i);
+            for (size_t e = 0; e < length; ++e) db->rpush(key, {"job:" + std::to_string(e)});
+        }
+        report_elements("quicklist lists", count * length, before, rss_bytes());
+    });
+    in_child([&]() {
+        size_t before = rss_bytes();
+        std::vector<std::vector<std::string>> vectors(count);
+        for (auto& list : vectors) {
+            for (size_t e = 0; e < length; ++e) list.push_back("job:" + std::to_string(e));
+        }
+        report_elements("vector lists", count * length, before, rss_bytes());
+    });
+}
+
+void small_objects(size_t count) {
+    in_child([&]() {
+        size_t before = rss_bytes();
+        std::unique_ptr<EnhancedDB> db(new EnhancedDB(count * 2));
+        for (size_t i = 0; i < count; ++i) {
+            std::string key = "session:" + std::to_string(i);
+            db->hset(key, "user_id", std::to_string(i));
+            db->hset(key, "name", "user" + std::to_string(i));
+            db->hset(key, "created", "1700000000");
+            db->hset(key, "ttl", "3600");
+            db->hset(key, "role", "member");
+        }
+        report("session hashes x5 fields", db->dbsize(), before, rss_bytes());
+    });
+    in_child([&]() {
+        size_t before = rss_bytes();
+        std::unique_ptr<EnhancedDB> db(new EnhancedDB(count * 2));
+        std::vector<std::string> members;
+        for (size_t i = 0; i < count; ++i) {
+            members.clear();
+            for (size_t m = 0; m < 10; ++m) members.push_back(std::to_string((i + m * 7919) % 100000));
+            db->sadd("ids:" + std::to_string(i), members);
+        }
+        report("integer sets x10 members", db->dbsize(), before, rss_bytes());
+    });
+}
+
+void bounded_memory(size_t count) {
+    in_child([&]() {
+        const size_t limit = 64 * 1024 * 1024;
+        size_t before = rss_bytes();
+        std::unique_ptr<DB> db(create_db("ENHANCED", count * 2, limit));
+        std::string big(4096, 'x');
+        for (size_t i = 0; i < count; ++i) {
+            std::string key = "key:" + std::to_string(i);
+            if (i % 1000 == 0) {
+                for (size_t f = 0; f < 200; ++f) db->hset(key, "field:" + std::to_string(f), big.substr(0, 100));
+            } else if (i % 10 == 0) {
+                db->set(key, big);
+            } else {
+                db->set(key, "value:" + std::to_string(i));
+            }
+        }
+        MemoryStats memory = db->memory_stats();
+        size_t rss = rss_bytes() - before;
+        std::cout << "maxmemory 64 MB: " << db->dbsize() << " keys kept, " << memory.evicted_keys
+                  << " evicted, used_memory " << memory.used_memory / (1024 * 1024) << " MB, RSS +"
+                  << rss / (1024 * 1024) << " MB" << std::endl;
+    });
+}
+
+}
+
+int main(int argc, char** argv) {
+    std::string mode = argc > 1 ? argv[1] : "all";
+    size_t count = argc > 2 ? std::stoul(argv[2]) : 0;
+    size_t fields = argc > 3 ? std::stoul(argv[3]) : 100;
+
+    std::string dir = enter_scratch_dir("memory_bench");
+    if (dir.empty()) return 1;
+
+    if (mode == "strings" || mode == "all") small_strings(count ? count : 1000000);
+    if (mode == "hashes" || mode == "all") large_hashes(count ? count : 10000, fields);
+    if (mode == "lists" || mode == "all") lists(count ? count : 1000, argc > 3 ? fields : 1000);
+    if (mode == "small" || mode == "all") small_objects(count ? count : 500000);
+    if (mode == "maxmemory" || mode == "all") bounded_memory(count ? count : 1000000);
+
+    std::remove("db.aof");
+    rmdir(dir.c_str());
+    return 0;
+}
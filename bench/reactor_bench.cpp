@@ -0,0 +1,202 @@
+/*
+ * reactor_bench.cpp
+ * Connection rate and request latency of the epoll reactor.
+ *
+ * Usage: reactor_bench [idle_clients] [active_clients] [seconds] [reactor_threads] [client_threads]
+ * Defaults: 10000 idle, 1000 active, 10 s, one reactor per core, 4 client threads.
+ *
+ * The reactor runs in-process behind a trivial PING session, so the numbers
+ * measure the I/O layer rather than command execution. Client and server
+ * share the machine; every client needs two descriptors (one per side).
+ */
+
+#include "reactor.h"
+#include <iostream>
+#include <vector>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+class PingSession : public Session {
+public:
+    bool on_data(std::string& input, std::string& output) override {
+        size_t pos = 0;
+        size_t eol;
+        while ((eol = input.find('\n', pos)) != std::string::npos) {
+            output += "+PONG\r\n";
+            pos = eol + 1;
+        }
+        input.erase(0, pos);
+        return true;
+    }
+};
+
+int connect_to(uint16_t port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, (sockaddr*)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+size_t raise_fd_limit() {
+    rlimit lim{};
+    getrlimit(RLIMIT_NOFILE, &lim);
+    lim.rlim_cur = lim.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &lim);
+    getrlimit(RLIMIT_NOFILE, &lim);
+    return lim.rlim_cur;
+}
+
+// Closed loop: every active socket always has one PING in flight.
+void drive_clients(const std::vector<int>& fds, Clock::time_point deadline,
+                   std::vector<double>& latencies_us) {
+    int ep = epoll_create1(0);
+    std::vector<Clock::time_point> sent_at(fds.size());
+    const char ping[] = "PING\r\n";
+
+    for (size_t i = 0; i < fds.size(); ++i) {
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.u64 = i;
+        epoll_ctl(ep, EPOLL_CTL_ADD, fds[i], &ev);
+        sent_at[i] = Clock::now();
+        if (send(fds[i], ping, sizeof(ping) - 1, MSG_NOSIGNAL) < 0) return;
+    }
+
+    epoll_event events[256];
+    char buf[256];
+    while (Clock::now() < deadline) {
+        int n = epoll_wait(ep, events, 256, 100);
+        for (int i = 0; i < n; ++i) {
+            size_t idx = events[i].data.u64;
+            ssize_t got = recv(fds[idx], buf, sizeof(buf), 0);
+            if (got <= 0) continue;
+            auto now = Clock::now();
+            latencies_us.push_back(std::chrono::duration<double, std::micro>(now - sent_at[idx]).count());
+            sent_at[idx] = now;
+            send(fds[idx], ping, sizeof(ping) - 1, MSG_NOSIGNAL);
+        }
+    }
+    close(ep);
+}
+
+double percentile(std::vector<double>& v, double p) {
+    if (v.empty()) return 0.0;
+    size_t idx = std::min(v.size() - 1, static_cast<size_t>(p * v.size()));
+    std::nth_element(v.begin(), v.begin() + idx, v.end());
+    return v[idx];
+}
+
+}
+
+int main(int argc, char** argv) {
+    size_t idle = argc > 1 ? std::stoul(argv[1]) : 10000;
+    size_t active = argc > 2 ? std::stoul(argv[2]) : 1000;
+    int seconds = argc > 3 ? std::stoi(argv[3]) : 10;
+    size_t reactor_threads = argc > 4 ? std::stoul(argv[4]) : std::max(1u, std::thread::hardware_concurrency());
+    size_t client_threads = argc > 5 ? std::stoul(argv[5]) : 4;
+
+    size_t fd_limit = raise_fd_limit();
+    size_t needed = 2 * (idle + active) + 64;
+    if (needed > fd_limit) {
+        size_t budget = (fd_limit - 64) / 2;
+        idle = budget > active ? budget - active : 0;
+        std::cerr << "RLIMIT_NOFILE is " << fd_limit << "; reducing idle clients to " << idle << std::endl;
+    }
+
+    int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    if (bind(listen_fd, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(listen_fd, SOMAXCONN) < 0) {
+        std::cerr << "Failed to listen: " << strerror(errno) << std::endl;
+        return 1;
+    }
+    socklen_t len = sizeof(addr);
+    getsockname(listen_fd, (sockaddr*)&addr, &len);
+    uint16_t port = ntohs(addr.sin_port);
+
+    Reactor reactor(listen_fd, reactor_threads, [](int, Outbox) {
+        return std::unique_ptr<Session>(new PingSession());
+    });
+    reactor.start();
+
+    std::cout << "reactor threads: " << reactor_threads << ", idle clients: " << idle
+              << ", active clients: " << active << ", client threads: " << client_threads << std::endl;
+
+    // Phase 1: connection rate, measured until the reactor has accepted everything.
+    std::vector<int> fds;
+    fds.reserve(idle + active);
+    auto start = Clock::now();
+    for (size_t i = 0; i < idle + active; ++i) {
+        int fd = connect_to(port);
+        if (fd < 0) {
+            std::cerr << "connect failed after " << i << " clients: " << strerror(errno) << std::endl;
+            break;
+        }
+        fds.push_back(fd);
+    }
+    while (reactor.accepted_count() < fds.size()) {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    double connect_secs = std::chrono::duration<double>(Clock::now() - start).count();
+    std::cout << "connections: " << fds.size() << " in " << connect_secs << " s ("
+              << static_cast<size_t>(fds.size() / connect_secs) << " conn/s)" << std::endl;
+
+    // Phase 2: the last `active` sockets ping while the rest stay idle.
+    size_t first_active = fds.size() > active ? fds.size() - active : 0;
+    std::vector<std::vector<int>> groups(client_threads);
+    for (size_t i = first_active; i < fds.size(); ++i) {
+        groups[i % client_threads].push_back(fds[i]);
+    }
+
+    auto deadline = Clock::now() + std::chrono::seconds(seconds);
+    std::vector<std::vector<double>> latencies(client_threads);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < client_threads; ++t) {
+        threads.emplace_back(drive_clients, std::cref(groups[t]), deadline, std::ref(latencies[t]));
+    }
+    for (auto& t : threads) t.join();
+
+    std::vector<double> all;
+    for (auto& l : latencies) all.insert(all.end(), l.begin(), l.end());
+    std::cout << "requests: " << all.size() << " (" << static_cast<size_t>(all.size() / double(seconds)) << " req/s)" << std::endl;
+    double p50 = percentile(all, 0.50);
+    double p99 = percentile(all, 0.99);
+    double p999 = percentile(all, 0.999);
+    std::cout << "latency us: p50 " << p50 << ", p99 " << p99 << ", p99.9 " << p999 << std::endl;
+
+    for (int fd : fds) close(fd);
+    reactor.stop();
+    reactor.join();
+    close(listen_fd);
+    return 0;
+}
@@ -0,0 +1,117 @@
+/*
+ * rehash_bench.cpp
+ * Latency spikes from table resizes: the keyspace table (SwissTable, which
+ * rehashes incrementally) against std::unordered_map, and GET latency on
+ * an EnhancedDB while another thread fills it.
+ *
+ * Usage: rehash_bench [keys]
+ * Default: 50M keys, which needs about 40 GB over the three runs.
+ *
+ * The table runs time every insert of "key:<n>" into an empty table and
+ * report the slowest ones; an all-at-once rehash shows up as the maximum.
+ * The DB run inserts the same keys with SET from one thread while a second
+ * thread GETs random keys already written and times each call, lock wait
+ * included.
+ */
+
+#include "db.h"
+#include "bench_common.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <random>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Call latencies in nanoseconds, reduced to a few percentiles.
+struct Latencies {
+    std::vector<uint32_t> samples;
+
+    void add(Clock::duration d) {
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+        samples.push_back(static_cast<uint32_t>(std::min<int64_t>(ns, UINT32_MAX)));
+    }
+
+    std::string summary() {
+        if (samples.empty()) return "no samples";
+        std::sort(samples.begin(), samples.end());
+        auto at = [&](double q) { return samples[std::min(samples.size() - 1, static_cast<size_t>(q * samples.size()))] / 1e3; };
+        char line[160];
+        snprintf(line, sizeof(line), "p50 %7.2f us, p99.9 %8.2f us, p99.99 %9.2f us, max %10.2f us",
+                 at(0.5), at(0.999), at(0.9999), samples.back() / 1e3);
+        return line;
+    }
+};
+
+template <typename Table>
+void run_table(const char* name, size_t keys) {
+    std::unique_ptr<Table> table(new Table());
+    Latencies inserts;
+    inserts.samples.reserve(keys);
+    std::string key;
+    for (size_t i = 0; i < keys; ++i) {
+        key = "key:" + std::to_string(i);
+        auto start = Clock::now();
+        (*table)[key];
+        inserts.add(Clock::now() - start);
+    }
+    printf("%-20s insert %s\n", name, inserts.summary().c_str());
+}
+
+void run_db(size_t keys) {
+    std::unique_ptr<EnhancedDB> db(new EnhancedDB(keys));
+    std::atomic<size_t> written{0};
+    std::atomic<bool> done{false};
+    Latencies gets;
+
+    std::thread reader([&] {
+        std::mt19937_64 rng(7);
+        std::string value;
+        while (!done) {
+            size_t n = written.load(std::memory_order_relaxed);
+            if (!n) continue;
+            std::string key = "key:" + std::to_string(rng() % n);
+            auto start = Clock::now();
+            db->get(key, value);
+            gets.add(Clock::now() - start);
+        }
+    });
+
+    for (size_t i = 0; i < keys; ++i) {
+        db->set("key:" + std::to_string(i), "value");
+        written.store(i + 1, std::memory_order_relaxed);
+    }
+    done = true;
+    reader.join();
+    printf("%-20s GET    %s (%zu GETs)\n", "EnhancedDB", gets.summary().c_str(), gets.samples.size());
+}
+
+}
+
+int main(int argc, char** argv) {
+    size_t keys = argc > 1 ? std::stoul(argv[1]) : 50000000;
+
+    std::string dir = enter_scratch_dir("rehash_bench");
+    if (dir.empty()) return 1;
+    AOFWriter::instance().configure("db.aof", AppendFsync::NO, false);
+
+    printf("%zu keys\n", keys);
+    run_table<std::unordered_map<std::string, KeyEntry>>("std::unordered_map", keys);
+    run_table<Keyspace>("SwissTable", keys);
+    run_db(keys);
+
+    std::remove("db.aof");
+    rmdir(dir.c_str());
+    return 0;
+}
@@ -0,0 +1,109 @@
+/*
+ * shard_scaling_bench.cpp
+ * GET/SET throughput of the DB classes from 1 to 32 threads.
+ *
+ * Usage: shard_scaling_bench [keys] [seconds_per_run]
+ *
+ * Each policy runs once with a single shard (equivalent to the old global
+ * lock) and once with DEFAULT_SHARD_COUNT shards. Runs inside a temporary
+ * directory because writes append to db.aof in the working directory.
+ */
+
+#include "db.h"
+#include "bench_common.h"
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <memory>
+#include <cstdlib>
+#include <cstdio>
+#include <unistd.h>
+
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+double run(DB* db, size_t keys, int threads, int write_percent, double seconds) {
+    std::atomic<bool> stop(false);
+    std::atomic<size_t> total_ops(0);
+    std::vector<std::thread> workers;
+
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t]() {
+            std::mt19937_64 rng(t + 1);
+            std::uniform_int_distribution<size_t> key_dist(0, keys - 1);
+            std::uniform_int_distribution<int> op_dist(0, 99);
+            std::string value;
+            size_t ops = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                for (int i = 0; i < 64; ++i) {
+                    std::string key = "key:" + std::to_string(key_dist(rng));
+                    if (op_dist(rng) < write_percent) {
+                        db->set(key, "value");
+                    } else {
+                        db->get(key, value);
+                    }
+                }
+                ops += 64;
+            }
+            total_ops += ops;
+        });
+    }
+
+    auto start = Clock::now();
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    stop = true;
+    for (auto& w : workers) w.join();
+    double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    return total_ops.load() / elapsed;
+}
+
+}
+
+int main(int argc, char** argv) {
+    size_t keys = argc > 1 ? std::stoul(argv[1]) : 100000;
+    double seconds = argc > 2 ? std::stod(argv[2]) : 1.0;
+
+    std::string dir = enter_scratch_dir("shard_bench");
+    if (dir.empty()) return 1;
+
+    const int thread_counts[] = {1, 2, 4, 8, 16, 32};
+    const int write_percents[] = {0, 10};
+
+    std::cout << "keys: " << keys << ", " << seconds << " s per run, hardware threads: "
+              << std::thread::hardware_concurrency() << "\n\n";
+
+    for (const char* policy : {"ENHANCED", "LRU"}) {
+        for (size_t shards : {size_t(1), DEFAULT_SHARD_COUNT}) {
+            std::unique_ptr<DB> db;
+            if (std::string(policy) == "ENHANCED") {
+                db.reset(new EnhancedDB(keys * 2, shards));
+            } else {
+                db.reset(new LRUDB(keys * 2, shards));
+            }
+            for (size_t i = 0; i < keys; ++i) {
+                db->set("key:" + std::to_string(i), "value");
+            }
+
+            for (int write_percent : write_percents) {
+                std::cout << policy << ", shards " << shards << ", " << write_percent << "% SET\n";
+                std::cout << "  threads      ops/s\n";
+                for (int threads : thread_counts) {
+                    double rate = run(db.get(), keys, threads, write_percent, seconds);
+                    std::cout << "  " << std::setw(7) << threads << "  " << std::setw(10)
+                              << static_cast<size_t>(rate) << "\n";
+                }
+            }
+            std::cout << std::endl;
+            std::remove("db.aof");
+        }
+    }
+
+    rmdir(dir.c_str());
+    return 0;
+}
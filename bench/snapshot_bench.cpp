@@ -0,0 +1,153 @@
+/*
+ * snapshot_bench.cpp
+ * SAVE / LOAD time and peak memory: binary snapshot vs the old JSON dump,
+ * and how long writers stall during SAVE vs BGSAVE.
+ *
+ * Usage: snapshot_bench [keys]
+ * Default: 1M keys, a mix of strings, lists, sets and hashes.
+ *
+ * Every measurement runs in a forked child that builds the dataset, resets
+ * the peak RSS counter and then saves or loads, so the reported peak is the
+ * memory the save or load needs on top of the dataset itself.
+ */
+
+#include "db.h"
+#include "bench_common.h"
+#include "snapshot.h"
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <memory>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+size_t peak_rss_kb() {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 6, "VmHWM:") == 0) return std::stoul(line.substr(6));
+    }
+    return 0;
+}
+
+size_t current_rss_kb() {
+    std::ifstream statm("/proc/self/statm");
+    size_t pages = 0, resident = 0;
+    statm >> pages >> resident;
+    return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE)) / 1024;
+}
+
+void reset_peak_rss() {
+    std::ofstream("/proc/self/clear_refs") << "5";
+}
+
+size_t file_size(const std::string& path) {
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 ? static_cast<size_t>(st.st_size) : 0;
+}
+
+void fill(EnhancedDB& db, size_t keys) {
+    for (size_t i = 0; i < keys; ++i) {
+        std::string key = "key:" + std::to_string(i);
+        switch (i % 8) {
+            case 0:
+                db.lpush(key, {"a" + std::to_string(i), "b", "c", "d"});
+                break;
+            case 1:
+                db.sadd(key, {"x" + std::to_string(i), "y", "z"});
+                break;
+            case 2:
+                db.hset(key, "name", "user" + std::to_string(i));
+                db.hset(key, "visits", std::to_string(i % 1000));
+                break;
+            default:
+                db.set(key, "value:" + std::to_string(i) + ":padding-padding");
+                break;
+        }
+    }
+}
+
+// Runs `step` in a child process on a freshly filled DB.
+template <typename Step>
+void measure(const std::string& name, size_t keys, Step step) {
+    std::cout.flush();
+    pid_t pid = fork();
+    if (pid == 0) {
+        std::unique_ptr<EnhancedDB> db(new EnhancedDB(keys * 2));
+        fill(*db, keys);
+        size_t base = current_rss_kb();
+        reset_peak_rss();
+        auto start = std::chrono::steady_clock::now();
+        step(*db);
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        size_t peak = peak_rss_kb();
+        std::cout << name << ": " << secs << " s, peak RSS +" << (peak > base ? peak - base : 0) / 1024
+                  << " MB over the dataset (" << db->dbsize() << " keys)" << std::endl;
+        std::_Exit(0);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+}
+
+// Runs SETs on another thread while `save` runs and reports the slowest.
+template <typename Save>
+void measure_write_stall(const std::string& name, size_t keys, Save save) {
+    measure(name, keys, [keys, save, name](EnhancedDB& db) {
+        std::atomic<bool> stop{false};
+        double worst_ms = 0;
+        size_t writes = 0;
+        std::thread writer([&]() {
+            while (!stop.load()) {
+                std::string key = "key:" + std::to_string((writes * 7919) % keys);
+                auto start = std::chrono::steady_clock::now();
+                db.set(key, "updated");
+                double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                if (ms > worst_ms) worst_ms = ms;
+                ++writes;
+            }
+        });
+        save(db);
+        stop = true;
+        writer.join();
+        std::cout << name << ": " << writes << " SETs during the save, slowest " << worst_ms << " ms" << std::endl;
+    });
+}
+
+}
+
+int main(int argc, char** argv) {
+    size_t keys = argc > 1 ? std::stoul(argv[1]) : 1000000;
+
+    std::string dir = enter_scratch_dir("snapshot_bench");
+    if (dir.empty()) return 1;
+    AOFWriter::instance().configure("db.aof", AppendFsync::NO, false);
+
+    measure("json save", keys, [](EnhancedDB& db) { db.save_json("db.json"); });
+    measure("snapshot save", keys, [](EnhancedDB& db) { db.save("db.rdb"); });
+    std::cout << "file size: json " << file_size("db.json") / 1024 << " KB, snapshot "
+              << file_size("db.rdb") / 1024 << " KB" << std::endl;
+
+    // Loads replace the dataset, so the peak covers old and new copies alike.
+    measure("json load", keys, [](EnhancedDB& db) { db.load("db.json"); });
+    measure("snapshot load", keys, [](EnhancedDB& db) { db.load("db.rdb"); });
+
+    measure_write_stall("writes during save", keys, [](EnhancedDB& db) { db.save("db.rdb"); });
+    measure_write_stall("writes during bgsave", keys, [](EnhancedDB& db) {
+        db.bgsave("db.rdb");
+        while (db.bgsave_status().in_progress) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    });
+
+    std::remove("db.json");
+    std::remove("db.rdb");
+    std::remove("db.aof");
+    rmdir(dir.c_str());
+    return 0;
+}
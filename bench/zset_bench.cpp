@@ -0,0 +1,97 @@
+/*
+ * zset_bench.cpp
+ * Sorted set operations on a leaderboard-sized key.
+ *
+ * Usage: zset_bench [members] [ops]
+ * Defaults: 1M members, 100k operations per command.
+ *
+ * One key is filled with `members` players with random scores, then each
+ * command runs `ops` times against random players: ZINCRBY (a score
+ * update), ZSCORE, ZRANK, ZREVRANGE 0 9 (the top ten), ZRANGE around a
+ * random rank and ZRANGEBYSCORE LIMIT 0 10 from a random score.
+ */
+
+#include "db.h"
+#include "bench_common.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <random>
+#include <functional>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+void time_ops(const std::string& name, size_t ops, const std::function<void(size_t)>& op) {
+    auto start = Clock::now();
+    for (size_t i = 0; i < ops; ++i) op(i);
+    double us = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / ops;
+    std::cout << name << ": " << us << " us/op" << std::endl;
+}
+
+}
+
+int main(int argc, char** argv) {
+    size_t members = argc > 1 ? std::stoul(argv[1]) : 1000000;
+    size_t ops = argc > 2 ? std::stoul(argv[2]) : 100000;
+
+    std::string dir = enter_scratch_dir("zset_bench");
+    if (dir.empty()) return 1;
+    AOFWriter::instance().configure("db.aof", AppendFsync::NO, false);
+
+    std::unique_ptr<EnhancedDB> db(new EnhancedDB(1024));
+    const std::string key = "leaderboard";
+    std::mt19937_64 rng(42);
+    const double max_score = 1e6;
+
+    auto fill_start = Clock::now();
+    std::vector<std::pair<double, std::string>> batch;
+    size_t added = 0;
+    for (size_t i = 0; i < members; ++i) {
+        batch.emplace_back(static_cast<double>(rng() % static_cast<uint64_t>(max_score)), "player:" + std::to_string(i));
+        if (batch.size() == 1000 || i + 1 == members) {
+            db->zadd(key, batch, added);
+            batch.clear();
+        }
+    }
+    double fill_secs = std::chrono::duration<double>(Clock::now() - fill_start).count();
+    size_t count = 0;
+    db->zcard(key, count);
+    std::cout << "ZADD: " << count << " members in " << fill_secs << " s ("
+              << fill_secs * 1e6 / members << " us/member)" << std::endl;
+
+    auto player = [&]() { return "player:" + std::to_string(rng() % members); };
+    double score;
+    size_t rank;
+    std::vector<ScoredMember> result;
+
+    time_ops("ZINCRBY", ops, [&](size_t) { db->zincrby(key, static_cast<double>(rng() % 100), player(), score); });
+    time_ops("ZSCORE", ops, [&](size_t) { db->zscore(key, player(), score); });
+    time_ops("ZRANK", ops, [&](size_t) { db->zrank(key, player(), false, rank); });
+    time_ops("ZREVRANGE 0 9", ops, [&](size_t) {
+        result.clear();
+        db->zrange(key, 0, 9, true, result);
+    });
+    time_ops("ZRANGE r r+9", ops, [&](size_t) {
+        int start = static_cast<int>(rng() % members);
+        result.clear();
+        db->zrange(key, start, start + 9, false, result);
+    });
+    time_ops("ZRANGEBYSCORE LIMIT 0 10", ops, [&](size_t) {
+        ScoreRange range;
+        range.min = static_cast<double>(rng() % static_cast<uint64_t>(max_score));
+        range.max = max_score * 2;
+        result.clear();
+        db->zrangebyscore(key, range, 0, 10, result);
+    });
+
+    std::remove("db.aof");
+    rmdir(dir.c_str());
+    return 0;
+}
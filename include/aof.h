@@ -0,0 +1,233 @@
+/*
+ * aof.h
+ * Append-only file writer with group commit, fsync policies and
+ * background rewrite (compaction).
+ */
+
+#ifndef AOF_H
+#define AOF_H
+
+#include <string>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <initializer_list>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// When the AOF is flushed to stable storage (Redis "appendfsync").
+enum class AppendFsync {
+    ALWAYS,    // fsync every batch; writers wait for it before replying
+    EVERYSEC,  // fsync at most once per second in the background
+    NO         // leave flushing to the operating system
+};
+
+AppendFsync parse_appendfsync(const std::string& name);
+
+// Builds one binary AOF record in place at the end of `out`:
+//   0xA5 | u32 payload length | u32 CRC-32 of payload | payload
+// where the payload is u32 argc followed by u32 length + bytes for each
+// argument. Integers are little endian.
+class AOFRecord {
+public:
+    static const unsigned char MAGIC = 0xA5;
+    static const size_t HEADER_SIZE = 9;
+
+    explicit AOFRecord(std::string& out);
+    void add(std::string_view arg);
+    void finish();
+
+private:
+    std::string& out_;
+    size_t start_;
+    uint32_t argc_;
+};
+
+// Reads an AOF back. Binary records and lines of the older text format
+// may be mixed in one file.
+class AOFLoader {
+public:
+    enum class Result { OK, NOT_FOUND, TRUNCATED, CORRUPT };
+    struct Stats {
+        size_t records = 0;
+        size_t bytes = 0;  // length of the valid prefix
+    };
+    using Apply = std::function<void(const std::vector<std::string_view>& args)>;
+
+    // Calls `apply` with the arguments of every command in `path`, reading
+    // the file in large blocks. Mutations made on this thread while loading
+    // are not logged again. A record cut short at the end of the file is
+    // dropped (TRUNCATED) and, with `repair`, the file is cut back to the
+    // last complete record. A checksum mismatch, a bad length, or anything
+    // but a record after the first binary one stops the load (CORRUPT) with
+    // `stats->bytes` at the end of the valid prefix. Old text-format lines
+    // are read only at the start of the file.
+    static Result load(const std::string& path, const Apply& apply, bool repair, Stats* stats = nullptr);
+    // True on a thread that is inside load().
+    static bool replaying();
+};
+
+// Temporary file a rewrite streams the compacted dataset into. Passed to
+// the rewrite source, which writes one chunk per shard it has dumped.
+class AOFRewriteFile {
+public:
+    AOFRewriteFile(const std::string& path, uint64_t id);
+    ~AOFRewriteFile();
+
+    // Rewrite this file belongs to. A shard dumped by it records the id so
+    // that later mutations of the shard are captured for the new file.
+    uint64_t id() const { return id_; }
+    void write(const std::string& chunk);
+    bool ok() const { return fd_ >= 0 && ok_; }
+    size_t size() const { return size_; }
+
+private:
+    friend class AOFWriter;
+    bool flush_pending();
+    int release();  // hands the descriptor over to the writer thread
+
+    std::string path_;
+    uint64_t id_;
+    int fd_;
+    bool ok_;
+    size_t size_;
+    std::string pending_;
+};
+
+// Writes the current dataset as commands. Called on the rewrite thread.
+using AOFRewriteSource = std::function<void(AOFRewriteFile&)>;
+
+// Process-wide AOF writer. Commands only append to an in-memory buffer;
+// a background thread owns the file descriptor, writes whatever has
+// accumulated in one batch (group commit) and fsyncs per policy.
+class AOFWriter {
+public:
+    struct Status {
+        bool rewrite_in_progress;
+        bool last_rewrite_ok;
+        uint64_t rewrites;
+        size_t current_size;  // bytes in the live AOF
+        size_t base_size;     // size after the last rewrite (or at startup)
+        bool last_write_ok;   // false while writes or fsyncs are failing
+    };
+
+    static AOFWriter& instance();
+
+    // Reopens the log on `filename`. Buffered entries are written first.
+    void configure(const std::string& filename, AppendFsync policy, bool enabled = true);
+
+    // Queue one encoded record; returns its sequence number for wait_durable().
+    // `rewrite_mark` is the id of the last rewrite that dumped the data the
+    // record modifies; while that rewrite runs the record is also kept for
+    // the new file.
+    uint64_t append(const std::string& record, uint64_t rewrite_mark = 0);
+    // With appendfsync always, block until record `seq` has been fsynced.
+    // False if it was not: writing the log is failing, or the writer stopped.
+    bool wait_durable(uint64_t seq);
+    // Write and fsync everything queued so far; false as for wait_durable().
+    bool flush();
+    // Whether the last write or fsync failed. The writer keeps the records
+    // that did not reach the disk and retries them every second.
+    bool write_failed() const { return write_error_.load(std::memory_order_relaxed); }
+
+    // Background rewrite. The source produces the compacted file. The
+    // writer starts a rewrite on its own once the log has grown
+    // `percentage` percent past its base size and is at least `min_size`
+    // bytes; a percentage of 0 disables that.
+    void set_rewrite_source(AOFRewriteSource source);
+    void set_auto_rewrite(unsigned percentage, size_t min_size);
+    // Returns false if a rewrite is already running or there is no source.
+    bool start_rewrite();
+    // Id of the rewrite currently dumping the dataset, 0 if none. Operations
+    // that replace the whole dataset mark every shard with it, so the
+    // rewrite keeps their log records instead of dumping those shards.
+    uint64_t capture_id();
+    Status status();
+
+    std::string filename();
+    AppendFsync policy();
+    bool enabled();
+
+    ~AOFWriter();
+
+private:
+    // A finished rewrite waiting for the writer thread to swap it in.
+    struct PendingSwap {
+        bool ready = false;
+        int fd = -1;
+        std::string temp_path;
+        size_t size = 0;
+        std::string tail;   // captured writes not yet in the new file
+        std::string stale;  // unwritten old-file entries, only kept if the swap fails
+    };
+
+    AOFWriter();
+    AOFWriter(const AOFWriter&) = delete;
+    AOFWriter& operator=(const AOFWriter&) = delete;
+
+    void run();
+    void run_rewrite(AOFRewriteSource source, uint64_t id, std::string path);
+    bool start_rewrite_locked();
+    bool auto_rewrite_due() const;
+
+    std::mutex mutex_;
+    std::condition_variable has_data_;
+    std::condition_variable written_;
+
+    std::string filename_;
+    AppendFsync policy_;
+    bool enabled_;
+    bool reopen_;                 // filename changed; writer switches files
+
+    std::string buffer_;          // filled by the command path
+    uint64_t appended_seq_;       // last sequence handed out
+    uint64_t synced_seq_;         // last sequence written and fsynced
+    uint64_t flush_requested_;    // flush() waits for this sequence
+
+    // Rewrite state
+    AOFRewriteSource rewrite_source_;
+    unsigned auto_rewrite_pct_;
+    size_t auto_rewrite_min_size_;
+    bool rewrite_in_progress_;    // from start until the new file is swapped in
+    bool capturing_;              // dump running; marked entries go to rewrite_buffer_
+    uint64_t rewrite_id_;
+    std::string rewrite_buffer_;
+    PendingSwap swap_;
+    bool last_rewrite_ok_;
+    uint64_t rewrites_;
+    size_t current_size_;
+    size_t base_size_;
+    std::thread rewrite_thread_;
+    std::atomic<bool> write_error_;  // last write or fsync failed; cleared once one succeeds
+
+    bool running_;
+    std::thread thread_;
+};
+
+// Logs a mutation to the AOF. Declare it before taking the data lock: under
+// appendfsync always the destructor waits for the fsync, which then happens
+// after the lock has been released.
+class AOFCommit {
+public:
+    AOFCommit() = default;
+    ~AOFCommit();
+    void log(std::initializer_list<std::string_view> args, uint64_t rewrite_mark = 0);
+    // Logs `args` followed by every element of `tail`.
+    void log(std::initializer_list<std::string_view> args, const std::vector<std::string>& tail,
+             uint64_t rewrite_mark = 0);
+    // Logs records already encoded with AOFRecord.
+    void log_records(const std::string& records, uint64_t rewrite_mark = 0);
+
+    // Whether every commit this thread made since the last call was made
+    // durable as the fsync policy requires. Clears the record.
+    static bool take_durable();
+
+private:
+    uint64_t seq_ = 0;
+};
+
+#endif // AOF_H
@@ -6,36 +6,84 @@
 #ifndef ARC_CACHE_H
 #define ARC_CACHE_H
 
+#include "data_types.h"
+#include "intrusive_list.h"
 #include <string>
 #include <unordered_map>
 #include <list>
+#include <chrono>
 #include <cstddef>
+#include <cstdint>
 
+// Counters of the ARC policy, summed over the shards for INFO.
+struct ARCStats {
+    size_t target_t1 = 0;     // p: the size ARC aims to give T1
+    size_t frequent = 0;      // |T2|
+    size_t ghosts = 0;        // |B1| + |B2|
+    uint64_t hits = 0;
+    std::chrono::nanoseconds hit_time{0};  // spent relinking hit entries
+
+    void merge(const ARCStats& other) {
+        target_t1 += other.target_t1;
+        frequent += other.frequent;
+        ghosts += other.ghosts;
+        hits += other.hits;
+        hit_time += other.hit_time;
+    }
+};
+
+// Adaptive Replacement Cache (Megiddo and Modha) over the entries of a
+// Keyspace table, used by EnhancedCache under EvictionPolicy::ARC. The
+// table owns the keys and values; ARCCache threads resident entries onto
+// T1 (used once lately) or T2 (used at least twice) through their LruTag
+// hook, and remembers the keys it evicted from each in the ghost lists B1
+// and B2. A new key found in B1 grows `p`, the target size of T1, and one
+// found in B2 shrinks it, so the split follows whichever list would have
+// kept the key. The cache size c is the number of resident keys, which
+// lets the same policy run under a key-count or a memory limit.
 class ARCCache {
+public:
+    ARCCache() = default;
+    ~ARCCache();
+    ARCCache(const ARCCache&) = delete;
+    ARCCache& operator=(const ARCCache&) = delete;
+
+    // `entry` was just added to the table, which now holds `resident` keys.
+    void insert(KeyEntry& entry, const std::string& key, size_t resident);
+    // Access to a resident entry: moves it to the MRU end of T2.
+    void hit(KeyEntry& entry);
+    // Entry ARC's REPLACE step would evict, other than `spare`; nullptr if
+    // there is none.
+    KeyEntry* victim(const KeyEntry& spare, size_t resident);
+    // Records that `entry`, returned by victim(), is being evicted and the
+    // table will hold `resident` keys afterwards.
+    void evicted(KeyEntry& entry, const std::string& key, size_t resident);
+    // Unlinks every entry and forgets the ghosts, when the policy changes.
+    void clear();
+
+    ARCStats stats() const;
+    // Heap bytes held by the ghost lists. INFO counts them, but they are
+    // bounded by the key count rather than by the memory limit.
+    size_t ghost_bytes() const { return ghost_bytes_; }
+
 private:
-    struct Entry { std::string key, value; };
-    std::list<Entry> t1_, t2_, b1_, b2_; // ARC lists: recent, frequent, ghost lists
-    std::unordered_map<std::string, std::list<Entry>::iterator> t1_map_, t2_map_;
-    std::unordered_map<std::string, std::list<Entry>::iterator> b1_map_, b2_map_;
-    size_t p_, size_;
-    size_t hits_, misses_;
-    double total_hit_latency_ms_ = 0.0; // New: to track total latency for hits
-    size_t eviction_count_ = 0;        // New: to track evictions
-
-    void replace(const std::string& key, const std::string& value);
-    void move_to_t2(const std::string& key);
+    using Ghosts = std::list<std::string>;
 
-public:
-    ARCCache(size_t size);
-    void put(const std::string& key, const std::string& value);
-    bool get(const std::string& key, std::string& value);
-    size_t get_hits() const { return hits_; }
-    size_t get_misses() const { return misses_; }
-    double get_avg_hit_latency() const { return total_hit_latency_ms_ / (hits_ > 0 ? hits_ : 1); }
-    size_t get_eviction_count() const { return eviction_count_; }
-    void erase(const std::string& key);
-    void set_expiry(const std::string& key, int seconds);
-    std::unordered_map<std::string, std::string> get_items() const; // For saving cache content
+    void remember(Ghosts& list, std::unordered_map<std::string, Ghosts::iterator>& map, const std::string& key);
+    void forget(Ghosts& list, std::unordered_map<std::string, Ghosts::iterator>& map,
+                std::unordered_map<std::string, Ghosts::iterator>::iterator it);
+    void move_to_t2(KeyEntry& entry);
+    static size_t ghost_entry_bytes(const std::string& key);
+
+    IntrusiveList<KeyEntry, LruTag> t1_, t2_;  // MRU at the front
+    size_t t2_size_ = 0;  // charged by the entries on T2
+    Ghosts b1_, b2_;      // MRU at the front
+    std::unordered_map<std::string, Ghosts::iterator> b1_map_, b2_map_;
+    size_t p_ = 0;
+    bool last_from_b2_ = false;  // the latest insert was a B2 ghost hit
+    size_t ghost_bytes_ = 0;
+    uint64_t hits_ = 0;
+    std::chrono::nanoseconds hit_time_{0};
 };
 
-#endif // ARC_CACHE_H 
\ No newline at end of file
+#endif // ARC_CACHE_H
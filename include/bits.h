@@ -0,0 +1,40 @@
+#pragma once
+#include <cstdint>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Bit operations the compilers provide as intrinsics under different
+// names. The count-trailing-zeros helpers are undefined for 0, like the
+// intrinsics they wrap.
+
+inline unsigned ctz32(uint32_t v) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, v);
+    return static_cast<unsigned>(index);
+#else
+    return static_cast<unsigned>(__builtin_ctz(v));
+#endif
+}
+
+inline unsigned ctz64(uint64_t v) {
+#if defined(_MSC_VER) && defined(_WIN64)
+    unsigned long index;
+    _BitScanForward64(&index, v);
+    return static_cast<unsigned>(index);
+#elif defined(_MSC_VER)
+    uint32_t low = static_cast<uint32_t>(v);
+    return low ? ctz32(low) : 32 + ctz32(static_cast<uint32_t>(v >> 32));
+#else
+    return static_cast<unsigned>(__builtin_ctzll(v));
+#endif
+}
+
+inline uint64_t bswap64(uint64_t v) {
+#if defined(_MSC_VER)
+    return _byteswap_uint64(v);
+#else
+    return __builtin_bswap64(v);
+#endif
+}
@@ -0,0 +1,192 @@
+/*
+ * command_table.h
+ * The commands the enhanced server understands, with the metadata the
+ * dispatcher checks before running one (arity, authentication) and that
+ * other features can read: whether it writes, where its keys are and
+ * which ACL category it belongs to.
+ *
+ * Names are found through a perfect hash built at compile time: the
+ * table's seed is searched for so that no two names, folded to upper
+ * case, share a slot. A lookup hashes the name once, reads one slot and
+ * compares one name, without allocating or copying the name.
+ */
+
+#ifndef COMMAND_TABLE_H
+#define COMMAND_TABLE_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+enum class CommandId : uint8_t {
+    AUTH, SET, GET, DEL, EXISTS, TYPE, KEYS, SCAN,
+    INCR, DECR, INCRBY, DECRBY,
+    LPUSH, RPUSH, LPOP, RPOP, LLEN, LRANGE,
+    SADD, SREM, SMEMBERS, SCARD, SISMEMBER, SSCAN,
+    HSET, HGET, HDEL, HGETALL, HKEYS, HVALS, HSCAN,
+    ZADD, ZINCRBY, ZREM, ZCARD, ZSCORE, ZRANK, ZREVRANK, ZRANGE, ZREVRANGE, ZRANGEBYSCORE, ZSCAN,
+    SAVE, LOAD, BGSAVE, BGREWRITEAOF, EXPIRE, FLUSHDB, DBSIZE, INFO,
+    PING, SUBSCRIBE, UNSUBSCRIBE, PUBLISH, QUIT,
+    COUNT
+};
+
+enum CommandFlags : uint8_t {
+    CMD_WRITE = 1 << 0,     // may change the dataset
+    CMD_READONLY = 1 << 1,  // reads the dataset only
+    CMD_ADMIN = 1 << 2,     // persistence and server state
+    CMD_PUBSUB = 1 << 3,    // channels rather than keys
+    CMD_NO_AUTH = 1 << 4,   // allowed before the client has authenticated
+};
+
+// The ACL category (Redis's @string, @list, ...) a command belongs to.
+enum class AclCategory : uint8_t {
+    KEYSPACE, STRING, LIST, SET, HASH, SORTED_SET, PUBSUB, CONNECTION, ADMIN
+};
+
+struct CommandSpec {
+    std::string_view name;  // upper case
+    CommandId id;
+    int8_t arity;      // arguments including the name; -N means at least N
+    uint8_t flags;     // CommandFlags
+    int8_t first_key;  // argument index of the first key, 0 if it takes none
+    int8_t last_key;   // of the last key; -1 is the last argument
+    int8_t key_step;   // distance between keys
+    AclCategory category;
+
+    // Whether `argc` arguments, the name included, fit the arity.
+    constexpr bool accepts(size_t argc) const {
+        return arity >= 0 ? argc == static_cast<size_t>(arity) : argc >= static_cast<size_t>(-arity);
+    }
+};
+
+// Indexed by CommandId. Commands that never checked their argument count
+// keep accepting any, so their arity is -1.
+inline constexpr CommandSpec COMMANDS[] = {
+    {"AUTH", CommandId::AUTH, 2, CMD_NO_AUTH, 0, 0, 0, AclCategory::CONNECTION},
+    {"SET", CommandId::SET, 3, CMD_WRITE, 1, 1, 1, AclCategory::STRING},
+    {"GET", CommandId::GET, 2, CMD_READONLY, 1, 1, 1, AclCategory::STRING},
+    {"DEL", CommandId::DEL, -2, CMD_WRITE, 1, -1, 1, AclCategory::KEYSPACE},
+    {"EXISTS", CommandId::EXISTS, 2, CMD_READONLY, 1, 1, 1, AclCategory::KEYSPACE},
+    {"TYPE", CommandId::TYPE, 2, CMD_READONLY, 1, 1, 1, AclCategory::KEYSPACE},
+    {"KEYS", CommandId::KEYS, -1, CMD_READONLY, 0, 0, 0, AclCategory::KEYSPACE},
+    {"SCAN", CommandId::SCAN, -2, CMD_READONLY, 0, 0, 0, AclCategory::KEYSPACE},
+    {"INCR", CommandId::INCR, 2, CMD_WRITE, 1, 1, 1, AclCategory::STRING},
+    {"DECR", CommandId::DECR, 2, CMD_WRITE, 1, 1, 1, AclCategory::STRING},
+    {"INCRBY", CommandId::INCRBY, 3, CMD_WRITE, 1, 1, 1, AclCategory::STRING},
+    {"DECRBY", CommandId::DECRBY, 3, CMD_WRITE, 1, 1, 1, AclCategory::STRING},
+    {"LPUSH", CommandId::LPUSH, -3, CMD_WRITE, 1, 1, 1, AclCategory::LIST},
+    {"RPUSH", CommandId::RPUSH, -3, CMD_WRITE, 1, 1, 1, AclCategory::LIST},
+    {"LPOP", CommandId::LPOP, 2, CMD_WRITE, 1, 1, 1, AclCategory::LIST},
+    {"RPOP", CommandId::RPOP, 2, CMD_WRITE, 1, 1, 1, AclCategory::LIST},
+    {"LLEN", CommandId::LLEN, 2, CMD_READONLY, 1, 1, 1, AclCategory::LIST},
+    {"LRANGE", CommandId::LRANGE, 4, CMD_READONLY, 1, 1, 1, AclCategory::LIST},
+    {"SADD", CommandId::SADD, -3, CMD_WRITE, 1, 1, 1, AclCategory::SET},
+    {"SREM", CommandId::SREM, -3, CMD_WRITE, 1, 1, 1, AclCategory::SET},
+    {"SMEMBERS", CommandId::SMEMBERS, 2, CMD_READONLY, 1, 1, 1, AclCategory::SET},
+    {"SCARD", CommandId::SCARD, 2, CMD_READONLY, 1, 1, 1, AclCategory::SET},
+    {"SISMEMBER", CommandId::SISMEMBER, 3, CMD_READONLY, 1, 1, 1, AclCategory::SET},
+    {"SSCAN", CommandId::SSCAN, -3, CMD_READONLY, 1, 1, 1, AclCategory::SET},
+    {"HSET", CommandId::HSET, 4, CMD_WRITE, 1, 1, 1, AclCategory::HASH},
+    {"HGET", CommandId::HGET, 3, CMD_READONLY, 1, 1, 1, AclCategory::HASH},
+    {"HDEL", CommandId::HDEL, -3, CMD_WRITE, 1, 1, 1, AclCategory::HASH},
+    {"HGETALL", CommandId::HGETALL, 2, CMD_READONLY, 1, 1, 1, AclCategory::HASH},
+    {"HKEYS", CommandId::HKEYS, 2, CMD_READONLY, 1, 1, 1, AclCategory::HASH},
+    {"HVALS", CommandId::HVALS, 2, CMD_READONLY, 1, 1, 1, AclCategory::HASH},
+    {"HSCAN", CommandId::HSCAN, -3, CMD_READONLY, 1, 1, 1, AclCategory::HASH},
+    {"ZADD", CommandId::ZADD, -4, CMD_WRITE, 1, 1, 1, AclCategory::SORTED_SET},
+    {"ZINCRBY", CommandId::ZINCRBY, 4, CMD_WRITE, 1, 1, 1, AclCategory::SORTED_SET},
+    {"ZREM", CommandId::ZREM, -3, CMD_WRITE, 1, 1, 1, AclCategory::SORTED_SET},
+    {"ZCARD", CommandId::ZCARD, 2, CMD_READONLY, 1, 1, 1, AclCategory::SORTED_SET},
+    {"ZSCORE", CommandId::ZSCORE, 3, CMD_READONLY, 1, 1, 1, AclCategory::SORTED_SET},
+    {"ZRANK", CommandId::ZRANK, 3, CMD_READONLY, 1, 1, 1, AclCategory::SORTED_SET},
+    {"ZREVRANK", CommandId::ZREVRANK, 3, CMD_READONLY, 1, 1, 1, AclCategory::SORTED_SET},
+    {"ZRANGE", CommandId::ZRANGE, -4, CMD_READONLY, 1, 1, 1, AclCategory::SORTED_SET},
+    {"ZREVRANGE", CommandId::ZREVRANGE, -4, CMD_READONLY, 1, 1, 1, AclCategory::SORTED_SET},
+    {"ZRANGEBYSCORE", CommandId::ZRANGEBYSCORE, -4, CMD_READONLY, 1, 1, 1, AclCategory::SORTED_SET},
+    {"ZSCAN", CommandId::ZSCAN, -3, CMD_READONLY, 1, 1, 1, AclCategory::SORTED_SET},
+    {"SAVE", CommandId::SAVE, -1, CMD_ADMIN, 0, 0, 0, AclCategory::ADMIN},
+    {"LOAD", CommandId::LOAD, -1, CMD_WRITE | CMD_ADMIN, 0, 0, 0, AclCategory::ADMIN},
+    {"BGSAVE", CommandId::BGSAVE, -1, CMD_ADMIN, 0, 0, 0, AclCategory::ADMIN},
+    {"BGREWRITEAOF", CommandId::BGREWRITEAOF, -1, CMD_ADMIN, 0, 0, 0, AclCategory::ADMIN},
+    {"EXPIRE", CommandId::EXPIRE, 3, CMD_WRITE, 1, 1, 1, AclCategory::KEYSPACE},
+    {"FLUSHDB", CommandId::FLUSHDB, -1, CMD_WRITE, 0, 0, 0, AclCategory::KEYSPACE},
+    {"DBSIZE", CommandId::DBSIZE, -1, CMD_READONLY, 0, 0, 0, AclCategory::KEYSPACE},
+    {"INFO", CommandId::INFO, -1, CMD_ADMIN, 0, 0, 0, AclCategory::ADMIN},
+    {"PING", CommandId::PING, -1, 0, 0, 0, 0, AclCategory::CONNECTION},
+    {"SUBSCRIBE", CommandId::SUBSCRIBE, -2, CMD_PUBSUB, 0, 0, 0, AclCategory::PUBSUB},
+    {"UNSUBSCRIBE", CommandId::UNSUBSCRIBE, -2, CMD_PUBSUB, 0, 0, 0, AclCategory::PUBSUB},
+    {"PUBLISH", CommandId::PUBLISH, 3, CMD_PUBSUB, 0, 0, 0, AclCategory::PUBSUB},
+    {"QUIT", CommandId::QUIT, -1, 0, 0, 0, 0, AclCategory::CONNECTION},
+};
+
+namespace command_table_detail {
+
+constexpr size_t COMMAND_COUNT = sizeof(COMMANDS) / sizeof(COMMANDS[0]);
+constexpr size_t SLOTS = 512;  // power of two, about 10x the commands
+constexpr uint8_t NO_COMMAND = 0xFF;
+
+static_assert(COMMAND_COUNT == static_cast<size_t>(CommandId::COUNT), "a command is missing from COMMANDS");
+static_assert(COMMAND_COUNT < NO_COMMAND, "slot entries are 8 bits");
+
+constexpr bool ordered_by_id() {
+    for (size_t i = 0; i < COMMAND_COUNT; ++i) {
+        if (static_cast<size_t>(COMMANDS[i].id) != i) return false;
+    }
+    return true;
+}
+static_assert(ordered_by_id(), "COMMANDS must be in CommandId order");
+
+constexpr char upper(char c) { return c >= 'a' && c <= 'z' ? static_cast<char>(c - 'a' + 'A') : c; }
+
+// FNV-1a over the upper-cased name, mixed with `seed`.
+constexpr uint32_t hash(std::string_view name, uint32_t seed) {
+    uint32_t h = 2166136261u ^ seed;
+    for (char c : name) {
+        h ^= static_cast<uint8_t>(upper(c));
+        h *= 16777619u;
+    }
+    return h ^ (h >> 16);
+}
+
+struct Index {
+    uint32_t seed = 0;
+    std::array<uint8_t, SLOTS> slots{};
+};
+
+// Tries seeds until every command lands in a slot of its own.
+constexpr Index build_index() {
+    for (uint32_t seed = 1;; ++seed) {
+        Index index;
+        index.seed = seed;
+        for (auto& slot : index.slots) slot = NO_COMMAND;
+        bool perfect = true;
+        for (size_t i = 0; i < COMMAND_COUNT && perfect; ++i) {
+            uint8_t& slot = index.slots[hash(COMMANDS[i].name, seed) & (SLOTS - 1)];
+            perfect = slot == NO_COMMAND;
+            slot = static_cast<uint8_t>(i);
+        }
+        if (perfect) return index;
+    }
+}
+
+inline constexpr Index INDEX = build_index();
+
+}  // namespace command_table_detail
+
+// The command called `name`, in any letter case; nullptr if there is none.
+inline const CommandSpec* find_command(std::string_view name) {
+    using namespace command_table_detail;
+    uint8_t index = INDEX.slots[hash(name, INDEX.seed) & (SLOTS - 1)];
+    if (index == NO_COMMAND) return nullptr;
+    const CommandSpec& spec = COMMANDS[index];
+    if (spec.name.size() != name.size()) return nullptr;
+    for (size_t i = 0; i < name.size(); ++i) {
+        if (upper(name[i]) != spec.name[i]) return nullptr;
+    }
+    return &spec;
+}
+
+inline const CommandSpec& command_spec(CommandId id) { return COMMANDS[static_cast<size_t>(id)]; }
+
+#endif // COMMAND_TABLE_H
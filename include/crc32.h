@@ -0,0 +1,15 @@
+/*
+ * crc32.h
+ * CRC-32 (IEEE 802.3, as used by zlib) for persistence checksums.
+ */
+
+#ifndef CRC32_H
+#define CRC32_H
+
+#include <cstdint>
+#include <cstddef>
+
+// Continues `crc` over `len` bytes; start with 0.
+uint32_t crc32(const void* data, size_t len, uint32_t crc = 0);
+
+#endif // CRC32_H
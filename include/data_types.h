@@ -4,7 +4,15 @@
 #include <set>
 #include <unordered_map>
 #include <variant>
+#include <chrono>
 #include <json.hpp>
+#include "intrusive_list.h"
+#include "quicklist.h"
+#include "sorted_set.h"
+#include "encodings.h"
+#include "memory_usage.h"
+#include "swiss_table.h"
+#include "glob.h"
 
 // Different data types that can be stored
 enum class DataType {
@@ -19,19 +27,24 @@ enum class DataType {
 struct DataValue {
     DataType type;
     std::variant<
-        std::string,                                    // STRING
-        std::vector<std::string>,                       // LIST
-        std::set<std::string>,                         // SET
-        std::unordered_map<std::string, std::string>,  // HASH
-        std::map<std::string, double>                  // ZSET (member -> score)
+        StringValue,                                    // STRING
+        QuickList,                                      // LIST
+        SetValue,                                       // SET
+        HashValue,                                      // HASH
+        SortedSet                                       // ZSET
     > data;
     
-    DataValue() : type(DataType::STRING), data(std::string()) {}
-    DataValue(const std::string& str) : type(DataType::STRING), data(str) {}
-    DataValue(const std::vector<std::string>& list) : type(DataType::LIST), data(list) {}
-    DataValue(const std::set<std::string>& set) : type(DataType::SET), data(set) {}
-    DataValue(const std::unordered_map<std::string, std::string>& hash) : type(DataType::HASH), data(hash) {}
-    DataValue(const std::map<std::string, double>& zset) : type(DataType::ZSET), data(zset) {}
+    DataValue() : type(DataType::STRING), data(StringValue()) {}
+    DataValue(const std::string& str) : type(DataType::STRING), data(StringValue(str)) {}
+    DataValue(const QuickList& list) : type(DataType::LIST), data(list) {}
+    DataValue(const SetValue& set) : type(DataType::SET), data(set) {}
+    DataValue(const HashValue& hash) : type(DataType::HASH), data(hash) {}
+    DataValue(const SortedSet& zset) : type(DataType::ZSET), data(zset) {}
+    DataValue(StringValue&& str) : type(DataType::STRING), data(std::move(str)) {}
+    DataValue(QuickList&& list) : type(DataType::LIST), data(std::move(list)) {}
+    DataValue(SetValue&& set) : type(DataType::SET), data(std::move(set)) {}
+    DataValue(HashValue&& hash) : type(DataType::HASH), data(std::move(hash)) {}
+    DataValue(SortedSet&& zset) : type(DataType::ZSET), data(std::move(zset)) {}
     
     // Convert to JSON for persistence
     nlohmann::json to_json() const;
@@ -39,68 +52,131 @@ struct DataValue {
     
     // Get string representation
     std::string to_string() const;
+    
+    // Heap bytes held by the value beyond sizeof(DataValue); O(1).
+    size_t memory_usage() const;
+};
+
+// Hook tags for the lists an entry can belong to
+struct LruTag {};
+struct ExpiryTag {};
+
+// Entry of the main keyspace table: the value plus the metadata the
+// eviction policy keeps for it. The key and value are stored only here;
+// the policy links entries through the embedded hooks, which unlink
+// themselves when the table erases the entry, and charges their size to
+// its memory total, which the entry likewise hands back when erased.
+struct KeyEntry : ListHook<LruTag>, ListHook<ExpiryTag> {
+    DataValue value;
+    const std::string* key = nullptr;  // the table's copy of the key, set once linked
+    std::chrono::steady_clock::time_point expires_at;  // valid while on the expiry wheel
+    MemoryCharge charge;  // against the owning cache's used memory
+    uint32_t access = 0;  // 24 bits of sampled-eviction state (access_bits)
+    MemoryCharge segment;  // 1 against the size of the policy list holding it (ARC, W-TinyLFU)
+    
+    KeyEntry() = default;
+    KeyEntry(const DataValue& v) : value(v) {}
 };
 
+using Keyspace = SwissTable<std::string, KeyEntry>;
+
+// Member and score, as returned by sorted set range queries
+using ScoredMember = std::pair<std::string, double>;
+
 // Database operations for different data types
 class DataOperations {
 public:
     // String operations
-    static bool set_string(std::unordered_map<std::string, DataValue>& storage, 
+    static bool set_string(Keyspace& storage, 
                           const std::string& key, const std::string& value);
-    static bool get_string(const std::unordered_map<std::string, DataValue>& storage, 
+    static bool get_string(const Keyspace& storage, 
                           const std::string& key, std::string& value);
-    static bool incr(std::unordered_map<std::string, DataValue>& storage, 
+    static bool incr(Keyspace& storage, 
                     const std::string& key, int64_t& result);
-    static bool decr(std::unordered_map<std::string, DataValue>& storage, 
+    static bool decr(Keyspace& storage, 
                     const std::string& key, int64_t& result);
+    static bool incrby(Keyspace& storage, 
+                      const std::string& key, int64_t delta, int64_t& result);
     
     // List operations
-    static bool lpush(std::unordered_map<std::string, DataValue>& storage, 
+    static bool lpush(Keyspace& storage, 
                      const std::string& key, const std::vector<std::string>& values);
-    static bool rpush(std::unordered_map<std::string, DataValue>& storage, 
+    static bool rpush(Keyspace& storage, 
                      const std::string& key, const std::vector<std::string>& values);
-    static bool lpop(std::unordered_map<std::string, DataValue>& storage, 
+    static bool lpop(Keyspace& storage, 
                     const std::string& key, std::string& value);
-    static bool rpop(std::unordered_map<std::string, DataValue>& storage, 
+    static bool rpop(Keyspace& storage, 
                     const std::string& key, std::string& value);
-    static bool llen(const std::unordered_map<std::string, DataValue>& storage, 
+    static bool llen(const Keyspace& storage, 
                     const std::string& key, size_t& length);
-    static bool lrange(const std::unordered_map<std::string, DataValue>& storage, 
+    static bool lrange(const Keyspace& storage, 
                       const std::string& key, int start, int stop, std::vector<std::string>& result);
     
     // Set operations
-    static bool sadd(std::unordered_map<std::string, DataValue>& storage, 
+    static bool sadd(Keyspace& storage, 
                     const std::string& key, const std::vector<std::string>& members);
-    static bool srem(std::unordered_map<std::string, DataValue>& storage, 
+    static bool srem(Keyspace& storage, 
                     const std::string& key, const std::vector<std::string>& members);
-    static bool smembers(const std::unordered_map<std::string, DataValue>& storage, 
+    static bool smembers(const Keyspace& storage, 
                         const std::string& key, std::set<std::string>& members);
-    static bool scard(const std::unordered_map<std::string, DataValue>& storage, 
+    static bool scard(const Keyspace& storage, 
                      const std::string& key, size_t& count);
-    static bool sismember(const std::unordered_map<std::string, DataValue>& storage, 
+    static bool sismember(const Keyspace& storage, 
                          const std::string& key, const std::string& member);
     
     // Hash operations
-    static bool hset(std::unordered_map<std::string, DataValue>& storage, 
+    static bool hset(Keyspace& storage, 
                     const std::string& key, const std::string& field, const std::string& value);
-    static bool hget(const std::unordered_map<std::string, DataValue>& storage, 
+    static bool hget(const Keyspace& storage, 
                     const std::string& key, const std::string& field, std::string& value);
-    static bool hdel(std::unordered_map<std::string, DataValue>& storage, 
+    static bool hdel(Keyspace& storage, 
                     const std::string& key, const std::vector<std::string>& fields);
-    static bool hgetall(const std::unordered_map<std::string, DataValue>& storage, 
+    static bool hgetall(const Keyspace& storage, 
                        const std::string& key, std::unordered_map<std::string, std::string>& result);
-    static bool hkeys(const std::unordered_map<std::string, DataValue>& storage, 
+    static bool hkeys(const Keyspace& storage, 
                      const std::string& key, std::vector<std::string>& fields);
-    static bool hvals(const std::unordered_map<std::string, DataValue>& storage, 
+    static bool hvals(const Keyspace& storage, 
                      const std::string& key, std::vector<std::string>& values);
     
+    // Sorted set operations
+    static bool zadd(Keyspace& storage, 
+                    const std::string& key, const std::vector<std::pair<double, std::string>>& members, size_t& added);
+    static bool zincrby(Keyspace& storage, 
+                       const std::string& key, double increment, const std::string& member, double& score);
+    static bool zrem(Keyspace& storage, 
+                    const std::string& key, const std::vector<std::string>& members, size_t& removed);
+    static bool zcard(const Keyspace& storage, 
+                     const std::string& key, size_t& count);
+    static bool zscore(const Keyspace& storage, 
+                      const std::string& key, const std::string& member, double& score);
+    static bool zrank(const Keyspace& storage, 
+                     const std::string& key, const std::string& member, bool reverse, size_t& rank);
+    static bool zrange(const Keyspace& storage, 
+                      const std::string& key, int start, int stop, bool reverse, std::vector<ScoredMember>& result);
+    static bool zrangebyscore(const Keyspace& storage, 
+                             const std::string& key, const ScoreRange& range, size_t offset, size_t count,
+                             std::vector<ScoredMember>& result);
+    
     // General operations
-    static bool exists(const std::unordered_map<std::string, DataValue>& storage, 
+    static bool exists(const Keyspace& storage, 
                       const std::string& key);
-    static bool del(std::unordered_map<std::string, DataValue>& storage, 
+    static bool del(Keyspace& storage, 
                    const std::string& key);
-    static DataType type(const std::unordered_map<std::string, DataValue>& storage, 
+    static DataType type(const Keyspace& storage, 
                         const std::string& key);
-    static std::vector<std::string> keys(const std::unordered_map<std::string, DataValue>& storage, 
-                                        const std::string& pattern = "*");
+    static std::vector<std::string> keys(const Keyspace& storage, 
+                                        const GlobPattern& pattern);
+    
+    // HSCAN / SSCAN / ZSCAN: append the next elements of `key` matching
+    // `pattern`, visiting about `count`, and return the cursor to resume
+    // from; 0 once the walk is complete or if `key` holds no such value.
+    static size_t hscan(const Keyspace& storage, 
+                       const std::string& key, size_t cursor, size_t count, const GlobPattern& pattern,
+                       std::vector<std::pair<std::string, std::string>>& result);
+    static size_t sscan(const Keyspace& storage, 
+                       const std::string& key, size_t cursor, size_t count, const GlobPattern& pattern,
+                       std::vector<std::string>& result);
+    static size_t zscan(const Keyspace& storage, 
+                       const std::string& key, size_t cursor, size_t count, const GlobPattern& pattern,
+                       std::vector<ScoredMember>& result);
 };
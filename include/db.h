@@ -5,8 +5,14 @@
 #include <unordered_map>
 #include "lru_cache.h"
 #include "lfu_cache.h"
+#include "enhanced_cache.h"
 #include "data_types.h"
+#include "shard.h"
+#include "aof.h"
+#include "snapshot.h"
 #include <mutex>
+#include <optional>
+#include <chrono>
 #include <json.hpp>
 
 class DB {
@@ -16,6 +22,7 @@ public:
     virtual bool get(const std::string& key, std::string& value) = 0;
     virtual bool incr(const std::string& key, int64_t& result) = 0;
     virtual bool decr(const std::string& key, int64_t& result) = 0;
+    virtual bool incrby(const std::string& key, int64_t delta, int64_t& result) = 0;
     
     // List operations
     virtual bool lpush(const std::string& key, const std::vector<std::string>& values) = 0;
@@ -40,29 +47,79 @@ public:
     virtual bool hkeys(const std::string& key, std::vector<std::string>& fields) = 0;
     virtual bool hvals(const std::string& key, std::vector<std::string>& values) = 0;
     
+    // Sorted set operations
+    virtual bool zadd(const std::string& key, const std::vector<std::pair<double, std::string>>& members, size_t& added) = 0;
+    virtual bool zincrby(const std::string& key, double increment, const std::string& member, double& score) = 0;
+    virtual bool zrem(const std::string& key, const std::vector<std::string>& members, size_t& removed) = 0;
+    virtual bool zcard(const std::string& key, size_t& count) = 0;
+    virtual bool zscore(const std::string& key, const std::string& member, double& score) = 0;
+    virtual bool zrank(const std::string& key, const std::string& member, bool reverse, size_t& rank) = 0;
+    virtual bool zrange(const std::string& key, int start, int stop, bool reverse, std::vector<ScoredMember>& result) = 0;
+    virtual bool zrangebyscore(const std::string& key, const ScoreRange& range, size_t offset, size_t count,
+                               std::vector<ScoredMember>& result) = 0;
+    
     // General operations
     virtual void del(const std::string& key) = 0;
     virtual bool exists(const std::string& key) = 0;
     virtual DataType type(const std::string& key) = 0;
     virtual std::vector<std::string> keys(const std::string& pattern = "*") = 0;
+    // Cursor-based iteration (SCAN, HSCAN, SSCAN, ZSCAN): appends the next
+    // keys, or elements of `key`, that match `pattern`, looking at about
+    // `count` of them, and returns the cursor for the next call; 0 once the
+    // walk is complete. A walk from cursor 0 returns every element present
+    // for its whole length at least once, however the tables resize.
+    virtual uint64_t scan(uint64_t cursor, size_t count, const std::string& pattern,
+                          std::vector<std::string>& keys) = 0;
+    virtual uint64_t hscan(const std::string& key, uint64_t cursor, size_t count, const std::string& pattern,
+                           std::vector<std::pair<std::string, std::string>>& fields) = 0;
+    virtual uint64_t sscan(const std::string& key, uint64_t cursor, size_t count, const std::string& pattern,
+                           std::vector<std::string>& members) = 0;
+    virtual uint64_t zscan(const std::string& key, uint64_t cursor, size_t count, const std::string& pattern,
+                           std::vector<ScoredMember>& members) = 0;
     virtual void save(const std::string& filename) = 0;
     virtual void load(const std::string& filename) = 0;
     virtual void expire(const std::string& key, int seconds) = 0;
+    // Expires `key` at an absolute Unix time in milliseconds (PEXPIREAT),
+    // as AOF replay does so the deadline survives restarts unchanged.
+    virtual void expire_at(const std::string& key, int64_t unix_ms) = 0;
     virtual void flushdb() = 0;
     virtual size_t dbsize() = 0;
     
+    // Writes the dataset as a minimal AOF command stream (BGREWRITEAOF)
+    virtual void rewrite_aof(AOFRewriteFile& out) = 0;
+    
+    // Starts writing a snapshot of the dataset as of this call on a
+    // background thread (BGSAVE); false if one is already running.
+    virtual bool bgsave(const std::string& filename) = 0;
+    virtual BackgroundSave::Status bgsave_status() = 0;
+    
+    // Active expiration: removes up to `max_keys` keys whose TTL has passed,
+    // spread over the shards. Keys are also expired lazily on access.
+    virtual size_t active_expire(size_t max_keys) = 0;
+    virtual ExpiryStats expiry_stats() = 0;
+    
+    // Background part of incremental rehashing: moves up to `groups` slot
+    // groups of every resizing table. Returns whether any is still resizing.
+    virtual bool rehash_step(size_t groups) = 0;
+    
+    // Memory limit in bytes, split evenly over the shards; 0 leaves only
+    // the key-count capacity. Writes evict until their shard is under it.
+    virtual void set_max_memory(size_t bytes) = 0;
+    virtual MemoryStats memory_stats() = 0;
+    
     virtual ~DB() = default;
 };
 
 class EnhancedDB : public DB {
 public:
-    EnhancedDB(size_t capacity);
+    EnhancedDB(size_t capacity, size_t num_shards = DEFAULT_SHARD_COUNT);
     
     // String operations
     void set(const std::string& key, const std::string& value) override;
     bool get(const std::string& key, std::string& value) override;
     bool incr(const std::string& key, int64_t& result) override;
     bool decr(const std::string& key, int64_t& result) override;
+    bool incrby(const std::string& key, int64_t delta, int64_t& result) override;
     
     // List operations
     bool lpush(const std::string& key, const std::vector<std::string>& values) override;
@@ -87,16 +144,52 @@ public:
     bool hkeys(const std::string& key, std::vector<std::string>& fields) override;
     bool hvals(const std::string& key, std::vector<std::string>& values) override;
     
+    // Sorted set operations
+    bool zadd(const std::string& key, const std::vector<std::pair<double, std::string>>& members, size_t& added) override;
+    bool zincrby(const std::string& key, double increment, const std::string& member, double& score) override;
+    bool zrem(const std::string& key, const std::vector<std::string>& members, size_t& removed) override;
+    bool zcard(const std::string& key, size_t& count) override;
+    bool zscore(const std::string& key, const std::string& member, double& score) override;
+    bool zrank(const std::string& key, const std::string& member, bool reverse, size_t& rank) override;
+    bool zrange(const std::string& key, int start, int stop, bool reverse, std::vector<ScoredMember>& result) override;
+    bool zrangebyscore(const std::string& key, const ScoreRange& range, size_t offset, size_t count,
+                       std::vector<ScoredMember>& result) override;
+    
     // General operations
     void del(const std::string& key) override;
     bool exists(const std::string& key) override;
     DataType type(const std::string& key) override;
     std::vector<std::string> keys(const std::string& pattern = "*") override;
+    uint64_t scan(uint64_t cursor, size_t count, const std::string& pattern,
+                  std::vector<std::string>& keys) override;
+    uint64_t hscan(const std::string& key, uint64_t cursor, size_t count, const std::string& pattern,
+                   std::vector<std::pair<std::string, std::string>>& fields) override;
+    uint64_t sscan(const std::string& key, uint64_t cursor, size_t count, const std::string& pattern,
+                   std::vector<std::string>& members) override;
+    uint64_t zscan(const std::string& key, uint64_t cursor, size_t count, const std::string& pattern,
+                   std::vector<ScoredMember>& members) override;
     void save(const std::string& filename) override;
     void load(const std::string& filename) override;
     void expire(const std::string& key, int seconds) override;
+    void expire_at(const std::string& key, int64_t unix_ms) override;
     void flushdb() override;
     size_t dbsize() override;
+    void rewrite_aof(AOFRewriteFile& out) override;
+    bool bgsave(const std::string& filename) override;
+    BackgroundSave::Status bgsave_status() override { return bgsave_.status(); }
+    size_t active_expire(size_t max_keys) override;
+    ExpiryStats expiry_stats() override;
+    bool rehash_step(size_t groups) override;
+    void set_max_memory(size_t bytes) override;
+    MemoryStats memory_stats() override;
+    // Eviction policy of every shard; see EnhancedCache::set_eviction_policy.
+    void set_eviction_policy(EvictionPolicy policy, size_t samples = DEFAULT_EVICTION_SAMPLES);
+    // ARC counters of every shard; zero unless the policy is ARC.
+    ARCStats arc_stats();
+    // W-TinyLFU counters of every shard; zero unless the policy is TINY_LFU.
+    TinyLFUStats tiny_lfu_stats();
+    // Legacy JSON dump of the dataset; SAVE writes a binary snapshot.
+    void save_json(const std::string& filename);
     
     // Stats access
     size_t get_hits() const;
@@ -105,20 +198,88 @@ public:
     ~EnhancedDB() override;
 
 private:
-    class EnhancedCache* cache_;
-    std::unordered_map<std::string, DataValue> storage_;
+    // One partition of the keyspace. `storage` is the only copy of each
+    // key and value; `cache` keeps LRU/TTL metadata inside its entries.
+    // Reads update recency and stats, so they take the mutex exclusively too.
+    // `aof_rewrite` is the last AOF rewrite that has dumped the shard.
+    struct Shard {
+        // A key as it was when the running BGSAVE started.
+        struct SavedEntry {
+            DataValue value;
+            bool has_ttl;
+            std::chrono::steady_clock::time_point expires_at;
+        };
+        // BGSAVE walks `storage` with scan(), which visits each key once
+        // even if the table grows meanwhile. Until the walk is over, a key
+        // the walk has not reached at `cursor` has its old value (nullopt if
+        // it did not exist) copied to `saved` before its first change.
+        struct SnapshotState {
+            bool active = false;
+            bool walked = false;
+            size_t cursor = 0;
+            std::unordered_map<std::string, std::optional<SavedEntry>> saved;
+        };
+        
+        std::mutex mutex;
+        Keyspace storage;
+        EnhancedCache cache;  // declared after storage: unlinks entries first
+        uint64_t aof_rewrite = 0;
+        SnapshotState snapshot;
+        
+        explicit Shard(size_t capacity);
+        // Call before modifying or removing `key`. `removing` lets the saved
+        // copy take the value instead of copying it.
+        void before_write(const std::string& key, bool removing = false) {
+            if (snapshot.active && !snapshot.walked && !storage.scanned(key, snapshot.cursor)) {
+                save_for_snapshot(key, removing);
+            }
+        }
+        // Moves every key not yet written into `saved`, before the whole
+        // table is cleared or replaced.
+        void before_clear();
+        
+    private:
+        void save_for_snapshot(const std::string& key, bool removing);
+    };
+    
+    // Marks every shard as dumped by the running AOF rewrite; returns its id.
+    uint64_t mark_all_rewritten();
+    // Body of BGSAVE, run on the background thread.
+    bool write_snapshot(SnapshotWriter& out);
+    // Takes every shard out of snapshot mode and drops the saved values,
+    // after a BGSAVE that did not complete.
+    void abandon_snapshot();
     
-    void sync_to_cache(const std::string& key);
-    void sync_from_cache();
+    ShardSet<Shard> shards_;
+    BackgroundSave bgsave_;  // declared last: waits for the thread before shards go away
+};
+
+// EnhancedDB whose shards evict by ARC instead of LRU, for workloads where
+// scans flush an LRU. Data types, TTLs and persistence are EnhancedDB's.
+class ARCDB : public EnhancedDB {
+public:
+    ARCDB(size_t capacity, size_t num_shards = DEFAULT_SHARD_COUNT);
+    // Average time a hit spends moving its entry onto T2, in milliseconds.
+    double get_avg_hit_latency();
+    size_t get_eviction_count();
+};
+
+// EnhancedDB whose shards evict by W-TinyLFU: new keys must out-score the
+// key they would displace on a frequency sketch to stay, which protects
+// frequently used keys from scans and one-off keys.
+class TinyLFUDB : public EnhancedDB {
+public:
+    TinyLFUDB(size_t capacity, size_t num_shards = DEFAULT_SHARD_COUNT);
 };
 
 class LRUDB : public DB {
 public:
-    LRUDB(size_t capacity);
+    LRUDB(size_t capacity, size_t num_shards = DEFAULT_SHARD_COUNT);
     void set(const std::string& key, const std::string& value) override;
     bool get(const std::string& key, std::string& value) override;
     bool incr(const std::string& key, int64_t& result) override { return false; } // Not implemented
     bool decr(const std::string& key, int64_t& result) override { return false; } // Not implemented
+    bool incrby(const std::string& key, int64_t delta, int64_t& result) override { return false; } // Not implemented
     bool lpush(const std::string& key, const std::vector<std::string>& values) override { return false; }
     bool rpush(const std::string& key, const std::vector<std::string>& values) override { return false; }
     bool lpop(const std::string& key, std::string& value) override { return false; }
@@ -136,26 +297,64 @@ public:
     bool hgetall(const std::string& key, std::unordered_map<std::string, std::string>& result) override { return false; }
     bool hkeys(const std::string& key, std::vector<std::string>& fields) override { return false; }
     bool hvals(const std::string& key, std::vector<std::string>& values) override { return false; }
+    bool zadd(const std::string& key, const std::vector<std::pair<double, std::string>>& members, size_t& added) override { return false; }
+    bool zincrby(const std::string& key, double increment, const std::string& member, double& score) override { return false; }
+    bool zrem(const std::string& key, const std::vector<std::string>& members, size_t& removed) override { return false; }
+    bool zcard(const std::string& key, size_t& count) override { return false; }
+    bool zscore(const std::string& key, const std::string& member, double& score) override { return false; }
+    bool zrank(const std::string& key, const std::string& member, bool reverse, size_t& rank) override { return false; }
+    bool zrange(const std::string& key, int start, int stop, bool reverse, std::vector<ScoredMember>& result) override { return false; }
+    bool zrangebyscore(const std::string& key, const ScoreRange& range, size_t offset, size_t count,
+                       std::vector<ScoredMember>& result) override { return false; }
     void del(const std::string& key) override;
     bool exists(const std::string& key) override { return false; } // Not implemented
     DataType type(const std::string& key) override { return DataType::STRING; }
     std::vector<std::string> keys(const std::string& pattern = "*") override { return {}; }
+    uint64_t scan(uint64_t cursor, size_t count, const std::string& pattern,
+                  std::vector<std::string>& keys) override { return 0; }
+    uint64_t hscan(const std::string& key, uint64_t cursor, size_t count, const std::string& pattern,
+                   std::vector<std::pair<std::string, std::string>>& fields) override { return 0; }
+    uint64_t sscan(const std::string& key, uint64_t cursor, size_t count, const std::string& pattern,
+                   std::vector<std::string>& members) override { return 0; }
+    uint64_t zscan(const std::string& key, uint64_t cursor, size_t count, const std::string& pattern,
+                   std::vector<ScoredMember>& members) override { return 0; }
     void save(const std::string& filename) override;
     void load(const std::string& filename) override;
     void expire(const std::string& key, int seconds) override;
+    void expire_at(const std::string& key, int64_t unix_ms) override;
     void flushdb() override {}
     size_t dbsize() override { return 0; }
+    void rewrite_aof(AOFRewriteFile& out) override;
+    bool bgsave(const std::string& filename) override;
+    BackgroundSave::Status bgsave_status() override { return bgsave_.status(); }
+    size_t active_expire(size_t max_keys) override;
+    ExpiryStats expiry_stats() override;
+    bool rehash_step(size_t groups) override { return false; }  // tables resize at once
+    void set_max_memory(size_t bytes) override;
+    MemoryStats memory_stats() override;
+    size_t get_hits() const;
+    size_t get_misses() const;
     ~LRUDB() override = default;
-    LRUCache* cache_;
+
+private:
+    struct Shard {
+        std::mutex mutex;
+        LRUCache cache;
+        uint64_t aof_rewrite = 0;
+        explicit Shard(size_t capacity) : cache(capacity) {}
+    };
+    ShardSet<Shard> shards_;
+    BackgroundSave bgsave_;
 };
 
 class LFUDB : public DB {
 public:
-    LFUDB(size_t capacity);
+    LFUDB(size_t capacity, size_t num_shards = DEFAULT_SHARD_COUNT);
     void set(const std::string& key, const std::string& value) override;
     bool get(const std::string& key, std::string& value) override;
     bool incr(const std::string& key, int64_t& result) override { return false; } // Not implemented
     bool decr(const std::string& key, int64_t& result) override { return false; } // Not implemented
+    bool incrby(const std::string& key, int64_t delta, int64_t& result) override { return false; } // Not implemented
     bool lpush(const std::string& key, const std::vector<std::string>& values) override { return false; }
     bool rpush(const std::string& key, const std::vector<std::string>& values) override { return false; }
     bool lpop(const std::string& key, std::string& value) override { return false; }
@@ -173,18 +372,60 @@ public:
     bool hgetall(const std::string& key, std::unordered_map<std::string, std::string>& result) override { return false; }
     bool hkeys(const std::string& key, std::vector<std::string>& fields) override { return false; }
     bool hvals(const std::string& key, std::vector<std::string>& values) override { return false; }
+    bool zadd(const std::string& key, const std::vector<std::pair<double, std::string>>& members, size_t& added) override { return false; }
+    bool zincrby(const std::string& key, double increment, const std::string& member, double& score) override { return false; }
+    bool zrem(const std::string& key, const std::vector<std::string>& members, size_t& removed) override { return false; }
+    bool zcard(const std::string& key, size_t& count) override { return false; }
+    bool zscore(const std::string& key, const std::string& member, double& score) override { return false; }
+    bool zrank(const std::string& key, const std::string& member, bool reverse, size_t& rank) override { return false; }
+    bool zrange(const std::string& key, int start, int stop, bool reverse, std::vector<ScoredMember>& result) override { return false; }
+    bool zrangebyscore(const std::string& key, const ScoreRange& range, size_t offset, size_t count,
+                       std::vector<ScoredMember>& result) override { return false; }
     void del(const std::string& key) override;
     bool exists(const std::string& key) override { return false; } // Not implemented
     DataType type(const std::string& key) override { return DataType::STRING; }
     std::vector<std::string> keys(const std::string& pattern = "*") override { return {}; }
+    uint64_t scan(uint64_t cursor, size_t count, const std::string& pattern,
+                  std::vector<std::string>& keys) override { return 0; }
+    uint64_t hscan(const std::string& key, uint64_t cursor, size_t count, const std::string& pattern,
+                   std::vector<std::pair<std::string, std::string>>& fields) override { return 0; }
+    uint64_t sscan(const std::string& key, uint64_t cursor, size_t count, const std::string& pattern,
+                   std::vector<std::string>& members) override { return 0; }
+    uint64_t zscan(const std::string& key, uint64_t cursor, size_t count, const std::string& pattern,
+                   std::vector<ScoredMember>& members) override { return 0; }
     void save(const std::string& filename) override;
     void load(const std::string& filename) override;
     void expire(const std::string& key, int seconds) override;
+    void expire_at(const std::string& key, int64_t unix_ms) override;
     void flushdb() override {}
     size_t dbsize() override { return 0; }
-    ~LFUDB() override;
-    LFUCache* cache_;
+    void rewrite_aof(AOFRewriteFile& out) override;
+    bool bgsave(const std::string& filename) override;
+    BackgroundSave::Status bgsave_status() override { return bgsave_.status(); }
+    size_t active_expire(size_t max_keys) override;
+    ExpiryStats expiry_stats() override;
+    bool rehash_step(size_t groups) override { return false; }  // tables resize at once
+    void set_max_memory(size_t bytes) override;
+    MemoryStats memory_stats() override;
+    size_t get_hits() const;
+    size_t get_misses() const;
+    ~LFUDB() override = default;
+
+private:
+    struct Shard {
+        std::mutex mutex;
+        LFUCache cache;
+        uint64_t aof_rewrite = 0;
+        explicit Shard(size_t capacity) : cache(capacity) {}
+    };
+    ShardSet<Shard> shards_;
+    BackgroundSave bgsave_;
 };
 
 // Factory function for DB
-DB* create_db(const std::string& policy, size_t capacity);
+DB* create_db(const std::string& policy, size_t capacity, size_t max_memory = 0);
+
+// Replays the AOF at `filename` into `db` without logging it again and
+// reports the outcome on stderr. With `repair`, a record cut short at the
+// end of the file is cut off so appends continue from a clean point.
+AOFLoader::Result replay_aof(DB& db, const std::string& filename, bool repair = true);
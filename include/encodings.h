@@ -0,0 +1,233 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <utility>
+#include <iterator>
+#include <cstdint>
+#include <cstddef>
+#include "memory_usage.h"
+#include "swiss_table.h"
+
+// Value of a STRING key, tagged with one of three encodings:
+//   INT     canonical text of a 64-bit integer, kept as the number
+//   EMBSTR  up to EMBED_MAX bytes, stored inline in the object
+//   RAW     anything longer, in a heap-allocated std::string
+// Counters stay INT, so INCR and friends add in place without parsing,
+// formatting or allocating.
+class StringValue {
+public:
+    enum class Encoding : uint8_t { EMBSTR, INT, RAW };
+    static const size_t EMBED_MAX = 32;
+    static const size_t INT_CHARS = 20;  // longest int64 text, "-9223372036854775808"
+
+    StringValue() : embedded_size_(0), encoding_(Encoding::EMBSTR) {}
+    explicit StringValue(std::string_view text) : StringValue() { assign(text); }
+    StringValue(const StringValue& other);
+    StringValue(StringValue&& other) noexcept;
+    StringValue& operator=(const StringValue& other);
+    StringValue& operator=(StringValue&& other) noexcept;
+    ~StringValue() { release(); }
+
+    Encoding encoding() const { return encoding_; }
+    size_t size() const;
+    // Heap bytes beyond the object itself.
+    size_t memory_usage() const { return encoding_ == Encoding::RAW ? heap_bytes(raw_) : 0; }
+
+    void assign(std::string_view text);
+    void set_int(int64_t value);
+    // The value as an integer; false if it is not the text of one.
+    bool to_int(int64_t& value) const;
+    // Adds `delta` and stores the sum in `result`; false, leaving the
+    // value alone, if it is not an integer or the sum would overflow.
+    bool incr(int64_t delta, int64_t& result);
+
+    // The value as text. An INT is formatted into `buf`, so the view lasts
+    // as long as both `buf` and the unmodified value.
+    std::string_view view(char (&buf)[INT_CHARS]) const;
+    std::string str() const;
+
+private:
+    void release();
+
+    union {
+        int64_t int_;
+        char embedded_[EMBED_MAX];
+        std::string raw_;
+    };
+    uint8_t embedded_size_;
+    Encoding encoding_;
+};
+
+// Collections start in a compact contiguous encoding and switch to the
+// full structure, for good, once they outgrow these limits. Set from
+// config.json at startup, before any data is loaded.
+struct EncodingLimits {
+    size_t hash_max_listpack_entries = 128;
+    size_t hash_max_listpack_value = 64;   // longest field or value kept packed
+    size_t set_max_intset_entries = 512;
+};
+extern EncodingLimits encoding_limits;
+
+// Value of a HASH key. Small hashes are a "listpack": one buffer of
+//   varint field length | field | varint value length | value
+// entries, searched linearly. Past the limits it becomes a hash table.
+class HashValue {
+public:
+    using Table = SwissTable<std::string, std::string>;
+    using Entry = std::pair<std::string_view, std::string_view>;
+
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Entry;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Entry*;
+        using reference = Entry;
+
+        Entry operator*() const;
+        const_iterator& operator++();
+        bool operator==(const const_iterator& other) const {
+            return owner_->table_ ? it_ == other.it_ : offset_ == other.offset_;
+        }
+        bool operator!=(const const_iterator& other) const { return !(*this == other); }
+
+    private:
+        friend class HashValue;
+        const_iterator(const HashValue* owner, size_t offset, Table::const_iterator it)
+            : owner_(owner), offset_(offset), it_(it) {}
+
+        const HashValue* owner_;
+        size_t offset_;             // listpack position
+        Table::const_iterator it_;  // hash table position
+    };
+
+    HashValue() : count_(0), table_bytes_(0) {}
+    HashValue(const HashValue& other);
+    HashValue(HashValue&& other) noexcept = default;
+    HashValue& operator=(const HashValue& other);
+    HashValue& operator=(HashValue&& other) noexcept = default;
+
+    size_t size() const { return table_ ? table_->size() : count_; }
+    bool empty() const { return size() == 0; }
+    bool is_packed() const { return !table_; }
+    // Heap bytes beyond the object itself; O(1).
+    size_t memory_usage() const;
+
+    // True if `field` was not in the hash before.
+    bool set(const std::string& field, const std::string& value);
+    bool get(const std::string& field, std::string& value) const;
+    bool erase(const std::string& field);
+
+    const_iterator begin() const;
+    const_iterator end() const;
+
+    // Calls fn(Entry) on the next fields of an HSCAN walk from `cursor`
+    // and returns the cursor to resume from, 0 once complete. A packed
+    // hash is small, so it is visited whole in the first call.
+    template <typename Fn>
+    size_t scan(size_t cursor, size_t count, Fn&& fn) const {
+        if (table_) {
+            return table_->scan_batch(cursor, count, [&](const Table::value_type& item) {
+                fn(Entry(item.first, item.second));
+            });
+        }
+        for (auto entry : *this) fn(entry);
+        return 0;
+    }
+
+private:
+    // Offset of the entry for `field` in packed_, or npos.
+    size_t find_packed(std::string_view field) const;
+    void convert_to_table();
+    static size_t table_entry_bytes(const Table::value_type& entry);
+
+    std::string packed_;
+    size_t count_;
+    std::unique_ptr<Table> table_;
+    size_t table_bytes_;  // nodes and strings of table_, buckets excluded
+};
+
+// Value of a SET key. While every member is the canonical text of a
+// 64-bit integer and the set is small, it is an "intset": a sorted array
+// of the integers, searched by bisection. Otherwise it is a hash table.
+class SetValue {
+public:
+    struct Present {};
+    using Strings = SwissTable<std::string, Present>;
+
+    // Yields string_views that stay valid until the iterator moves.
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::string_view;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const std::string_view*;
+        using reference = std::string_view;
+
+        std::string_view operator*() const;
+        const_iterator& operator++() {
+            if (owner_->strings_) ++it_; else ++index_;
+            return *this;
+        }
+        bool operator==(const const_iterator& other) const {
+            return owner_->strings_ ? it_ == other.it_ : index_ == other.index_;
+        }
+        bool operator!=(const const_iterator& other) const { return !(*this == other); }
+
+    private:
+        friend class SetValue;
+        const_iterator(const SetValue* owner, size_t index, Strings::const_iterator it)
+            : owner_(owner), index_(index), it_(it) {}
+
+        const SetValue* owner_;
+        size_t index_;                // intset position
+        Strings::const_iterator it_;  // hash table position
+        mutable char buf_[24];
+    };
+
+    SetValue() = default;
+    SetValue(const SetValue& other);
+    SetValue(SetValue&& other) noexcept = default;
+    SetValue& operator=(const SetValue& other);
+    SetValue& operator=(SetValue&& other) noexcept = default;
+
+    size_t size() const { return strings_ ? strings_->size() : ints_.size(); }
+    bool empty() const { return size() == 0; }
+    bool is_intset() const { return !strings_; }
+    // Heap bytes beyond the object itself; O(1).
+    size_t memory_usage() const {
+        return strings_ ? sizeof(Strings) + strings_bytes_ + strings_->table_bytes() : ints_.capacity() * sizeof(int64_t);
+    }
+
+    // True if `member` was not in the set before.
+    bool insert(const std::string& member);
+    bool contains(const std::string& member) const;
+    bool erase(const std::string& member);
+
+    const_iterator begin() const;
+    const_iterator end() const;
+
+    // Calls fn(std::string_view) on the next members of an SSCAN walk from
+    // `cursor` and returns the cursor to resume from, 0 once complete. An
+    // intset is small, so it is visited whole in the first call.
+    template <typename Fn>
+    size_t scan(size_t cursor, size_t count, Fn&& fn) const {
+        if (strings_) {
+            return strings_->scan_batch(cursor, count, [&](const Strings::value_type& item) {
+                fn(std::string_view(item.first));
+            });
+        }
+        for (auto member : *this) fn(member);
+        return 0;
+    }
+
+private:
+    void convert_to_strings();
+    static size_t member_bytes(const std::string& member) { return Strings::node_bytes() + heap_bytes(member); }
+
+    std::vector<int64_t> ints_;
+    std::unique_ptr<Strings> strings_;
+    size_t strings_bytes_ = 0;  // nodes and strings of strings_
+};
@@ -1,47 +1,119 @@
 #pragma once
 #include "data_types.h"
+#include "intrusive_list.h"
+#include "timer_wheel.h"
+#include "memory_usage.h"
+#include "sampled_eviction.h"
+#include "arc_cache.h"
+#include "tiny_lfu.h"
 #include <unordered_map>
-#include <list>
 #include <string>
 #include <chrono>
+#include <functional>
+#include <random>
 
+// LRU eviction and TTL bookkeeping for a Keyspace table. The table owns
+// every key and value; the cache only threads its entries onto an
+// intrusive recency list and a timer wheel, and erases entries from the
+// table when they expire or fall off the LRU end. Eviction starts once
+// the table holds more than `capacity` keys or, with a memory limit, once
+// the entries' charged bytes pass it.
+//
+// Under a sampled policy no list is kept: an access only updates the
+// entry's access bits, and eviction samples random keys from the table
+// into an EvictionPool and removes the best candidate. Under ARC and
+// TINY_LFU the entries sit on ARCCache's or TinyLFUCache's lists instead
+// of the recency list.
 class EnhancedCache {
 public:
-    EnhancedCache(size_t capacity);
-    
-    // Core cache operations
-    void put(const std::string& key, const DataValue& value);
-    bool get(const std::string& key, DataValue& value);
-    void erase(const std::string& key);
-    bool exists(const std::string& key) const;
-    
-    // TTL support
-    void set_expiry(const std::string& key, int seconds);
-    
+    EnhancedCache(Keyspace& data, size_t capacity, size_t max_memory = 0);
+    ~EnhancedCache();
+
+    // Read access: drops the key if it has expired, counts a hit or miss
+    // and records the access. Returns nullptr on a miss.
+    KeyEntry* get(const std::string& key);
+    // Record a write to `key`: link or refresh it, recharge its size, evict
+    // over capacity or memory and expire a few keys whose TTL has passed.
+    void touch(const std::string& key);
+    // Lazily expire `key`; returns true if it was removed.
+    bool expire_if_needed(const std::string& key);
+    bool exists(const std::string& key);
+    // Whether `entry` has a TTL that passed before `now`.
+    static bool is_expired(const KeyEntry& entry, std::chrono::steady_clock::time_point now);
+
+    // TTL support; returns false if the key does not exist
+    bool set_expiry(const std::string& key, int seconds);
+    bool set_expiry_at(const std::string& key, std::chrono::steady_clock::time_point when);
+
+    // Active expiration: removes up to `max_keys` keys whose TTL has
+    // passed, oldest deadline first. Returns how many were removed.
+    size_t expire_due(size_t max_keys);
+    const ExpiryStats& expiry_stats() const { return expiry_stats_; }
+
+    // Called with the key just before an entry is evicted for capacity.
+    void set_evict_hook(std::function<void(const std::string&)> hook) { evict_hook_ = std::move(hook); }
+
+    // 0 removes the limit; a lower limit takes effect on the next write.
+    void set_max_memory(size_t bytes) { max_memory_ = bytes; }
+    MemoryStats memory_stats() const;
+
+    // Switches policy, relinking or stamping every entry; O(n). `samples`
+    // is the number of keys a sampled policy inspects per eviction.
+    void set_eviction_policy(EvictionPolicy policy, size_t samples = DEFAULT_EVICTION_SAMPLES);
+    EvictionPolicy eviction_policy() const { return policy_; }
+    ARCStats arc_stats() const { return arc_.stats(); }
+    TinyLFUStats tiny_lfu_stats() const { return tiny_lfu_.stats(); }
+
     // Stats
     size_t get_hits() const { return hits_; }
     size_t get_misses() const { return misses_; }
     size_t size() const { return data_.size(); }
-    
-    // Data access for persistence
-    const std::unordered_map<std::string, DataValue>& get_data() const { return data_; }
-    void clear() { data_.clear(); lru_list_.clear(); lru_map_.clear(); expiry_.clear(); }
 
 private:
-    void touch(const std::string& key);
-    void cleanup_expired();
-    void evict_if_needed();
-    
+    // Called on every read and write of `entry`; `inserted` for the write
+    // that created it.
+    void record_access(KeyEntry& entry, bool inserted);
+    // Evicts until under the limits, sparing `written`.
+    void evict_if_needed(const KeyEntry& written);
+    // Key to evict under a sampled policy, other than `written`; end() if
+    // there is none.
+    Keyspace::iterator sampled_victim(const KeyEntry& written);
+    // Eviction score of `entry`; the higher, the sooner it goes.
+    uint64_t eviction_score(const KeyEntry& entry) const;
+    bool over_limit() const;
+    // Estimated bytes held by one table entry, key and value included.
+    static size_t entry_bytes(const Keyspace::value_type& entry);
+    // Lazy expiration of one entry found on access.
+    bool drop_if_expired(Keyspace::iterator it, std::chrono::steady_clock::time_point now);
+
+    Keyspace& data_;
     size_t capacity_;
-    std::unordered_map<std::string, DataValue> data_;
-    
-    // LRU tracking
-    std::list<std::string> lru_list_;
-    std::unordered_map<std::string, std::list<std::string>::iterator> lru_map_;
-    
-    // TTL support
-    std::unordered_map<std::string, std::chrono::steady_clock::time_point> expiry_;
-    
+    size_t max_memory_;
+    size_t used_memory_ = 0;  // sum of the entries' charges
+    uint64_t evicted_keys_ = 0;
+    std::function<void(const std::string&)> evict_hook_;
+
+    EvictionPolicy policy_ = EvictionPolicy::LRU;
+    size_t samples_ = DEFAULT_EVICTION_SAMPLES;
+
+    // LRU tracking: most recently used at the front
+    IntrusiveList<KeyEntry, LruTag> lru_list_;
+
+    // ARC policy
+    ARCCache arc_;
+
+    // W-TinyLFU policy
+    TinyLFUCache tiny_lfu_;
+
+    // Sampled policies
+    uint32_t access_clock_ = 0;
+    EvictionPool pool_;
+    std::minstd_rand rng_;
+
+    // TTL support: entries that carry an expiry deadline
+    TimerWheel<KeyEntry, ExpiryTag> expiry_wheel_;
+    ExpiryStats expiry_stats_;
+
     // Stats
     size_t hits_ = 0;
     size_t misses_ = 0;
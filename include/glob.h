@@ -0,0 +1,51 @@
+/*
+ * glob.h
+ * Redis-style glob patterns for KEYS and the SCAN family's MATCH option.
+ */
+
+#ifndef GLOB_H
+#define GLOB_H
+
+#include <string>
+#include <string_view>
+
+// A pattern compiled once and matched against many keys or members:
+//   *      any run of characters, including none
+//   ?      any one character
+//   [abc]  one of the listed characters; [^abc] any other; [a-z] a range
+//   \x     the character x itself
+// Matching never allocates. The literal text a pattern starts with, and
+// the literal text after its last `*`, are kept unescaped and compared
+// with memcmp before the matcher runs, so "prefix:*" and "*:suffix"
+// patterns reject most keys after a few bytes and match the rest without
+// backtracking.
+class GlobPattern {
+public:
+    explicit GlobPattern(const std::string& pattern);
+
+    // True for "*", which every string matches.
+    bool matches_all() const { return all_; }
+    // True if the pattern has no wildcards; it then matches only prefix().
+    bool is_literal() const { return literal_; }
+    // Unescaped literal text every match starts with.
+    const std::string& prefix() const { return prefix_; }
+
+    bool matches(std::string_view text) const;
+
+private:
+    // Matches `text` against the pattern between `pos` and end_.
+    bool match_from(size_t pos, std::string_view text) const;
+    // Whether `c` matches the single-character item at `pos` (a literal,
+    // ?, escape or class); sets `next` to the position after the item.
+    bool match_char(size_t pos, char c, size_t& next) const;
+
+    std::string pattern_;
+    std::string prefix_;
+    std::string suffix_;  // literal tail after the last `*`, if it has no wildcards
+    size_t rest_;  // position in pattern_ just past the prefix
+    size_t end_;   // position in pattern_ where suffix_ starts, or its size
+    bool all_;
+    bool literal_;
+};
+
+#endif // GLOB_H
@@ -0,0 +1,81 @@
+#pragma once
+#include <cstddef>
+
+// Hook embedded in an object so it can sit in an IntrusiveList without a
+// separate list node. `Tag` lets one object carry several independent hooks.
+// A hook unlinks itself when the object is destroyed, and copies start out
+// unlinked, so containers can copy or erase objects without involving the list.
+template <typename Tag>
+struct ListHook {
+    ListHook* prev = nullptr;
+    ListHook* next = nullptr;
+
+    ListHook() = default;
+    ListHook(const ListHook&) {}
+    ListHook& operator=(const ListHook&) { return *this; }
+    ~ListHook() { unlink(); }
+
+    bool is_linked() const { return next != nullptr; }
+
+    void unlink() {
+        if (next) {
+            prev->next = next;
+            next->prev = prev;
+            prev = next = nullptr;
+        }
+    }
+};
+
+// Circular doubly linked list over objects of type T deriving from
+// ListHook<Tag>. Every operation is O(1) except clear().
+template <typename T, typename Tag>
+class IntrusiveList {
+public:
+    using Hook = ListHook<Tag>;
+
+    IntrusiveList() { head_.prev = head_.next = &head_; }
+    ~IntrusiveList() { clear(); }
+    IntrusiveList(const IntrusiveList&) = delete;
+    IntrusiveList& operator=(const IntrusiveList&) = delete;
+
+    bool empty() const { return head_.next == &head_; }
+
+    T* front() { return empty() ? nullptr : item(head_.next); }
+    T* back() { return empty() ? nullptr : item(head_.prev); }
+    // Element after `current` in front-to-back order, or nullptr at the end.
+    T* next(T* current) {
+        Hook* h = static_cast<Hook*>(current)->next;
+        return h == &head_ ? nullptr : item(h);
+    }
+    const T* front() const { return empty() ? nullptr : item(head_.next); }
+    const T* next(const T* current) const {
+        const Hook* h = static_cast<const Hook*>(current)->next;
+        return h == &head_ ? nullptr : item(h);
+    }
+
+    // Links `value` at the front, moving it there if it is already linked.
+    void push_front(T& value) { insert_after(&head_, value); }
+    void push_back(T& value) { insert_after(head_.prev, value); }
+    // Links `value` right after `pos`, which must be in this list.
+    void insert_after(T& pos, T& value) { insert_after(static_cast<Hook*>(&pos), value); }
+
+    void clear() {
+        while (!empty()) head_.next->unlink();
+    }
+
+private:
+    static T* item(Hook* h) { return static_cast<T*>(h); }
+    static const T* item(const Hook* h) { return static_cast<const T*>(h); }
+
+    void insert_after(Hook* pos, T& value) {
+        Hook* h = static_cast<Hook*>(&value);
+        if (h == pos) return;
+        h->unlink();
+        h->prev = pos;
+        h->next = pos->next;
+        pos->next->prev = h;
+        pos->next = h;
+    }
+
+    Hook head_;
+};
@@ -1,28 +1,87 @@
 #pragma once
 #include <unordered_map>
-#include <map>
 #include <string>
-#include <list>
+#include <vector>
 #include <chrono>
+#include <cstdint>
+#include "intrusive_list.h"
+#include "timer_wheel.h"
+#include "memory_usage.h"
 
+// O(1) LFU with dynamic aging (LFU-DA). Each key has a priority: the
+// cache age at insertion plus one per access. Keys of equal priority share
+// a bucket, and buckets form a list in ascending priority, so an access
+// moves its key to the bucket after its own, creating it if needed.
+// Eviction takes the oldest key of the first bucket and raises the cache
+// age to that key's priority; new keys start just above the age, so keys
+// that were hot long ago are eventually evicted once they stop being used.
 class LFUCache {
 public:
-    LFUCache(size_t capacity);
+    struct EntryTag {};
+    struct BucketTag {};
+    struct Bucket;
+    // The table owns every key and value; the hooks unlink the entry from
+    // its bucket and the timer wheel when the table erases it.
+    struct Entry : KeyTimer, ListHook<EntryTag> {
+        std::string value;
+        Bucket* bucket = nullptr;
+    };
+    struct Bucket : ListHook<BucketTag> {
+        uint64_t priority;
+        IntrusiveList<Entry, EntryTag> entries;  // oldest access at the front
+        explicit Bucket(uint64_t p) : priority(p) {}
+    };
+    using Table = std::unordered_map<std::string, Entry>;
+
+    LFUCache(size_t capacity, size_t max_memory = 0);
+    ~LFUCache();
+    LFUCache(const LFUCache&) = delete;
+    LFUCache& operator=(const LFUCache&) = delete;
+
+    // Writing a key counts as an access and clears its TTL.
     void put(const std::string& key, const std::string& value);
     bool get(const std::string& key, std::string& value);
     void erase(const std::string& key);
-    const std::list<std::pair<std::string, std::string>>& get_items() const { return items_; }
-    void set_expiry(const std::string& key, int seconds);
+    const Table& get_items() const { return table_; }
+    // TTL support; returns false if the key does not exist
+    bool set_expiry(const std::string& key, int seconds);
+    bool set_expiry_at(const std::string& key, std::chrono::steady_clock::time_point when);
+    bool get_expiry(const std::string& key, std::chrono::steady_clock::time_point& when) const;
+    // Active expiration: removes up to `max_keys` keys whose TTL has passed.
+    size_t expire_due(size_t max_keys);
+    const ExpiryStats& expiry_stats() const { return expiry_stats_; }
+    // Evicts past `capacity` keys or, if non-zero, `max_memory` bytes.
+    void set_max_memory(size_t bytes) { max_memory_ = bytes; }
+    MemoryStats memory_stats() const;
     size_t get_hits() const { return hits_; }
     size_t get_misses() const { return misses_; }
+    // Bucket priorities from the first bucket to the last, for checking
+    // the list order.
+    std::vector<uint64_t> bucket_priorities() const;
 private:
     size_t capacity_;
-    std::list<std::pair<std::string, std::string>> items_;
-    std::unordered_map<std::string, std::list<std::pair<std::string, std::string>>::iterator> map_;
-    std::unordered_map<std::string, int> freq_;
-    std::map<int, std::list<std::string>> freq_list_;
-    std::unordered_map<std::string, std::chrono::steady_clock::time_point> expiry_;
+    size_t max_memory_;
+    size_t used_memory_ = 0;
+    uint64_t evicted_keys_ = 0;
+    uint64_t age_ = 0;  // priority of the last evicted key
+    IntrusiveList<Bucket, BucketTag> buckets_;  // ascending priority
+    TimerWheel<KeyTimer, TimerTag> expiry_wheel_;
+    Table table_;  // declared last: its entries unlink from the lists above
+    ExpiryStats expiry_stats_;
     size_t hits_ = 0;
     size_t misses_ = 0;
-    void update_freq(const std::string& key);
+    // Lazy expiration of `it` on access; true if it was removed.
+    bool drop_if_expired(Table::iterator it);
+    // Links a new entry at the current age, or moves an entry one priority up.
+    void link_new(Entry& entry);
+    void promote(Entry& entry);
+    // Unlinks `entry` from its bucket, freeing the bucket once empty.
+    void unlink(Entry& entry);
+    Bucket* new_bucket(uint64_t priority, Bucket* after);
+    void erase(Table::iterator it);
+    // Evicts until under the limits, sparing `written`.
+    void evict_if_needed(const Entry& written);
+    // Estimated bytes held for one key and value.
+    static size_t entry_bytes(const std::string& key, const std::string& value);
+    bool over_limit() const;
 };
@@ -3,23 +3,45 @@
 #include <unordered_map>
 #include <string>
 #include <chrono>
+#include "timer_wheel.h"
+#include "memory_usage.h"
 
 class LRUCache {
 public:
-    LRUCache(size_t capacity);
+    LRUCache(size_t capacity, size_t max_memory = 0);
     void put(const std::string& key, const std::string& value);
     bool get(const std::string& key, std::string& value);
     void erase(const std::string& key);
     const std::list<std::pair<std::string, std::string>>& get_items() const { return items_; }
-    // TTL support
-    void set_expiry(const std::string& key, int seconds);
+    // TTL support; returns false if the key does not exist
+    bool set_expiry(const std::string& key, int seconds);
+    bool set_expiry_at(const std::string& key, std::chrono::steady_clock::time_point when);
+    bool get_expiry(const std::string& key, std::chrono::steady_clock::time_point& when) const;
+    // Active expiration: removes up to `max_keys` keys whose TTL has passed.
+    size_t expire_due(size_t max_keys);
+    const ExpiryStats& expiry_stats() const { return expiry_stats_; }
+    // Evicts past `capacity` keys or, if non-zero, `max_memory` bytes.
+    void set_max_memory(size_t bytes) { max_memory_ = bytes; }
+    MemoryStats memory_stats() const;
     size_t get_hits() const { return hits_; }
     size_t get_misses() const { return misses_; }
 private:
     size_t capacity_;
+    size_t max_memory_;
+    size_t used_memory_ = 0;
+    uint64_t evicted_keys_ = 0;
     std::list<std::pair<std::string, std::string>> items_;
     std::unordered_map<std::string, std::list<std::pair<std::string, std::string>>::iterator> map_;
-    std::unordered_map<std::string, std::chrono::steady_clock::time_point> expiry_;
+    std::unordered_map<std::string, KeyTimer> expiry_;
+    TimerWheel<KeyTimer, TimerTag> expiry_wheel_;
+    ExpiryStats expiry_stats_;
     size_t hits_ = 0;
     size_t misses_ = 0;
+    // Lazy expiration of `key` on access; true if it was removed.
+    bool drop_if_expired(const std::string& key);
+    // Estimated bytes held for one key and value across the structures.
+    static size_t entry_bytes(const std::string& key, const std::string& value);
+    static size_t timer_bytes(const std::string& key);
+    void erase_expiry(const std::string& key);
+    bool over_limit() const;
 };
@@ -0,0 +1,84 @@
+#pragma once
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+// Memory accounting. Every cache charges each entry an estimate of the
+// bytes it holds (key, value and the table and list nodes around them)
+// and evicts once the total passes its share of `maxmemory`. The
+// estimates count what the containers allocate, not allocator overhead;
+// INFO puts them next to the resident set size as the fragmentation ratio.
+struct MemoryStats {
+    size_t used_memory = 0;   // sum of the entry estimates plus table buckets
+    size_t max_memory = 0;    // 0: limited by key count only
+    uint64_t evicted_keys = 0;
+
+    void merge(const MemoryStats& other) {
+        used_memory += other.used_memory;
+        max_memory += other.max_memory;
+        evicted_keys += other.evicted_keys;
+    }
+};
+
+// Bytes (or a count) an object is charged against a running total. Like a
+// ListHook it settles itself: destroying the object takes the charge back, and copies
+// start out uncharged, so containers can copy or erase charged objects
+// without telling the owner of the total.
+struct MemoryCharge {
+    size_t* total = nullptr;
+    size_t bytes = 0;
+
+    MemoryCharge() = default;
+    MemoryCharge(const MemoryCharge&) {}
+    MemoryCharge& operator=(const MemoryCharge&) { return *this; }
+    ~MemoryCharge() { release(); }
+
+    bool charged() const { return total != nullptr; }
+    bool charged_to(const size_t& owner) const { return total == &owner; }
+    // Charges `new_bytes` to `owner`, replacing any earlier charge.
+    void charge(size_t& owner, size_t new_bytes) {
+        release();
+        total = &owner;
+        bytes = new_bytes;
+        owner += new_bytes;
+    }
+    void release() {
+        if (total) *total -= bytes;
+        total = nullptr;
+        bytes = 0;
+    }
+    // Forgets the total without touching it, for when its owner goes away first.
+    void detach() { total = nullptr; }
+};
+
+// Heap bytes behind a std::string: none while it fits the inline buffer.
+inline size_t heap_bytes(const std::string& s) {
+    static const size_t inline_capacity = std::string().capacity();
+    return s.capacity() > inline_capacity ? s.capacity() + 1 : 0;
+}
+
+// One node of a node-based hash table holding `Value`: the value, the
+// chain pointer and the cached hash.
+template <typename Value>
+constexpr size_t hash_node_bytes() {
+    return sizeof(Value) + sizeof(void*) + sizeof(size_t);
+}
+
+// One node of a std::set or std::map holding `Value`: the value plus
+// colour, parent and two child pointers.
+template <typename Value>
+constexpr size_t tree_node_bytes() {
+    return sizeof(Value) + 4 * sizeof(void*);
+}
+
+// One node of a std::list holding `Value`.
+template <typename Value>
+constexpr size_t list_node_bytes() {
+    return sizeof(Value) + 2 * sizeof(void*);
+}
+
+// Bytes a process-wide byte budget gives each of `shards` partitions;
+// 0 stays 0 (unlimited).
+inline size_t per_shard_memory(size_t max_memory, size_t shards) {
+    return max_memory ? (max_memory + shards - 1) / shards : 0;
+}
@@ -1,6 +1,8 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <vector>
+#include <utility>
 #include <sstream>
 #include <cstdint>
 
@@ -8,11 +10,13 @@
 class CommandParser {
 public:
     struct Command {
-        std::string name;
+        std::string name;  // as sent; find_command() matches it in any case
         std::vector<std::string> args;
     };
     
     static Command parse(const std::string& input);
+    // Fill `cmd` from parsed arguments, reusing its string capacity.
+    static void assign(Command& cmd, const std::vector<std::string_view>& argv);
     static std::string format_response(const std::string& response);
     static std::string format_error(const std::string& error);
     static std::string format_array(const std::vector<std::string>& array);
@@ -20,10 +24,39 @@ public:
     static std::string format_bulk_string(const std::string& str);
 };
 
+// Incremental request parser for RESP multibulk requests (*N / $len, the
+// request framing shared by RESP2 and RESP3) with the inline protocol as a
+// fallback. It runs over a connection buffer that may hold several pipelined
+// requests or only part of one; progress on a partial request is kept between
+// calls, so the caller must present the unconsumed bytes again starting at the
+// same request. Arguments are views into `data` and stay valid until the
+// caller modifies the buffer.
+class RequestParser {
+public:
+    enum class Status { OK, INCOMPLETE, ERROR };
+
+    // On OK, `args` holds the request (empty for a blank inline line) and
+    // `consumed` is its length in bytes.
+    Status parse(const char* data, size_t len, std::vector<std::string_view>& args, size_t& consumed);
+    const std::string& error() const { return error_; }
+    void reset();
+
+private:
+    Status parse_multibulk(const char* data, size_t len, std::vector<std::string_view>& args, size_t& consumed);
+    Status parse_inline(const char* data, size_t len, std::vector<std::string_view>& args, size_t& consumed);
+    Status fail(const std::string& message);
+
+    size_t pos_ = 0;                                // bytes of the current request already parsed
+    int64_t multibulk_len_ = -1;                    // -1 until the *N header has been read
+    std::vector<std::pair<size_t, size_t>> spans_;  // offset/length of each parsed argument
+    std::string error_;
+};
+
 // Redis-like response formatter
 class ResponseFormatter {
 public:
     static std::string ok() { return "+OK\r\n"; }
+    static std::string simple_string(const std::string& str) { return "+" + str + "\r\n"; }
     static std::string error(const std::string& msg) { return "-ERR " + msg + "\r\n"; }
     static std::string nil() { return "$-1\r\n"; }
     static std::string integer(int64_t value) { return ":" + std::to_string(value) + "\r\n"; }
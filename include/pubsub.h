@@ -6,24 +6,29 @@
 #include <set>
 #include <mutex>
 #include <functional>
-#include <thread>
+#include <cstdint>
 
-// Forward declaration for client socket in server.cpp
-class Server;
+// Hands a formatted message to a subscriber's connection. Called on the
+// publishing thread, so it must queue the bytes for the thread that owns
+// the connection rather than write to the socket itself.
+using MessageSink = std::function<void(std::string message)>;
 
 class PubSubManager {
 public:
     PubSubManager();
     ~PubSubManager();
 
-    void subscribe(const std::string& channel, int client_socket);
-    void unsubscribe(const std::string& channel, int client_socket);
-    void publish(const std::string& channel, const std::string& message);
+    // Subscribers are identified by a number unique to their connection,
+    // never by its socket, which the OS reuses once the connection closes.
+    void subscribe(const std::string& channel, uint64_t subscriber, MessageSink sink);
+    void unsubscribe(const std::string& channel, uint64_t subscriber);
+    // Drops every subscription of `subscriber`; called when its connection closes.
+    void unsubscribe_all(uint64_t subscriber);
+    // Returns the number of subscribers the message was queued for.
+    size_t publish(const std::string& channel, const std::string& message);
 
 private:
-    std::map<std::string, std::set<int>> subscriptions_; // channel -> set of client sockets
+    std::map<std::string, std::map<uint64_t, MessageSink>> subscriptions_; // channel -> subscribers
+    std::map<uint64_t, std::set<std::string>> channels_;                    // subscriber -> channels
     std::mutex mutex_;
-
-    // Method to send messages to a specific client socket
-    void send_message_to_client(int client_socket, const std::string& message);
-}; 
\ No newline at end of file
+};
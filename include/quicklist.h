@@ -0,0 +1,106 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <iterator>
+#include <cstdint>
+#include <cstddef>
+
+// Value of a LIST key: a doubly linked list of nodes, each packing its
+// elements back to back in one buffer of at most NODE_BYTES. Pushing and
+// popping at either end touches only the end node, so both are O(1); a
+// range read walks whole nodes and then decodes contiguous memory.
+//
+// An element is stored as
+//   varint length | bytes | backlen
+// where backlen is the size of the first two parts written so that it can
+// be decoded from its last byte backwards, which is how the tail is read.
+// Elements popped from the front are skipped over and the node buffer is
+// compacted once the dead prefix outgrows the live part.
+class QuickList {
+private:
+    struct Node;
+
+public:
+    // Upper bound on a node's buffer; a larger element gets a node of its own.
+    static const size_t NODE_BYTES = 8192;
+
+    // Forward iterator over the elements. A string_view stays valid until
+    // the list is modified.
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::string_view;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const std::string_view*;
+        using reference = std::string_view;
+
+        const_iterator() : node_(nullptr), offset_(0) {}
+        std::string_view operator*() const;
+        const_iterator& operator++();
+        const_iterator operator++(int) {
+            const_iterator old = *this;
+            ++*this;
+            return old;
+        }
+        bool operator==(const const_iterator& other) const {
+            return node_ == other.node_ && offset_ == other.offset_;
+        }
+        bool operator!=(const const_iterator& other) const { return !(*this == other); }
+
+    private:
+        friend class QuickList;
+        const_iterator(const Node* node, size_t offset) : node_(node), offset_(offset) {}
+
+        const Node* node_;
+        size_t offset_;
+    };
+
+    QuickList() : head_(nullptr), tail_(nullptr), size_(0), nodes_(0), bytes_(0) {}
+    QuickList(const std::vector<std::string>& items);
+    QuickList(const QuickList& other);
+    QuickList(QuickList&& other) noexcept;
+    QuickList& operator=(const QuickList& other);
+    QuickList& operator=(QuickList&& other) noexcept;
+    ~QuickList() { clear(); }
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    size_t node_count() const { return nodes_; }
+    // Bytes held by node buffers and node headers, kept up to date by
+    // every push and pop.
+    size_t allocated_bytes() const { return bytes_; }
+
+    void push_front(std::string_view value);
+    void push_back(std::string_view value);
+    // Return false if the list is empty.
+    bool pop_front(std::string& value);
+    bool pop_back(std::string& value);
+    void clear();
+
+    const_iterator begin() const { return head_ ? const_iterator(head_, head_->start) : end(); }
+    const_iterator end() const { return const_iterator(); }
+    // Iterator to the element at `index`, skipping whole nodes on the way;
+    // end() if out of range.
+    const_iterator at(size_t index) const;
+
+private:
+    struct Node {
+        Node* prev = nullptr;
+        Node* next = nullptr;
+        std::string buf;   // packed elements; bytes before `start` are dead
+        size_t start = 0;
+        uint32_t count = 0;
+    };
+
+    Node* new_node(Node* prev, Node* next);
+    void unlink_node(Node* node);
+    static size_t encoded_size(size_t len);
+    static void encode(std::string_view value, char* out);
+
+    Node* head_;
+    Node* tail_;
+    size_t size_;
+    size_t nodes_;
+    size_t bytes_;
+};
@@ -0,0 +1,81 @@
+/*
+ * reactor.h
+ * Event-driven connection handling for the enhanced server.
+ */
+
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <cstddef>
+#include <cstdint>
+
+// Protocol state for one client connection. The I/O layer owns the byte
+// buffers; the session only turns buffered requests into buffered replies.
+// It is destroyed when the connection closes.
+class Session {
+public:
+    virtual ~Session() = default;
+
+    // Consume every complete request at the front of `input` and append the
+    // replies to `output`. Return false once the connection should be closed
+    // (after `output` has been flushed).
+    virtual bool on_data(std::string& input, std::string& output) = 0;
+};
+
+// Queues bytes for a connection from any thread, such as a pub/sub message
+// published by another client. The thread that owns the connection appends
+// them to its output after the replies already buffered; once the
+// connection has closed they are dropped.
+using Outbox = std::function<void(std::string data)>;
+
+using SessionFactory = std::function<std::unique_ptr<Session>(int client_fd, Outbox outbox)>;
+
+#ifdef __linux__
+
+// Non-blocking, edge-triggered epoll server. Each reactor thread has its own
+// epoll instance, accepts from the shared listening socket and owns every
+// connection it accepted, so connection state is never touched by two threads.
+class Reactor {
+public:
+    Reactor(int listen_fd, size_t num_threads, SessionFactory factory);
+    ~Reactor();
+
+    void start();
+    void stop();
+    void join();
+
+    size_t connection_count() const { return connections_.load(); }
+    size_t accepted_count() const { return accepted_.load(); }
+
+private:
+    struct Connection;
+    struct Loop;
+
+    void run_loop(Loop& loop);
+    void accept_connections(Loop& loop);
+    void handle_read(Loop& loop, Connection* conn);
+    // Queues `data` for connection `id` on `loop` and wakes the loop.
+    static void post(Loop& loop, int fd, uint64_t id, std::string data);
+    // Appends the queued data to its connections' output, on the loop thread.
+    void deliver_mail(Loop& loop);
+    bool flush(Connection* conn);
+    void close_connection(Loop& loop, Connection* conn);
+
+    int listen_fd_;
+    SessionFactory factory_;
+    std::vector<std::unique_ptr<Loop>> loops_;
+    std::vector<std::thread> threads_;
+    std::atomic<bool> running_;
+    std::atomic<size_t> connections_;
+    std::atomic<size_t> accepted_;
+};
+
+#endif // __linux__
+
+#endif // REACTOR_H
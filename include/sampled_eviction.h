@@ -0,0 +1,102 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+// How a cache picks the key to evict.
+enum class EvictionPolicy {
+    LRU,          // exact: a recency list that every access relinks
+    SAMPLED_LRU,  // idlest of a few sampled keys, by a 24-bit access clock
+    SAMPLED_LFU,  // least used of a few sampled keys, by a decaying log counter
+    ARC,          // adaptive replacement over recency and frequency lists (ARCCache)
+    TINY_LFU,     // window LRU and segmented LRU with sketch admission (TinyLFUCache)
+};
+
+// "lru", "sampled-lru", "sampled-lfu", "arc" or "tinylfu"; anything else is LRU.
+EvictionPolicy parse_eviction_policy(const std::string& name);
+
+const size_t DEFAULT_EVICTION_SAMPLES = 5;
+
+// The 24 bits of access state a sampled policy keeps in each entry, as in
+// Redis. Recording an access writes only these bits, so reads never touch
+// shared structure.
+//
+// SAMPLED_LRU stores the owner's access clock at the last access. The
+// clock counts accesses rather than time, so idleness is measured in
+// accesses to the same cache and wraps harmlessly after 2^24.
+//
+// SAMPLED_LFU stores a 16-bit minute stamp above an 8-bit counter that
+// grows logarithmically: at counter c the next access increments it with
+// probability 1 / ((c - LFU_INIT) * LFU_LOG_FACTOR + 1), so 255 stands for
+// about a million accesses. The counter loses one point per minute idle;
+// new keys start at LFU_INIT so they are not evicted before a second use.
+namespace access_bits {
+
+const uint32_t CLOCK_MASK = (1u << 24) - 1;
+const uint32_t LFU_INIT = 5;
+const uint32_t LFU_LOG_FACTOR = 10;
+
+inline uint32_t lru_idle(uint32_t stamp, uint32_t clock) { return (clock - stamp) & CLOCK_MASK; }
+
+inline uint32_t minutes_now() {
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::minutes>(now).count()) & 0xFFFF;
+}
+
+// Counter of `bits` after the decay owed since its stamp.
+inline uint32_t lfu_counter(uint32_t bits, uint32_t minutes) {
+    uint32_t counter = bits & 0xFF;
+    uint32_t idle = (minutes - (bits >> 8)) & 0xFFFF;
+    return idle >= counter ? 0 : counter - idle;
+}
+
+inline uint32_t lfu_pack(uint32_t counter, uint32_t minutes) { return (minutes << 8) | counter; }
+
+// `random` is uniform in [0, 1).
+inline uint32_t lfu_increment(uint32_t counter, double random) {
+    if (counter == 255) return counter;
+    double base = counter > LFU_INIT ? counter - LFU_INIT : 0;
+    return random < 1.0 / (base * LFU_LOG_FACTOR + 1) ? counter + 1 : counter;
+}
+
+}
+
+// Best eviction candidates seen so far, as in Redis's eviction pool. Each
+// eviction adds a fresh sample of keys, so the pool keeps good candidates
+// from earlier samples and the choice approaches that of exact LRU or LFU
+// with far fewer keys inspected per eviction.
+class EvictionPool {
+public:
+    static const size_t SIZE = 16;
+
+    struct Candidate {
+        uint64_t score;  // higher is evicted first
+        std::string key;
+    };
+
+    // Keeps `key` if the pool has room or it beats the worst candidate.
+    void offer(const std::string& key, uint64_t score) {
+        if (pool_.size() == SIZE && score <= pool_.front().score) return;
+        for (const Candidate& c : pool_) {
+            if (c.key == key) return;
+        }
+        size_t pos = 0;
+        while (pos < pool_.size() && pool_[pos].score < score) ++pos;
+        if (pool_.size() == SIZE) {
+            // Drop the worst candidate to make room below `pos`.
+            pool_.erase(pool_.begin());
+            --pos;
+        }
+        pool_.insert(pool_.begin() + pos, Candidate{score, key});
+    }
+
+    bool empty() const { return pool_.empty(); }
+    Candidate& best() { return pool_.back(); }
+    void pop_best() { pool_.pop_back(); }
+    void clear() { pool_.clear(); }
+
+private:
+    std::vector<Candidate> pool_;  // ascending by score
+};
@@ -0,0 +1,64 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <functional>
+#include <cstdint>
+
+const size_t DEFAULT_SHARD_COUNT = 16;
+
+// Hash-partitioned keyspace shards. Every Shard type carries its own
+// `std::mutex mutex`; single-key operations lock only the shard owning the
+// key, whole-keyspace operations lock all shards in index order.
+template <typename Shard>
+class ShardSet {
+public:
+    template <typename... Args>
+    explicit ShardSet(size_t count, const Args&... args) {
+        // Round up to a power of two so the shard index is a shift.
+        size_t n = 1;
+        bits_ = 0;
+        while (n < count) {
+            n <<= 1;
+            bits_++;
+        }
+        for (size_t i = 0; i < n; ++i) {
+            shards_.emplace_back(new Shard(args...));
+        }
+    }
+
+    size_t size() const { return shards_.size(); }
+    // log2 of size(), counted when the set is built.
+    unsigned bits() const { return bits_; }
+    Shard& operator[](size_t index) const { return *shards_[index]; }
+
+    size_t index_for(const std::string& key) const {
+        if (bits_ == 0) return 0;
+        // Use the high bits of a mixed hash: the per-shard hash tables index
+        // by the low bits of the same std::hash value.
+        uint64_t h = static_cast<uint64_t>(std::hash<std::string>{}(key)) * 0x9E3779B97F4A7C15ULL;
+        return static_cast<size_t>(h >> (64 - bits_));
+    }
+
+    Shard& for_key(const std::string& key) const { return *shards_[index_for(key)]; }
+
+    std::vector<std::unique_lock<std::mutex>> lock_all() const {
+        std::vector<std::unique_lock<std::mutex>> locks;
+        locks.reserve(shards_.size());
+        for (const auto& shard : shards_) {
+            locks.emplace_back(shard->mutex);
+        }
+        return locks;
+    }
+
+private:
+    std::vector<std::unique_ptr<Shard>> shards_;
+    unsigned bits_;
+};
+
+// Capacity of each shard when `capacity` is spread over `shards` partitions.
+inline size_t per_shard_capacity(size_t capacity, size_t shards) {
+    size_t per_shard = (capacity + shards - 1) / shards;
+    return per_shard > 0 ? per_shard : 1;
+}
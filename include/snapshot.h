@@ -0,0 +1,125 @@
+/*
+ * snapshot.h
+ * Streaming binary snapshot format (SAVE / LOAD).
+ *
+ * File layout:
+ *   "MYDBSNAP" u8 version
+ *   chunk*        u8 flags | varint raw length | varint stored length |
+ *                 u32 CRC-32 of the stored bytes | stored bytes
+ *   trailer       u8 0xFF | varint key count | u32 CRC-32 of the count
+ *
+ * The chunks, decompressed and concatenated, hold the entries:
+ *   [0xFE varint expire_unix_ms] u8 type | key | value
+ * where strings are a varint length followed by the bytes, and a value is
+ *   STRING  string
+ *   LIST    varint count, string*
+ *   SET     varint count, string*
+ *   HASH    varint count, (field, value)*
+ *   ZSET    varint count, (member, 8-byte double)*
+ * An entry may span chunks, so neither side needs more than one chunk of
+ * buffer. Integers outside varints are little endian.
+ */
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "data_types.h"
+#include <string>
+#include <string_view>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <cstdio>
+#include <cstdint>
+#include <cstddef>
+
+class SnapshotWriter {
+public:
+    // Writes to `path`.tmp and renames it over `path` in finish().
+    // Chunks are LZ4-compressed when built with LZ4 and `compress` is set.
+    explicit SnapshotWriter(const std::string& path, bool compress = true);
+    ~SnapshotWriter();
+
+    bool ok() const { return file_ != nullptr && ok_; }
+    // `expire_unix_ms` of 0 means no expiry.
+    void write(const std::string& key, const DataValue& value, int64_t expire_unix_ms = 0);
+    void write_string(const std::string& key, std::string_view value, int64_t expire_unix_ms = 0);
+    // Flushes, fsyncs and installs the file; false if anything failed.
+    bool finish();
+
+    size_t keys() const { return keys_; }
+    size_t bytes_written() const { return bytes_written_; }
+
+private:
+    void begin_entry(DataType type, const std::string& key, int64_t expire_unix_ms);
+    void put_varint(uint64_t v);
+    void put_string(std::string_view s);
+    void maybe_flush();
+    void flush_chunk();
+    void write_raw(const void* data, size_t len);
+
+    std::string path_;
+    std::string temp_path_;
+    std::FILE* file_;
+    bool compress_;
+    bool ok_;
+    std::string chunk_;
+    std::string packed_;
+    size_t keys_;
+    size_t bytes_written_;
+};
+
+class SnapshotReader {
+public:
+    enum class Result { OK, NOT_FOUND, NOT_SNAPSHOT, CORRUPT };
+    // Receives each entry; `expire_unix_ms` is 0 for keys without expiry.
+    using Apply = std::function<void(std::string& key, DataValue& value, int64_t expire_unix_ms)>;
+
+    // Streams the snapshot at `path` into `apply`. NOT_SNAPSHOT means the
+    // file exists but has no snapshot header (e.g. an older JSON dump).
+    // On CORRUPT the entries before the damaged chunk have been applied.
+    static Result load(const std::string& path, const Apply& apply, size_t* keys = nullptr);
+};
+
+// Runs one snapshot at a time on a background thread (BGSAVE) and keeps
+// its progress and outcome for INFO.
+class BackgroundSave {
+public:
+    struct Status {
+        bool in_progress = false;
+        bool last_ok = true;
+        uint64_t saves = 0;           // completed successfully
+        int64_t last_save_time = 0;   // unix seconds of the last successful save
+        double last_duration = 0;     // seconds the last save took
+        size_t keys_saved = 0;        // progress of the running save
+        size_t keys_total = 0;
+    };
+    // Writes the dataset into `out`; returns false to abandon the snapshot.
+    using Job = std::function<bool(SnapshotWriter& out)>;
+
+    BackgroundSave() = default;
+    BackgroundSave(const BackgroundSave&) = delete;
+    BackgroundSave& operator=(const BackgroundSave&) = delete;
+    // Cancels a running save and waits for its thread.
+    ~BackgroundSave();
+
+    // Runs `job` into `path` on a new thread; false if a save is running.
+    // `abandon`, if set, runs on that thread when the snapshot is not
+    // completed (the file did not open, the job or a write failed), before
+    // the save is reported as finished.
+    bool start(const std::string& path, size_t keys_total, Job job, std::function<void()> abandon = nullptr);
+    // Reported by the job as it goes.
+    void progress(size_t keys_saved);
+    // Polled by the job; set once the owner is being destroyed.
+    bool cancelled() const { return cancel_.load(std::memory_order_relaxed); }
+    Status status();
+
+private:
+    std::mutex mutex_;
+    Status status_;
+    std::atomic<bool> cancel_{false};
+    std::thread thread_;
+};
+
+#endif // SNAPSHOT_H
@@ -0,0 +1,158 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <iterator>
+#include <cstdint>
+#include <cstddef>
+#include "swiss_table.h"
+
+// Inclusive or exclusive bounds of a ZRANGEBYSCORE query.
+struct ScoreRange {
+    double min = 0;
+    double max = 0;
+    bool min_exclusive = false;
+    bool max_exclusive = false;
+
+    bool above_min(double score) const { return min_exclusive ? score > min : score >= min; }
+    bool below_max(double score) const { return max_exclusive ? score < max : score <= max; }
+};
+
+// Value of a ZSET key: a skiplist ordered by (score, member) plus a hash
+// from member to its skiplist node. Each forward link records how many
+// elements it skips, so rank lookups and rank ranges cost O(log N) like
+// inserts, removals and score lookups.
+class SortedSet {
+public:
+    struct Node;
+    struct Level {
+        Node* forward;
+        size_t span;  // elements between this node and `forward`, counting forward
+    };
+    struct Node {
+        std::string member;
+        double score;
+        Node* backward;
+        uint8_t height;
+        Level* level() { return reinterpret_cast<Level*>(this + 1); }
+        const Level* level() const { return reinterpret_cast<const Level*>(this + 1); }
+    };
+
+    // Walks the elements in ascending (score, member) order.
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Node;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Node*;
+        using reference = const Node&;
+
+        explicit const_iterator(const Node* node = nullptr) : node_(node) {}
+        const Node& operator*() const { return *node_; }
+        const Node* operator->() const { return node_; }
+        const_iterator& operator++() {
+            node_ = node_->level()[0].forward;
+            return *this;
+        }
+        bool operator==(const const_iterator& other) const { return node_ == other.node_; }
+        bool operator!=(const const_iterator& other) const { return node_ != other.node_; }
+
+    private:
+        const Node* node_;
+    };
+
+    SortedSet();
+    SortedSet(const SortedSet& other);
+    SortedSet(SortedSet&& other) noexcept;
+    SortedSet& operator=(const SortedSet& other);
+    SortedSet& operator=(SortedSet&& other) noexcept;
+    ~SortedSet();
+
+    size_t size() const { return index_.size(); }
+    bool empty() const { return index_.empty(); }
+    // Heap bytes beyond the object itself: skiplist nodes, members and the
+    // member index; O(1).
+    size_t memory_usage() const;
+
+    // Sets the score of `member`; true if it was not in the set before.
+    bool add(const std::string& member, double score);
+    // Adds `delta` to the score of `member` (0 if absent) and stores the
+    // result in `score`; false, leaving the set alone, if it would be NaN.
+    bool incr(const std::string& member, double delta, double& score);
+    bool remove(const std::string& member);
+    bool score(const std::string& member, double& score) const;
+    // 0-based position of `member` in ascending order, or descending if
+    // `reverse`; false if absent.
+    bool rank(const std::string& member, bool reverse, size_t& rank) const;
+
+    // Calls fn(node) for ranks start..stop inclusive, already clamped to
+    // the set, in ascending order or descending if `reverse`.
+    template <typename Fn>
+    void for_rank_range(size_t start, size_t stop, bool reverse, Fn&& fn) const {
+        if (start > stop || stop >= size()) return;
+        const Node* node = by_rank(reverse ? size() - start : start + 1);
+        for (size_t i = start; i <= stop; ++i) {
+            fn(*node);
+            node = reverse ? node->backward : node->level()[0].forward;
+        }
+    }
+
+    // Calls fn(node) for up to `limit` elements within `range`, after
+    // skipping `offset` of them, in ascending order.
+    template <typename Fn>
+    void for_score_range(const ScoreRange& range, size_t offset, size_t limit, Fn&& fn) const {
+        for (const Node* node = first_in_range(range); node && limit > 0 && range.below_max(node->score);
+             node = node->level()[0].forward) {
+            if (offset > 0) {
+                --offset;
+                continue;
+            }
+            fn(*node);
+            --limit;
+        }
+    }
+
+    const_iterator begin() const { return const_iterator(header_->level()[0].forward); }
+    const_iterator end() const { return const_iterator(); }
+
+    // Calls fn(node) on the next members of a ZSCAN walk from `cursor`,
+    // in member-index order, and returns the cursor to resume from, 0
+    // once complete.
+    template <typename Fn>
+    size_t scan(size_t cursor, size_t count, Fn&& fn) const {
+        return index_.scan_batch(cursor, count, [&](const Index::value_type& item) { fn(*item.second); });
+    }
+
+    // Parses a score argument: a number, or inf / +inf / -inf. NaN and
+    // trailing garbage are rejected.
+    static bool parse_score(const std::string& text, double& score);
+    // Parses ZRANGEBYSCORE bounds, where a leading '(' makes one exclusive.
+    static bool parse_range(const std::string& min, const std::string& max, ScoreRange& range);
+    // Shortest text that parses back to the same double.
+    static std::string format_score(double score);
+
+private:
+    using Index = SwissTable<std::string_view, Node*>;
+    static const int MAX_HEIGHT = 32;
+
+    static Node* new_node(int height, std::string&& member, double score);
+    static void free_node(Node* node);
+    static int random_height();
+
+    Node* insert(std::string&& member, double score);
+    // Unlinks `node` given the predecessor at each level.
+    void unlink(Node* node, Node** update);
+    // Unlinks and frees the node, returning its member string.
+    std::string erase(Node* node);
+    // Node with the given 1-based rank.
+    const Node* by_rank(size_t rank) const;
+    const Node* first_in_range(const ScoreRange& range) const;
+    void clear();
+    // Bytes charged for one member: its node, string and index entry.
+    static size_t node_bytes(const Node* node);
+
+    Node* header_;
+    Node* tail_;
+    int height_;
+    Index index_;  // views of the nodes' members
+    size_t bytes_;  // node_bytes() summed over the members
+};
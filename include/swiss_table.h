@@ -0,0 +1,486 @@
+#pragma once
+#include "bits.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Open-addressing hash table laid out like Abseil's Swiss tables. Slots
+// come in groups of 16, each with one control byte: EMPTY, DELETED, or
+// the low 7 bits of the element's hash (H2) when full. A lookup starts at
+// the group the remaining hash bits (H1) pick and compares its 16 control
+// bytes against H2 at once (one SSE2 compare where available), so it only
+// touches an element whose hash already matches in 7 bits, and it stops
+// at the first group with an EMPTY slot. Groups are probed in triangular
+// order; the table doubles at 7/8 load, or rebuilds at the same size when
+// most of that load is DELETED markers.
+//
+// Slots point to heap nodes that hold the element and its full hash, as in
+// absl::node_hash_map: elements never move, so intrusive hooks and
+// pointers into them survive rehashing, and rehashing never hashes a key
+// again. A std::string key short enough for its inline buffer lives in
+// the node itself. `Hash` must spread its low bits, as std::hash does for
+// strings.
+//
+// Rehashing is incremental, as in Redis's dict: a resize allocates new
+// slot arrays and keeps the old ones, lookups and erases search both, and
+// each insert moves one group of old slots across (rehash_step() moves
+// more from a background task), so no single operation pays for the
+// whole table. A moved slot is marked DELETED rather than EMPTY, which
+// keeps the old arrays' probe sequences intact until the last group has
+// moved. Erasing never moves elements, so erasing while iterating is safe.
+//
+// scan() walks the table one home group at a time in reverse-binary order,
+// like Redis's dictScan over buckets, so an element present for the whole
+// walk is visited exactly once even if the table grows in between.
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class SwissTable {
+    struct Node;
+
+public:
+    using key_type = Key;
+    using mapped_type = Value;
+    using value_type = std::pair<const Key, Value>;
+
+    // Walks the new slot arrays, then the old ones.
+    template <bool Const>
+    class Iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = SwissTable::value_type;
+        using difference_type = std::ptrdiff_t;
+        using reference = std::conditional_t<Const, const value_type&, value_type&>;
+        using pointer = std::conditional_t<Const, const value_type*, value_type*>;
+
+        Iterator() = default;
+        template <bool C = Const, typename = std::enable_if_t<C>>
+        Iterator(const Iterator<false>& other) : table_(other.table_), index_(other.index_) {}
+
+        reference operator*() const { return table_->node_at(index_)->value; }
+        pointer operator->() const { return &table_->node_at(index_)->value; }
+        Iterator& operator++() {
+            index_ = table_->next_full(index_ + 1);
+            return *this;
+        }
+        Iterator operator++(int) {
+            Iterator old = *this;
+            ++*this;
+            return old;
+        }
+        bool operator==(const Iterator& other) const { return index_ == other.index_; }
+        bool operator!=(const Iterator& other) const { return index_ != other.index_; }
+
+    private:
+        friend class SwissTable;
+        template <bool>
+        friend class Iterator;
+        using Table = std::conditional_t<Const, const SwissTable, SwissTable>;
+
+        Iterator(Table* table, size_t index) : table_(table), index_(index) {}
+
+        Table* table_ = nullptr;
+        size_t index_ = 0;  // slot of the new arrays, then past them of the old
+    };
+    using iterator = Iterator<false>;
+    using const_iterator = Iterator<true>;
+
+    static constexpr size_t GROUP_SIZE = 16;
+    // Old groups each insert moves during a resize. A doubled table takes
+    // 7/8 of its old capacity in inserts to fill, far more than the 1/16
+    // it takes to move every group at this rate.
+    static constexpr size_t GROUPS_PER_INSERT = 1;
+
+    SwissTable() = default;
+    SwissTable(const SwissTable& other) : hash_(other.hash_) {
+        reserve(other.size());
+        for (const auto& item : other) try_emplace(item.first, item.second);
+    }
+    SwissTable(SwissTable&& other) noexcept { swap(other); }
+    SwissTable& operator=(const SwissTable& other) {
+        if (this != &other) SwissTable(other).swap(*this);
+        return *this;
+    }
+    SwissTable& operator=(SwissTable&& other) noexcept {
+        if (this != &other) {
+            clear();
+            swap(other);
+        }
+        return *this;
+    }
+    ~SwissTable() {
+        destroy_nodes(table_);
+        destroy_nodes(old_);
+    }
+
+    void swap(SwissTable& other) noexcept {
+        std::swap(table_, other.table_);
+        std::swap(old_, other.old_);
+        std::swap(moved_, other.moved_);
+        std::swap(size_, other.size_);
+        std::swap(old_size_, other.old_size_);
+        std::swap(hash_, other.hash_);
+    }
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    // Slots, full or not, old arrays included.
+    size_t bucket_count() const { return table_.capacity + old_.capacity; }
+    // Whether a resize is still moving elements out of the old arrays.
+    bool rehashing() const { return old_.capacity != 0; }
+
+    iterator begin() { return iterator(this, next_full(0)); }
+    iterator end() { return iterator(this, bucket_count()); }
+    const_iterator begin() const { return const_iterator(this, next_full(0)); }
+    const_iterator end() const { return const_iterator(this, bucket_count()); }
+    // First element at or after slot `slot`, for sampling from a random slot.
+    iterator from_slot(size_t slot) { return iterator(this, next_full(slot)); }
+
+    iterator find(const Key& key) { return iterator(this, find_index(key, hash_(key))); }
+    const_iterator find(const Key& key) const { return const_iterator(this, find_index(key, hash_(key))); }
+    size_t count(const Key& key) const { return find_index(key, hash_(key)) != bucket_count(); }
+
+    // Inserts `key` with a Value built from `args` unless it is present.
+    template <typename... Args>
+    std::pair<iterator, bool> try_emplace(const Key& key, Args&&... args) {
+        size_t hash = hash_(key);
+        size_t index = find_index(key, hash);
+        if (index != bucket_count()) return {iterator(this, index), false};
+        move_groups(GROUPS_PER_INSERT);
+        size_t slot = prepare_insert(hash);
+        table_.slots[slot] = new Node(hash, key, std::forward<Args>(args)...);
+        if (table_.ctrl[slot] == DELETED) --table_.deleted;
+        table_.ctrl[slot] = h2(hash);
+        ++size_;
+        return {iterator(this, slot), true};
+    }
+
+    Value& operator[](const Key& key) { return try_emplace(key).first->second; }
+
+    // Returns the element after `pos`.
+    iterator erase(const_iterator pos) {
+        erase_index(pos.index_);
+        return iterator(this, next_full(pos.index_ + 1));
+    }
+    iterator erase(iterator pos) { return erase(const_iterator(pos)); }
+    size_t erase(const Key& key) {
+        size_t index = find_index(key, hash_(key));
+        if (index == bucket_count()) return 0;
+        erase_index(index);
+        return 1;
+    }
+
+    // Frees every element and the slot arrays.
+    void clear() {
+        destroy_nodes(table_);
+        destroy_nodes(old_);
+        table_ = Arrays();
+        old_ = Arrays();
+        size_ = old_size_ = moved_ = 0;
+    }
+
+    // Grows so that `count` elements fit without a rehash; finishes any
+    // resize under way at once.
+    void reserve(size_t count) {
+        move_groups(old_groups());
+        size_t capacity = table_.capacity ? table_.capacity : GROUP_SIZE;
+        while (max_load(capacity) < count) capacity *= 2;
+        if (capacity == table_.capacity) return;
+        start_resize(capacity);
+        move_groups(old_groups());
+    }
+
+    // Moves up to `groups` groups of old slots into the new arrays.
+    // Returns whether the resize still has groups to move.
+    bool rehash_step(size_t groups) {
+        move_groups(groups);
+        return rehashing();
+    }
+
+    // Calls `fn` on every element whose home group is the one `cursor`
+    // names and returns the cursor of the next group, or 0 once the walk
+    // is complete; a walk starts at 0. `fn` must not insert or erase.
+    template <typename F>
+    size_t scan(size_t cursor, F&& fn) {
+        return scan_nodes(cursor, [&](Node* node) { fn(node->value); });
+    }
+    template <typename F>
+    size_t scan(size_t cursor, F&& fn) const {
+        return scan_nodes(cursor, [&](const Node* node) { fn(node->value); });
+    }
+
+    // Continues a walk from `cursor` until `count` elements have been
+    // visited, or ten times as many home groups if most are empty, and
+    // returns the cursor to resume from (0 once complete). A group is
+    // never split, so a call may visit a few more than `count`.
+    template <typename F>
+    size_t scan_batch(size_t cursor, size_t count, F&& fn) const {
+        size_t visited = 0;
+        size_t groups = 0;
+        size_t max_groups = count > SIZE_MAX / 10 ? SIZE_MAX : count * 10;
+        do {
+            cursor = scan(cursor, [&](const value_type& item) {
+                ++visited;
+                fn(item);
+            });
+        } while (cursor && visited < count && ++groups < max_groups);
+        return cursor;
+    }
+
+    // Whether a walk whose next cursor is `cursor` has passed the home
+    // group of `key`, present or not. False for cursor 0.
+    bool scanned(const Key& key, size_t cursor) const {
+        if (!cursor || !table_.capacity) return false;
+        size_t mask = scan_mask();
+        return reverse_bits(h1(hash_(key)) & mask) < reverse_bits(cursor & mask);
+    }
+
+    // Heap bytes of one element's node.
+    static constexpr size_t node_bytes() { return sizeof(Node); }
+    // Heap bytes of the control bytes and slot pointers, old arrays included.
+    size_t table_bytes() const { return bucket_count() * (sizeof(ctrl_t) + sizeof(Node*)); }
+
+private:
+    using ctrl_t = int8_t;
+    static constexpr ctrl_t EMPTY = -128;
+    static constexpr ctrl_t DELETED = -2;
+
+    struct Node {
+        template <typename... Args>
+        Node(size_t h, const Key& key, Args&&... args)
+            : hash(h), value(std::piecewise_construct, std::forward_as_tuple(key),
+                             std::forward_as_tuple(std::forward<Args>(args)...)) {}
+
+        size_t hash;
+        value_type value;
+    };
+
+    // Control bytes and slots of one table size.
+    struct Arrays {
+        std::unique_ptr<ctrl_t[]> ctrl;
+        std::unique_ptr<Node*[]> slots;
+        size_t capacity = 0;  // 0, or a power of two of at least GROUP_SIZE
+        size_t deleted = 0;   // DELETED control bytes
+
+        Arrays() = default;
+        explicit Arrays(size_t n) : ctrl(new ctrl_t[n]), slots(new Node*[n]), capacity(n) {
+            // Slots are only read where the control byte says full, so they
+            // stay uninitialized and a large table is not faulted in at once.
+            std::fill(ctrl.get(), ctrl.get() + n, EMPTY);
+        }
+        size_t group_mask() const { return capacity / GROUP_SIZE - 1; }
+    };
+
+    // Masks of the slots in one group whose control bytes match.
+    struct Group {
+#if defined(__SSE2__)
+        explicit Group(const ctrl_t* ctrl) : bytes(_mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl))) {}
+        uint32_t match(ctrl_t h) const { return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h), bytes)); }
+        // EMPTY and DELETED are the control bytes with the sign bit set.
+        uint32_t match_empty_or_deleted() const { return _mm_movemask_epi8(bytes); }
+
+        __m128i bytes;
+#else
+        explicit Group(const ctrl_t* ctrl) : bytes(ctrl) {}
+        uint32_t match(ctrl_t h) const {
+            uint32_t mask = 0;
+            for (size_t i = 0; i < GROUP_SIZE; ++i) mask |= uint32_t(bytes[i] == h) << i;
+            return mask;
+        }
+        uint32_t match_empty_or_deleted() const {
+            uint32_t mask = 0;
+            for (size_t i = 0; i < GROUP_SIZE; ++i) mask |= uint32_t(bytes[i] < 0) << i;
+            return mask;
+        }
+
+        const ctrl_t* bytes;
+#endif
+        uint32_t match_empty() const { return match(EMPTY); }
+        uint32_t match_full() const { return ~match_empty_or_deleted() & 0xFFFF; }
+    };
+
+    static size_t h1(size_t hash) { return hash >> 7; }
+    static ctrl_t h2(size_t hash) { return static_cast<ctrl_t>(hash & 0x7F); }
+    static size_t max_load(size_t capacity) { return capacity - capacity / 8; }
+    size_t old_groups() const { return old_.capacity / GROUP_SIZE; }
+    // The old arrays are never larger than the new ones.
+    size_t scan_mask() const { return rehashing() ? old_.group_mask() : table_.group_mask(); }
+
+    static uint64_t reverse_bits(uint64_t v) {
+        v = ((v >> 1) & 0x5555555555555555ULL) | ((v & 0x5555555555555555ULL) << 1);
+        v = ((v >> 2) & 0x3333333333333333ULL) | ((v & 0x3333333333333333ULL) << 2);
+        v = ((v >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((v & 0x0F0F0F0F0F0F0F0FULL) << 4);
+        return bswap64(v);
+    }
+
+    Node* node_at(size_t index) const {
+        return index < table_.capacity ? table_.slots[index] : old_.slots[index - table_.capacity];
+    }
+
+    // Iterator index of `key`, or bucket_count() if it is absent.
+    size_t find_index(const Key& key, size_t hash) const {
+        size_t slot = find_slot(table_, key, hash);
+        if (slot != table_.capacity || !rehashing()) return slot;
+        return table_.capacity + find_slot(old_, key, hash);
+    }
+
+    // Slot of `key` in `arrays`, or arrays.capacity if it is absent.
+    static size_t find_slot(const Arrays& arrays, const Key& key, size_t hash) {
+        if (!arrays.capacity) return arrays.capacity;
+        size_t mask = arrays.group_mask();
+        ctrl_t tag = h2(hash);
+        for (size_t group = h1(hash) & mask, step = 0;; group = (group + ++step) & mask) {
+            size_t base = group * GROUP_SIZE;
+            Group g(&arrays.ctrl[base]);
+            for (uint32_t match = g.match(tag); match; match &= match - 1) {
+                size_t slot = base + ctz32(match);
+                const Node* node = arrays.slots[slot];
+                if (node->hash == hash && node->value.first == key) return slot;
+            }
+            if (g.match_empty()) return arrays.capacity;
+        }
+    }
+
+    // First EMPTY or DELETED slot on the probe sequence of `hash`.
+    static size_t free_slot(const Arrays& arrays, size_t hash) {
+        size_t mask = arrays.group_mask();
+        for (size_t group = h1(hash) & mask, step = 0;; group = (group + ++step) & mask) {
+            size_t base = group * GROUP_SIZE;
+            uint32_t open = Group(&arrays.ctrl[base]).match_empty_or_deleted();
+            if (open) return base + ctz32(open);
+        }
+    }
+
+    template <typename F>
+    size_t scan_nodes(size_t cursor, F&& fn) const {
+        if (!table_.capacity) return 0;
+        // Cursors advance over the smaller (old) arrays' groups; each of
+        // them covers the groups of the new arrays with the same low bits.
+        size_t mask = scan_mask();
+        size_t home = cursor & mask;
+        if (rehashing()) scan_home(old_, home, fn);
+        for (size_t group = home; group <= table_.group_mask(); group += mask + 1) scan_home(table_, group, fn);
+        cursor |= ~mask;
+        cursor = reverse_bits(reverse_bits(cursor) + 1);
+        return cursor;
+    }
+
+    template <typename F>
+    static void scan_home(const Arrays& arrays, size_t home, F& fn) {
+        size_t mask = arrays.group_mask();
+        for (size_t group = home, step = 0;; group = (group + ++step) & mask) {
+            size_t base = group * GROUP_SIZE;
+            Group g(&arrays.ctrl[base]);
+            for (uint32_t full = g.match_full(); full; full &= full - 1) {
+                Node* node = arrays.slots[base + ctz32(full)];
+                if ((h1(node->hash) & mask) == home) fn(node);
+            }
+            // Elements homed here never sit past a group with an EMPTY slot.
+            if (g.match_empty()) break;
+        }
+    }
+
+    // Slot of the new arrays for a new element with `hash`, starting a
+    // resize first if taking an EMPTY slot would pass the load limit.
+    size_t prepare_insert(size_t hash) {
+        if (table_.capacity) {
+            size_t slot = free_slot(table_, hash);
+            size_t load = size_ - old_size_ + table_.deleted;
+            if (table_.ctrl[slot] == DELETED || load < max_load(table_.capacity)) return slot;
+        }
+        // Full before the last resize finished, which the insert rate
+        // rules out unless erases made room for more inserts: finish it.
+        move_groups(old_groups());
+        if (!table_.capacity) {
+            table_ = Arrays(GROUP_SIZE);
+        } else if (size_ < max_load(table_.capacity) / 2) {
+            start_resize(table_.capacity);  // mostly DELETED markers: rebuild
+        } else {
+            start_resize(table_.capacity * 2);
+        }
+        return free_slot(table_, hash);
+    }
+
+    void start_resize(size_t capacity) {
+        old_ = std::move(table_);
+        table_ = Arrays(capacity);
+        old_size_ = size_;
+        moved_ = 0;
+    }
+
+    void move_groups(size_t groups) {
+        if (!rehashing()) return;
+        for (size_t end = std::min(old_groups(), moved_ + groups); moved_ < end; ++moved_) {
+            size_t base = moved_ * GROUP_SIZE;
+            for (uint32_t full = Group(&old_.ctrl[base]).match_full(); full; full &= full - 1) {
+                size_t old_slot = base + ctz32(full);
+                Node* node = old_.slots[old_slot];
+                size_t slot = free_slot(table_, node->hash);
+                if (table_.ctrl[slot] == DELETED) --table_.deleted;
+                table_.ctrl[slot] = h2(node->hash);
+                table_.slots[slot] = node;
+                old_.ctrl[old_slot] = DELETED;
+                --old_size_;
+            }
+        }
+        if (moved_ == old_groups()) {
+            old_ = Arrays();
+            moved_ = 0;
+        }
+    }
+
+    void erase_index(size_t index) {
+        if (index < table_.capacity) {
+            erase_slot(table_, index);
+        } else {
+            erase_slot(old_, index - table_.capacity);
+            --old_size_;
+        }
+        --size_;
+    }
+
+    static void erase_slot(Arrays& arrays, size_t slot) {
+        // A group that still has an EMPTY slot never made a probe move
+        // past it, so the slot can go back to EMPTY; otherwise lookups
+        // must keep probing through it.
+        if (Group(&arrays.ctrl[slot & ~(GROUP_SIZE - 1)]).match_empty()) {
+            arrays.ctrl[slot] = EMPTY;
+        } else {
+            arrays.ctrl[slot] = DELETED;
+            ++arrays.deleted;
+        }
+        Node* node = arrays.slots[slot];
+        arrays.slots[slot] = nullptr;
+        delete node;
+    }
+
+    size_t next_full(size_t index) const {
+        for (; index < table_.capacity; ++index) {
+            if (table_.ctrl[index] >= 0) return index;
+        }
+        for (; index < bucket_count(); ++index) {
+            if (old_.ctrl[index - table_.capacity] >= 0) return index;
+        }
+        return index;
+    }
+
+    static void destroy_nodes(Arrays& arrays) {
+        for (size_t i = 0; i < arrays.capacity; ++i) {
+            if (arrays.ctrl[i] >= 0) delete arrays.slots[i];
+        }
+    }
+
+    Arrays table_;  // where new elements go
+    Arrays old_;    // being emptied into table_ while rehashing()
+    size_t moved_ = 0;     // groups of old_ already moved
+    size_t size_ = 0;      // elements in both
+    size_t old_size_ = 0;  // elements still in old_
+    Hash hash_;
+};
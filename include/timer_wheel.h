@@ -0,0 +1,176 @@
+#pragma once
+#include "bits.h"
+#include "intrusive_list.h"
+#include <chrono>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+// Counters kept by every cache's expiration engine.
+struct ExpiryStats {
+    uint64_t expired = 0;         // keys removed because their TTL passed
+    uint64_t active_expired = 0;  // of those, removed by the timer wheel rather than on access
+    std::chrono::nanoseconds total_lag{0};  // sum of (removal time - deadline) over active expirations
+    std::chrono::nanoseconds max_lag{0};
+
+    void merge(const ExpiryStats& other) {
+        expired += other.expired;
+        active_expired += other.active_expired;
+        total_lag += other.total_lag;
+        if (other.max_lag > max_lag) max_lag = other.max_lag;
+    }
+};
+
+// Hierarchical timing wheel over objects of type T that derive from
+// ListHook<Tag> and carry a `std::chrono::steady_clock::time_point
+// expires_at`. A linked object is scheduled; destroying or unlinking it
+// cancels the timer, so owners never have to tell the wheel.
+//
+// Ticks are milliseconds. Level L has 256 slots of 256^L ticks each; an
+// entry sits at the lowest level whose window it shares with the current
+// tick and moves down a level each time the wheel reaches its slot, so
+// scheduling and cancelling are O(1). Deadlines more than 2^32 ms (about
+// 49 days) ahead wait in an overflow list. Per-level bitmaps of occupied
+// slots let advance() jump over empty stretches of time.
+template <typename T, typename Tag>
+class TimerWheel {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit TimerWheel(Clock::time_point start = Clock::now()) : epoch_(start), current_(0) {
+        for (auto& level : bitmap_) {
+            for (auto& word : level) word = 0;
+        }
+    }
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    // Schedules `entry` for entry.expires_at, moving it if already scheduled.
+    void schedule(T& entry) { place(entry, deadline_tick(entry.expires_at)); }
+
+    // Moves the wheel up to `now` and hands at most `max_expired` due
+    // entries to `expire`, unlinked, oldest tick first. Entries left over
+    // stay due and come first on the next call. Returns the number expired.
+    template <typename Fn>
+    size_t advance(Clock::time_point now, size_t max_expired, Fn&& expire) {
+        uint64_t now_tick = tick_of(now);
+        size_t expired = 0;
+        for (;;) {
+            List& slot = slots_[0][current_ & SLOT_MASK];
+            while (T* entry = slot.front()) {
+                if (expired == max_expired) return expired;
+                static_cast<ListHook<Tag>*>(entry)->unlink();
+                ++expired;
+                expire(*entry);
+            }
+            clear_bit(0, current_ & SLOT_MASK);
+            if (current_ >= now_tick) return expired;
+
+            uint64_t next = next_event(current_);
+            current_ = next < now_tick ? next : now_tick;
+            cascade(current_);
+        }
+    }
+
+private:
+    using List = IntrusiveList<T, Tag>;
+    static const unsigned LEVELS = 4;
+    static const unsigned SLOT_BITS = 8;
+    static const uint64_t SLOTS = uint64_t(1) << SLOT_BITS;
+    static const uint64_t SLOT_MASK = SLOTS - 1;
+    static const uint64_t NEVER = ~uint64_t(0);
+
+    uint64_t tick_of(Clock::time_point when) const {
+        if (when <= epoch_) return 0;
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(when - epoch_).count());
+    }
+
+    // Rounded up, so an entry never fires before its deadline.
+    uint64_t deadline_tick(Clock::time_point when) const {
+        uint64_t tick = tick_of(when);
+        return epoch_ + std::chrono::milliseconds(tick) < when ? tick + 1 : tick;
+    }
+
+    void place(T& entry, uint64_t tick) {
+        // Already due: the current slot is drained by the next advance().
+        if (tick < current_) tick = current_;
+        for (unsigned level = 0; level < LEVELS; ++level) {
+            unsigned above = SLOT_BITS * (level + 1);
+            if ((tick >> above) == (current_ >> above)) {
+                size_t index = (tick >> (SLOT_BITS * level)) & SLOT_MASK;
+                slots_[level][index].push_back(entry);
+                set_bit(level, index);
+                return;
+            }
+        }
+        overflow_.push_back(entry);
+    }
+
+    // Re-files the entries of every level whose slot boundary is `tick`,
+    // highest level first, so they drop towards level 0.
+    void cascade(uint64_t tick) {
+        if ((tick & ((uint64_t(1) << (SLOT_BITS * LEVELS)) - 1)) == 0) refile(overflow_);
+        for (unsigned level = LEVELS - 1; level >= 1; --level) {
+            if ((tick & ((uint64_t(1) << (SLOT_BITS * level)) - 1)) != 0) continue;
+            size_t index = (tick >> (SLOT_BITS * level)) & SLOT_MASK;
+            refile(slots_[level][index]);
+            clear_bit(level, index);
+        }
+    }
+
+    void refile(List& list) {
+        // Detach first: far-off entries go straight back to the overflow list.
+        List pending;
+        while (T* entry = list.front()) pending.push_back(*entry);
+        while (T* entry = pending.front()) {
+            static_cast<ListHook<Tag>*>(entry)->unlink();
+            schedule(*entry);
+        }
+    }
+
+    // First tick after `tick` at which a level-0 slot is due or a higher
+    // slot cascades; NEVER if the wheel is empty from here on.
+    uint64_t next_event(uint64_t tick) const {
+        for (unsigned level = 0; level < LEVELS; ++level) {
+            unsigned shift = SLOT_BITS * level;
+            size_t index = (tick >> shift) & SLOT_MASK;
+            size_t found = next_bit(level, index + 1);
+            if (found < SLOTS) {
+                return ((tick >> (shift + SLOT_BITS)) << (shift + SLOT_BITS)) | (uint64_t(found) << shift);
+            }
+        }
+        if (!overflow_.empty()) {
+            unsigned top = SLOT_BITS * LEVELS;
+            return ((tick >> top) + 1) << top;
+        }
+        return NEVER;
+    }
+
+    // Bits mark slots that may hold entries; cancelled timers can leave a
+    // bit set for an empty slot, which costs one empty visit.
+    void set_bit(unsigned level, size_t index) { bitmap_[level][index >> 6] |= uint64_t(1) << (index & 63); }
+    void clear_bit(unsigned level, size_t index) { bitmap_[level][index >> 6] &= ~(uint64_t(1) << (index & 63)); }
+
+    size_t next_bit(unsigned level, size_t from) const {
+        for (size_t word = from >> 6; word < SLOTS / 64; ++word) {
+            uint64_t bits = bitmap_[level][word];
+            if (word == (from >> 6)) bits &= ~uint64_t(0) << (from & 63);
+            if (bits) return word * 64 + static_cast<size_t>(ctz64(bits));
+        }
+        return SLOTS;
+    }
+
+    Clock::time_point epoch_;
+    uint64_t current_;  // tick whose level-0 slot is drained next
+    List slots_[LEVELS][SLOTS];
+    List overflow_;
+    uint64_t bitmap_[LEVELS][SLOTS / 64];
+};
+
+// Side-table timer for caches that keep TTLs in a map keyed by name: the
+// map owns the node, and erasing it cancels the timer.
+struct TimerTag {};
+struct KeyTimer : ListHook<TimerTag> {
+    std::chrono::steady_clock::time_point expires_at;
+    const std::string* key = nullptr;  // the side table's copy of the key
+};
@@ -0,0 +1,101 @@
+/*
+ * tiny_lfu.h
+ * Defines the W-TinyLFU admission and eviction policy.
+ */
+
+#ifndef TINY_LFU_H
+#define TINY_LFU_H
+
+#include "data_types.h"
+#include "intrusive_list.h"
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+// Count-min sketch of recent access frequencies with 4-bit counters, 16
+// to a word, in four rows. Once the sketch has counted ten times as many
+// accesses as it has counters per row, every counter is halved, so old
+// popularity fades. Estimates never undercount between resets.
+class FrequencySketch {
+public:
+    // Resizes to at least `keys` counters per row; resizing clears it.
+    void ensure_capacity(size_t keys);
+    void increment(const std::string& key);
+    uint32_t frequency(const std::string& key) const;
+    size_t bytes() const { return table_.capacity() * sizeof(uint64_t); }
+
+private:
+    static const int DEPTH = 4;
+
+    // Index of the counter for `hash` in row `row`, over all rows.
+    size_t slot(uint64_t hash, int row) const;
+    void halve();
+
+    std::vector<uint64_t> table_;  // DEPTH rows of width_ / 16 words
+    size_t width_ = 0;
+    size_t additions_ = 0;
+    size_t sample_size_ = 0;
+};
+
+// Counters of the W-TinyLFU policy, summed over the shards for INFO.
+struct TinyLFUStats {
+    size_t window = 0;       // keys in the admission window
+    size_t protected_ = 0;   // keys in the protected main segment
+    uint64_t admitted = 0;   // window keys that displaced a main key
+    uint64_t rejected = 0;   // window keys evicted in favour of a main key
+
+    void merge(const TinyLFUStats& other) {
+        window += other.window;
+        protected_ += other.protected_;
+        admitted += other.admitted;
+        rejected += other.rejected;
+    }
+};
+
+// W-TinyLFU (Einziger, Friedman and Manes) over the entries of a Keyspace
+// table, used by EnhancedCache under EvictionPolicy::TINY_LFU. New keys
+// enter a window LRU holding 1% of the cache; keys leaving the window join
+// the probation segment of a segmented LRU, and a second access there
+// promotes them to the protected segment (80% of the main space). To
+// evict, the newest key on probation competes with the oldest: the one the
+// FrequencySketch has seen less often goes. A burst of keys used once, such
+// as a scan, thus passes through the window and probation without
+// displacing the keys that are used repeatedly.
+//
+// Entries are linked through their LruTag hook; their `segment` charge
+// counts them in the window or protected segment. The cache size is the
+// number of resident keys.
+class TinyLFUCache {
+public:
+    TinyLFUCache() = default;
+    ~TinyLFUCache();
+    TinyLFUCache(const TinyLFUCache&) = delete;
+    TinyLFUCache& operator=(const TinyLFUCache&) = delete;
+
+    // `entry` was just added to the table, which now holds `resident` keys.
+    void insert(KeyEntry& entry, size_t resident);
+    // Access to a resident entry.
+    void hit(KeyEntry& entry, size_t resident);
+    // Entry to evict next, other than `spare`; nullptr if there is none.
+    KeyEntry* victim(const KeyEntry& spare);
+    // Unlinks every entry, when the policy changes.
+    void clear();
+
+    TinyLFUStats stats() const;
+    // Heap bytes of the frequency sketch.
+    size_t sketch_bytes() const { return sketch_.bytes(); }
+
+private:
+    static size_t window_limit(size_t resident) { return std::max<size_t>(1, resident / 100); }
+
+    IntrusiveList<KeyEntry, LruTag> window_, probation_, protected_;  // MRU at the front
+    size_t window_size_ = 0;     // charged by the entries in the window
+    size_t protected_size_ = 0;  // charged by the entries in protected_
+    FrequencySketch sketch_;
+    uint64_t admitted_ = 0;
+    uint64_t rejected_ = 0;
+};
+
+#endif // TINY_LFU_H
@@ -0,0 +1,640 @@
+/*
+ * aof.cpp
+ * Implements the background AOF writer and AOF rewrite.
+ */
+
+#include "aof.h"
+#include "crc32.h"
+#include <iostream>
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <fcntl.h>
+
+#ifdef _WIN32
+#include <io.h>
+#include <windows.h>
+#define aof_open(path) _open(path, _O_WRONLY | _O_APPEND | _O_CREAT | _O_BINARY, 0644)
+#define aof_open_trunc(path) _open(path, _O_WRONLY | _O_TRUNC | _O_CREAT | _O_BINARY, 0644)
+#define aof_write _write
+#define aof_fsync _commit
+#define aof_close _close
+#define aof_size(fd) _lseeki64(fd, 0, SEEK_END)
+#define aof_truncate(fd, size) _chsize_s(fd, size)
+#else
+#include <unistd.h>
+#define aof_open(path) open(path, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644)
+#define aof_open_trunc(path) open(path, O_WRONLY | O_TRUNC | O_CREAT | O_CLOEXEC, 0644)
+#define aof_write write
+#define aof_fsync fsync
+#define aof_close close
+#define aof_size(fd) lseek(fd, 0, SEEK_END)
+#define aof_truncate(fd, size) ftruncate(fd, size)
+#endif
+
+namespace {
+
+// Captured writes are copied into the new file until fewer than this many
+// bytes are left for the writer thread to append at swap time.
+const size_t REWRITE_TAIL_TARGET = 64 * 1024;
+const int REWRITE_DRAIN_ROUNDS = 16;
+const size_t REWRITE_CHUNK = 1024 * 1024;
+const size_t LOAD_BLOCK = 1024 * 1024;
+// Upper bound on one record; anything larger is treated as corruption.
+const uint32_t MAX_RECORD_SIZE = 1u << 30;
+// How long the writer waits before retrying a failed write or fsync.
+const auto WRITE_RETRY_INTERVAL = std::chrono::seconds(1);
+
+thread_local bool loading_aof = false;
+thread_local std::string record_scratch;
+// Cleared when a commit on this thread does not reach the disk
+thread_local bool commits_durable = true;
+
+void put_u32(char* p, uint32_t v) {
+    p[0] = static_cast<char>(v);
+    p[1] = static_cast<char>(v >> 8);
+    p[2] = static_cast<char>(v >> 16);
+    p[3] = static_cast<char>(v >> 24);
+}
+
+uint32_t get_u32(const char* p) {
+    const unsigned char* u = reinterpret_cast<const unsigned char*>(p);
+    return uint32_t(u[0]) | uint32_t(u[1]) << 8 | uint32_t(u[2]) << 16 | uint32_t(u[3]) << 24;
+}
+
+// Splits a payload into its arguments; false if the lengths do not add up.
+bool decode_payload(const char* p, size_t len, std::vector<std::string_view>& args) {
+    args.clear();
+    if (len < 4) return false;
+    uint32_t argc = get_u32(p);
+    size_t pos = 4;
+    for (uint32_t i = 0; i < argc; ++i) {
+        if (len - pos < 4) return false;
+        uint32_t n = get_u32(p + pos);
+        pos += 4;
+        if (len - pos < n) return false;
+        args.emplace_back(p + pos, n);
+        pos += n;
+    }
+    return pos == len;
+}
+
+// Lines written by the old text format: space separated arguments.
+void split_text_line(std::string_view line, std::vector<std::string_view>& args) {
+    args.clear();
+    size_t pos = 0;
+    while (pos < line.size()) {
+        size_t end = line.find(' ', pos);
+        if (end == std::string_view::npos) end = line.size();
+        if (end > pos) args.push_back(line.substr(pos, end - pos));
+        pos = end + 1;
+    }
+}
+
+int open_file(const std::string& path) {
+    int fd = aof_open(path.c_str());
+    if (fd < 0) {
+        std::cerr << "Failed to open AOF " << path << ": " << strerror(errno) << std::endl;
+    }
+    return fd;
+}
+
+bool write_all(int fd, const std::string& data) {
+    if (fd < 0) return false;
+    size_t offset = 0;
+    while (offset < data.size()) {
+        auto n = aof_write(fd, data.data() + offset, static_cast<unsigned>(data.size() - offset));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "AOF write failed: " << strerror(errno) << std::endl;
+            return false;
+        }
+        offset += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// Atomically replaces `to` with `from`.
+bool replace_file(const std::string& from, const std::string& to) {
+#ifdef _WIN32
+    return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    return std::rename(from.c_str(), to.c_str()) == 0;
+#endif
+}
+
+} // namespace
+
+AppendFsync parse_appendfsync(const std::string& name) {
+    std::string lower = name;
+    std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+    if (lower == "always") return AppendFsync::ALWAYS;
+    if (lower == "no") return AppendFsync::NO;
+    return AppendFsync::EVERYSEC;
+}
+
+AOFRecord::AOFRecord(std::string& out) : out_(out), start_(out.size()), argc_(0) {
+    out_.append(HEADER_SIZE + 4, '\0');
+    out_[start_] = static_cast<char>(MAGIC);
+}
+
+void AOFRecord::add(std::string_view arg) {
+    char len[4];
+    put_u32(len, static_cast<uint32_t>(arg.size()));
+    out_.append(len, 4);
+    out_.append(arg.data(), arg.size());
+    ++argc_;
+}
+
+void AOFRecord::finish() {
+    char* header = &out_[start_];
+    char* payload = header + HEADER_SIZE;
+    size_t payload_len = out_.size() - start_ - HEADER_SIZE;
+    put_u32(payload, argc_);
+    put_u32(header + 1, static_cast<uint32_t>(payload_len));
+    put_u32(header + 5, crc32(payload, payload_len));
+}
+
+AOFCommit::~AOFCommit() {
+    if (seq_ && !AOFWriter::instance().wait_durable(seq_)) commits_durable = false;
+}
+
+bool AOFCommit::take_durable() {
+    bool durable = commits_durable;
+    commits_durable = true;
+    return durable;
+}
+
+void AOFCommit::log(std::initializer_list<std::string_view> args, uint64_t rewrite_mark) {
+    if (loading_aof) return;
+    record_scratch.clear();
+    AOFRecord record(record_scratch);
+    for (std::string_view arg : args) record.add(arg);
+    record.finish();
+    seq_ = AOFWriter::instance().append(record_scratch, rewrite_mark);
+}
+
+void AOFCommit::log(std::initializer_list<std::string_view> args, const std::vector<std::string>& tail,
+                    uint64_t rewrite_mark) {
+    if (loading_aof) return;
+    record_scratch.clear();
+    AOFRecord record(record_scratch);
+    for (std::string_view arg : args) record.add(arg);
+    for (const auto& arg : tail) record.add(arg);
+    record.finish();
+    seq_ = AOFWriter::instance().append(record_scratch, rewrite_mark);
+}
+
+void AOFCommit::log_records(const std::string& records, uint64_t rewrite_mark) {
+    if (loading_aof) return;
+    seq_ = AOFWriter::instance().append(records, rewrite_mark);
+}
+
+bool AOFLoader::replaying() {
+    return loading_aof;
+}
+
+AOFLoader::Result AOFLoader::load(const std::string& path, const Apply& apply, bool repair, Stats* stats) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) return Result::NOT_FOUND;
+
+    struct LoadingScope {
+        LoadingScope() { loading_aof = true; }
+        ~LoadingScope() { loading_aof = false; }
+    } scope;
+
+    std::vector<std::string_view> args;
+    std::string buf;
+    size_t begin = 0;      // first unparsed byte in buf
+    size_t offset = 0;     // file offset of buf[begin]
+    size_t records = 0;
+    bool eof = false;
+    bool binary = false;   // a binary record has been read: no text lines may follow
+    Result result = Result::OK;
+
+    while (true) {
+        size_t avail = buf.size() - begin;
+        size_t need = 0;  // bytes required before the next record can be parsed
+
+        if (avail > 0 && static_cast<unsigned char>(buf[begin]) == AOFRecord::MAGIC) {
+            if (avail >= AOFRecord::HEADER_SIZE) {
+                uint32_t len = get_u32(&buf[begin + 1]);
+                if (len > MAX_RECORD_SIZE) {
+                    result = Result::CORRUPT;
+                    break;
+                }
+                need = AOFRecord::HEADER_SIZE + len;
+                if (avail >= need) {
+                    const char* payload = &buf[begin + AOFRecord::HEADER_SIZE];
+                    if (crc32(payload, len) != get_u32(&buf[begin + 5]) ||
+                        !decode_payload(payload, len, args)) {
+                        result = Result::CORRUPT;
+                        break;
+                    }
+                    apply(args);
+                    ++records;
+                    binary = true;
+                    begin += need;
+                    offset += need;
+                    continue;
+                }
+            } else {
+                need = AOFRecord::HEADER_SIZE;
+            }
+        } else if (avail > 0) {
+            // Text lines come from files written before the binary format,
+            // which the writer only appends binary records to; after the
+            // first binary record anything else is damage.
+            if (binary) {
+                result = Result::CORRUPT;
+                break;
+            }
+            size_t nl = buf.find('\n', begin);
+            if (nl != std::string::npos) {
+                std::string_view line(&buf[begin], nl - begin);
+                if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+                split_text_line(line, args);
+                if (!args.empty()) {
+                    apply(args);
+                    ++records;
+                }
+                offset += nl + 1 - begin;
+                begin = nl + 1;
+                continue;
+            }
+            if (avail > MAX_RECORD_SIZE) {
+                result = Result::CORRUPT;
+                break;
+            }
+            need = avail + 1;
+        }
+
+        if (eof) {
+            if (avail > 0) result = Result::TRUNCATED;
+            break;
+        }
+        // Keep the unparsed tail and read the next block behind it.
+        buf.erase(0, begin);
+        begin = 0;
+        size_t old_size = buf.size();
+        buf.resize(old_size + std::max(LOAD_BLOCK, need > old_size ? need - old_size : 0));
+        in.read(&buf[old_size], static_cast<std::streamsize>(buf.size() - old_size));
+        buf.resize(old_size + static_cast<size_t>(in.gcount()));
+        if (buf.size() == old_size) eof = true;
+    }
+    in.close();
+
+    if (stats) {
+        stats->records = records;
+        stats->bytes = offset;
+    }
+    if (result == Result::TRUNCATED && repair) {
+        std::error_code ec;
+        std::filesystem::resize_file(path, offset, ec);
+        if (ec) std::cerr << "Failed to truncate AOF " << path << ": " << ec.message() << std::endl;
+    }
+    return result;
+}
+
+AOFRewriteFile::AOFRewriteFile(const std::string& path, uint64_t id)
+    : path_(path), id_(id), fd_(aof_open_trunc(path.c_str())), ok_(true), size_(0) {
+    if (fd_ < 0) {
+        std::cerr << "Failed to create AOF rewrite file " << path << ": " << strerror(errno) << std::endl;
+    }
+}
+
+AOFRewriteFile::~AOFRewriteFile() {
+    if (fd_ >= 0) aof_close(fd_);
+}
+
+void AOFRewriteFile::write(const std::string& chunk) {
+    if (!ok()) return;
+    pending_ += chunk;
+    size_ += chunk.size();
+    if (pending_.size() >= REWRITE_CHUNK) flush_pending();
+}
+
+bool AOFRewriteFile::flush_pending() {
+    if (!ok()) return false;
+    if (!write_all(fd_, pending_)) ok_ = false;
+    pending_.clear();
+    return ok_;
+}
+
+int AOFRewriteFile::release() {
+    int fd = fd_;
+    fd_ = -1;
+    return fd;
+}
+
+AOFWriter& AOFWriter::instance() {
+    static AOFWriter writer;
+    return writer;
+}
+
+AOFWriter::AOFWriter()
+    : filename_("db.aof"), policy_(AppendFsync::EVERYSEC), enabled_(true), reopen_(false),
+      appended_seq_(0), synced_seq_(0), flush_requested_(0),
+      auto_rewrite_pct_(0), auto_rewrite_min_size_(0), rewrite_in_progress_(false),
+      capturing_(false), rewrite_id_(0), last_rewrite_ok_(true), rewrites_(0),
+      current_size_(0), base_size_(0), write_error_(false), running_(true) {
+    thread_ = std::thread(&AOFWriter::run, this);
+}
+
+AOFWriter::~AOFWriter() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = false;
+    }
+    has_data_.notify_one();
+    if (rewrite_thread_.joinable()) rewrite_thread_.join();
+    if (thread_.joinable()) thread_.join();
+}
+
+void AOFWriter::configure(const std::string& filename, AppendFsync policy, bool enabled) {
+    flush();
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (filename != filename_) {
+        filename_ = filename;
+        reopen_ = true;
+        has_data_.notify_one();
+    }
+    policy_ = policy;
+    enabled_ = enabled;
+}
+
+uint64_t AOFWriter::append(const std::string& record, uint64_t rewrite_mark) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!enabled_) return 0;
+    bool was_empty = buffer_.empty();
+    buffer_ += record;
+    if (capturing_ && rewrite_mark == rewrite_id_) {
+        rewrite_buffer_ += record;
+    }
+    uint64_t seq = ++appended_seq_;
+    if (was_empty) has_data_.notify_one();
+    return seq;
+}
+
+bool AOFWriter::wait_durable(uint64_t seq) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (policy_ != AppendFsync::ALWAYS) return true;
+    written_.wait(lock, [this, seq] { return synced_seq_ >= seq || write_error_ || !running_; });
+    return synced_seq_ >= seq;
+}
+
+bool AOFWriter::flush() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    uint64_t target = appended_seq_;
+    flush_requested_ = std::max(flush_requested_, target);
+    has_data_.notify_one();
+    written_.wait(lock, [this, target] { return synced_seq_ >= target || write_error_ || !running_; });
+    return synced_seq_ >= target;
+}
+
+
+void AOFWriter::set_rewrite_source(AOFRewriteSource source) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    rewrite_source_ = std::move(source);
+}
+
+void AOFWriter::set_auto_rewrite(unsigned percentage, size_t min_size) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto_rewrite_pct_ = percentage;
+    auto_rewrite_min_size_ = min_size;
+}
+
+bool AOFWriter::start_rewrite() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return start_rewrite_locked();
+}
+
+uint64_t AOFWriter::capture_id() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return capturing_ ? rewrite_id_ : 0;
+}
+
+AOFWriter::Status AOFWriter::status() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return Status{rewrite_in_progress_, last_rewrite_ok_, rewrites_, current_size_, base_size_, !write_error_};
+}
+
+std::string AOFWriter::filename() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return filename_;
+}
+
+AppendFsync AOFWriter::policy() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return policy_;
+}
+
+bool AOFWriter::enabled() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return enabled_;
+}
+
+bool AOFWriter::start_rewrite_locked() {
+    if (rewrite_in_progress_ || !rewrite_source_ || !enabled_ || !running_) return false;
+    // A previous rewrite thread has already handed its file over and no
+    // longer needs the mutex, so joining it here cannot deadlock.
+    if (rewrite_thread_.joinable()) rewrite_thread_.join();
+    rewrite_in_progress_ = true;
+    capturing_ = true;
+    rewrite_buffer_.clear();
+    ++rewrite_id_;
+    rewrite_thread_ = std::thread(&AOFWriter::run_rewrite, this, rewrite_source_, rewrite_id_, filename_);
+    return true;
+}
+
+bool AOFWriter::auto_rewrite_due() const {
+    if (auto_rewrite_pct_ == 0 || rewrite_in_progress_ || !rewrite_source_) return false;
+    if (current_size_ < auto_rewrite_min_size_ || current_size_ <= base_size_) return false;
+    return (current_size_ - base_size_) * 100 >= base_size_ * auto_rewrite_pct_;
+}
+
+void AOFWriter::run_rewrite(AOFRewriteSource source, uint64_t id, std::string path) {
+    std::string temp_path = path + ".rewrite";
+    AOFRewriteFile out(temp_path, id);
+    if (out.ok()) source(out);
+
+    // Shards dumped early keep changing while the rest are written; copy
+    // what has been captured so far so the tail left for the swap is small.
+    std::string captured;
+    for (int round = 0; round < REWRITE_DRAIN_ROUNDS && out.ok(); ++round) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            captured.swap(rewrite_buffer_);
+        }
+        out.write(captured);
+        bool small = captured.size() < REWRITE_TAIL_TARGET;
+        captured.clear();
+        if (small) break;
+    }
+    bool ok = out.flush_pending() && aof_fsync(out.fd_) == 0;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    capturing_ = false;
+    if (!ok || !running_) {
+        rewrite_buffer_.clear();
+        rewrite_in_progress_ = false;
+        last_rewrite_ok_ = false;
+        lock.unlock();
+        std::cerr << "Background AOF rewrite failed" << std::endl;
+        std::remove(temp_path.c_str());
+        return;
+    }
+
+    // Everything appended so far is covered by the snapshot plus the
+    // captured tail, so the unwritten old-file entries become redundant.
+    swap_.ready = true;
+    swap_.fd = out.release();
+    swap_.temp_path = temp_path;
+    swap_.size = out.size();
+    swap_.tail.swap(rewrite_buffer_);
+    swap_.stale.swap(buffer_);
+    rewrite_buffer_.clear();
+    buffer_.clear();
+    has_data_.notify_one();
+}
+
+void AOFWriter::run() {
+    // The descriptor and everything about its on-disk state belong to this thread.
+    int fd = -1;
+    bool dirty = false;  // written since the last fsync
+    auto last_fsync = std::chrono::steady_clock::now();
+    std::string batch;
+    PendingSwap swap;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        if (write_error_) {
+            // Retry the failed write or fsync after a pause rather than spin on it.
+            has_data_.wait_for(lock, WRITE_RETRY_INTERVAL, [this] { return reopen_ || swap_.ready || !running_; });
+        } else {
+            // Wake for new data, an explicit flush, a reopen, a finished rewrite,
+            // shutdown, or the everysec tick.
+            has_data_.wait_for(lock, std::chrono::seconds(1), [this] {
+                return !buffer_.empty() || flush_requested_ > synced_seq_ || reopen_ || swap_.ready || !running_;
+            });
+        }
+
+        batch.swap(buffer_);
+        uint64_t seq = appended_seq_;
+        bool sync_requested = flush_requested_ > synced_seq_;
+        bool reopen = reopen_;
+        reopen_ = false;
+        std::swap(swap, swap_);
+        bool stopping = !running_;
+        AppendFsync policy = policy_;
+        std::string path = filename_;
+
+        // File I/O happens without the lock so appends never wait on the disk.
+        lock.unlock();
+        bool opened = false;
+        long long opened_size = 0;
+        size_t written = 0;
+        bool swapped = false;
+        bool failed = false;  // the batch or an fsync did not reach the disk
+
+        if (reopen && fd >= 0) {
+            if (dirty && aof_fsync(fd) != 0) {
+                std::cerr << "AOF fsync failed: " << strerror(errno) << std::endl;
+                failed = true;
+            }
+            aof_close(fd);
+            fd = -1;
+            dirty = false;
+        }
+        if (swap.ready) {
+            swapped = write_all(swap.fd, swap.tail) && aof_fsync(swap.fd) == 0 &&
+                      replace_file(swap.temp_path, path);
+            if (swapped) {
+                if (fd >= 0) aof_close(fd);
+                fd = swap.fd;
+                dirty = false;
+            } else {
+                aof_close(swap.fd);
+                std::remove(swap.temp_path.c_str());
+                batch.insert(0, swap.stale);
+            }
+        }
+        if (!batch.empty()) {
+            if (fd < 0) {
+                fd = open_file(path);
+                opened = fd >= 0;
+                if (opened) opened_size = aof_size(fd);
+            }
+            long long before = fd >= 0 ? aof_size(fd) : -1;
+            if (write_all(fd, batch)) {
+                dirty = true;
+                written = batch.size();
+                batch.clear();
+            } else {
+                // Keep the batch for the retry, cutting off any part of it
+                // that did reach the file so no record is logged twice.
+                if (before >= 0 && aof_truncate(fd, before) != 0) {
+                    std::cerr << "AOF truncate failed: " << strerror(errno) << std::endl;
+                    aof_close(fd);
+                    fd = -1;
+                }
+                failed = true;
+            }
+        }
+        auto now = std::chrono::steady_clock::now();
+        bool sync_due = policy == AppendFsync::ALWAYS || sync_requested || stopping ||
+                        (policy == AppendFsync::EVERYSEC && now - last_fsync >= std::chrono::seconds(1));
+        if (dirty && sync_due) {
+            if (aof_fsync(fd) == 0) {
+                dirty = false;
+                last_fsync = now;
+            } else {
+                std::cerr << "AOF fsync failed: " << strerror(errno) << std::endl;
+                failed = true;
+            }
+        }
+        lock.lock();
+
+        if (!batch.empty()) {
+            buffer_.insert(0, batch);
+            batch.clear();
+        }
+        if (failed != write_error_) {
+            std::cerr << (failed ? "AOF writes are failing; retrying" : "AOF writes recovered") << std::endl;
+        }
+        write_error_ = failed;
+
+        if (swap.ready) {
+            rewrite_in_progress_ = false;
+            last_rewrite_ok_ = swapped;
+            if (swapped) {
+                ++rewrites_;
+                current_size_ = base_size_ = swap.size + swap.tail.size();
+            } else {
+                std::cerr << "Failed to install rewritten AOF " << path << std::endl;
+            }
+            swap = PendingSwap();
+        }
+        if (opened) {
+            current_size_ = opened_size > 0 ? static_cast<size_t>(opened_size) : 0;
+            base_size_ = current_size_;
+        }
+        current_size_ += written;
+        // Only what was both written and fsynced counts as durable.
+        if (!failed && !dirty) synced_seq_ = std::max(synced_seq_, seq);
+        written_.notify_all();
+        if (stopping && (buffer_.empty() || failed)) {
+            if (failed) std::cerr << "AOF closed with " << buffer_.size() << " bytes unwritten" << std::endl;
+            break;
+        }
+        if (auto_rewrite_due()) start_rewrite_locked();
+    }
+    lock.unlock();
+
+    if (fd >= 0) aof_close(fd);
+}
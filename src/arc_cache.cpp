@@ -4,187 +4,117 @@
  */
 
 #include "arc_cache.h"
+#include "memory_usage.h"
 #include <algorithm>
-#include <chrono> // For std::chrono::high_resolution_clock
 
-ARCCache::ARCCache(size_t size) : size_(size), p_(0), hits_(0), misses_(0) {}
-
-void ARCCache::put(const std::string& key, const std::string& value) {
-    // Case I: item is in T1 or T2 (cache hit)
-    if (t1_map_.count(key)) {
-        hits_++;
-        auto start_time = std::chrono::high_resolution_clock::now();
-        t1_.erase(t1_map_[key]);
-        t1_map_.erase(key);
-        t2_.push_front({key, value});
-        t2_map_[key] = t2_.begin();
-        auto end_time = std::chrono::high_resolution_clock::now();
-        total_hit_latency_ms_ += std::chrono::duration<double, std::milli>(end_time - start_time).count();
-        return;
-    }
-    if (t2_map_.count(key)) {
-        hits_++;
-        auto start_time = std::chrono::high_resolution_clock::now();
-        t2_.erase(t2_map_[key]);
-        t2_map_.erase(key);
-        t2_.push_front({key, value});
-        t2_map_[key] = t2_.begin();
-        auto end_time = std::chrono::high_resolution_clock::now();
-        total_hit_latency_ms_ += std::chrono::duration<double, std::milli>(end_time - start_time).count();
-        return;
-    }
+ARCCache::~ARCCache() {
+    // The table outlives the cache; its entries must not credit our count.
+    for (KeyEntry* entry = t2_.front(); entry; entry = t2_.next(entry)) entry->segment.detach();
+}
 
-    // Case II: item is in B1 or B2 (cache miss, but in ghost list)
-    if (b1_map_.count(key)) {
-        misses_++;
-        p_ = std::min(size_, p_ + std::max((size_t)1, b2_.size() / b1_.size()));
-        replace(key, value);
-        b1_.erase(b1_map_[key]);
-        b1_map_.erase(key);
-        t2_.push_front({key, value});
-        t2_map_[key] = t2_.begin();
+void ARCCache::insert(KeyEntry& entry, const std::string& key, size_t resident) {
+    auto ghost = b1_map_.find(key);
+    if (ghost != b1_map_.end()) {
+        // Recency would have kept it: give T1 more room.
+        size_t delta = std::max<size_t>(1, b2_.size() / b1_.size());
+        p_ = std::min(resident, p_ + delta);
+        forget(b1_, b1_map_, ghost);
+        last_from_b2_ = false;
+        move_to_t2(entry);
         return;
     }
-    if (b2_map_.count(key)) {
-        misses_++;
-        p_ = std::max((size_t)0, p_ - std::max((size_t)1, b1_.size() / b2_.size()));
-        replace(key, value);
-        b2_.erase(b2_map_[key]);
-        b2_map_.erase(key);
-        t2_.push_front({key, value});
-        t2_map_[key] = t2_.begin();
+    ghost = b2_map_.find(key);
+    if (ghost != b2_map_.end()) {
+        // Frequency would have kept it: give T2 more room.
+        size_t delta = std::max<size_t>(1, b1_.size() / b2_.size());
+        p_ -= std::min(p_, delta);
+        forget(b2_, b2_map_, ghost);
+        last_from_b2_ = true;
+        move_to_t2(entry);
         return;
     }
+    last_from_b2_ = false;
+    t1_.push_front(entry);
+}
 
-    // Case III: item is new (cache miss, not in ghost list)
-    misses_++;
-    if (t1_.size() + b1_.size() == size_) {
-        if (t1_.size() < size_) {
-            // ARC-TERP 1
-            std::string evicted_key = b1_.back().key;
-            b1_.erase(b1_map_[evicted_key]);
-            b1_map_.erase(evicted_key);
-            replace(key, value);
-        } else {
-            // ARC-TERP 2
-            std::string evicted_key = t1_.back().key;
-            t1_.pop_back();
-            t1_map_.erase(evicted_key);
-            eviction_count_++; // Eviction from T1
-        }
-    } else if (t1_.size() + t2_.size() == size_) {
-        if (t1_.size() + b1_.size() == 2 * size_) {
-            std::string evicted_key = b1_.back().key;
-            b1_.pop_back();
-            b1_map_.erase(evicted_key);
-        }
-        replace(key, value);
-    }
+void ARCCache::hit(KeyEntry& entry) {
+    auto start = std::chrono::steady_clock::now();
+    move_to_t2(entry);
+    hits_++;
+    hit_time_ += std::chrono::steady_clock::now() - start;
+}
 
-    t1_.push_front({key, value});
-    t1_map_[key] = t1_.begin();
+void ARCCache::move_to_t2(KeyEntry& entry) {
+    t2_.push_front(entry);  // unlinks it from T1 if it was there
+    if (!entry.segment.charged()) entry.segment.charge(t2_size_, 1);
+}
 
-    // Eviction if total cache size exceeds limit (L1 + L2 > C)
-    if (t1_.size() + t2_.size() > size_) {
-        if (t1_.size() > p_) {
-            std::string evicted_key = t1_.back().key;
-            t1_.pop_back();
-            t1_map_.erase(evicted_key);
-            b1_.push_front({evicted_key, ""}); // Value not needed for ghost list
-            b1_map_[evicted_key] = b1_.begin();
-            eviction_count_++; // Eviction from T1 to B1
-        } else {
-            std::string evicted_key = t2_.back().key;
-            t2_.pop_back();
-            t2_map_.erase(evicted_key);
-            b2_.push_front({evicted_key, ""});
-            b2_map_[evicted_key] = b2_.begin();
-            eviction_count_++; // Eviction from T2 to B2
-        }
-    }
+KeyEntry* ARCCache::victim(const KeyEntry& spare, size_t resident) {
+    size_t t1_size = resident - t2_size_;
+    bool from_t1 = t1_size > 0 && (t1_size > p_ || (last_from_b2_ && t1_size == p_));
+    KeyEntry* first = from_t1 ? t1_.back() : t2_.back();
+    KeyEntry* second = from_t1 ? t2_.back() : t1_.back();
+    // New and hit entries go to the front, so `spare` is at the back only
+    // when it is alone on its list.
+    if (first && first != &spare) return first;
+    if (second && second != &spare) return second;
+    return nullptr;
 }
 
-bool ARCCache::get(const std::string& key, std::string& value) {
-    auto start_time = std::chrono::high_resolution_clock::now(); // Start timing
-    if (t1_map_.count(key)) {
-        hits_++;
-        value = t1_map_[key]->value;
-        t2_.push_front(*t1_map_[key]);
-        t2_map_[key] = t2_.begin();
-        t1_.erase(t1_map_[key]);
-        t1_map_.erase(key);
-        auto end_time = std::chrono::high_resolution_clock::now(); // End timing
-        total_hit_latency_ms_ += std::chrono::duration<double, std::milli>(end_time - start_time).count(); // Accumulate latency
-        return true;
-    }
-    if (t2_map_.count(key)) {
-        hits_++;
-        value = t2_map_[key]->value;
-        t2_.erase(t2_map_[key]);
-        t2_map_.erase(key);
-        t2_.push_front({key, value});
-        t2_map_[key] = t2_.begin();
-        auto end_time = std::chrono::high_resolution_clock::now(); // End timing
-        total_hit_latency_ms_ += std::chrono::duration<double, std::milli>(end_time - start_time).count(); // Accumulate latency
-        return true;
+void ARCCache::evicted(KeyEntry& entry, const std::string& key, size_t resident) {
+    if (entry.segment.charged()) {
+        entry.segment.release();
+        remember(b2_, b2_map_, key);
+    } else {
+        remember(b1_, b1_map_, key);
     }
-    misses_++; // Count miss if not found in T1 or T2
-    return false;
+    static_cast<ListHook<LruTag>&>(entry).unlink();
+
+    // Keep |T1| + |B1| <= c and |T1| + |T2| + |B1| + |B2| <= 2c.
+    size_t c = std::max<size_t>(resident, 1);
+    size_t t1_size = resident - t2_size_;
+    while (!b1_.empty() && t1_size + b1_.size() > c) forget(b1_, b1_map_, b1_map_.find(b1_.back()));
+    while (!b2_.empty() && resident + b1_.size() + b2_.size() > 2 * c) forget(b2_, b2_map_, b2_map_.find(b2_.back()));
+    p_ = std::min(p_, c);
 }
 
-void ARCCache::replace(const std::string& key, const std::string& value) {
-    // If cache is full, decide which list to evict from
-    if (t1_.size() > p_) { // If T1 is larger than P, evict from T1
-        std::string evicted_key = t1_.back().key;
-        t1_.pop_back();
-        t1_map_.erase(evicted_key);
-        b1_.push_front({evicted_key, ""});
-        b1_map_[evicted_key] = b1_.begin();
-        eviction_count_++; // Eviction from T1 to B1 via replace
-    } else { // If T1 is not larger than P, evict from T2
-        std::string evicted_key = t2_.back().key;
-        t2_.pop_back();
-        t2_map_.erase(evicted_key);
-        b2_.push_front({evicted_key, ""});
-        b2_map_[evicted_key] = b2_.begin();
-        eviction_count_++; // Eviction from T2 to B2 via replace
-    }
+void ARCCache::clear() {
+    for (KeyEntry* entry = t2_.front(); entry; entry = t2_.next(entry)) entry->segment.release();
+    t1_.clear();
+    t2_.clear();
+    b1_.clear();
+    b2_.clear();
+    b1_map_.clear();
+    b2_map_.clear();
+    p_ = 0;
+    last_from_b2_ = false;
+    ghost_bytes_ = 0;
 }
 
-void ARCCache::move_to_t2(const std::string& key) {
-    // This method is primarily used internally by 'replace' and 'put' logic
-    // When an item moves from T1 to T2 or from B1/B2 to T2, it should be handled there.
-    // No direct external call to this method expected for simple ARC implementation.
+ARCStats ARCCache::stats() const {
+    ARCStats stats;
+    stats.target_t1 = p_;
+    stats.frequent = t2_size_;
+    stats.ghosts = b1_.size() + b2_.size();
+    stats.hits = hits_;
+    stats.hit_time = hit_time_;
+    return stats;
 }
 
-void ARCCache::erase(const std::string& key) {
-    if (t1_map_.count(key)) {
-        t1_.erase(t1_map_[key]);
-        t1_map_.erase(key);
-    } else if (t2_map_.count(key)) {
-        t2_.erase(t2_map_[key]);
-        t2_map_.erase(key);
-    } else if (b1_map_.count(key)) {
-        b1_.erase(b1_map_[key]);
-        b1_map_.erase(key);
-    } else if (b2_map_.count(key)) {
-        b2_.erase(b2_map_[key]);
-        b2_map_.erase(key);
-    }
+void ARCCache::remember(Ghosts& list, std::unordered_map<std::string, Ghosts::iterator>& map, const std::string& key) {
+    list.push_front(key);
+    map[key] = list.begin();
+    ghost_bytes_ += ghost_entry_bytes(key);
 }
 
-void ARCCache::set_expiry(const std::string& key, int seconds) {
-    // ARC cache itself does not handle expiry. This should be handled at the DB layer.
-    // For now, this method does nothing, consistent with LRU/LFU cache definitions.
+void ARCCache::forget(Ghosts& list, std::unordered_map<std::string, Ghosts::iterator>& map,
+                      std::unordered_map<std::string, Ghosts::iterator>::iterator it) {
+    ghost_bytes_ -= ghost_entry_bytes(it->first);
+    list.erase(it->second);
+    map.erase(it);
 }
 
-std::unordered_map<std::string, std::string> ARCCache::get_items() const {
-    std::unordered_map<std::string, std::string> items;
-    for (const auto& entry : t1_) {
-        items[entry.key] = entry.value;
-    }
-    for (const auto& entry : t2_) {
-        items[entry.key] = entry.value;
-    }
-    return items;
-} 
\ No newline at end of file
+size_t ARCCache::ghost_entry_bytes(const std::string& key) {
+    return list_node_bytes<std::string>() + hash_node_bytes<std::pair<const std::string, Ghosts::iterator>>() +
+           2 * heap_bytes(key);
+}
@@ -1,7 +1,6 @@
 #include "data_types.h"
 #include <algorithm>
 #include <sstream>
-#include <regex>
 
 // DataValue implementations
 nlohmann::json DataValue::to_json() const {
@@ -10,23 +9,31 @@ nlohmann::json DataValue::to_json() const {
     
     switch (type) {
         case DataType::STRING:
-            j["data"] = std::get<std::string>(data);
+            j["data"] = std::get<StringValue>(data).str();
             break;
-        case DataType::LIST:
-            j["data"] = std::get<std::vector<std::string>>(data);
+        case DataType::LIST: {
+            auto& list_data = std::get<QuickList>(data);
+            j["data"] = std::vector<std::string>(list_data.begin(), list_data.end());
             break;
+        }
         case DataType::SET: {
-            auto& set_data = std::get<std::set<std::string>>(data);
+            auto& set_data = std::get<SetValue>(data);
             j["data"] = std::vector<std::string>(set_data.begin(), set_data.end());
             break;
         }
-        case DataType::HASH:
-            j["data"] = std::get<std::unordered_map<std::string, std::string>>(data);
+        case DataType::HASH: {
+            auto& hash_data = std::get<HashValue>(data);
+            j["data"] = nlohmann::json::object();
+            for (auto entry : hash_data) {
+                j["data"][std::string(entry.first)] = entry.second;
+            }
             break;
+        }
         case DataType::ZSET: {
-            auto& zset_data = std::get<std::map<std::string, double>>(data);
-            for (const auto& pair : zset_data) {
-                j["data"][pair.first] = pair.second;
+            auto& zset_data = std::get<SortedSet>(data);
+            j["data"] = nlohmann::json::object();
+            for (const auto& node : zset_data) {
+                j["data"][node.member] = node.score;
             }
             break;
         }
@@ -41,20 +48,27 @@ DataValue DataValue::from_json(const nlohmann::json& j) {
         case DataType::STRING:
             return DataValue(j["data"].get<std::string>());
         case DataType::LIST:
-            return DataValue(j["data"].get<std::vector<std::string>>());
+            return DataValue(QuickList(j["data"].get<std::vector<std::string>>()));
         case DataType::SET: {
-            auto vec = j["data"].get<std::vector<std::string>>();
-            std::set<std::string> set_data(vec.begin(), vec.end());
-            return DataValue(set_data);
+            SetValue set_data;
+            for (const auto& member : j["data"]) {
+                set_data.insert(member.get<std::string>());
+            }
+            return DataValue(std::move(set_data));
+        }
+        case DataType::HASH: {
+            HashValue hash_data;
+            for (auto it = j["data"].begin(); it != j["data"].end(); ++it) {
+                hash_data.set(it.key(), it.value().get<std::string>());
+            }
+            return DataValue(std::move(hash_data));
         }
-        case DataType::HASH:
-            return DataValue(j["data"].get<std::unordered_map<std::string, std::string>>());
         case DataType::ZSET: {
-            std::map<std::string, double> zset_data;
+            SortedSet zset_data;
             for (auto it = j["data"].begin(); it != j["data"].end(); ++it) {
-                zset_data[it.key()] = it.value();
+                zset_data.add(it.key(), it.value().get<double>());
             }
-            return DataValue(zset_data);
+            return DataValue(std::move(zset_data));
         }
     }
     return DataValue();
@@ -63,24 +77,26 @@ DataValue DataValue::from_json(const nlohmann::json& j) {
 std::string DataValue::to_string() const {
     switch (type) {
         case DataType::STRING:
-            return std::get<std::string>(data);
+            return std::get<StringValue>(data).str();
         case DataType::LIST: {
-            auto& list_data = std::get<std::vector<std::string>>(data);
+            auto& list_data = std::get<QuickList>(data);
             std::ostringstream oss;
             oss << "[";
-            for (size_t i = 0; i < list_data.size(); ++i) {
-                if (i > 0) oss << ", ";
-                oss << "\"" << list_data[i] << "\"";
+            bool first = true;
+            for (auto item : list_data) {
+                if (!first) oss << ", ";
+                oss << "\"" << item << "\"";
+                first = false;
             }
             oss << "]";
             return oss.str();
         }
         case DataType::SET: {
-            auto& set_data = std::get<std::set<std::string>>(data);
+            auto& set_data = std::get<SetValue>(data);
             std::ostringstream oss;
             oss << "{";
             bool first = true;
-            for (const auto& item : set_data) {
+            for (auto item : set_data) {
                 if (!first) oss << ", ";
                 oss << "\"" << item << "\"";
                 first = false;
@@ -89,11 +105,11 @@ std::string DataValue::to_string() const {
             return oss.str();
         }
         case DataType::HASH: {
-            auto& hash_data = std::get<std::unordered_map<std::string, std::string>>(data);
+            auto& hash_data = std::get<HashValue>(data);
             std::ostringstream oss;
             oss << "{";
             bool first = true;
-            for (const auto& pair : hash_data) {
+            for (auto pair : hash_data) {
                 if (!first) oss << ", ";
                 oss << "\"" << pair.first << "\": \"" << pair.second << "\"";
                 first = false;
@@ -102,13 +118,13 @@ std::string DataValue::to_string() const {
             return oss.str();
         }
         case DataType::ZSET: {
-            auto& zset_data = std::get<std::map<std::string, double>>(data);
+            auto& zset_data = std::get<SortedSet>(data);
             std::ostringstream oss;
             oss << "{";
             bool first = true;
-            for (const auto& pair : zset_data) {
+            for (const auto& node : zset_data) {
                 if (!first) oss << ", ";
-                oss << "\"" << pair.first << "\": " << pair.second;
+                oss << "\"" << node.member << "\": " << SortedSet::format_score(node.score);
                 first = false;
             }
             oss << "}";
@@ -118,116 +134,117 @@ std::string DataValue::to_string() const {
     return "";
 }
 
+size_t DataValue::memory_usage() const {
+    switch (type) {
+        case DataType::STRING: return std::get<StringValue>(data).memory_usage();
+        case DataType::LIST: return std::get<QuickList>(data).allocated_bytes();
+        case DataType::SET: return std::get<SetValue>(data).memory_usage();
+        case DataType::HASH: return std::get<HashValue>(data).memory_usage();
+        case DataType::ZSET: return std::get<SortedSet>(data).memory_usage();
+    }
+    return 0;
+}
+
+namespace {
+
+// Returns the container of type `Container` stored at `key` for in-place
+// modification, creating an empty one if the key is missing, or nullptr if
+// the key holds a value of another type. One lookup, no copies.
+template <typename Container>
+Container* mutable_container(Keyspace& storage, const std::string& key, DataType type) {
+    auto inserted = storage.try_emplace(key);
+    DataValue& value = inserted.first->second.value;
+    if (inserted.second) {
+        value.type = type;
+        value.data = Container();
+    } else if (value.type != type) {
+        return nullptr;
+    }
+    return &std::get<Container>(value.data);
+}
+
+}
+
 // String operations
-bool DataOperations::set_string(std::unordered_map<std::string, DataValue>& storage, 
+bool DataOperations::set_string(Keyspace& storage, 
                                 const std::string& key, const std::string& value) {
-    storage[key] = DataValue(value);
+    DataValue& stored = storage[key].value;
+    if (stored.type == DataType::STRING) {
+        // Reuses the existing buffer when it is large enough.
+        std::get<StringValue>(stored.data).assign(value);
+    } else {
+        stored = DataValue(value);
+    }
     return true;
 }
 
-bool DataOperations::get_string(const std::unordered_map<std::string, DataValue>& storage, 
+bool DataOperations::get_string(const Keyspace& storage, 
                                 const std::string& key, std::string& value) {
     auto it = storage.find(key);
-    if (it != storage.end() && it->second.type == DataType::STRING) {
-        value = std::get<std::string>(it->second.data);
+    if (it != storage.end() && it->second.value.type == DataType::STRING) {
+        char buf[StringValue::INT_CHARS];
+        value.assign(std::get<StringValue>(it->second.value.data).view(buf));
         return true;
     }
     return false;
 }
 
-bool DataOperations::incr(std::unordered_map<std::string, DataValue>& storage, 
+bool DataOperations::incr(Keyspace& storage, 
                          const std::string& key, int64_t& result) {
-    auto it = storage.find(key);
-    if (it == storage.end()) {
-        storage[key] = DataValue("1");
-        result = 1;
-        return true;
-    }
-    
-    if (it->second.type != DataType::STRING) return false;
-    
-    try {
-        int64_t val = std::stoll(std::get<std::string>(it->second.data));
-        val++;
-        storage[key] = DataValue(std::to_string(val));
-        result = val;
-        return true;
-    } catch (...) {
-        return false;
-    }
+    return incrby(storage, key, 1, result);
 }
 
-bool DataOperations::decr(std::unordered_map<std::string, DataValue>& storage, 
+bool DataOperations::decr(Keyspace& storage, 
                          const std::string& key, int64_t& result) {
-    auto it = storage.find(key);
-    if (it == storage.end()) {
-        storage[key] = DataValue("-1");
-        result = -1;
-        return true;
-    }
-    
-    if (it->second.type != DataType::STRING) return false;
-    
-    try {
-        int64_t val = std::stoll(std::get<std::string>(it->second.data));
-        val--;
-        storage[key] = DataValue(std::to_string(val));
-        result = val;
+    return incrby(storage, key, -1, result);
+}
+
+// Adds `delta` to the integer stored at `key`, creating it from 0 if the
+// key is missing. An INT-encoded value is updated in place.
+bool DataOperations::incrby(Keyspace& storage, 
+                           const std::string& key, int64_t delta, int64_t& result) {
+    auto inserted = storage.try_emplace(key);
+    DataValue& value = inserted.first->second.value;
+    if (inserted.second) {
+        std::get<StringValue>(value.data).set_int(delta);
+        result = delta;
         return true;
-    } catch (...) {
-        return false;
     }
+    if (value.type != DataType::STRING) return false;
+    return std::get<StringValue>(value.data).incr(delta, result);
 }
 
 // List operations
-bool DataOperations::lpush(std::unordered_map<std::string, DataValue>& storage, 
+bool DataOperations::lpush(Keyspace& storage, 
                           const std::string& key, const std::vector<std::string>& values) {
-    auto it = storage.find(key);
-    std::vector<std::string> list_data;
-    
-    if (it != storage.end()) {
-        if (it->second.type != DataType::LIST) return false;
-        list_data = std::get<std::vector<std::string>>(it->second.data);
-    }
+    auto* list_data = mutable_container<QuickList>(storage, key, DataType::LIST);
+    if (!list_data) return false;
     
-    // Insert at beginning (reverse order to maintain Redis behavior)
-    for (auto it = values.rbegin(); it != values.rend(); ++it) {
-        list_data.insert(list_data.begin(), *it);
+    // Each value goes to the head in turn, so the batch lands reversed
+    for (const auto& value : values) {
+        list_data->push_front(value);
     }
-    
-    storage[key] = DataValue(list_data);
     return true;
 }
 
-bool DataOperations::rpush(std::unordered_map<std::string, DataValue>& storage, 
+bool DataOperations::rpush(Keyspace& storage, 
                           const std::string& key, const std::vector<std::string>& values) {
-    auto it = storage.find(key);
-    std::vector<std::string> list_data;
+    auto* list_data = mutable_container<QuickList>(storage, key, DataType::LIST);
+    if (!list_data) return false;
     
-    if (it != storage.end()) {
-        if (it->second.type != DataType::LIST) return false;
-        list_data = std::get<std::vector<std::string>>(it->second.data);
-    }
-    
-    // Insert at end
     for (const auto& value : values) {
-        list_data.push_back(value);
+        list_data->push_back(value);
     }
-    
-    storage[key] = DataValue(list_data);
     return true;
 }
 
-bool DataOperations::lpop(std::unordered_map<std::string, DataValue>& storage, 
+bool DataOperations::lpop(Keyspace& storage, 
                          const std::string& key, std::string& value) {
     auto it = storage.find(key);
-    if (it == storage.end() || it->second.type != DataType::LIST) return false;
+    if (it == storage.end() || it->second.value.type != DataType::LIST) return false;
     
-    auto& list_data = std::get<std::vector<std::string>>(it->second.data);
-    if (list_data.empty()) return false;
-    
-    value = list_data.front();
-    list_data.erase(list_data.begin());
+    auto& list_data = std::get<QuickList>(it->second.value.data);
+    if (!list_data.pop_front(value)) return false;
     
     if (list_data.empty()) {
         storage.erase(it);
@@ -236,16 +253,13 @@ bool DataOperations::lpop(std::unordered_map<std::string, DataValue>& storage,
     return true;
 }
 
-bool DataOperations::rpop(std::unordered_map<std::string, DataValue>& storage, 
+bool DataOperations::rpop(Keyspace& storage, 
                          const std::string& key, std::string& value) {
     auto it = storage.find(key);
-    if (it == storage.end() || it->second.type != DataType::LIST) return false;
-    
-    auto& list_data = std::get<std::vector<std::string>>(it->second.data);
-    if (list_data.empty()) return false;
+    if (it == storage.end() || it->second.value.type != DataType::LIST) return false;
     
-    value = list_data.back();
-    list_data.pop_back();
+    auto& list_data = std::get<QuickList>(it->second.value.data);
+    if (!list_data.pop_back(value)) return false;
     
     if (list_data.empty()) {
         storage.erase(it);
@@ -254,7 +268,7 @@ bool DataOperations::rpop(std::unordered_map<std::string, DataValue>& storage,
     return true;
 }
 
-bool DataOperations::llen(const std::unordered_map<std::string, DataValue>& storage, 
+bool DataOperations::llen(const Keyspace& storage, 
                          const std::string& key, size_t& length) {
     auto it = storage.find(key);
     if (it == storage.end()) {
@@ -262,18 +276,18 @@ bool DataOperations::llen(const std::unordered_map<std::string, DataValue>& stor
         return true;
     }
     
-    if (it->second.type != DataType::LIST) return false;
+    if (it->second.value.type != DataType::LIST) return false;
     
-    length = std::get<std::vector<std::string>>(it->second.data).size();
+    length = std::get<QuickList>(it->second.value.data).size();
     return true;
 }
 
-bool DataOperations::lrange(const std::unordered_map<std::string, DataValue>& storage, 
+bool DataOperations::lrange(const Keyspace& storage, 
                            const std::string& key, int start, int stop, std::vector<std::string>& result) {
     auto it = storage.find(key);
-    if (it == storage.end() || it->second.type != DataType::LIST) return false;
+    if (it == storage.end() || it->second.value.type != DataType::LIST) return false;
     
-    const auto& list_data = std::get<std::vector<std::string>>(it->second.data);
+    const auto& list_data = std::get<QuickList>(it->second.value.data);
     int size = static_cast<int>(list_data.size());
     
     // Handle negative indices
@@ -285,37 +299,35 @@ bool DataOperations::lrange(const std::unordered_map<std::string, DataValue>& st
     stop = std::min(size - 1, stop);
     
     if (start <= stop) {
-        result.assign(list_data.begin() + start, list_data.begin() + stop + 1);
+        result.clear();
+        result.reserve(stop - start + 1);
+        auto item = list_data.at(start);
+        for (int i = start; i <= stop; ++i, ++item) {
+            result.emplace_back(*item);
+        }
     }
     
     return true;
 }
 
 // Set operations
-bool DataOperations::sadd(std::unordered_map<std::string, DataValue>& storage, 
+bool DataOperations::sadd(Keyspace& storage, 
                          const std::string& key, const std::vector<std::string>& members) {
-    auto it = storage.find(key);
-    std::set<std::string> set_data;
-    
-    if (it != storage.end()) {
-        if (it->second.type != DataType::SET) return false;
-        set_data = std::get<std::set<std::string>>(it->second.data);
-    }
+    auto* set_data = mutable_container<SetValue>(storage, key, DataType::SET);
+    if (!set_data) return false;
     
     for (const auto& member : members) {
-        set_data.insert(member);
+        set_data->insert(member);
     }
-    
-    storage[key] = DataValue(set_data);
     return true;
 }
 
-bool DataOperations::srem(std::unordered_map<std::string, DataValue>& storage, 
+bool DataOperations::srem(Keyspace& storage, 
                          const std::string& key, const std::vector<std::string>& members) {
     auto it = storage.find(key);
-    if (it == storage.end() || it->second.type != DataType::SET) return false;
+    if (it == storage.end() || it->second.value.type != DataType::SET) return false;
     
-    auto& set_data = std::get<std::set<std::string>>(it->second.data);
+    auto& set_data = std::get<SetValue>(it->second.value.data);
     
     for (const auto& member : members) {
         set_data.erase(member);
@@ -328,16 +340,19 @@ bool DataOperations::srem(std::unordered_map<std::string, DataValue>& storage,
     return true;
 }
 
-bool DataOperations::smembers(const std::unordered_map<std::string, DataValue>& storage, 
+bool DataOperations::smembers(const Keyspace& storage, 
                              const std::string& key, std::set<std::string>& members) {
     auto it = storage.find(key);
-    if (it == storage.end() || it->second.type != DataType::SET) return false;
+    if (it == storage.end() || it->second.value.type != DataType::SET) return false;
     
-    members = std::get<std::set<std::string>>(it->second.data);
+    const auto& set_data = std::get<SetValue>(it->second.value.data);
+    for (auto member : set_data) {
+        members.emplace(member);
+    }
     return true;
 }
 
-bool DataOperations::scard(const std::unordered_map<std::string, DataValue>& storage, 
+bool DataOperations::scard(const Keyspace& storage, 
                           const std::string& key, size_t& count) {
     auto it = storage.find(key);
     if (it == storage.end()) {
@@ -345,56 +360,44 @@ bool DataOperations::scard(const std::unordered_map<std::string, DataValue>& sto
         return true;
     }
     
-    if (it->second.type != DataType::SET) return false;
+    if (it->second.value.type != DataType::SET) return false;
     
-    count = std::get<std::set<std::string>>(it->second.data).size();
+    count = std::get<SetValue>(it->second.value.data).size();
     return true;
 }
 
-bool DataOperations::sismember(const std::unordered_map<std::string, DataValue>& storage, 
+bool DataOperations::sismember(const Keyspace& storage, 
                               const std::string& key, const std::string& member) {
     auto it = storage.find(key);
-    if (it == storage.end() || it->second.type != DataType::SET) return false;
+    if (it == storage.end() || it->second.value.type != DataType::SET) return false;
     
-    const auto& set_data = std::get<std::set<std::string>>(it->second.data);
-    return set_data.find(member) != set_data.end();
+    return std::get<SetValue>(it->second.value.data).contains(member);
 }
 
 // Hash operations
-bool DataOperations::hset(std::unordered_map<std::string, DataValue>& storage, 
+bool DataOperations::hset(Keyspace& storage, 
                          const std::string& key, const std::string& field, const std::string& value) {
-    auto it = storage.find(key);
-    std::unordered_map<std::string, std::string> hash_data;
-    
-    if (it != storage.end()) {
-        if (it->second.type != DataType::HASH) return false;
-        hash_data = std::get<std::unordered_map<std::string, std::string>>(it->second.data);
-    }
+    auto* hash_data = mutable_container<HashValue>(storage, key, DataType::HASH);
+    if (!hash_data) return false;
     
-    hash_data[field] = value;
-    storage[key] = DataValue(hash_data);
+    hash_data->set(field, value);
     return true;
 }
 
-bool DataOperations::hget(const std::unordered_map<std::string, DataValue>& storage, 
+bool DataOperations::hget(const Keyspace& storage, 
                          const std::string& key, const std::string& field, std::string& value) {
     auto it = storage.find(key);
-    if (it == storage.end() || it->second.type != DataType::HASH) return false;
+    if (it == storage.end() || it->second.value.type != DataType::HASH) return false;
     
-    const auto& hash_data = std::get<std::unordered_map<std::string, std::string>>(it->second.data);
-    auto field_it = hash_data.find(field);
-    if (field_it == hash_data.end()) return false;
-    
-    value = field_it->second;
-    return true;
+    return std::get<HashValue>(it->second.value.data).get(field, value);
 }
 
-bool DataOperations::hdel(std::unordered_map<std::string, DataValue>& storage, 
+bool DataOperations::hdel(Keyspace& storage, 
                          const std::string& key, const std::vector<std::string>& fields) {
     auto it = storage.find(key);
-    if (it == storage.end() || it->second.type != DataType::HASH) return false;
+    if (it == storage.end() || it->second.value.type != DataType::HASH) return false;
     
-    auto& hash_data = std::get<std::unordered_map<std::string, std::string>>(it->second.data);
+    auto& hash_data = std::get<HashValue>(it->second.value.data);
     
     for (const auto& field : fields) {
         hash_data.erase(field);
@@ -407,79 +410,224 @@ bool DataOperations::hdel(std::unordered_map<std::string, DataValue>& storage,
     return true;
 }
 
-bool DataOperations::hgetall(const std::unordered_map<std::string, DataValue>& storage, 
+bool DataOperations::hgetall(const Keyspace& storage, 
                             const std::string& key, std::unordered_map<std::string, std::string>& result) {
     auto it = storage.find(key);
-    if (it == storage.end() || it->second.type != DataType::HASH) return false;
+    if (it == storage.end() || it->second.value.type != DataType::HASH) return false;
     
-    result = std::get<std::unordered_map<std::string, std::string>>(it->second.data);
+    const auto& hash_data = std::get<HashValue>(it->second.value.data);
+    result.reserve(hash_data.size());
+    for (auto pair : hash_data) {
+        result.emplace(pair.first, pair.second);
+    }
     return true;
 }
 
-bool DataOperations::hkeys(const std::unordered_map<std::string, DataValue>& storage, 
+bool DataOperations::hkeys(const Keyspace& storage, 
                           const std::string& key, std::vector<std::string>& fields) {
     auto it = storage.find(key);
-    if (it == storage.end() || it->second.type != DataType::HASH) return false;
+    if (it == storage.end() || it->second.value.type != DataType::HASH) return false;
     
-    const auto& hash_data = std::get<std::unordered_map<std::string, std::string>>(it->second.data);
-    for (const auto& pair : hash_data) {
-        fields.push_back(pair.first);
+    const auto& hash_data = std::get<HashValue>(it->second.value.data);
+    for (auto pair : hash_data) {
+        fields.emplace_back(pair.first);
     }
     return true;
 }
 
-bool DataOperations::hvals(const std::unordered_map<std::string, DataValue>& storage, 
+bool DataOperations::hvals(const Keyspace& storage, 
                           const std::string& key, std::vector<std::string>& values) {
     auto it = storage.find(key);
-    if (it == storage.end() || it->second.type != DataType::HASH) return false;
+    if (it == storage.end() || it->second.value.type != DataType::HASH) return false;
+    
+    const auto& hash_data = std::get<HashValue>(it->second.value.data);
+    for (auto pair : hash_data) {
+        values.emplace_back(pair.second);
+    }
+    return true;
+}
+
+// Sorted set operations
+bool DataOperations::zadd(Keyspace& storage, 
+                         const std::string& key, const std::vector<std::pair<double, std::string>>& members,
+                         size_t& added) {
+    auto* zset_data = mutable_container<SortedSet>(storage, key, DataType::ZSET);
+    if (!zset_data) return false;
+    
+    added = 0;
+    for (const auto& entry : members) {
+        if (zset_data->add(entry.second, entry.first)) ++added;
+    }
+    return true;
+}
+
+bool DataOperations::zincrby(Keyspace& storage, 
+                            const std::string& key, double increment, const std::string& member, double& score) {
+    auto* zset_data = mutable_container<SortedSet>(storage, key, DataType::ZSET);
+    if (!zset_data) return false;
+    
+    bool success = zset_data->incr(member, increment, score);
+    if (zset_data->empty()) {
+        storage.erase(key);
+    }
+    return success;
+}
+
+bool DataOperations::zrem(Keyspace& storage, 
+                         const std::string& key, const std::vector<std::string>& members, size_t& removed) {
+    removed = 0;
+    auto it = storage.find(key);
+    if (it == storage.end()) return true;
+    if (it->second.value.type != DataType::ZSET) return false;
+    
+    auto& zset_data = std::get<SortedSet>(it->second.value.data);
+    for (const auto& member : members) {
+        if (zset_data.remove(member)) ++removed;
+    }
+    
+    if (zset_data.empty()) {
+        storage.erase(it);
+    }
+    return true;
+}
+
+bool DataOperations::zcard(const Keyspace& storage, 
+                          const std::string& key, size_t& count) {
+    auto it = storage.find(key);
+    if (it == storage.end()) {
+        count = 0;
+        return true;
+    }
+    
+    if (it->second.value.type != DataType::ZSET) return false;
+    
+    count = std::get<SortedSet>(it->second.value.data).size();
+    return true;
+}
+
+bool DataOperations::zscore(const Keyspace& storage, 
+                           const std::string& key, const std::string& member, double& score) {
+    auto it = storage.find(key);
+    if (it == storage.end() || it->second.value.type != DataType::ZSET) return false;
+    
+    return std::get<SortedSet>(it->second.value.data).score(member, score);
+}
+
+bool DataOperations::zrank(const Keyspace& storage, 
+                          const std::string& key, const std::string& member, bool reverse, size_t& rank) {
+    auto it = storage.find(key);
+    if (it == storage.end() || it->second.value.type != DataType::ZSET) return false;
+    
+    return std::get<SortedSet>(it->second.value.data).rank(member, reverse, rank);
+}
+
+bool DataOperations::zrange(const Keyspace& storage, 
+                           const std::string& key, int start, int stop, bool reverse,
+                           std::vector<ScoredMember>& result) {
+    auto it = storage.find(key);
+    if (it == storage.end() || it->second.value.type != DataType::ZSET) return false;
     
-    const auto& hash_data = std::get<std::unordered_map<std::string, std::string>>(it->second.data);
-    for (const auto& pair : hash_data) {
-        values.push_back(pair.second);
+    const auto& zset_data = std::get<SortedSet>(it->second.value.data);
+    int size = static_cast<int>(zset_data.size());
+    
+    // Handle negative indices
+    if (start < 0) start += size;
+    if (stop < 0) stop += size;
+    
+    // Bounds checking
+    start = std::max(0, start);
+    stop = std::min(size - 1, stop);
+    
+    if (start <= stop) {
+        result.reserve(stop - start + 1);
+        zset_data.for_rank_range(start, stop, reverse, [&](const SortedSet::Node& node) {
+            result.emplace_back(node.member, node.score);
+        });
     }
+    
+    return true;
+}
+
+bool DataOperations::zrangebyscore(const Keyspace& storage, 
+                                  const std::string& key, const ScoreRange& range, size_t offset, size_t count,
+                                  std::vector<ScoredMember>& result) {
+    auto it = storage.find(key);
+    if (it == storage.end() || it->second.value.type != DataType::ZSET) return false;
+    
+    const auto& zset_data = std::get<SortedSet>(it->second.value.data);
+    zset_data.for_score_range(range, offset, count, [&](const SortedSet::Node& node) {
+        result.emplace_back(node.member, node.score);
+    });
     return true;
 }
 
 // General operations
-bool DataOperations::exists(const std::unordered_map<std::string, DataValue>& storage, 
+bool DataOperations::exists(const Keyspace& storage, 
                            const std::string& key) {
     return storage.find(key) != storage.end();
 }
 
-bool DataOperations::del(std::unordered_map<std::string, DataValue>& storage, 
+bool DataOperations::del(Keyspace& storage, 
                         const std::string& key) {
     return storage.erase(key) > 0;
 }
 
-DataType DataOperations::type(const std::unordered_map<std::string, DataValue>& storage, 
+DataType DataOperations::type(const Keyspace& storage, 
                              const std::string& key) {
     auto it = storage.find(key);
     if (it == storage.end()) return DataType::STRING; // Default
-    return it->second.type;
+    return it->second.value.type;
 }
 
-std::vector<std::string> DataOperations::keys(const std::unordered_map<std::string, DataValue>& storage, 
-                                              const std::string& pattern) {
+std::vector<std::string> DataOperations::keys(const Keyspace& storage, 
+                                              const GlobPattern& pattern) {
     std::vector<std::string> result;
-    
-    if (pattern == "*") {
-        for (const auto& pair : storage) {
+    for (const auto& pair : storage) {
+        if (pattern.matches(pair.first)) {
             result.push_back(pair.first);
         }
-    } else {
-        // Simple pattern matching (*, ?)
-        std::string regex_pattern = pattern;
-        std::replace(regex_pattern.begin(), regex_pattern.end(), '*', '.');
-        regex_pattern = std::regex_replace(regex_pattern, std::regex("\\."), ".*");
-        std::replace(regex_pattern.begin(), regex_pattern.end(), '?', '.');
-        
-        std::regex re(regex_pattern);
-        for (const auto& pair : storage) {
-            if (std::regex_match(pair.first, re)) {
-                result.push_back(pair.first);
-            }
-        }
     }
-    
     return result;
 }
+
+size_t DataOperations::hscan(const Keyspace& storage, 
+                             const std::string& key, size_t cursor, size_t count, const GlobPattern& pattern,
+                             std::vector<std::pair<std::string, std::string>>& result) {
+    auto it = storage.find(key);
+    if (it == storage.end() || it->second.value.type != DataType::HASH) return 0;
+    
+    const auto& hash_data = std::get<HashValue>(it->second.value.data);
+    return hash_data.scan(cursor, count, [&](HashValue::Entry entry) {
+        if (pattern.matches(entry.first)) {
+            result.emplace_back(entry.first, entry.second);
+        }
+    });
+}
+
+size_t DataOperations::sscan(const Keyspace& storage, 
+                             const std::string& key, size_t cursor, size_t count, const GlobPattern& pattern,
+                             std::vector<std::string>& result) {
+    auto it = storage.find(key);
+    if (it == storage.end() || it->second.value.type != DataType::SET) return 0;
+    
+    const auto& set_data = std::get<SetValue>(it->second.value.data);
+    return set_data.scan(cursor, count, [&](std::string_view member) {
+        if (pattern.matches(member)) {
+            result.emplace_back(member);
+        }
+    });
+}
+
+size_t DataOperations::zscan(const Keyspace& storage, 
+                             const std::string& key, size_t cursor, size_t count, const GlobPattern& pattern,
+                             std::vector<ScoredMember>& result) {
+    auto it = storage.find(key);
+    if (it == storage.end() || it->second.value.type != DataType::ZSET) return 0;
+    
+    const auto& zset_data = std::get<SortedSet>(it->second.value.data);
+    return zset_data.scan(cursor, count, [&](const SortedSet::Node& node) {
+        if (pattern.matches(node.member)) {
+            result.emplace_back(node.member, node.score);
+        }
+    });
+}
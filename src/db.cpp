@@ -3,412 +3,1372 @@
 #include "lfu_cache.h"
 #include "enhanced_cache.h"
 #include "data_types.h"
+#include "aof.h"
+#include "snapshot.h"
 #include <fstream>
 #include <json.hpp>
 #include <mutex>
 #include <string>
 #include <sstream>
+#include <iostream>
+#include <cstdlib>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <thread>
 
-static const char* AOF_FILENAME = "db.aof";
-
-class AOFLogger {
-  public:
-    static void log(const std::string& entry) {
-        std::ofstream aof(AOF_FILENAME, std::ios::app);
-        aof << entry << "\n";
-    }
-    static void replay(LRUDB* db) {
-        std::ifstream aof(AOF_FILENAME);
-        std::string line;
-        while (std::getline(aof, line)) {
-            std::istringstream iss(line);
-            std::string cmd, key, value;
-            iss >> cmd >> key;
-            if (cmd == "SET") {
-                iss >> value;
-                db->set(key, value);
-            } else if (cmd == "DEL") {
-                db->del(key);
+// Number of elements per command when a rewrite serializes a collection
+static const size_t AOF_REWRITE_ITEMS_PER_CMD = 64;
+// Keys (walked or saved) BGSAVE writes per shard lock hold
+static const size_t BGSAVE_STEP = 1024;
+// LOAD hands its AOF records to the writer in batches of about this size
+static const size_t LOAD_LOG_BATCH = 1024 * 1024;
+
+// Expiry deadlines are logged as absolute Unix times in milliseconds, so a
+// replay long after the write still expires the key at the right moment.
+static int64_t to_unix_ms(std::chrono::steady_clock::time_point when) {
+    auto wall = std::chrono::system_clock::now() +
+                std::chrono::duration_cast<std::chrono::system_clock::duration>(when - std::chrono::steady_clock::now());
+    return std::chrono::duration_cast<std::chrono::milliseconds>(wall.time_since_epoch()).count();
+}
+
+static std::chrono::steady_clock::time_point from_unix_ms(int64_t unix_ms) {
+    auto wall = std::chrono::system_clock::time_point(std::chrono::milliseconds(unix_ms));
+    return std::chrono::steady_clock::now() +
+           std::chrono::duration_cast<std::chrono::steady_clock::duration>(wall - std::chrono::system_clock::now());
+}
+
+static int64_t deadline_unix_ms(int seconds) {
+    return to_unix_ms(std::chrono::steady_clock::now() + std::chrono::seconds(seconds));
+}
+
+static void append_expire_record(const std::string& key, std::chrono::steady_clock::time_point when, std::string& out) {
+    AOFRecord record(out);
+    record.add("PEXPIREAT");
+    record.add(key);
+    record.add(std::to_string(to_unix_ms(when)));
+    record.finish();
+}
+
+// Appends the records that recreate `key` with `value` to `out`.
+static void append_rewrite_commands(const std::string& key, const DataValue& value, std::string& out) {
+    auto emit_batched = [&](const char* cmd, auto begin, auto end, auto&& add) {
+        while (begin != end) {
+            AOFRecord record(out);
+            record.add(cmd);
+            record.add(key);
+            for (size_t n = 0; n < AOF_REWRITE_ITEMS_PER_CMD && begin != end; ++n, ++begin) {
+                add(record, *begin);
             }
+            record.finish();
         }
-    }
-};
+    };
+    auto add_item = [](AOFRecord& record, std::string_view item) { record.add(item); };
 
-std::mutex db_mutex;
+    switch (value.type) {
+        case DataType::STRING: {
+            char buf[StringValue::INT_CHARS];
+            AOFRecord record(out);
+            record.add("SET");
+            record.add(key);
+            record.add(std::get<StringValue>(value.data).view(buf));
+            record.finish();
+            break;
+        }
+        case DataType::LIST: {
+            const auto& list = std::get<QuickList>(value.data);
+            emit_batched("RPUSH", list.begin(), list.end(), add_item);
+            break;
+        }
+        case DataType::SET: {
+            const auto& set = std::get<SetValue>(value.data);
+            emit_batched("SADD", set.begin(), set.end(), add_item);
+            break;
+        }
+        case DataType::HASH: {
+            const auto& hash = std::get<HashValue>(value.data);
+            for (auto field : hash) {
+                AOFRecord record(out);
+                record.add("HSET");
+                record.add(key);
+                record.add(field.first);
+                record.add(field.second);
+                record.finish();
+            }
+            break;
+        }
+        case DataType::ZSET: {
+            const auto& zset = std::get<SortedSet>(value.data);
+            emit_batched("ZADD", zset.begin(), zset.end(),
+                         [](AOFRecord& record, const SortedSet::Node& node) {
+                             record.add(SortedSet::format_score(node.score));
+                             record.add(node.member);
+                         });
+            break;
+        }
+    }
+}
 
 // Enhanced DB implementation
-EnhancedDB::EnhancedDB(size_t capacity) : cache_(new EnhancedCache(capacity)) {}
+EnhancedDB::EnhancedDB(size_t capacity, size_t num_shards)
+    : shards_(num_shards, per_shard_capacity(capacity, num_shards)) {}
+
+EnhancedDB::Shard::Shard(size_t capacity) : cache(storage, capacity) {
+    cache.set_evict_hook([this](const std::string& key) { before_write(key, true); });
+}
+
+void EnhancedDB::Shard::save_for_snapshot(const std::string& key, bool removing) {
+    auto slot = snapshot.saved.try_emplace(key);
+    if (!slot.second) return;  // already saved
+    auto it = storage.find(key);
+    if (it == storage.end()) return;  // stays nullopt: the key is newer than the snapshot
+    KeyEntry& entry = it->second;
+    bool has_ttl = static_cast<const ListHook<ExpiryTag>&>(entry).is_linked();
+    slot.first->second = SavedEntry{removing ? std::move(entry.value) : entry.value, has_ttl, entry.expires_at};
+}
+
+void EnhancedDB::Shard::before_clear() {
+    if (!snapshot.active || snapshot.walked) return;
+    do {
+        snapshot.cursor = storage.scan(snapshot.cursor, [this](Keyspace::value_type& item) {
+            save_for_snapshot(item.first, true);
+        });
+    } while (snapshot.cursor);
+    snapshot.walked = true;
+}
 
 void EnhancedDB::set(const std::string& key, const std::string& value) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    storage_[key] = DataValue(value);
-    cache_->put(key, storage_[key]);
-    AOFLogger::log("SET " + key + " " + value);
+    AOFCommit commit;
+    Shard& shard = shards_.for_key(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.before_write(key);
+    shard.cache.expire_if_needed(key);
+    DataOperations::set_string(shard.storage, key, value);
+    shard.cache.touch(key);
+    commit.log({"SET", key, value}, shard.aof_rewrite);
 }
 
 bool EnhancedDB::get(const std::string& key, std::string& value) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    DataValue data_value;
-    if (cache_->get(key, data_value)) {
-        if (data_value.type == DataType::STRING) {
-            value = std::get<std::string>(data_value.data);
-            return true;
-        }
+    Shard& shard = shards_.for_key(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    KeyEntry* entry = shard.cache.get(key);
+    if (entry && entry->value.type == DataType::STRING) {
+        char buf[StringValue::INT_CHARS];
+        value.assign(std::get<StringValue>(entry->value.data).view(buf));
+        return true;
     }
     return false;
 }
 
 bool EnhancedDB::incr(const std::string& key, int64_t& result) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    sync_from_cache();
-    bool success = DataOperations::incr(storage_, key, result);
+    AOFCommit commit;
+    Shard& shard = shards_.for_key(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.before_write(key);
+    shard.cache.expire_if_needed(key);
+    bool success = DataOperations::incr(shard.storage, key, result);
     if (success) {
-        sync_to_cache(key);
-        AOFLogger::log("INCR " + key);
+        shard.cache.touch(key);
+        commit.log({"INCR", key}, shard.aof_rewrite);
     }
     return success;
 }
 
 bool EnhancedDB::decr(const std::string& key, int64_t& result) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    sync_from_cache();
-    bool success = DataOperations::decr(storage_, key, result);
+    AOFCommit commit;
+    Shard& shard = shards_.for_key(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.before_write(key);
+    shard.cache.expire_if_needed(key);
+    bool success = DataOperations::decr(shard.storage, key, result);
     if (success) {
-        sync_to_cache(key);
-        AOFLogger::log("DECR " + key);
+        shard.cache.touch(key);
+        commit.log({"DECR", key}, shard.aof_rewrite);
+    }
+    return success;
+}
+
+bool EnhancedDB::incrby(const std::string& key, int64_t delta, int64_t& result) {
+    AOFCommit commit;
+    Shard& shard = shards_.for_key(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.before_write(key);
+    shard.cache.expire_if_needed(key);
+    bool success = DataOperations::incrby(shard.storage, key, delta, result);
+    if (success) {
+        shard.cache.touch(key);
+        commit.log({"INCRBY", key, std::to_string(delta)}, shard.aof_rewrite);
     }
     return success;
 }
 
 bool EnhancedDB::lpush(const std::string& key, const std::vector<std::string>& values) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    sync_from_cache();
-    bool success = DataOperations::lpush(storage_, key, values);
+    AOFCommit commit;
+    Shard& shard = shards_.for_key(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.before_write(key);
+    shard.cache.expire_if_needed(key);
+    bool success = DataOperations::lpush(shard.storage, key, values);
     if (success) {
-        sync_to_cache(key);
-        std::string vals;
-        for (const auto& v : values) vals += " " + v;
-        AOFLogger::log("LPUSH " + key + vals);
+        shard.cache.touch(key);
+        commit.log({"LPUSH", key}, values, shard.aof_rewrite);
     }
     return success;
 }
 
 bool EnhancedDB::rpush(const std::string& key, const std::vector<std::string>& values) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    sync_from_cache();
-    bool success = DataOperations::rpush(storage_, key, values);
+    AOFCommit commit;
+    Shard& shard = shards_.for_key(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.before_write(key);
+    shard.cache.expire_if_needed(key);
+    bool success = DataOperations::rpush(shard.storage, key, values);
     if (success) {
-        sync_to_cache(key);
-        std::string vals;
-        for (const auto& v : values) vals += " " + v;
-        AOFLogger::log("RPUSH " + key + vals);
+        shard.cache.touch(key);
+        commit.log({"RPUSH", key}, values, shard.aof_rewrite);
     }
     return success;
 }
 
 bool EnhancedDB::lpop(const std::string& key, std::string& value) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    sync_from_cache();
-    bool success = DataOperations::lpop(storage_, key, value);
+    AOFCommit commit;
+    Shard& shard = shards_.for_key(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.before_write(key);
+    shard.cache.expire_if_needed(key);
+    bool success = DataOperations::lpop(shard.storage, key, value);
     if (success) {
-        sync_to_cache(key);
-        AOFLogger::log("LPOP " + key);
+        shard.cache.touch(key);
+        commit.log({"LPOP", key}, shard.aof_rewrite);
     }
     return success;
 }
 
 bool EnhancedDB::rpop(const std::string& key, std::string& value) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    sync_from_cache();
-    bool success = DataOperations::rpop(storage_, key, value);
+    AOFCommit commit;
+    Shard& shard = shards_.for_key(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.before_write(key);
+    shard.cache.expire_if_needed(key);
+    bool success = DataOperations::rpop(shard.storage, key, value);
     if (success) {
-        sync_to_cache(key);
-        AOFLogger::log("RPOP " + key);
+        shard.cache.touch(key);
+        commit.log({"RPOP", key}, shard.aof_rewrite);
     }
     return success;
 }
 
 bool EnhancedDB::llen(const std::string& key, size_t& length) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    sync_from_cache();
-    return DataOperations::llen(storage_, key, length);
+    Shard& shard = shards_.for_key(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.cache.expire_if_needed(key);
+    return DataOperations::llen(shard.storage, key, length);
 }
 
 bool EnhancedDB::lrange(const std::string& key, int start, int stop, std::vector<std::string>& result) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    sync_from_cache();
-    return DataOperations::lrange(storage_, key, start, stop, result);
+    Shard& shard = shards_.for_key(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.cache.expire_if_needed(key);
+    return DataOperations::lrange(shard.storage, key, start, stop, result);
 }
 
 bool EnhancedDB::sadd(const std::string& key, const std::vector<std::string>& members) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    sync_from_cache();
-    bool success = DataOperations::sadd(storage_, key, members);
+    AOFCommit commit;
+    Shard& shard = shards_.for_key(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.before_write(key);
+    shard.cache.expire_if_needed(key);
+    bool success = DataOperations::sadd(shard.storage, key, members);
     if (success) {
-        sync_to_cache(key);
-        std::string mems;
-        for (const auto& m : members) mems += " " + m;
-        AOFLogger::log("SADD " + key + mems);
+        shard.cache.touch(key);
+        commit.log({"SADD", key}, members, shard.aof_rewrite);
     }
     return success;
 }
 
 bool EnhancedDB::srem(const std::string& key, const std::vector<std::string>& members) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    sync_from_cache();
-    bool success = DataOperations::srem(storage_, key, members);
+    AOFCommit commit;
+    Shard& shard = shards_.for_key(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.before_write(key);
+    shard.cache.expire_if_needed(key);
+    bool success = DataOperations::srem(shard.storage, key, members);
     if (success) {
-        sync_to_cache(key);
-        std::string mems;
-        for (const auto& m : members) mems += " " + m;
-        AOFLogger::log("SREM " + key + mems);
+        shard.cache.touch(key);
+        commit.log({"SREM", key}, members, shard.aof_rewrite);
     }
     return success;
 }
 
 bool EnhancedDB::smembers(const std::string& key, std::set<std::string>& members) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    sync_from_cache();
-    return DataOperations::smembers(storage_, key, members);
+    Shard& shard = shards_.for_key(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.cache.expire_if_needed(key);
+    return DataOperations::smembers(shard.storage, key, members);
 }
 
 bool EnhancedDB::scard(const std::string& key, size_t& count) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    sync_from_cache();
-    return DataOperations::scard(storage_, key, count);
+    Shard& shard = shards_.for_key(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.cache.expire_if_needed(key);
+    return DataOperations::scard(shard.storage, key, count);
 }
 
 bool EnhancedDB::sismember(const std::string& key, const std::string& member) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    sync_from_cache();
-    return DataOperations::sismember(storage_, key, member);
+    Shard& shard = shards_.for_key(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.cache.expire_if_needed(key);
+    return DataOperations::sismember(shard.storage, key, member);
 }
 
 bool EnhancedDB::hset(const std::string& key, const std::string& field, const std::string& value) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    sync_from_cache();
-    bool success = DataOperations::hset(storage_, key, field, value);
+    AOFCommit commit;
+    Shard& shard = shards_.for_key(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.before_write(key);
+    shard.cache.expire_if_needed(key);
+    bool success = DataOperations::hset(shard.storage, key, field, value);
     if (success) {
-        sync_to_cache(key);
-        AOFLogger::log("HSET " + key + " " + field + " " + value);
+        shard.cache.touch(key);
+        commit.log({"HSET", key, field, value}, shard.aof_rewrite);
     }
     return success;
 }
 
 bool EnhancedDB::hget(const std::string& key, const std::string& field, std::string& value) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    sync_from_cache();
-    return DataOperations::hget(storage_, key, field, value);
+    Shard& shard = shards_.for_key(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.cache.expire_if_needed(key);
+    return DataOperations::hget(shard.storage, key, field, value);
 }
 
 bool EnhancedDB::hdel(const std::string& key, const std::vector<std::string>& fields) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    sync_from_cache();
-    bool success = DataOperations::hdel(storage_, key, fields);
+    AOFCommit commit;
+    Shard& shard = shards_.for_key(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.before_write(key);
+    shard.cache.expire_if_needed(key);
+    bool success = DataOperations::hdel(shard.storage, key, fields);
     if (success) {
-        sync_to_cache(key);
-        std::string flds;
-        for (const auto& f : fields) flds += " " + f;
-        AOFLogger::log("HDEL " + key + flds);
+        shard.cache.touch(key);
+        commit.log({"HDEL", key}, fields, shard.aof_rewrite);
     }
     return success;
 }
 
 bool EnhancedDB::hgetall(const std::string& key, std::unordered_map<std::string, std::string>& result) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    sync_from_cache();
-    return DataOperations::hgetall(storage_, key, result);
+    Shard& shard = shards_.for_key(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.cache.expire_if_needed(key);
+    return DataOperations::hgetall(shard.storage, key, result);
 }
 
 bool EnhancedDB::hkeys(const std::string& key, std::vector<std::string>& fields) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    sync_from_cache();
-    return DataOperations::hkeys(storage_, key, fields);
+    Shard& shard = shards_.for_key(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.cache.expire_if_needed(key);
+    return DataOperations::hkeys(shard.storage, key, fields);
 }
 
 bool EnhancedDB::hvals(const std::string& key, std::vector<std::string>& values) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    sync_from_cache();
-    return DataOperations::hvals(storage_, key, values);
+    Shard& shard = shards_.for_key(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.cache.expire_if_needed(key);
+    return DataOperations::hvals(shard.storage, key, values);
+}
+
+bool EnhancedDB::zadd(const std::string& key, const std::vector<std::pair<double, std::string>>& members,
+                      size_t& added) {
+    AOFCommit commit;
+    Shard& shard = shards_.for_key(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.before_write(key);
+    shard.cache.expire_if_needed(key);
+    bool success = DataOperations::zadd(shard.storage, key, members, added);
+    if (success) {
+        shard.cache.touch(key);
+        std::vector<std::string> args;
+        args.reserve(members.size() * 2);
+        for (const auto& entry : members) {
+            args.push_back(SortedSet::format_score(entry.first));
+            args.push_back(entry.second);
+        }
+        commit.log({"ZADD", key}, args, shard.aof_rewrite);
+    }
+    return success;
+}
+
+bool EnhancedDB::zincrby(const std::string& key, double increment, const std::string& member, double& score) {
+    AOFCommit commit;
+    Shard& shard = shards_.for_key(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.before_write(key);
+    shard.cache.expire_if_needed(key);
+    bool success = DataOperations::zincrby(shard.storage, key, increment, member, score);
+    if (success) {
+        shard.cache.touch(key);
+        commit.log({"ZINCRBY", key, SortedSet::format_score(increment), member}, shard.aof_rewrite);
+    }
+    return success;
+}
+
+bool EnhancedDB::zrem(const std::string& key, const std::vector<std::string>& members, size_t& removed) {
+    AOFCommit commit;
+    Shard& shard = shards_.for_key(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.before_write(key);
+    shard.cache.expire_if_needed(key);
+    bool success = DataOperations::zrem(shard.storage, key, members, removed);
+    if (success && removed > 0) {
+        shard.cache.touch(key);
+        commit.log({"ZREM", key}, members, shard.aof_rewrite);
+    }
+    return success;
+}
+
+bool EnhancedDB::zcard(const std::string& key, size_t& count) {
+    Shard& shard = shards_.for_key(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.cache.expire_if_needed(key);
+    return DataOperations::zcard(shard.storage, key, count);
+}
+
+bool EnhancedDB::zscore(const std::string& key, const std::string& member, double& score) {
+    Shard& shard = shards_.for_key(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.cache.expire_if_needed(key);
+    return DataOperations::zscore(shard.storage, key, member, score);
+}
+
+bool EnhancedDB::zrank(const std::string& key, const std::string& member, bool reverse, size_t& rank) {
+    Shard& shard = shards_.for_key(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.cache.expire_if_needed(key);
+    return DataOperations::zrank(shard.storage, key, member, reverse, rank);
+}
+
+bool EnhancedDB::zrange(const std::string& key, int start, int stop, bool reverse, std::vector<ScoredMember>& result) {
+    Shard& shard = shards_.for_key(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.cache.expire_if_needed(key);
+    return DataOperations::zrange(shard.storage, key, start, stop, reverse, result);
+}
+
+bool EnhancedDB::zrangebyscore(const std::string& key, const ScoreRange& range, size_t offset, size_t count,
+                               std::vector<ScoredMember>& result) {
+    Shard& shard = shards_.for_key(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.cache.expire_if_needed(key);
+    return DataOperations::zrangebyscore(shard.storage, key, range, offset, count, result);
 }
 
 void EnhancedDB::del(const std::string& key) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    cache_->erase(key);
-    storage_.erase(key);
-    AOFLogger::log("DEL " + key);
+    AOFCommit commit;
+    Shard& shard = shards_.for_key(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.before_write(key, true);
+    shard.storage.erase(key);
+    commit.log({"DEL", key}, shard.aof_rewrite);
 }
 
 bool EnhancedDB::exists(const std::string& key) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    return cache_->exists(key) || storage_.find(key) != storage_.end();
+    Shard& shard = shards_.for_key(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return shard.cache.exists(key);
 }
 
 DataType EnhancedDB::type(const std::string& key) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    sync_from_cache();
-    return DataOperations::type(storage_, key);
+    Shard& shard = shards_.for_key(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.cache.expire_if_needed(key);
+    return DataOperations::type(shard.storage, key);
 }
 
 std::vector<std::string> EnhancedDB::keys(const std::string& pattern) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    sync_from_cache();
-    return DataOperations::keys(storage_, pattern);
+    GlobPattern glob(pattern);
+    std::vector<std::string> result;
+    if (glob.is_literal()) {
+        // No wildcards: at most one key, found by hash in its own shard.
+        if (exists(glob.prefix())) result.push_back(glob.prefix());
+        return result;
+    }
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        Shard& shard = shards_[i];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto shard_keys = DataOperations::keys(shard.storage, glob);
+        result.insert(result.end(), shard_keys.begin(), shard_keys.end());
+    }
+    return result;
+}
+
+uint64_t EnhancedDB::scan(uint64_t cursor, size_t count, const std::string& pattern,
+                          std::vector<std::string>& keys) {
+    // The low bits of the cursor pick the shard, the rest is the cursor of
+    // that shard's table walk; shards are walked one after another.
+    GlobPattern glob(pattern);
+    size_t shard_bits = shards_.bits();
+    size_t index = cursor & (shards_.size() - 1);
+    uint64_t table_cursor = cursor >> shard_bits;
+    size_t visited = 0;
+    auto now = std::chrono::steady_clock::now();
+    for (;;) {
+        Shard& shard = shards_[index];
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            const Keyspace& storage = shard.storage;
+            // Expired keys are skipped rather than removed: removing would
+            // change the table under the walk.
+            table_cursor = storage.scan_batch(table_cursor, count - visited, [&](const Keyspace::value_type& item) {
+                ++visited;
+                if (EnhancedCache::is_expired(item.second, now)) return;
+                if (glob.matches(item.first)) keys.push_back(item.first);
+            });
+        }
+        if (table_cursor) return table_cursor << shard_bits | index;
+        if (++index == shards_.size()) return 0;
+        if (visited >= count) return index;
+    }
+}
+
+uint64_t EnhancedDB::hscan(const std::string& key, uint64_t cursor, size_t count, const std::string& pattern,
+                           std::vector<std::pair<std::string, std::string>>& fields) {
+    GlobPattern glob(pattern);
+    Shard& shard = shards_.for_key(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.cache.expire_if_needed(key);
+    return DataOperations::hscan(shard.storage, key, cursor, count, glob, fields);
+}
+
+uint64_t EnhancedDB::sscan(const std::string& key, uint64_t cursor, size_t count, const std::string& pattern,
+                           std::vector<std::string>& members) {
+    GlobPattern glob(pattern);
+    Shard& shard = shards_.for_key(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.cache.expire_if_needed(key);
+    return DataOperations::sscan(shard.storage, key, cursor, count, glob, members);
+}
+
+uint64_t EnhancedDB::zscan(const std::string& key, uint64_t cursor, size_t count, const std::string& pattern,
+                           std::vector<ScoredMember>& members) {
+    GlobPattern glob(pattern);
+    Shard& shard = shards_.for_key(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.cache.expire_if_needed(key);
+    return DataOperations::zscan(shard.storage, key, cursor, count, glob, members);
 }
 
 void EnhancedDB::save(const std::string& filename) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    sync_from_cache();
+    auto locks = shards_.lock_all();
+    SnapshotWriter out(filename);
+    auto now = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        for (const auto& item : shards_[i].storage) {
+            int64_t expire_ms = 0;
+            if (static_cast<const ListHook<ExpiryTag>&>(item.second).is_linked()) {
+                if (now > item.second.expires_at) continue;
+                expire_ms = to_unix_ms(item.second.expires_at);
+            }
+            out.write(item.first, item.second.value, expire_ms);
+        }
+    }
+    out.finish();
+}
+
+void EnhancedDB::save_json(const std::string& filename) {
+    auto locks = shards_.lock_all();
     nlohmann::json j;
-    for (const auto& item : storage_) {
-        j[item.first] = item.second.to_json();
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        for (const auto& item : shards_[i].storage) {
+            j[item.first] = item.second.value.to_json();
+        }
     }
     std::ofstream file(filename);
     file << j.dump();
 }
 
 void EnhancedDB::load(const std::string& filename) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    std::ifstream file(filename);
-    if (!file.is_open()) return;
-    
-    nlohmann::json j;
-    file >> j;
+    AOFCommit commit;
+    auto locks = shards_.lock_all();
+    uint64_t rewrite_mark = mark_all_rewritten();
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        shards_[i].before_clear();
+        shards_[i].storage.clear();
+    }
     
-    storage_.clear();
-    cache_->clear();
+    // Logged as a flush followed by the loaded dataset, in bounded batches,
+    // so the AOF does not depend on the snapshot file staying around.
+    std::string records;
+    {
+        AOFRecord record(records);
+        record.add("FLUSHDB");
+        record.finish();
+    }
+    int64_t now_ms = to_unix_ms(std::chrono::steady_clock::now());
+    auto apply = [&](std::string& key, DataValue& value, int64_t expire_ms) {
+        if (expire_ms && expire_ms <= now_ms) return;
+        Shard& shard = shards_.for_key(key);
+        KeyEntry& entry = shard.storage[key];
+        entry.value = std::move(value);
+        shard.cache.touch(key);
+        append_rewrite_commands(key, entry.value, records);
+        if (expire_ms) {
+            shard.cache.set_expiry_at(key, from_unix_ms(expire_ms));
+            append_expire_record(key, from_unix_ms(expire_ms), records);
+        }
+        if (records.size() >= LOAD_LOG_BATCH) {
+            commit.log_records(records, rewrite_mark);
+            records.clear();
+        }
+    };
     
-    for (auto it = j.begin(); it != j.end(); ++it) {
-        DataValue value = DataValue::from_json(it.value());
-        storage_[it.key()] = value;
-        cache_->put(it.key(), value);
+    size_t keys = 0;
+    auto result = SnapshotReader::load(filename, apply, &keys);
+    if (result == SnapshotReader::Result::NOT_SNAPSHOT) {
+        // Dumps written before the binary format
+        std::ifstream file(filename);
+        nlohmann::json j;
+        file >> j;
+        for (auto it = j.begin(); it != j.end(); ++it) {
+            std::string key = it.key();
+            DataValue value = DataValue::from_json(it.value());
+            apply(key, value, 0);
+        }
+    } else if (result == SnapshotReader::Result::CORRUPT) {
+        std::cerr << "Snapshot " << filename << " is corrupt; loaded " << keys << " keys before the damage" << std::endl;
     }
+    commit.log_records(records, rewrite_mark);
 }
 
 void EnhancedDB::expire(const std::string& key, int seconds) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    cache_->set_expiry(key, seconds);
+    AOFCommit commit;
+    Shard& shard = shards_.for_key(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.before_write(key);
+    if (shard.cache.set_expiry(key, seconds)) {
+        commit.log({"PEXPIREAT", key, std::to_string(deadline_unix_ms(seconds))}, shard.aof_rewrite);
+    }
+}
+
+void EnhancedDB::expire_at(const std::string& key, int64_t unix_ms) {
+    AOFCommit commit;
+    Shard& shard = shards_.for_key(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.before_write(key);
+    if (shard.cache.set_expiry_at(key, from_unix_ms(unix_ms))) {
+        commit.log({"PEXPIREAT", key, std::to_string(unix_ms)}, shard.aof_rewrite);
+    }
 }
 
 void EnhancedDB::flushdb() {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    storage_.clear();
-    cache_->clear();
-    AOFLogger::log("FLUSHDB");
+    AOFCommit commit;
+    auto locks = shards_.lock_all();
+    uint64_t rewrite_mark = mark_all_rewritten();
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        shards_[i].before_clear();
+        shards_[i].storage.clear();
+    }
+    commit.log({"FLUSHDB"}, rewrite_mark);
+}
+
+uint64_t EnhancedDB::mark_all_rewritten() {
+    // Called with every shard locked. A running rewrite then skips the
+    // shards it has not reached and keeps the FLUSHDB/LOAD record instead.
+    uint64_t id = AOFWriter::instance().capture_id();
+    if (id) {
+        for (size_t i = 0; i < shards_.size(); ++i) shards_[i].aof_rewrite = id;
+    }
+    return id;
+}
+
+void EnhancedDB::rewrite_aof(AOFRewriteFile& out) {
+    // One shard at a time, so writers are only held up while their own
+    // shard is being serialized; the file write happens after unlocking.
+    std::string chunk;
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        Shard& shard = shards_[i];
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            // Already covered by a FLUSHDB/LOAD record captured for this rewrite.
+            if (shard.aof_rewrite == out.id()) continue;
+            auto now = std::chrono::steady_clock::now();
+            for (const auto& item : shard.storage) {
+                bool has_ttl = static_cast<const ListHook<ExpiryTag>&>(item.second).is_linked();
+                if (has_ttl && now > item.second.expires_at) continue;
+                append_rewrite_commands(item.first, item.second.value, chunk);
+                if (has_ttl) append_expire_record(item.first, item.second.expires_at, chunk);
+            }
+            shard.aof_rewrite = out.id();
+        }
+        out.write(chunk);
+        chunk.clear();
+    }
+}
+
+bool EnhancedDB::bgsave(const std::string& filename) {
+    // The snapshot is the dataset as of this moment: every shard is locked
+    // while its walk state is set up, then the thread proceeds shard by shard.
+    auto locks = shards_.lock_all();
+    size_t total = 0;
+    for (size_t i = 0; i < shards_.size(); ++i) total += shards_[i].storage.size();
+    if (!bgsave_.start(filename, total, [this](SnapshotWriter& out) { return write_snapshot(out); },
+                       [this]() { abandon_snapshot(); })) {
+        return false;
+    }
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        Shard::SnapshotState& state = shards_[i].snapshot;
+        state.active = true;
+        state.walked = false;
+        state.cursor = 0;
+        state.saved.clear();
+    }
+    return true;
+}
+
+void EnhancedDB::abandon_snapshot() {
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        Shard& shard = shards_[i];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        Shard::SnapshotState& state = shard.snapshot;
+        state.active = false;
+        state.walked = false;
+        state.cursor = 0;
+        std::unordered_map<std::string, std::optional<Shard::SavedEntry>>().swap(state.saved);
+    }
+}
+
+bool EnhancedDB::write_snapshot(SnapshotWriter& out) {
+    auto write_entry = [&](const std::string& key, const DataValue& value, bool has_ttl,
+                           std::chrono::steady_clock::time_point expires_at,
+                           std::chrono::steady_clock::time_point now) {
+        if (has_ttl && now > expires_at) return;
+        out.write(key, value, has_ttl ? to_unix_ms(expires_at) : 0);
+    };
+    
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        Shard& shard = shards_[i];
+        Shard::SnapshotState& state = shard.snapshot;
+        bool done = false;
+        while (!done) {
+            // Let writers queued on the mutex in between steps.
+            std::this_thread::yield();
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            if (bgsave_.cancelled() || !out.ok()) return false;
+            auto now = std::chrono::steady_clock::now();
+            if (!state.walked) {
+                size_t visited = 0;
+                do {
+                    state.cursor = shard.storage.scan(state.cursor, [&](const Keyspace::value_type& item) {
+                        ++visited;
+                        // Changed since the snapshot started: written from `saved`.
+                        if (!state.saved.empty() && state.saved.count(item.first)) return;
+                        const KeyEntry& entry = item.second;
+                        write_entry(item.first, entry.value,
+                                    static_cast<const ListHook<ExpiryTag>&>(entry).is_linked(), entry.expires_at, now);
+                    });
+                } while (state.cursor && visited < BGSAVE_STEP);
+                // Walk finished: later writes need no saving.
+                if (!state.cursor) state.walked = true;
+            } else {
+                auto it = state.saved.begin();
+                for (size_t n = 0; n < BGSAVE_STEP && it != state.saved.end(); ++n) {
+                    if (it->second) {
+                        write_entry(it->first, it->second->value, it->second->has_ttl, it->second->expires_at, now);
+                    }
+                    it = state.saved.erase(it);
+                }
+                if (state.saved.empty()) {
+                    std::unordered_map<std::string, std::optional<Shard::SavedEntry>>().swap(state.saved);
+                    state.active = false;
+                    done = true;
+                }
+            }
+            bgsave_.progress(out.keys());
+        }
+    }
+    return true;
 }
 
 size_t EnhancedDB::dbsize() {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    sync_from_cache();
-    return storage_.size();
+    size_t total = 0;
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        Shard& shard = shards_[i];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        total += shard.storage.size();
+    }
+    return total;
+}
+
+size_t EnhancedDB::active_expire(size_t max_keys) {
+    size_t per_shard = std::max<size_t>(1, max_keys / shards_.size());
+    size_t expired = 0;
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        std::lock_guard<std::mutex> lock(shards_[i].mutex);
+        expired += shards_[i].cache.expire_due(per_shard);
+    }
+    return expired;
+}
+
+bool EnhancedDB::rehash_step(size_t groups) {
+    bool rehashing = false;
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        std::lock_guard<std::mutex> lock(shards_[i].mutex);
+        rehashing |= shards_[i].storage.rehash_step(groups);
+    }
+    return rehashing;
+}
+
+ExpiryStats EnhancedDB::expiry_stats() {
+    ExpiryStats total;
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        std::lock_guard<std::mutex> lock(shards_[i].mutex);
+        total.merge(shards_[i].cache.expiry_stats());
+    }
+    return total;
+}
+
+void EnhancedDB::set_max_memory(size_t bytes) {
+    size_t per_shard = per_shard_memory(bytes, shards_.size());
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        std::lock_guard<std::mutex> lock(shards_[i].mutex);
+        shards_[i].cache.set_max_memory(per_shard);
+    }
+}
+
+MemoryStats EnhancedDB::memory_stats() {
+    MemoryStats total;
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        std::lock_guard<std::mutex> lock(shards_[i].mutex);
+        total.merge(shards_[i].cache.memory_stats());
+    }
+    return total;
+}
+
+void EnhancedDB::set_eviction_policy(EvictionPolicy policy, size_t samples) {
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        std::lock_guard<std::mutex> lock(shards_[i].mutex);
+        shards_[i].cache.set_eviction_policy(policy, samples);
+    }
+}
+
+ARCStats EnhancedDB::arc_stats() {
+    ARCStats total;
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        std::lock_guard<std::mutex> lock(shards_[i].mutex);
+        total.merge(shards_[i].cache.arc_stats());
+    }
+    return total;
+}
+
+TinyLFUStats EnhancedDB::tiny_lfu_stats() {
+    TinyLFUStats total;
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        std::lock_guard<std::mutex> lock(shards_[i].mutex);
+        total.merge(shards_[i].cache.tiny_lfu_stats());
+    }
+    return total;
 }
 
 size_t EnhancedDB::get_hits() const {
-    return cache_->get_hits();
+    size_t total = 0;
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        std::lock_guard<std::mutex> lock(shards_[i].mutex);
+        total += shards_[i].cache.get_hits();
+    }
+    return total;
 }
 
 size_t EnhancedDB::get_misses() const {
-    return cache_->get_misses();
+    size_t total = 0;
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        std::lock_guard<std::mutex> lock(shards_[i].mutex);
+        total += shards_[i].cache.get_misses();
+    }
+    return total;
 }
 
-void EnhancedDB::sync_to_cache(const std::string& key) {
-    auto it = storage_.find(key);
-    if (it != storage_.end()) {
-        cache_->put(key, it->second);
-    }
+EnhancedDB::~EnhancedDB() = default;
+
+// ARCDB method implementations
+ARCDB::ARCDB(size_t capacity, size_t num_shards) : EnhancedDB(capacity, num_shards) {
+    set_eviction_policy(EvictionPolicy::ARC);
 }
 
-void EnhancedDB::sync_from_cache() {
-    // For now, we keep storage_ as the primary source
-    // In a more sophisticated implementation, we could sync cache data back to storage
+double ARCDB::get_avg_hit_latency() {
+    ARCStats stats = arc_stats();
+    return stats.hits ? std::chrono::duration<double, std::milli>(stats.hit_time).count() / stats.hits : 0.0;
 }
 
-EnhancedDB::~EnhancedDB() {
-    delete cache_;
+size_t ARCDB::get_eviction_count() {
+    return memory_stats().evicted_keys;
 }
 
-// LRUDB method implementations (unchanged)
-LRUDB::LRUDB(size_t capacity) : cache_(new LRUCache(capacity)) {
-    AOFLogger::replay(this);
+// TinyLFUDB method implementations
+TinyLFUDB::TinyLFUDB(size_t capacity, size_t num_shards) : EnhancedDB(capacity, num_shards) {
+    set_eviction_policy(EvictionPolicy::TINY_LFU);
 }
+
+// LRUDB method implementations
+LRUDB::LRUDB(size_t capacity, size_t num_shards)
+    : shards_(num_shards, per_shard_capacity(capacity, num_shards)) {}
 void LRUDB::set(const std::string& key, const std::string& value) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    cache_->put(key, value);
-    AOFLogger::log("SET " + key + " " + value);
+    AOFCommit commit;
+    Shard& shard = shards_.for_key(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.cache.put(key, value);
+    commit.log({"SET", key, value}, shard.aof_rewrite);
 }
 bool LRUDB::get(const std::string& key, std::string& value) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    return cache_->get(key, value);
+    Shard& shard = shards_.for_key(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return shard.cache.get(key, value);
 }
 void LRUDB::del(const std::string& key) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    cache_->erase(key);
-    AOFLogger::log("DEL " + key);
+    AOFCommit commit;
+    Shard& shard = shards_.for_key(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.cache.erase(key);
+    commit.log({"DEL", key}, shard.aof_rewrite);
+}
+void LRUDB::rewrite_aof(AOFRewriteFile& out) {
+    std::string chunk;
+    std::chrono::steady_clock::time_point when;
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        Shard& shard = shards_[i];
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            for (const auto& item : shard.cache.get_items()) {
+                DataValue value(item.second);
+                append_rewrite_commands(item.first, value, chunk);
+                if (shard.cache.get_expiry(item.first, when)) append_expire_record(item.first, when, chunk);
+            }
+            shard.aof_rewrite = out.id();
+        }
+        out.write(chunk);
+        chunk.clear();
+    }
 }
 void LRUDB::save(const std::string& filename) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    nlohmann::json j;
-    for (const auto& item : cache_->get_items()) {
-        j[item.first] = item.second;
+    auto locks = shards_.lock_all();
+    SnapshotWriter out(filename);
+    std::chrono::steady_clock::time_point when;
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        for (const auto& item : shards_[i].cache.get_items()) {
+            bool has_ttl = shards_[i].cache.get_expiry(item.first, when);
+            out.write_string(item.first, item.second, has_ttl ? to_unix_ms(when) : 0);
+        }
     }
-    std::ofstream file(filename);
-    file << j.dump();
+    out.finish();
 }
+bool LRUDB::bgsave(const std::string& filename) {
+    // Strings only, so the snapshot is a copy taken under all shard locks;
+    // the slow part, writing it out, happens on the background thread.
+    if (bgsave_.status().in_progress) return false;
+    struct Item {
+        std::string key;
+        std::string value;
+        int64_t expire_ms;
+    };
+    auto items = std::make_shared<std::vector<Item>>();
+    auto locks = shards_.lock_all();
+    std::chrono::steady_clock::time_point when;
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        for (const auto& item : shards_[i].cache.get_items()) {
+            bool has_ttl = shards_[i].cache.get_expiry(item.first, when);
+            items->push_back(Item{item.first, item.second, has_ttl ? to_unix_ms(when) : 0});
+        }
+    }
+    return bgsave_.start(filename, items->size(), [this, items](SnapshotWriter& out) {
+        for (const auto& item : *items) {
+            if (bgsave_.cancelled()) return false;
+            out.write_string(item.key, item.value, item.expire_ms);
+            if (out.keys() % 4096 == 0) bgsave_.progress(out.keys());
+        }
+        bgsave_.progress(out.keys());
+        return true;
+    });
+}
+
 void LRUDB::load(const std::string& filename) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    std::ifstream file(filename);
-    nlohmann::json j;
-    file >> j;
-    for (auto it = j.begin(); it != j.end(); ++it) {
-        cache_->put(it.key(), it.value());
+    AOFCommit commit;
+    int64_t now_ms = to_unix_ms(std::chrono::steady_clock::now());
+    auto apply = [&](std::string& key, DataValue& value, int64_t expire_ms) {
+        if (value.type != DataType::STRING || (expire_ms && expire_ms <= now_ms)) return;
+        std::string str = std::get<StringValue>(value.data).str();
+        Shard& shard = shards_.for_key(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.cache.put(key, str);
+        commit.log({"SET", key, str}, shard.aof_rewrite);
+        if (expire_ms) {
+            shard.cache.set_expiry_at(key, from_unix_ms(expire_ms));
+            commit.log({"PEXPIREAT", key, std::to_string(expire_ms)}, shard.aof_rewrite);
+        }
+    };
+    if (SnapshotReader::load(filename, apply) == SnapshotReader::Result::NOT_SNAPSHOT) {
+        // Dumps written before the binary format
+        std::ifstream file(filename);
+        nlohmann::json j;
+        file >> j;
+        for (auto it = j.begin(); it != j.end(); ++it) {
+            std::string key = it.key();
+            DataValue value(it.value().get<std::string>());
+            apply(key, value, 0);
+        }
     }
 }
 void LRUDB::expire(const std::string& key, int seconds) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    cache_->set_expiry(key, seconds);
+    AOFCommit commit;
+    Shard& shard = shards_.for_key(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (shard.cache.set_expiry(key, seconds)) {
+        commit.log({"PEXPIREAT", key, std::to_string(deadline_unix_ms(seconds))}, shard.aof_rewrite);
+    }
+}
+void LRUDB::expire_at(const std::string& key, int64_t unix_ms) {
+    AOFCommit commit;
+    Shard& shard = shards_.for_key(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (shard.cache.set_expiry_at(key, from_unix_ms(unix_ms))) {
+        commit.log({"PEXPIREAT", key, std::to_string(unix_ms)}, shard.aof_rewrite);
+    }
+}
+size_t LRUDB::active_expire(size_t max_keys) {
+    size_t per_shard = std::max<size_t>(1, max_keys / shards_.size());
+    size_t expired = 0;
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        std::lock_guard<std::mutex> lock(shards_[i].mutex);
+        expired += shards_[i].cache.expire_due(per_shard);
+    }
+    return expired;
+}
+
+ExpiryStats LRUDB::expiry_stats() {
+    ExpiryStats total;
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        std::lock_guard<std::mutex> lock(shards_[i].mutex);
+        total.merge(shards_[i].cache.expiry_stats());
+    }
+    return total;
+}
+
+void LRUDB::set_max_memory(size_t bytes) {
+    size_t per_shard = per_shard_memory(bytes, shards_.size());
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        std::lock_guard<std::mutex> lock(shards_[i].mutex);
+        shards_[i].cache.set_max_memory(per_shard);
+    }
+}
+
+MemoryStats LRUDB::memory_stats() {
+    MemoryStats total;
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        std::lock_guard<std::mutex> lock(shards_[i].mutex);
+        total.merge(shards_[i].cache.memory_stats());
+    }
+    return total;
+}
+
+size_t LRUDB::get_hits() const {
+    size_t total = 0;
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        std::lock_guard<std::mutex> lock(shards_[i].mutex);
+        total += shards_[i].cache.get_hits();
+    }
+    return total;
+}
+size_t LRUDB::get_misses() const {
+    size_t total = 0;
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        std::lock_guard<std::mutex> lock(shards_[i].mutex);
+        total += shards_[i].cache.get_misses();
+    }
+    return total;
 }
 
 // LFUDB method implementations
-LFUDB::LFUDB(size_t capacity) : cache_(new LFUCache(capacity)) {}
+LFUDB::LFUDB(size_t capacity, size_t num_shards)
+    : shards_(num_shards, per_shard_capacity(capacity, num_shards)) {}
 void LFUDB::set(const std::string& key, const std::string& value) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    cache_->put(key, value);
+    AOFCommit commit;
+    Shard& shard = shards_.for_key(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.cache.put(key, value);
+    commit.log({"SET", key, value}, shard.aof_rewrite);
 }
 bool LFUDB::get(const std::string& key, std::string& value) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    return cache_->get(key, value);
+    Shard& shard = shards_.for_key(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return shard.cache.get(key, value);
 }
 void LFUDB::del(const std::string& key) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    cache_->erase(key);
+    AOFCommit commit;
+    Shard& shard = shards_.for_key(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.cache.erase(key);
+    commit.log({"DEL", key}, shard.aof_rewrite);
+}
+void LFUDB::rewrite_aof(AOFRewriteFile& out) {
+    std::string chunk;
+    std::chrono::steady_clock::time_point when;
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        Shard& shard = shards_[i];
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            for (const auto& item : shard.cache.get_items()) {
+                DataValue value(item.second.value);
+                append_rewrite_commands(item.first, value, chunk);
+                if (shard.cache.get_expiry(item.first, when)) append_expire_record(item.first, when, chunk);
+            }
+            shard.aof_rewrite = out.id();
+        }
+        out.write(chunk);
+        chunk.clear();
+    }
 }
 void LFUDB::save(const std::string& filename) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    nlohmann::json j;
-    for (const auto& item : cache_->get_items()) {
-        j[item.first] = item.second;
+    auto locks = shards_.lock_all();
+    SnapshotWriter out(filename);
+    std::chrono::steady_clock::time_point when;
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        for (const auto& item : shards_[i].cache.get_items()) {
+            bool has_ttl = shards_[i].cache.get_expiry(item.first, when);
+            out.write_string(item.first, item.second.value, has_ttl ? to_unix_ms(when) : 0);
+        }
     }
-    std::ofstream file(filename);
-    file << j.dump();
+    out.finish();
 }
+bool LFUDB::bgsave(const std::string& filename) {
+    // Strings only, so the snapshot is a copy taken under all shard locks;
+    // the slow part, writing it out, happens on the background thread.
+    if (bgsave_.status().in_progress) return false;
+    struct Item {
+        std::string key;
+        std::string value;
+        int64_t expire_ms;
+    };
+    auto items = std::make_shared<std::vector<Item>>();
+    auto locks = shards_.lock_all();
+    std::chrono::steady_clock::time_point when;
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        for (const auto& item : shards_[i].cache.get_items()) {
+            bool has_ttl = shards_[i].cache.get_expiry(item.first, when);
+            items->push_back(Item{item.first, item.second.value, has_ttl ? to_unix_ms(when) : 0});
+        }
+    }
+    return bgsave_.start(filename, items->size(), [this, items](SnapshotWriter& out) {
+        for (const auto& item : *items) {
+            if (bgsave_.cancelled()) return false;
+            out.write_string(item.key, item.value, item.expire_ms);
+            if (out.keys() % 4096 == 0) bgsave_.progress(out.keys());
+        }
+        bgsave_.progress(out.keys());
+        return true;
+    });
+}
+
 void LFUDB::load(const std::string& filename) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    std::ifstream file(filename);
-    nlohmann::json j;
-    file >> j;
-    for (auto it = j.begin(); it != j.end(); ++it) {
-        cache_->put(it.key(), it.value());
+    AOFCommit commit;
+    int64_t now_ms = to_unix_ms(std::chrono::steady_clock::now());
+    auto apply = [&](std::string& key, DataValue& value, int64_t expire_ms) {
+        if (value.type != DataType::STRING || (expire_ms && expire_ms <= now_ms)) return;
+        std::string str = std::get<StringValue>(value.data).str();
+        Shard& shard = shards_.for_key(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.cache.put(key, str);
+        commit.log({"SET", key, str}, shard.aof_rewrite);
+        if (expire_ms) {
+            shard.cache.set_expiry_at(key, from_unix_ms(expire_ms));
+            commit.log({"PEXPIREAT", key, std::to_string(expire_ms)}, shard.aof_rewrite);
+        }
+    };
+    if (SnapshotReader::load(filename, apply) == SnapshotReader::Result::NOT_SNAPSHOT) {
+        // Dumps written before the binary format
+        std::ifstream file(filename);
+        nlohmann::json j;
+        file >> j;
+        for (auto it = j.begin(); it != j.end(); ++it) {
+            std::string key = it.key();
+            DataValue value(it.value().get<std::string>());
+            apply(key, value, 0);
+        }
     }
 }
 void LFUDB::expire(const std::string& key, int seconds) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    cache_->set_expiry(key, seconds);
+    AOFCommit commit;
+    Shard& shard = shards_.for_key(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (shard.cache.set_expiry(key, seconds)) {
+        commit.log({"PEXPIREAT", key, std::to_string(deadline_unix_ms(seconds))}, shard.aof_rewrite);
+    }
+}
+void LFUDB::expire_at(const std::string& key, int64_t unix_ms) {
+    AOFCommit commit;
+    Shard& shard = shards_.for_key(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (shard.cache.set_expiry_at(key, from_unix_ms(unix_ms))) {
+        commit.log({"PEXPIREAT", key, std::to_string(unix_ms)}, shard.aof_rewrite);
+    }
+}
+size_t LFUDB::active_expire(size_t max_keys) {
+    size_t per_shard = std::max<size_t>(1, max_keys / shards_.size());
+    size_t expired = 0;
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        std::lock_guard<std::mutex> lock(shards_[i].mutex);
+        expired += shards_[i].cache.expire_due(per_shard);
+    }
+    return expired;
 }
-LFUDB::~LFUDB() { delete cache_; }
 
-// Factory function
-DB* create_db(const std::string& policy, size_t capacity) {
-    if (policy == "ENHANCED") return new EnhancedDB(capacity);
-    if (policy == "LFU") return new LFUDB(capacity);
-    return new LRUDB(capacity);
+ExpiryStats LFUDB::expiry_stats() {
+    ExpiryStats total;
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        std::lock_guard<std::mutex> lock(shards_[i].mutex);
+        total.merge(shards_[i].cache.expiry_stats());
+    }
+    return total;
+}
+
+void LFUDB::set_max_memory(size_t bytes) {
+    size_t per_shard = per_shard_memory(bytes, shards_.size());
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        std::lock_guard<std::mutex> lock(shards_[i].mutex);
+        shards_[i].cache.set_max_memory(per_shard);
+    }
+}
+
+MemoryStats LFUDB::memory_stats() {
+    MemoryStats total;
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        std::lock_guard<std::mutex> lock(shards_[i].mutex);
+        total.merge(shards_[i].cache.memory_stats());
+    }
+    return total;
+}
+
+size_t LFUDB::get_hits() const {
+    size_t total = 0;
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        std::lock_guard<std::mutex> lock(shards_[i].mutex);
+        total += shards_[i].cache.get_hits();
+    }
+    return total;
+}
+size_t LFUDB::get_misses() const {
+    size_t total = 0;
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        std::lock_guard<std::mutex> lock(shards_[i].mutex);
+        total += shards_[i].cache.get_misses();
+    }
+    return total;
 }
+
+AOFLoader::Result replay_aof(DB& db, const std::string& filename, bool repair) {
+    std::vector<std::string> tail;
+    auto rest = [&](const std::vector<std::string_view>& args, size_t from) -> const std::vector<std::string>& {
+        tail.assign(args.begin() + from, args.end());
+        return tail;
+    };
+    
+    auto apply = [&](const std::vector<std::string_view>& args) {
+        std::string_view cmd = args[0];
+        if (cmd == "FLUSHDB") {
+            db.flushdb();
+            return;
+        }
+        if (args.size() < 2) return;
+        std::string key(args[1]);
+        int64_t result;
+        std::string value;
+        
+        if (cmd == "SET" && args.size() == 3) {
+            db.set(key, std::string(args[2]));
+        } else if (cmd == "DEL") {
+            db.del(key);
+        } else if (cmd == "INCR") {
+            db.incr(key, result);
+        } else if (cmd == "DECR") {
+            db.decr(key, result);
+        } else if (cmd == "INCRBY" && args.size() == 3) {
+            db.incrby(key, std::strtoll(std::string(args[2]).c_str(), nullptr, 10), result);
+        } else if (cmd == "LPUSH" && args.size() > 2) {
+            db.lpush(key, rest(args, 2));
+        } else if (cmd == "RPUSH" && args.size() > 2) {
+            db.rpush(key, rest(args, 2));
+        } else if (cmd == "LPOP") {
+            db.lpop(key, value);
+        } else if (cmd == "RPOP") {
+            db.rpop(key, value);
+        } else if (cmd == "SADD" && args.size() > 2) {
+            db.sadd(key, rest(args, 2));
+        } else if (cmd == "SREM" && args.size() > 2) {
+            db.srem(key, rest(args, 2));
+        } else if (cmd == "HSET" && args.size() == 4) {
+            db.hset(key, std::string(args[2]), std::string(args[3]));
+        } else if (cmd == "HDEL" && args.size() > 2) {
+            db.hdel(key, rest(args, 2));
+        } else if (cmd == "ZADD" && args.size() > 3 && args.size() % 2 == 0) {
+            std::vector<std::pair<double, std::string>> members;
+            double score;
+            for (size_t i = 2; i + 1 < args.size(); i += 2) {
+                if (SortedSet::parse_score(std::string(args[i]), score)) members.emplace_back(score, std::string(args[i + 1]));
+            }
+            size_t added;
+            db.zadd(key, members, added);
+        } else if (cmd == "ZINCRBY" && args.size() == 4) {
+            double increment, score;
+            if (SortedSet::parse_score(std::string(args[2]), increment)) db.zincrby(key, increment, std::string(args[3]), score);
+        } else if (cmd == "ZREM" && args.size() > 2) {
+            size_t removed;
+            db.zrem(key, rest(args, 2), removed);
+        } else if (cmd == "PEXPIREAT" && args.size() == 3) {
+            int64_t deadline = std::strtoll(std::string(args[2]).c_str(), nullptr, 10);
+            int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+            if (deadline <= now) {
+                db.del(key);
+            } else {
+                db.expire_at(key, deadline);
+            }
+        }
+    };
+    
+    AOFLoader::Stats stats;
+    auto start = std::chrono::steady_clock::now();
+    AOFLoader::Result status = AOFLoader::load(filename, apply, repair, &stats);
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    
+    switch (status) {
+        case AOFLoader::Result::NOT_FOUND:
+            break;
+        case AOFLoader::Result::OK:
+            std::cerr << "AOF loaded: " << stats.records << " records in " << ms << " ms" << std::endl;
+            break;
+        case AOFLoader::Result::TRUNCATED:
+            std::cerr << "AOF " << filename << " ends in a partial record; loaded " << stats.records
+                      << " records (" << stats.bytes << " bytes)"
+                      << (repair ? ", truncated the rest" : "") << std::endl;
+            break;
+        case AOFLoader::Result::CORRUPT:
+            std::cerr << "AOF " << filename << " is corrupt at offset " << stats.bytes
+                      << " (bad record or checksum); loaded " << stats.records << " records before it" << std::endl;
+            break;
+    }
+    return status;
+}
+
+// Factory function
+DB* create_db(const std::string& policy, size_t capacity, size_t max_memory) {
+    DB* db;
+    if (policy == "ENHANCED") {
+        db = new EnhancedDB(capacity);
+    } else if (policy == "ARC") {
+        db = new ARCDB(capacity);
+    } else if (policy == "TINYLFU") {
+        db = new TinyLFUDB(capacity);
+    } else if (policy == "LFU") {
+        db = new LFUDB(capacity);
+    } else {
+        db = new LRUDB(capacity);
+    }
+    db->set_max_memory(max_memory);
+    return db;
+}
\ No newline at end of file
@@ -0,0 +1,389 @@
+#include "encodings.h"
+#include <algorithm>
+#include <charconv>
+#include <limits>
+#include <cstring>
+#include <new>
+
+EncodingLimits encoding_limits;
+
+namespace {
+
+void append_varint(std::string& out, uint64_t v) {
+    while (v >= 0x80) {
+        out.push_back(static_cast<char>((v & 0x7f) | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<char>(v));
+}
+
+// Reads the length-prefixed string at `offset` and moves past it.
+std::string_view read_string(const std::string& buf, size_t& offset) {
+    uint64_t len = 0;
+    unsigned shift = 0;
+    for (;;) {
+        uint8_t b = static_cast<uint8_t>(buf[offset++]);
+        len |= uint64_t(b & 0x7f) << shift;
+        if (!(b & 0x80)) break;
+        shift += 7;
+    }
+    std::string_view s(buf.data() + offset, static_cast<size_t>(len));
+    offset += static_cast<size_t>(len);
+    return s;
+}
+
+// Parses `text` if it is exactly how the integer would be printed, so the
+// intset can give the member back byte for byte.
+bool canonical_int(std::string_view text, int64_t& value) {
+    if (text.empty() || text.size() > 20) return false;
+    const char* first = text.data();
+    const char* last = first + text.size();
+    auto result = std::from_chars(first, last, value);
+    if (result.ec != std::errc() || result.ptr != last) return false;
+    const char* digits = text[0] == '-' ? first + 1 : first;
+    if (digits == last || (*digits == '0' && (last - digits > 1 || digits != first))) return false;
+    return true;
+}
+
+}
+
+// StringValue
+
+StringValue::StringValue(const StringValue& other) : embedded_size_(other.embedded_size_), encoding_(other.encoding_) {
+    switch (encoding_) {
+        case Encoding::INT: int_ = other.int_; break;
+        case Encoding::EMBSTR: std::memcpy(embedded_, other.embedded_, embedded_size_); break;
+        case Encoding::RAW: new (&raw_) std::string(other.raw_); break;
+    }
+}
+
+StringValue::StringValue(StringValue&& other) noexcept
+    : embedded_size_(other.embedded_size_), encoding_(other.encoding_) {
+    switch (encoding_) {
+        case Encoding::INT: int_ = other.int_; break;
+        case Encoding::EMBSTR: std::memcpy(embedded_, other.embedded_, embedded_size_); break;
+        case Encoding::RAW: new (&raw_) std::string(std::move(other.raw_)); break;
+    }
+}
+
+StringValue& StringValue::operator=(const StringValue& other) {
+    if (this != &other) {
+        if (other.encoding_ == Encoding::RAW) {
+            assign(other.raw_);  // reuses our buffer if we are RAW too
+        } else {
+            release();
+            new (this) StringValue(other);
+        }
+    }
+    return *this;
+}
+
+StringValue& StringValue::operator=(StringValue&& other) noexcept {
+    if (this != &other) {
+        release();
+        new (this) StringValue(std::move(other));
+    }
+    return *this;
+}
+
+void StringValue::release() {
+    if (encoding_ == Encoding::RAW) raw_.~basic_string();
+    encoding_ = Encoding::EMBSTR;
+    embedded_size_ = 0;
+}
+
+size_t StringValue::size() const {
+    switch (encoding_) {
+        case Encoding::INT: {
+            char buf[INT_CHARS];
+            return view(buf).size();
+        }
+        case Encoding::EMBSTR: return embedded_size_;
+        case Encoding::RAW: return raw_.size();
+    }
+    return 0;
+}
+
+void StringValue::assign(std::string_view text) {
+    int64_t value;
+    if (canonical_int(text, value)) {
+        set_int(value);
+    } else if (text.size() <= EMBED_MAX) {
+        release();
+        std::memcpy(embedded_, text.data(), text.size());
+        embedded_size_ = static_cast<uint8_t>(text.size());
+    } else if (encoding_ == Encoding::RAW) {
+        raw_.assign(text.data(), text.size());
+    } else {
+        new (&raw_) std::string(text);
+        encoding_ = Encoding::RAW;
+    }
+}
+
+void StringValue::set_int(int64_t value) {
+    release();
+    int_ = value;
+    encoding_ = Encoding::INT;
+}
+
+bool StringValue::to_int(int64_t& value) const {
+    if (encoding_ == Encoding::INT) {
+        value = int_;
+        return true;
+    }
+    char buf[INT_CHARS];
+    std::string_view text = view(buf);
+    if (text.empty()) return false;
+    auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+    return result.ec == std::errc() && result.ptr == text.data() + text.size();
+}
+
+bool StringValue::incr(int64_t delta, int64_t& result) {
+    int64_t value;
+    if (!to_int(value)) return false;
+    if ((delta > 0 && value > INT64_MAX - delta) || (delta < 0 && value < INT64_MIN - delta)) return false;
+    result = value + delta;
+    if (encoding_ == Encoding::INT) {
+        int_ = result;
+    } else {
+        set_int(result);
+    }
+    return true;
+}
+
+std::string_view StringValue::view(char (&buf)[INT_CHARS]) const {
+    switch (encoding_) {
+        case Encoding::INT: {
+            auto result = std::to_chars(buf, buf + INT_CHARS, int_);
+            return std::string_view(buf, static_cast<size_t>(result.ptr - buf));
+        }
+        case Encoding::EMBSTR: return std::string_view(embedded_, embedded_size_);
+        case Encoding::RAW: return raw_;
+    }
+    return std::string_view();
+}
+
+std::string StringValue::str() const {
+    char buf[INT_CHARS];
+    return std::string(view(buf));
+}
+
+// HashValue
+
+HashValue::HashValue(const HashValue& other)
+    : packed_(other.packed_), count_(other.count_),
+      table_(other.table_ ? new Table(*other.table_) : nullptr), table_bytes_(other.table_bytes_) {}
+
+HashValue& HashValue::operator=(const HashValue& other) {
+    if (this != &other) {
+        HashValue copy(other);
+        *this = std::move(copy);
+    }
+    return *this;
+}
+
+size_t HashValue::find_packed(std::string_view field) const {
+    size_t offset = 0;
+    while (offset < packed_.size()) {
+        size_t entry = offset;
+        std::string_view name = read_string(packed_, offset);
+        read_string(packed_, offset);
+        if (name == field) return entry;
+    }
+    return std::string::npos;
+}
+
+void HashValue::convert_to_table() {
+    std::unique_ptr<Table> table(new Table);
+    table->reserve(count_ + 1);
+    table_bytes_ = 0;
+    for (auto entry : *this) {
+        auto inserted = table->try_emplace(std::string(entry.first), entry.second);
+        table_bytes_ += table_entry_bytes(*inserted.first);
+    }
+    table_ = std::move(table);
+    std::string().swap(packed_);
+    count_ = 0;
+}
+
+bool HashValue::set(const std::string& field, const std::string& value) {
+    if (!table_) {
+        size_t entry = find_packed(field);
+        bool fits = field.size() <= encoding_limits.hash_max_listpack_value &&
+                    value.size() <= encoding_limits.hash_max_listpack_value;
+        if (entry != std::string::npos && fits) {
+            size_t offset = entry;
+            read_string(packed_, offset);
+            size_t value_start = offset;
+            read_string(packed_, offset);
+            std::string encoded;
+            append_varint(encoded, value.size());
+            encoded += value;
+            packed_.replace(value_start, offset - value_start, encoded);
+            return false;
+        }
+        if (entry == std::string::npos && fits && count_ < encoding_limits.hash_max_listpack_entries) {
+            append_varint(packed_, field.size());
+            packed_ += field;
+            append_varint(packed_, value.size());
+            packed_ += value;
+            ++count_;
+            return true;
+        }
+        convert_to_table();
+    }
+    auto it = table_->find(field);
+    if (it != table_->end()) {
+        table_bytes_ -= heap_bytes(it->second);
+        it->second = value;
+        table_bytes_ += heap_bytes(it->second);
+        return false;
+    }
+    it = table_->try_emplace(field, value).first;
+    table_bytes_ += table_entry_bytes(*it);
+    return true;
+}
+
+bool HashValue::get(const std::string& field, std::string& value) const {
+    if (table_) {
+        auto it = table_->find(field);
+        if (it == table_->end()) return false;
+        value = it->second;
+        return true;
+    }
+    size_t offset = find_packed(field);
+    if (offset == std::string::npos) return false;
+    read_string(packed_, offset);
+    value.assign(read_string(packed_, offset));
+    return true;
+}
+
+bool HashValue::erase(const std::string& field) {
+    if (table_) {
+        auto it = table_->find(field);
+        if (it == table_->end()) return false;
+        table_bytes_ -= table_entry_bytes(*it);
+        table_->erase(it);
+        return true;
+    }
+    size_t entry = find_packed(field);
+    if (entry == std::string::npos) return false;
+    size_t offset = entry;
+    read_string(packed_, offset);
+    read_string(packed_, offset);
+    packed_.erase(entry, offset - entry);
+    --count_;
+    return true;
+}
+
+size_t HashValue::table_entry_bytes(const Table::value_type& entry) {
+    return Table::node_bytes() + heap_bytes(entry.first) + heap_bytes(entry.second);
+}
+
+size_t HashValue::memory_usage() const {
+    if (!table_) return heap_bytes(packed_);
+    return sizeof(Table) + table_bytes_ + table_->table_bytes();
+}
+
+HashValue::const_iterator HashValue::begin() const {
+    return table_ ? const_iterator(this, 0, table_->begin()) : const_iterator(this, 0, Table::const_iterator());
+}
+
+HashValue::const_iterator HashValue::end() const {
+    return table_ ? const_iterator(this, 0, table_->end())
+                  : const_iterator(this, packed_.size(), Table::const_iterator());
+}
+
+HashValue::Entry HashValue::const_iterator::operator*() const {
+    if (owner_->table_) return Entry(it_->first, it_->second);
+    size_t offset = offset_;
+    std::string_view field = read_string(owner_->packed_, offset);
+    return Entry(field, read_string(owner_->packed_, offset));
+}
+
+HashValue::const_iterator& HashValue::const_iterator::operator++() {
+    if (owner_->table_) {
+        ++it_;
+    } else {
+        read_string(owner_->packed_, offset_);
+        read_string(owner_->packed_, offset_);
+    }
+    return *this;
+}
+
+// SetValue
+
+SetValue::SetValue(const SetValue& other)
+    : ints_(other.ints_), strings_(other.strings_ ? new Strings(*other.strings_) : nullptr),
+      strings_bytes_(other.strings_bytes_) {}
+
+SetValue& SetValue::operator=(const SetValue& other) {
+    if (this != &other) {
+        SetValue copy(other);
+        *this = std::move(copy);
+    }
+    return *this;
+}
+
+void SetValue::convert_to_strings() {
+    std::unique_ptr<Strings> strings(new Strings);
+    strings_bytes_ = 0;
+    for (int64_t v : ints_) strings_bytes_ += member_bytes(strings->try_emplace(std::to_string(v)).first->first);
+    strings_ = std::move(strings);
+    std::vector<int64_t>().swap(ints_);
+}
+
+bool SetValue::insert(const std::string& member) {
+    if (!strings_) {
+        int64_t v;
+        if (canonical_int(member, v)) {
+            auto it = std::lower_bound(ints_.begin(), ints_.end(), v);
+            if (it != ints_.end() && *it == v) return false;
+            if (ints_.size() < encoding_limits.set_max_intset_entries) {
+                ints_.insert(it, v);
+                return true;
+            }
+        }
+        convert_to_strings();
+    }
+    auto inserted = strings_->try_emplace(member);
+    if (inserted.second) strings_bytes_ += member_bytes(inserted.first->first);
+    return inserted.second;
+}
+
+bool SetValue::contains(const std::string& member) const {
+    if (strings_) return strings_->count(member) > 0;
+    int64_t v;
+    return canonical_int(member, v) && std::binary_search(ints_.begin(), ints_.end(), v);
+}
+
+bool SetValue::erase(const std::string& member) {
+    if (strings_) {
+        auto it = strings_->find(member);
+        if (it == strings_->end()) return false;
+        strings_bytes_ -= member_bytes(it->first);
+        strings_->erase(it);
+        return true;
+    }
+    int64_t v;
+    if (!canonical_int(member, v)) return false;
+    auto it = std::lower_bound(ints_.begin(), ints_.end(), v);
+    if (it == ints_.end() || *it != v) return false;
+    ints_.erase(it);
+    return true;
+}
+
+SetValue::const_iterator SetValue::begin() const {
+    return strings_ ? const_iterator(this, 0, strings_->begin()) : const_iterator(this, 0, Strings::const_iterator());
+}
+
+SetValue::const_iterator SetValue::end() const {
+    return strings_ ? const_iterator(this, 0, strings_->end())
+                    : const_iterator(this, ints_.size(), Strings::const_iterator());
+}
+
+std::string_view SetValue::const_iterator::operator*() const {
+    if (owner_->strings_) return it_->first;
+    auto result = std::to_chars(buf_, buf_ + sizeof(buf_), owner_->ints_[index_]);
+    return std::string_view(buf_, static_cast<size_t>(result.ptr - buf_));
+}
@@ -1,111 +1,219 @@
 #include "enhanced_cache.h"
 #include <algorithm>
 
-EnhancedCache::EnhancedCache(size_t capacity) : capacity_(capacity) {}
+// Keys a write expires in passing, so memory is reclaimed even when
+// nothing calls expire_due().
+static const size_t TOUCH_EXPIRE_BUDGET = 4;
 
-void EnhancedCache::put(const std::string& key, const DataValue& value) {
-    cleanup_expired();
-    
-    auto it = data_.find(key);
-    if (it != data_.end()) {
-        // Update existing key
-        it->second = value;
-        touch(key);
-    } else {
-        // Insert new key
-        data_[key] = value;
-        lru_list_.push_front(key);
-        lru_map_[key] = lru_list_.begin();
-        evict_if_needed();
+EnhancedCache::EnhancedCache(Keyspace& data, size_t capacity, size_t max_memory)
+    : data_(data), capacity_(capacity), max_memory_(max_memory) {}
+
+EnhancedCache::~EnhancedCache() {
+    // The table outlives the cache; its entries must not credit our total.
+    for (auto& item : data_) item.second.charge.detach();
+}
+
+EvictionPolicy parse_eviction_policy(const std::string& name) {
+    if (name == "sampled-lru") return EvictionPolicy::SAMPLED_LRU;
+    if (name == "sampled-lfu") return EvictionPolicy::SAMPLED_LFU;
+    if (name == "arc") return EvictionPolicy::ARC;
+    if (name == "tinylfu") return EvictionPolicy::TINY_LFU;
+    return EvictionPolicy::LRU;
+}
+
+void EnhancedCache::set_eviction_policy(EvictionPolicy policy, size_t samples) {
+    samples_ = std::max<size_t>(samples, 1);
+    if (policy == policy_) return;
+    if (policy_ == EvictionPolicy::ARC) arc_.clear();
+    if (policy_ == EvictionPolicy::TINY_LFU) tiny_lfu_.clear();
+    policy_ = policy;
+    pool_.clear();
+    if (policy_ != EvictionPolicy::LRU) lru_list_.clear();
+    for (auto& item : data_) {
+        item.second.key = &item.first;
+        record_access(item.second, true);
     }
 }
 
-bool EnhancedCache::get(const std::string& key, DataValue& value) {
-    cleanup_expired();
-    
+KeyEntry* EnhancedCache::get(const std::string& key) {
     auto it = data_.find(key);
     if (it != data_.end()) {
-        // Check if expired
-        auto exp_it = expiry_.find(key);
-        if (exp_it != expiry_.end() && std::chrono::steady_clock::now() > exp_it->second) {
-            erase(key);
+        if (drop_if_expired(it, std::chrono::steady_clock::now())) {
             misses_++;
-            return false;
+            return nullptr;
         }
-        
-        value = it->second;
-        touch(key);
+
+        it->second.key = &it->first;
+        record_access(it->second, false);
         hits_++;
-        return true;
+        return &it->second;
     }
-    
+
     misses_++;
-    return false;
+    return nullptr;
 }
 
-void EnhancedCache::erase(const std::string& key) {
+void EnhancedCache::touch(const std::string& key) {
     auto it = data_.find(key);
-    if (it != data_.end()) {
-        data_.erase(it);
-        
-        auto lru_it = lru_map_.find(key);
-        if (lru_it != lru_map_.end()) {
-            lru_list_.erase(lru_it->second);
-            lru_map_.erase(lru_it);
-        }
-        
-        expiry_.erase(key);
-    }
+    if (it == data_.end()) return;
+
+    bool inserted = !it->second.key;
+    it->second.key = &it->first;
+    record_access(it->second, inserted);
+    it->second.charge.charge(used_memory_, entry_bytes(*it));
+    evict_if_needed(it->second);
+    expire_due(TOUCH_EXPIRE_BUDGET);
+}
+
+bool EnhancedCache::expire_if_needed(const std::string& key) {
+    auto it = data_.find(key);
+    return it != data_.end() && drop_if_expired(it, std::chrono::steady_clock::now());
+}
+
+bool EnhancedCache::exists(const std::string& key) {
+    return !expire_if_needed(key) && data_.find(key) != data_.end();
 }
 
-bool EnhancedCache::exists(const std::string& key) const {
+bool EnhancedCache::set_expiry(const std::string& key, int seconds) {
+    return set_expiry_at(key, std::chrono::steady_clock::now() + std::chrono::seconds(seconds));
+}
+
+bool EnhancedCache::set_expiry_at(const std::string& key, std::chrono::steady_clock::time_point when) {
     auto it = data_.find(key);
     if (it == data_.end()) return false;
-    
-    // Check if expired
-    auto exp_it = expiry_.find(key);
-    if (exp_it != expiry_.end() && std::chrono::steady_clock::now() > exp_it->second) {
-        return false;
-    }
-    
+    it->second.key = &it->first;
+    it->second.expires_at = when;
+    expiry_wheel_.schedule(it->second);
     return true;
 }
 
-void EnhancedCache::set_expiry(const std::string& key, int seconds) {
-    if (data_.find(key) != data_.end()) {
-        expiry_[key] = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+size_t EnhancedCache::expire_due(size_t max_keys) {
+    auto now = std::chrono::steady_clock::now();
+    return expiry_wheel_.advance(now, max_keys, [&](KeyEntry& entry) {
+        auto lag = std::chrono::duration_cast<std::chrono::nanoseconds>(now - entry.expires_at);
+        if (lag.count() < 0) lag = std::chrono::nanoseconds(0);
+        expiry_stats_.expired++;
+        expiry_stats_.active_expired++;
+        expiry_stats_.total_lag += lag;
+        expiry_stats_.max_lag = std::max(expiry_stats_.max_lag, lag);
+        data_.erase(data_.find(*entry.key));
+    });
+}
+
+bool EnhancedCache::drop_if_expired(Keyspace::iterator it, std::chrono::steady_clock::time_point now) {
+    if (!is_expired(it->second, now)) return false;
+    expiry_stats_.expired++;
+    data_.erase(it);
+    return true;
+}
+
+bool EnhancedCache::is_expired(const KeyEntry& entry, std::chrono::steady_clock::time_point now) {
+    return static_cast<const ListHook<ExpiryTag>&>(entry).is_linked() && now > entry.expires_at;
+}
+
+size_t EnhancedCache::entry_bytes(const Keyspace::value_type& entry) {
+    return Keyspace::node_bytes() + heap_bytes(entry.first) + entry.second.value.memory_usage();
+}
+
+MemoryStats EnhancedCache::memory_stats() const {
+    MemoryStats stats;
+    stats.used_memory = used_memory_ + data_.table_bytes() + arc_.ghost_bytes() +
+                        tiny_lfu_.sketch_bytes();
+    stats.max_memory = max_memory_;
+    stats.evicted_keys = evicted_keys_;
+    return stats;
+}
+
+bool EnhancedCache::over_limit() const {
+    return data_.size() > capacity_ || (max_memory_ && used_memory_ + data_.table_bytes() > max_memory_);
+}
+
+void EnhancedCache::record_access(KeyEntry& entry, bool inserted) {
+    switch (policy_) {
+        case EvictionPolicy::LRU:
+            lru_list_.push_front(entry);
+            break;
+        case EvictionPolicy::ARC:
+            if (inserted) {
+                arc_.insert(entry, *entry.key, data_.size());
+            } else {
+                arc_.hit(entry);
+            }
+            break;
+        case EvictionPolicy::TINY_LFU:
+            if (inserted) {
+                tiny_lfu_.insert(entry, data_.size());
+            } else {
+                tiny_lfu_.hit(entry, data_.size());
+            }
+            break;
+        case EvictionPolicy::SAMPLED_LRU:
+            entry.access = ++access_clock_ & access_bits::CLOCK_MASK;
+            break;
+        case EvictionPolicy::SAMPLED_LFU: {
+            uint32_t minutes = access_bits::minutes_now();
+            uint32_t counter = access_bits::LFU_INIT;
+            if (!inserted) {
+                double random = std::uniform_real_distribution<double>(0.0, 1.0)(rng_);
+                counter = access_bits::lfu_increment(access_bits::lfu_counter(entry.access, minutes), random);
+            }
+            entry.access = access_bits::lfu_pack(counter, minutes);
+            break;
+        }
     }
 }
 
-void EnhancedCache::touch(const std::string& key) {
-    auto lru_it = lru_map_.find(key);
-    if (lru_it != lru_map_.end()) {
-        lru_list_.erase(lru_it->second);
-        lru_list_.push_front(key);
-        lru_map_[key] = lru_list_.begin();
+uint64_t EnhancedCache::eviction_score(const KeyEntry& entry) const {
+    if (policy_ == EvictionPolicy::SAMPLED_LFU) {
+        return 255 - access_bits::lfu_counter(entry.access, access_bits::minutes_now());
     }
+    return access_bits::lru_idle(entry.access, access_clock_);
 }
 
-void EnhancedCache::cleanup_expired() {
-    auto now = std::chrono::steady_clock::now();
-    auto it = expiry_.begin();
-    while (it != expiry_.end()) {
-        if (now > it->second) {
-            erase(it->first);
-            it = expiry_.erase(it);
-        } else {
-            ++it;
-        }
+Keyspace::iterator EnhancedCache::sampled_victim(const KeyEntry& written) {
+    // Walk the elements from a random slot until `samples_` keys are seen;
+    // keys land in slots by hash, so neighbours are a fair sample.
+    auto it = data_.from_slot(rng_() % data_.bucket_count());
+    size_t seen = 0;
+    for (size_t visited = 0; visited < data_.size() && seen < samples_; ++visited, ++it) {
+        if (it == data_.end()) it = data_.begin();
+        if (&it->second == &written) continue;
+        pool_.offer(it->first, eviction_score(it->second));
+        ++seen;
     }
+
+    while (!pool_.empty()) {
+        EvictionPool::Candidate& best = pool_.best();
+        auto it = data_.find(best.key);
+        // Skip keys deleted or accessed since they were sampled.
+        bool stale = it == data_.end() || &it->second == &written || eviction_score(it->second) < best.score;
+        pool_.pop_best();
+        if (!stale) return it;
+    }
+    return data_.end();
 }
 
-void EnhancedCache::evict_if_needed() {
-    while (data_.size() > capacity_) {
-        if (!lru_list_.empty()) {
-            std::string lru_key = lru_list_.back();
-            erase(lru_key);
+// The entry just written is never evicted by its own write, even when it
+// alone is over the memory limit.
+void EnhancedCache::evict_if_needed(const KeyEntry& written) {
+    while (over_limit()) {
+        Keyspace::iterator victim = data_.end();
+        if (policy_ == EvictionPolicy::LRU) {
+            KeyEntry* lru = lru_list_.back();
+            if (lru && lru != &written) victim = data_.find(*lru->key);
+        } else if (policy_ == EvictionPolicy::ARC) {
+            if (KeyEntry* entry = arc_.victim(written, data_.size())) {
+                victim = data_.find(*entry->key);
+                arc_.evicted(*entry, *entry->key, data_.size() - 1);
+            }
+        } else if (policy_ == EvictionPolicy::TINY_LFU) {
+            if (KeyEntry* entry = tiny_lfu_.victim(written)) victim = data_.find(*entry->key);
         } else {
-            break;
+            victim = sampled_victim(written);
         }
+        if (victim == data_.end()) break;
+        if (evict_hook_) evict_hook_(victim->first);
+        data_.erase(victim);
+        evicted_keys_++;
     }
 }
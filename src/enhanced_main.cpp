@@ -4,6 +4,7 @@
 #include <string>
 #include <vector>
 #include <algorithm>
+#include <cstdint>
 
 void print_help() {
     std::cout << "\n=== Enhanced MyDB CLI Help ===\n\n";
@@ -11,7 +12,9 @@ void print_help() {
     std::cout << "  SET key value         - Set string value\n";
     std::cout << "  GET key              - Get string value\n";
     std::cout << "  INCR key             - Increment integer value\n";
-    std::cout << "  DECR key             - Decrement integer value\n\n";
+    std::cout << "  DECR key             - Decrement integer value\n";
+    std::cout << "  INCRBY key delta     - Add delta to integer value\n";
+    std::cout << "  DECRBY key delta     - Subtract delta from integer value\n\n";
     
     std::cout << "List Commands:\n";
     std::cout << "  LPUSH key val1 val2  - Push values to left of list\n";
@@ -36,6 +39,16 @@ void print_help() {
     std::cout << "  HKEYS key            - Get all hash field names\n";
     std::cout << "  HVALS key            - Get all hash values\n\n";
     
+    std::cout << "Sorted Set Commands:\n";
+    std::cout << "  ZADD key score mem [score mem ...] - Add members with scores\n";
+    std::cout << "  ZINCRBY key incr mem - Increment a member's score\n";
+    std::cout << "  ZREM key mem1 mem2   - Remove members\n";
+    std::cout << "  ZCARD key            - Get number of members\n";
+    std::cout << "  ZSCORE key member    - Get a member's score\n";
+    std::cout << "  ZRANK key member     - Get a member's rank (ZREVRANK: from the top)\n";
+    std::cout << "  ZRANGE key start stop [WITHSCORES] - Get members by rank (ZREVRANGE: from the top)\n";
+    std::cout << "  ZRANGEBYSCORE key min max [WITHSCORES] - Get members by score\n\n";
+    
     std::cout << "General Commands:\n";
     std::cout << "  DEL key1 key2        - Delete keys\n";
     std::cout << "  EXISTS key           - Check if key exists\n";
@@ -43,6 +56,7 @@ void print_help() {
     std::cout << "  KEYS pattern         - Find keys matching pattern\n";
     std::cout << "  EXPIRE key seconds   - Set key expiration\n";
     std::cout << "  SAVE [filename]      - Save database to file\n";
+    std::cout << "  BGSAVE [filename]    - Save database to file in the background\n";
     std::cout << "  LOAD [filename]      - Load database from file\n";
     std::cout << "  FLUSHDB              - Clear all data\n";
     std::cout << "  DBSIZE               - Get number of keys\n";
@@ -51,6 +65,17 @@ void print_help() {
     std::cout << "  QUIT                 - Exit CLI\n\n";
 }
 
+void print_scored(const std::vector<ScoredMember>& result, bool with_scores) {
+    size_t n = 0;
+    for (const auto& member : result) {
+        std::cout << ++n << ") \"" << member.first << "\"\n";
+        if (with_scores) std::cout << ++n << ") \"" << SortedSet::format_score(member.second) << "\"\n";
+    }
+    if (result.empty()) {
+        std::cout << "(empty list or set)\n";
+    }
+}
+
 bool is_integer(const std::string& s) {
     if (s.empty()) return false;
     size_t start = (s[0] == '-') ? 1 : 0;
@@ -70,6 +95,7 @@ void print_data_type_info(DataType type) {
 
 int main() {
     std::unique_ptr<DB> db(create_db("ENHANCED", 1000));
+    replay_aof(*db, AOFWriter::instance().filename());
     
     std::cout << "==================================================\n";
     std::cout << "     Welcome to Enhanced MyDB CLI v2.0!\n";
@@ -140,6 +166,19 @@ int main() {
             } else {
                 std::cout << "ERR value is not an integer or out of range\n";
             }
+        } else if (cmd == "INCRBY" || cmd == "DECRBY") {
+            std::string key;
+            long long delta;
+            if (!(iss >> key >> delta) || (cmd == "DECRBY" && delta == INT64_MIN)) {
+                std::cout << "Usage: " << cmd << " key delta\n";
+                continue;
+            }
+            int64_t result;
+            if (db->incrby(key, cmd == "DECRBY" ? -delta : delta, result)) {
+                std::cout << result << "\n";
+            } else {
+                std::cout << "ERR value is not an integer or out of range\n";
+            }
         } else if (cmd == "LPUSH") {
             std::string key, value;
             iss >> key;
@@ -426,6 +465,123 @@ int main() {
             } else {
                 std::cout << "(empty hash)\n";
             }
+        } else if (cmd == "ZADD") {
+            std::string key, score_str, member;
+            iss >> key;
+            std::vector<std::pair<double, std::string>> members;
+            bool valid = !key.empty();
+            while (valid && iss >> score_str) {
+                double score;
+                valid = (iss >> member) && SortedSet::parse_score(score_str, score);
+                if (valid) members.emplace_back(score, member);
+            }
+            if (!valid || members.empty()) {
+                std::cout << "Usage: ZADD key score member [score member ...]\n";
+                continue;
+            }
+            size_t added;
+            if (db->zadd(key, members, added)) {
+                std::cout << added << "\n";
+            } else {
+                std::cout << "ERR Operation failed\n";
+            }
+        } else if (cmd == "ZINCRBY") {
+            std::string key, increment_str, member;
+            iss >> key >> increment_str >> member;
+            double increment, score;
+            if (member.empty() || !SortedSet::parse_score(increment_str, increment)) {
+                std::cout << "Usage: ZINCRBY key increment member\n";
+                continue;
+            }
+            if (db->zincrby(key, increment, member, score)) {
+                std::cout << "\"" << SortedSet::format_score(score) << "\"\n";
+            } else {
+                std::cout << "ERR Operation failed\n";
+            }
+        } else if (cmd == "ZREM") {
+            std::string key, member;
+            iss >> key;
+            std::vector<std::string> members;
+            while (iss >> member) {
+                members.push_back(member);
+            }
+            if (key.empty() || members.empty()) {
+                std::cout << "Usage: ZREM key member1 [member2 ...]\n";
+                continue;
+            }
+            size_t removed;
+            if (db->zrem(key, members, removed)) {
+                std::cout << removed << "\n";
+            } else {
+                std::cout << "ERR Operation failed\n";
+            }
+        } else if (cmd == "ZCARD") {
+            std::string key;
+            iss >> key;
+            if (key.empty()) {
+                std::cout << "Usage: ZCARD key\n";
+                continue;
+            }
+            size_t count;
+            if (db->zcard(key, count)) {
+                std::cout << count << "\n";
+            } else {
+                std::cout << "0\n";
+            }
+        } else if (cmd == "ZSCORE") {
+            std::string key, member;
+            iss >> key >> member;
+            if (key.empty() || member.empty()) {
+                std::cout << "Usage: ZSCORE key member\n";
+                continue;
+            }
+            double score;
+            if (db->zscore(key, member, score)) {
+                std::cout << "\"" << SortedSet::format_score(score) << "\"\n";
+            } else {
+                std::cout << "(nil)\n";
+            }
+        } else if (cmd == "ZRANK" || cmd == "ZREVRANK") {
+            std::string key, member;
+            iss >> key >> member;
+            if (key.empty() || member.empty()) {
+                std::cout << "Usage: " << cmd << " key member\n";
+                continue;
+            }
+            size_t rank;
+            if (db->zrank(key, member, cmd == "ZREVRANK", rank)) {
+                std::cout << rank << "\n";
+            } else {
+                std::cout << "(nil)\n";
+            }
+        } else if (cmd == "ZRANGE" || cmd == "ZREVRANGE") {
+            std::string key, start_str, stop_str, option;
+            iss >> key >> start_str >> stop_str >> option;
+            std::transform(option.begin(), option.end(), option.begin(), ::toupper);
+            if (key.empty() || stop_str.empty() || (!option.empty() && option != "WITHSCORES")) {
+                std::cout << "Usage: " << cmd << " key start stop [WITHSCORES]\n";
+                continue;
+            }
+            try {
+                std::vector<ScoredMember> result;
+                db->zrange(key, std::stoi(start_str), std::stoi(stop_str), cmd == "ZREVRANGE", result);
+                print_scored(result, !option.empty());
+            } catch (...) {
+                std::cout << "ERR value is not an integer or out of range\n";
+            }
+        } else if (cmd == "ZRANGEBYSCORE") {
+            std::string key, min_str, max_str, option;
+            iss >> key >> min_str >> max_str >> option;
+            std::transform(option.begin(), option.end(), option.begin(), ::toupper);
+            ScoreRange range;
+            if (key.empty() || !SortedSet::parse_range(min_str, max_str, range) ||
+                (!option.empty() && option != "WITHSCORES")) {
+                std::cout << "Usage: ZRANGEBYSCORE key min max [WITHSCORES]\n";
+                continue;
+            }
+            std::vector<ScoredMember> result;
+            db->zrangebyscore(key, range, 0, SIZE_MAX, result);
+            print_scored(result, !option.empty());
         } else if (cmd == "DEL") {
             std::string key;
             int deleted = 0;
@@ -489,13 +645,22 @@ int main() {
         } else if (cmd == "SAVE") {
             std::string filename;
             iss >> filename;
-            if (filename.empty()) filename = "db.json";
+            if (filename.empty()) filename = "db.rdb";
             db->save(filename);
             std::cout << "OK\n";
+        } else if (cmd == "BGSAVE") {
+            std::string filename;
+            iss >> filename;
+            if (filename.empty()) filename = "db.rdb";
+            if (db->bgsave(filename)) {
+                std::cout << "Background saving started\n";
+            } else {
+                std::cout << "ERR Background save already in progress\n";
+            }
         } else if (cmd == "LOAD") {
             std::string filename;
             iss >> filename;
-            if (filename.empty()) filename = "db.json";
+            if (filename.empty()) filename = "db.rdb";
             db->load(filename);
             std::cout << "OK\n";
         } else if (cmd == "FLUSHDB") {
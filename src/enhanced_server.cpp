@@ -1,6 +1,9 @@
 #include "db.h"
 #include "protocol.h"
 #include "pubsub.h"
+#include "reactor.h"
+#include "aof.h"
+#include "command_table.h"
 #include <iostream>
 #include <string>
 #include <thread>
@@ -11,6 +14,10 @@
 #include <curl/curl.h>
 #include <regex>
 #include <mutex>
+#include <algorithm>
+#include <cstdio>
+#include <cstdint>
+#include <charconv>
 
 #ifdef _WIN32
 #include <winsock2.h>
@@ -21,7 +28,12 @@
 #include <unistd.h>
 #endif
 
-#define BUFFER_SIZE 1024
+#define BUFFER_SIZE 16384
+
+// Largest COUNT a SCAN-family call honours: each call holds a shard lock
+// for its whole batch, and a client asking for more simply gets it over
+// more calls.
+static const size_t MAX_SCAN_COUNT = 1000;
 
 struct ServerConfig {
     int port = 6379;
@@ -30,8 +42,59 @@ struct ServerConfig {
     std::string api_key = "";
     std::string password = "";
     bool auth_required = false;
+    std::string io_mode = "epoll";   // "epoll" (reactor) or "threads" (thread per client)
+    int io_threads = 0;              // reactor threads, 0 = one per core
+    bool appendonly = true;
+    std::string appendfilename = "db.aof";
+    std::string appendfsync = "everysec"; // "always", "everysec" or "no"
+    int auto_aof_rewrite_percentage = 100;  // 0 disables automatic rewrites
+    size_t auto_aof_rewrite_min_size = 64 * 1024 * 1024;
+    int hz = 10;                            // active expire cycles per second
+    size_t active_expire_keys = 2000;       // keys one cycle step may expire
+    EncodingLimits encoding;                // when small collections leave their compact encoding
+    size_t maxmemory = 0;                   // bytes of keys and values before eviction, 0 = no limit
+    std::string maxmemory_policy = "lru";   // lru | sampled-lru | sampled-lfu | arc (ENHANCED only)
+    size_t maxmemory_samples = DEFAULT_EVICTION_SAMPLES;  // keys a sampled policy inspects per eviction
 };
 
+// "maxmemory" is a byte count, or a string with a kb/mb/gb suffix as in
+// redis.conf ("512mb").
+size_t parse_memory_size(const nlohmann::json& value) {
+    if (value.is_number()) return value.get<size_t>();
+    std::string text = value.get<std::string>();
+    size_t digits = 0;
+    while (digits < text.size() && std::isdigit(static_cast<unsigned char>(text[digits]))) ++digits;
+    size_t bytes = digits ? std::stoull(text.substr(0, digits)) : 0;
+    std::string unit = text.substr(digits);
+    std::transform(unit.begin(), unit.end(), unit.begin(), ::tolower);
+    if (unit == "k" || unit == "kb") return bytes << 10;
+    if (unit == "m" || unit == "mb") return bytes << 20;
+    if (unit == "g" || unit == "gb") return bytes << 30;
+    return bytes;
+}
+
+// Resident set size of the server process, 0 where it cannot be read.
+size_t process_rss_bytes() {
+#ifdef _WIN32
+    return 0;
+#else
+    std::ifstream statm("/proc/self/statm");
+    size_t pages = 0, resident = 0;
+    statm >> pages >> resident;
+    return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+// The DB `cfg` describes, with its memory limit and eviction policy applied.
+DB* create_configured_db(const ServerConfig& cfg) {
+    DB* db = create_db(cfg.cache_policy, cfg.cache_size, cfg.maxmemory);
+    auto* enhanced = dynamic_cast<EnhancedDB*>(db);
+    if (enhanced && !dynamic_cast<ARCDB*>(db) && !dynamic_cast<TinyLFUDB*>(db)) {
+        enhanced->set_eviction_policy(parse_eviction_policy(cfg.maxmemory_policy), cfg.maxmemory_samples);
+    }
+    return db;
+}
+
 ServerConfig read_config() {
     ServerConfig cfg;
     std::ifstream f("config.json");
@@ -46,109 +109,193 @@ ServerConfig read_config() {
             cfg.password = j["password"];
             cfg.auth_required = !cfg.password.empty();
         }
+        if (j.contains("io_mode")) cfg.io_mode = j["io_mode"];
+        if (j.contains("io_threads")) cfg.io_threads = j["io_threads"];
+        if (j.contains("appendonly")) cfg.appendonly = j["appendonly"];
+        if (j.contains("appendfilename")) cfg.appendfilename = j["appendfilename"];
+        if (j.contains("appendfsync")) cfg.appendfsync = j["appendfsync"];
+        if (j.contains("auto_aof_rewrite_percentage")) cfg.auto_aof_rewrite_percentage = j["auto_aof_rewrite_percentage"];
+        if (j.contains("auto_aof_rewrite_min_size")) cfg.auto_aof_rewrite_min_size = j["auto_aof_rewrite_min_size"];
+        if (j.contains("hz")) cfg.hz = j["hz"];
+        if (j.contains("active_expire_keys")) cfg.active_expire_keys = j["active_expire_keys"];
+        if (j.contains("hash_max_listpack_entries")) cfg.encoding.hash_max_listpack_entries = j["hash_max_listpack_entries"];
+        if (j.contains("hash_max_listpack_value")) cfg.encoding.hash_max_listpack_value = j["hash_max_listpack_value"];
+        if (j.contains("set_max_intset_entries")) cfg.encoding.set_max_intset_entries = j["set_max_intset_entries"];
+        if (j.contains("maxmemory")) cfg.maxmemory = parse_memory_size(j["maxmemory"]);
+        if (j.contains("maxmemory_policy")) cfg.maxmemory_policy = j["maxmemory_policy"];
+        if (j.contains("maxmemory_samples")) cfg.maxmemory_samples = j["maxmemory_samples"];
     }
     return cfg;
 }
 
+// Keys expired per second, measured by the active expire loop.
+std::atomic<double> expired_keys_per_sec(0.0);
+
 class EnhancedCommandHandler {
 private:
     DB* db_;
     PubSubManager* pubsub_;
+    uint64_t client_id_;  // subscriber id of the connection
+    Outbox outbox_;       // delivers its pub/sub messages
     bool authenticated_;
     std::string password_;
 
 public:
-    EnhancedCommandHandler(DB* db, PubSubManager* pubsub, const std::string& password) 
-        : db_(db), pubsub_(pubsub), authenticated_(!password.empty() ? false : true), password_(password) {}
+    EnhancedCommandHandler(DB* db, PubSubManager* pubsub, uint64_t client_id, Outbox outbox,
+                           const std::string& password) 
+        : db_(db), pubsub_(pubsub), client_id_(client_id), outbox_(std::move(outbox)),
+          authenticated_(!password.empty() ? false : true), password_(password) {}
     
-    std::string handle_command(const std::string& input, int client_socket) {
-        auto cmd = CommandParser::parse(input);
+    std::string handle_command(const CommandParser::Command& cmd) {
+        const CommandSpec* spec = find_command(cmd.name);
+        if (!spec) {
+            return ResponseFormatter::error("unknown command '" + cmd.name + "'");
+        }
         
         // Authentication check
-        if (!password_.empty() && !authenticated_ && cmd.name != "AUTH") {
+        if (!password_.empty() && !authenticated_ && !(spec->flags & CMD_NO_AUTH)) {
             return ResponseFormatter::error("NOAUTH Authentication required");
         }
         
-        if (cmd.name == "AUTH") {
+        if (!spec->accepts(cmd.args.size() + 1)) {
+            std::string name(spec->name);
+            std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+            return ResponseFormatter::error("wrong number of arguments for '" + name + "' command");
+        }
+        
+        // Writes are refused while the AOF cannot be written, and one whose
+        // own record did not reach the disk is not acknowledged.
+        bool logged = spec->flags & CMD_WRITE;
+        if (logged && AOFWriter::instance().write_failed()) {
+            return ResponseFormatter::error("MISCONF Errors writing to the AOF file");
+        }
+        AOFCommit::take_durable();
+        std::string reply = run_command(*spec, cmd);
+        if (logged && !AOFCommit::take_durable()) {
+            return ResponseFormatter::error("MISCONF Errors writing to the AOF file");
+        }
+        return reply;
+    }
+
+private:
+    std::string run_command(const CommandSpec& spec, const CommandParser::Command& cmd) {
+        switch (spec.id) {
+        case CommandId::AUTH:
             return handle_auth(cmd);
-        } else if (cmd.name == "SET") {
+        case CommandId::SET:
             return handle_set(cmd);
-        } else if (cmd.name == "GET") {
+        case CommandId::GET:
             return handle_get(cmd);
-        } else if (cmd.name == "DEL") {
+        case CommandId::DEL:
             return handle_del(cmd);
-        } else if (cmd.name == "EXISTS") {
+        case CommandId::EXISTS:
             return handle_exists(cmd);
-        } else if (cmd.name == "TYPE") {
+        case CommandId::TYPE:
             return handle_type(cmd);
-        } else if (cmd.name == "KEYS") {
+        case CommandId::KEYS:
             return handle_keys(cmd);
-        } else if (cmd.name == "INCR") {
+        case CommandId::SCAN:
+            return handle_scan(cmd);
+        case CommandId::INCR:
             return handle_incr(cmd);
-        } else if (cmd.name == "DECR") {
+        case CommandId::DECR:
             return handle_decr(cmd);
-        } else if (cmd.name == "LPUSH") {
+        case CommandId::INCRBY:
+            return handle_incrby(cmd, false);
+        case CommandId::DECRBY:
+            return handle_incrby(cmd, true);
+        case CommandId::LPUSH:
             return handle_lpush(cmd);
-        } else if (cmd.name == "RPUSH") {
+        case CommandId::RPUSH:
             return handle_rpush(cmd);
-        } else if (cmd.name == "LPOP") {
+        case CommandId::LPOP:
             return handle_lpop(cmd);
-        } else if (cmd.name == "RPOP") {
+        case CommandId::RPOP:
             return handle_rpop(cmd);
-        } else if (cmd.name == "LLEN") {
+        case CommandId::LLEN:
             return handle_llen(cmd);
-        } else if (cmd.name == "LRANGE") {
+        case CommandId::LRANGE:
             return handle_lrange(cmd);
-        } else if (cmd.name == "SADD") {
+        case CommandId::SADD:
             return handle_sadd(cmd);
-        } else if (cmd.name == "SREM") {
+        case CommandId::SREM:
             return handle_srem(cmd);
-        } else if (cmd.name == "SMEMBERS") {
+        case CommandId::SMEMBERS:
             return handle_smembers(cmd);
-        } else if (cmd.name == "SCARD") {
+        case CommandId::SCARD:
             return handle_scard(cmd);
-        } else if (cmd.name == "SISMEMBER") {
+        case CommandId::SISMEMBER:
             return handle_sismember(cmd);
-        } else if (cmd.name == "HSET") {
+        case CommandId::SSCAN:
+            return handle_sscan(cmd);
+        case CommandId::HSET:
             return handle_hset(cmd);
-        } else if (cmd.name == "HGET") {
+        case CommandId::HGET:
             return handle_hget(cmd);
-        } else if (cmd.name == "HDEL") {
+        case CommandId::HDEL:
             return handle_hdel(cmd);
-        } else if (cmd.name == "HGETALL") {
+        case CommandId::HGETALL:
             return handle_hgetall(cmd);
-        } else if (cmd.name == "HKEYS") {
+        case CommandId::HKEYS:
             return handle_hkeys(cmd);
-        } else if (cmd.name == "HVALS") {
+        case CommandId::HVALS:
             return handle_hvals(cmd);
-        } else if (cmd.name == "SAVE") {
+        case CommandId::HSCAN:
+            return handle_hscan(cmd);
+        case CommandId::ZADD:
+            return handle_zadd(cmd);
+        case CommandId::ZINCRBY:
+            return handle_zincrby(cmd);
+        case CommandId::ZREM:
+            return handle_zrem(cmd);
+        case CommandId::ZCARD:
+            return handle_zcard(cmd);
+        case CommandId::ZSCORE:
+            return handle_zscore(cmd);
+        case CommandId::ZRANK:
+            return handle_zrank(cmd, false);
+        case CommandId::ZREVRANK:
+            return handle_zrank(cmd, true);
+        case CommandId::ZRANGE:
+            return handle_zrange(cmd, false);
+        case CommandId::ZREVRANGE:
+            return handle_zrange(cmd, true);
+        case CommandId::ZRANGEBYSCORE:
+            return handle_zrangebyscore(cmd);
+        case CommandId::ZSCAN:
+            return handle_zscan(cmd);
+        case CommandId::SAVE:
             return handle_save(cmd);
-        } else if (cmd.name == "LOAD") {
+        case CommandId::LOAD:
             return handle_load(cmd);
-        } else if (cmd.name == "EXPIRE") {
+        case CommandId::BGSAVE:
+            return handle_bgsave(cmd);
+        case CommandId::BGREWRITEAOF:
+            return handle_bgrewriteaof(cmd);
+        case CommandId::EXPIRE:
             return handle_expire(cmd);
-        } else if (cmd.name == "FLUSHDB") {
+        case CommandId::FLUSHDB:
             return handle_flushdb(cmd);
-        } else if (cmd.name == "DBSIZE") {
+        case CommandId::DBSIZE:
             return handle_dbsize(cmd);
-        } else if (cmd.name == "INFO") {
+        case CommandId::INFO:
             return handle_info(cmd);
-        } else if (cmd.name == "PING") {
+        case CommandId::PING:
             return handle_ping(cmd);
-        } else if (cmd.name == "SUBSCRIBE") {
-            return handle_subscribe(cmd, client_socket);
-        } else if (cmd.name == "UNSUBSCRIBE") {
-            return handle_unsubscribe(cmd, client_socket);
-        } else if (cmd.name == "PUBLISH") {
+        case CommandId::SUBSCRIBE:
+            return handle_subscribe(cmd);
+        case CommandId::UNSUBSCRIBE:
+            return handle_unsubscribe(cmd);
+        case CommandId::PUBLISH:
             return handle_publish(cmd);
-        } else if (cmd.name == "QUIT") {
+        case CommandId::QUIT:
             return "QUIT";
-        } else {
-            return ResponseFormatter::error("unknown command '" + cmd.name + "'");
+        case CommandId::COUNT:
+            break;
         }
+        return ResponseFormatter::error("unknown command '" + cmd.name + "'");
     }
 
-private:
     std::string handle_auth(const CommandParser::Command& cmd) {
         if (cmd.args.size() != 1) {
             return ResponseFormatter::error("wrong number of arguments for 'auth' command");
@@ -230,6 +377,57 @@ private:
         return ResponseFormatter::array(keys);
     }
 
+    // Arguments of the SCAN family from args[first] on:
+    // cursor [MATCH pattern] [COUNT count]. Returns an error reply, or an
+    // empty string if they parse.
+    static std::string parse_scan_args(const std::vector<std::string>& args, size_t first,
+                                       uint64_t& cursor, std::string& pattern, size_t& count) {
+        const std::string& text = args[first];
+        auto parsed = std::from_chars(text.data(), text.data() + text.size(), cursor);
+        if (text.empty() || parsed.ec != std::errc() || parsed.ptr != text.data() + text.size()) {
+            return ResponseFormatter::error("invalid cursor");
+        }
+        pattern = "*";
+        count = 10;
+        for (size_t i = first + 1; i < args.size(); i += 2) {
+            if (i + 1 == args.size()) return ResponseFormatter::error("syntax error");
+            if (is_option(args[i], "MATCH")) {
+                pattern = args[i + 1];
+            } else if (is_option(args[i], "COUNT")) {
+                const std::string& value = args[i + 1];
+                auto end = value.data() + value.size();
+                if (std::from_chars(value.data(), end, count).ptr != end || value.empty()) {
+                    return ResponseFormatter::error("value is not an integer or out of range");
+                }
+                if (count < 1) return ResponseFormatter::error("syntax error");
+                count = std::min(count, MAX_SCAN_COUNT);
+            } else {
+                return ResponseFormatter::error("syntax error");
+            }
+        }
+        return std::string();
+    }
+
+    // The two-element SCAN reply: next cursor, then the items.
+    static std::string scan_reply(uint64_t cursor, const std::vector<std::string>& items) {
+        return "*2\r\n" + ResponseFormatter::bulk_string(std::to_string(cursor)) + ResponseFormatter::array(items);
+    }
+
+    // SCAN cursor [MATCH pattern] [COUNT count]
+    std::string handle_scan(const CommandParser::Command& cmd) {
+        if (cmd.args.empty()) {
+            return ResponseFormatter::error("wrong number of arguments for 'scan' command");
+        }
+        uint64_t cursor;
+        std::string pattern;
+        size_t count;
+        std::string error = parse_scan_args(cmd.args, 0, cursor, pattern, count);
+        if (!error.empty()) return error;
+        std::vector<std::string> keys;
+        cursor = db_->scan(cursor, count, pattern, keys);
+        return scan_reply(cursor, keys);
+    }
+
     std::string handle_incr(const CommandParser::Command& cmd) {
         if (cmd.args.size() != 1) {
             return ResponseFormatter::error("wrong number of arguments for 'incr' command");
@@ -252,6 +450,28 @@ private:
         return ResponseFormatter::error("value is not an integer or out of range");
     }
 
+    std::string handle_incrby(const CommandParser::Command& cmd, bool negate) {
+        if (cmd.args.size() != 2) {
+            return ResponseFormatter::error(std::string("wrong number of arguments for '") +
+                                            (negate ? "decrby" : "incrby") + "' command");
+        }
+        
+        int64_t delta = 0, result;
+        size_t used = 0;
+        try {
+            delta = std::stoll(cmd.args[1], &used);
+        } catch (...) {
+            used = 0;
+        }
+        if (used == 0 || used != cmd.args[1].size() || (negate && delta == INT64_MIN)) {
+            return ResponseFormatter::error("value is not an integer or out of range");
+        }
+        if (db_->incrby(cmd.args[0], negate ? -delta : delta, result)) {
+            return ResponseFormatter::integer(result);
+        }
+        return ResponseFormatter::error("value is not an integer or out of range");
+    }
+
     std::string handle_lpush(const CommandParser::Command& cmd) {
         if (cmd.args.size() < 2) {
             return ResponseFormatter::error("wrong number of arguments for 'lpush' command");
@@ -383,6 +603,21 @@ private:
         return ResponseFormatter::integer(is_member ? 1 : 0);
     }
 
+    // SSCAN key cursor [MATCH pattern] [COUNT count]
+    std::string handle_sscan(const CommandParser::Command& cmd) {
+        if (cmd.args.size() < 2) {
+            return ResponseFormatter::error("wrong number of arguments for 'sscan' command");
+        }
+        uint64_t cursor;
+        std::string pattern;
+        size_t count;
+        std::string error = parse_scan_args(cmd.args, 1, cursor, pattern, count);
+        if (!error.empty()) return error;
+        std::vector<std::string> members;
+        cursor = db_->sscan(cmd.args[0], cursor, count, pattern, members);
+        return scan_reply(cursor, members);
+    }
+
     std::string handle_hset(const CommandParser::Command& cmd) {
         if (cmd.args.size() != 3) {
             return ResponseFormatter::error("wrong number of arguments for 'hset' command");
@@ -453,18 +688,235 @@ private:
         return ResponseFormatter::array({});
     }
 
+    // HSCAN key cursor [MATCH pattern] [COUNT count]
+    std::string handle_hscan(const CommandParser::Command& cmd) {
+        if (cmd.args.size() < 2) {
+            return ResponseFormatter::error("wrong number of arguments for 'hscan' command");
+        }
+        uint64_t cursor;
+        std::string pattern;
+        size_t count;
+        std::string error = parse_scan_args(cmd.args, 1, cursor, pattern, count);
+        if (!error.empty()) return error;
+        std::vector<std::pair<std::string, std::string>> fields;
+        cursor = db_->hscan(cmd.args[0], cursor, count, pattern, fields);
+        std::vector<std::string> items;
+        items.reserve(fields.size() * 2);
+        for (auto& field : fields) {
+            items.push_back(std::move(field.first));
+            items.push_back(std::move(field.second));
+        }
+        return scan_reply(cursor, items);
+    }
+
+    static bool is_option(const std::string& arg, const char* option) {
+        std::string upper = arg;
+        std::transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
+        return upper == option;
+    }
+
+    static std::string scored_array(const std::vector<ScoredMember>& members, bool with_scores) {
+        std::vector<std::string> items;
+        items.reserve(members.size() * (with_scores ? 2 : 1));
+        for (const auto& member : members) {
+            items.push_back(member.first);
+            if (with_scores) items.push_back(SortedSet::format_score(member.second));
+        }
+        return ResponseFormatter::array(items);
+    }
+
+    std::string handle_zadd(const CommandParser::Command& cmd) {
+        if (cmd.args.size() < 3 || cmd.args.size() % 2 == 0) {
+            return ResponseFormatter::error("wrong number of arguments for 'zadd' command");
+        }
+        std::vector<std::pair<double, std::string>> members;
+        for (size_t i = 1; i < cmd.args.size(); i += 2) {
+            double score;
+            if (!SortedSet::parse_score(cmd.args[i], score)) {
+                return ResponseFormatter::error("value is not a valid float");
+            }
+            members.emplace_back(score, cmd.args[i + 1]);
+        }
+        size_t added;
+        if (db_->zadd(cmd.args[0], members, added)) {
+            return ResponseFormatter::integer(added);
+        }
+        return ResponseFormatter::error("operation failed");
+    }
+
+    std::string handle_zincrby(const CommandParser::Command& cmd) {
+        if (cmd.args.size() != 3) {
+            return ResponseFormatter::error("wrong number of arguments for 'zincrby' command");
+        }
+        double increment, score;
+        if (!SortedSet::parse_score(cmd.args[1], increment)) {
+            return ResponseFormatter::error("value is not a valid float");
+        }
+        if (db_->zincrby(cmd.args[0], increment, cmd.args[2], score)) {
+            return ResponseFormatter::bulk_string(SortedSet::format_score(score));
+        }
+        return ResponseFormatter::error("operation failed");
+    }
+
+    std::string handle_zrem(const CommandParser::Command& cmd) {
+        if (cmd.args.size() < 2) {
+            return ResponseFormatter::error("wrong number of arguments for 'zrem' command");
+        }
+        std::vector<std::string> members(cmd.args.begin() + 1, cmd.args.end());
+        size_t removed;
+        if (db_->zrem(cmd.args[0], members, removed)) {
+            return ResponseFormatter::integer(removed);
+        }
+        return ResponseFormatter::error("operation failed");
+    }
+
+    std::string handle_zcard(const CommandParser::Command& cmd) {
+        if (cmd.args.size() != 1) {
+            return ResponseFormatter::error("wrong number of arguments for 'zcard' command");
+        }
+        size_t count;
+        if (db_->zcard(cmd.args[0], count)) {
+            return ResponseFormatter::integer(count);
+        }
+        return ResponseFormatter::integer(0);
+    }
+
+    std::string handle_zscore(const CommandParser::Command& cmd) {
+        if (cmd.args.size() != 2) {
+            return ResponseFormatter::error("wrong number of arguments for 'zscore' command");
+        }
+        double score;
+        if (db_->zscore(cmd.args[0], cmd.args[1], score)) {
+            return ResponseFormatter::bulk_string(SortedSet::format_score(score));
+        }
+        return ResponseFormatter::nil();
+    }
+
+    std::string handle_zrank(const CommandParser::Command& cmd, bool reverse) {
+        if (cmd.args.size() != 2) {
+            return ResponseFormatter::error(std::string("wrong number of arguments for '") +
+                                            (reverse ? "zrevrank" : "zrank") + "' command");
+        }
+        size_t rank;
+        if (db_->zrank(cmd.args[0], cmd.args[1], reverse, rank)) {
+            return ResponseFormatter::integer(rank);
+        }
+        return ResponseFormatter::nil();
+    }
+
+    std::string handle_zrange(const CommandParser::Command& cmd, bool reverse) {
+        bool with_scores = cmd.args.size() == 4 && is_option(cmd.args[3], "WITHSCORES");
+        if (cmd.args.size() != 3 && !with_scores) {
+            return ResponseFormatter::error(std::string("wrong number of arguments for '") +
+                                            (reverse ? "zrevrange" : "zrange") + "' command");
+        }
+        
+        try {
+            int start = std::stoi(cmd.args[1]);
+            int stop = std::stoi(cmd.args[2]);
+            std::vector<ScoredMember> result;
+            if (db_->zrange(cmd.args[0], start, stop, reverse, result)) {
+                return scored_array(result, with_scores);
+            }
+            return ResponseFormatter::array({});
+        } catch (...) {
+            return ResponseFormatter::error("value is not an integer or out of range");
+        }
+    }
+
+    // ZSCAN key cursor [MATCH pattern] [COUNT count]
+    std::string handle_zscan(const CommandParser::Command& cmd) {
+        if (cmd.args.size() < 2) {
+            return ResponseFormatter::error("wrong number of arguments for 'zscan' command");
+        }
+        uint64_t cursor;
+        std::string pattern;
+        size_t count;
+        std::string error = parse_scan_args(cmd.args, 1, cursor, pattern, count);
+        if (!error.empty()) return error;
+        std::vector<ScoredMember> members;
+        cursor = db_->zscan(cmd.args[0], cursor, count, pattern, members);
+        std::vector<std::string> items;
+        items.reserve(members.size() * 2);
+        for (const auto& member : members) {
+            items.push_back(member.first);
+            items.push_back(SortedSet::format_score(member.second));
+        }
+        return scan_reply(cursor, items);
+    }
+
+    // ZRANGEBYSCORE key min max [WITHSCORES] [LIMIT offset count]
+    std::string handle_zrangebyscore(const CommandParser::Command& cmd) {
+        if (cmd.args.size() < 3) {
+            return ResponseFormatter::error("wrong number of arguments for 'zrangebyscore' command");
+        }
+        ScoreRange range;
+        if (!SortedSet::parse_range(cmd.args[1], cmd.args[2], range)) {
+            return ResponseFormatter::error("min or max is not a float");
+        }
+        
+        bool with_scores = false;
+        size_t offset = 0;
+        size_t count = SIZE_MAX;
+        for (size_t i = 3; i < cmd.args.size(); ++i) {
+            if (is_option(cmd.args[i], "WITHSCORES")) {
+                with_scores = true;
+            } else if (is_option(cmd.args[i], "LIMIT") && i + 2 < cmd.args.size()) {
+                try {
+                    long long first = std::stoll(cmd.args[i + 1]);
+                    long long limit = std::stoll(cmd.args[i + 2]);
+                    if (first < 0) return ResponseFormatter::array({});
+                    offset = static_cast<size_t>(first);
+                    count = limit < 0 ? SIZE_MAX : static_cast<size_t>(limit);
+                } catch (...) {
+                    return ResponseFormatter::error("value is not an integer or out of range");
+                }
+                i += 2;
+            } else {
+                return ResponseFormatter::error("syntax error");
+            }
+        }
+        
+        std::vector<ScoredMember> result;
+        if (db_->zrangebyscore(cmd.args[0], range, offset, count, result)) {
+            return scored_array(result, with_scores);
+        }
+        return ResponseFormatter::array({});
+    }
+
     std::string handle_save(const CommandParser::Command& cmd) {
-        std::string filename = cmd.args.empty() ? "db.json" : cmd.args[0];
+        if (db_->bgsave_status().in_progress) {
+            return ResponseFormatter::error("Background save already in progress");
+        }
+        std::string filename = cmd.args.empty() ? "db.rdb" : cmd.args[0];
         db_->save(filename);
         return ResponseFormatter::ok();
     }
 
     std::string handle_load(const CommandParser::Command& cmd) {
-        std::string filename = cmd.args.empty() ? "db.json" : cmd.args[0];
+        std::string filename = cmd.args.empty() ? "db.rdb" : cmd.args[0];
         db_->load(filename);
         return ResponseFormatter::ok();
     }
 
+    std::string handle_bgsave(const CommandParser::Command& cmd) {
+        std::string filename = cmd.args.empty() ? "db.rdb" : cmd.args[0];
+        if (!db_->bgsave(filename)) {
+            return ResponseFormatter::error("Background save already in progress");
+        }
+        return ResponseFormatter::simple_string("Background saving started");
+    }
+
+    std::string handle_bgrewriteaof(const CommandParser::Command& cmd) {
+        if (!AOFWriter::instance().enabled()) {
+            return ResponseFormatter::error("append only file is disabled");
+        }
+        if (!AOFWriter::instance().start_rewrite()) {
+            return ResponseFormatter::error("Background append only file rewriting already in progress");
+        }
+        return ResponseFormatter::simple_string("Background append only file rewriting started");
+    }
+
     std::string handle_expire(const CommandParser::Command& cmd) {
         if (cmd.args.size() != 2) {
             return ResponseFormatter::error("wrong number of arguments for 'expire' command");
@@ -501,6 +953,72 @@ private:
             info += "keyspace_misses:" + std::to_string(enhanced_db->get_misses()) + "\r\n";
         }
         
+        if (auto* arc_db = dynamic_cast<ARCDB*>(db_)) {
+            ARCStats arc = arc_db->arc_stats();
+            char latency_str[32];
+            snprintf(latency_str, sizeof(latency_str), "%.6f", arc_db->get_avg_hit_latency());
+            info += "# ARC\r\n";
+            info += "arc_target_recent:" + std::to_string(arc.target_t1) + "\r\n";
+            info += "arc_frequent_keys:" + std::to_string(arc.frequent) + "\r\n";
+            info += "arc_ghost_keys:" + std::to_string(arc.ghosts) + "\r\n";
+            info += "arc_avg_hit_latency_ms:" + std::string(latency_str) + "\r\n";
+            info += "arc_evictions:" + std::to_string(arc_db->get_eviction_count()) + "\r\n";
+        }
+
+        if (auto* tiny_lfu_db = dynamic_cast<TinyLFUDB*>(db_)) {
+            TinyLFUStats tiny_lfu = tiny_lfu_db->tiny_lfu_stats();
+            info += "# TinyLFU\r\n";
+            info += "tinylfu_window_keys:" + std::to_string(tiny_lfu.window) + "\r\n";
+            info += "tinylfu_protected_keys:" + std::to_string(tiny_lfu.protected_) + "\r\n";
+            info += "tinylfu_admitted:" + std::to_string(tiny_lfu.admitted) + "\r\n";
+            info += "tinylfu_rejected:" + std::to_string(tiny_lfu.rejected) + "\r\n";
+            info += "tinylfu_evictions:" + std::to_string(tiny_lfu_db->memory_stats().evicted_keys) + "\r\n";
+        }
+        
+        MemoryStats memory = db_->memory_stats();
+        size_t rss = process_rss_bytes();
+        char ratio_str[32];
+        snprintf(ratio_str, sizeof(ratio_str), "%.2f", memory.used_memory ? static_cast<double>(rss) / memory.used_memory : 0.0);
+        info += "# Memory\r\n";
+        info += "used_memory:" + std::to_string(memory.used_memory) + "\r\n";
+        info += "used_memory_rss:" + std::to_string(rss) + "\r\n";
+        info += "maxmemory:" + std::to_string(memory.max_memory) + "\r\n";
+        info += "mem_fragmentation_ratio:" + std::string(ratio_str) + "\r\n";
+        info += "evicted_keys:" + std::to_string(memory.evicted_keys) + "\r\n";
+        
+        ExpiryStats expiry = db_->expiry_stats();
+        double lag_avg_ms = expiry.active_expired ? expiry.total_lag.count() / 1e6 / expiry.active_expired : 0.0;
+        char expiry_str[128];
+        snprintf(expiry_str, sizeof(expiry_str),
+                 "expired_keys_per_sec:%.2f\r\nexpire_lag_avg_ms:%.3f\r\nexpire_lag_max_ms:%.3f\r\n",
+                 expired_keys_per_sec.load(), lag_avg_ms, expiry.max_lag.count() / 1e6);
+        info += "# Expiry\r\n";
+        info += "expired_keys:" + std::to_string(expiry.expired) + "\r\n";
+        info += "expired_keys_active:" + std::to_string(expiry.active_expired) + "\r\n";
+        info += expiry_str;
+        
+        AOFWriter::Status aof = AOFWriter::instance().status();
+        info += "# Persistence\r\n";
+        info += "aof_enabled:" + std::string(AOFWriter::instance().enabled() ? "1" : "0") + "\r\n";
+        info += "aof_rewrite_in_progress:" + std::string(aof.rewrite_in_progress ? "1" : "0") + "\r\n";
+        info += "aof_rewrites:" + std::to_string(aof.rewrites) + "\r\n";
+        info += "aof_last_bgrewrite_status:" + std::string(aof.last_rewrite_ok ? "ok" : "err") + "\r\n";
+        info += "aof_last_write_status:" + std::string(aof.last_write_ok ? "ok" : "err") + "\r\n";
+        info += "aof_current_size:" + std::to_string(aof.current_size) + "\r\n";
+        info += "aof_base_size:" + std::to_string(aof.base_size) + "\r\n";
+        
+        BackgroundSave::Status rdb = db_->bgsave_status();
+        double progress = rdb.keys_total ? 100.0 * rdb.keys_saved / rdb.keys_total : 0.0;
+        char progress_str[16];
+        snprintf(progress_str, sizeof(progress_str), "%.2f", rdb.in_progress ? std::min(progress, 100.0) : 0.0);
+        info += "rdb_bgsave_in_progress:" + std::string(rdb.in_progress ? "1" : "0") + "\r\n";
+        info += "rdb_saves:" + std::to_string(rdb.saves) + "\r\n";
+        info += "rdb_last_save_time:" + std::to_string(rdb.last_save_time) + "\r\n";
+        info += "rdb_last_bgsave_status:" + std::string(rdb.last_ok ? "ok" : "err") + "\r\n";
+        info += "rdb_last_bgsave_time_sec:" + std::to_string(static_cast<long long>(rdb.last_duration + 0.5)) + "\r\n";
+        info += "rdb_current_bgsave_keys_saved:" + std::to_string(rdb.in_progress ? rdb.keys_saved : 0) + "\r\n";
+        info += "rdb_current_bgsave_progress:" + std::string(progress_str) + "%\r\n";
+        
         return ResponseFormatter::bulk_string(info);
     }
 
@@ -512,13 +1030,13 @@ private:
         }
     }
 
-    std::string handle_subscribe(const CommandParser::Command& cmd, int client_socket) {
+    std::string handle_subscribe(const CommandParser::Command& cmd) {
         if (cmd.args.empty()) {
             return ResponseFormatter::error("wrong number of arguments for 'subscribe' command");
         }
         
         for (const auto& channel : cmd.args) {
-            pubsub_->subscribe(channel, client_socket);
+            pubsub_->subscribe(channel, client_id_, outbox_);
         }
         
         // Return subscription confirmation
@@ -526,13 +1044,13 @@ private:
         return ResponseFormatter::array(response);
     }
 
-    std::string handle_unsubscribe(const CommandParser::Command& cmd, int client_socket) {
+    std::string handle_unsubscribe(const CommandParser::Command& cmd) {
         if (cmd.args.empty()) {
             return ResponseFormatter::error("wrong number of arguments for 'unsubscribe' command");
         }
         
         for (const auto& channel : cmd.args) {
-            pubsub_->unsubscribe(channel, client_socket);
+            pubsub_->unsubscribe(channel, client_id_);
         }
         
         // Return unsubscription confirmation
@@ -545,40 +1063,119 @@ private:
             return ResponseFormatter::error("wrong number of arguments for 'publish' command");
         }
         
-        pubsub_->publish(cmd.args[0], cmd.args[1]);
-        return ResponseFormatter::integer(1); // Simplified: always return 1
+        size_t receivers = pubsub_->publish(cmd.args[0], cmd.args[1]);
+        return ResponseFormatter::integer(static_cast<int64_t>(receivers));
+    }
+};
+
+// Per-client session: parses pipelined RESP (or inline) requests straight
+// out of the connection buffer and executes them in order.
+class ClientSession : public Session {
+public:
+    ClientSession(Outbox outbox, DB* db, PubSubManager* pubsub, const std::string& password)
+        : id_(++next_id_), pubsub_(pubsub), handler_(db, pubsub, id_, std::move(outbox), password) {}
+    // The connection is closing: nothing may be posted to it any more.
+    ~ClientSession() override { pubsub_->unsubscribe_all(id_); }
+
+    bool on_data(std::string& input, std::string& output) override {
+        size_t pos = 0;
+        bool keep_open = true;
+
+        while (keep_open && pos < input.size()) {
+            size_t consumed = 0;
+            auto status = parser_.parse(input.data() + pos, input.size() - pos, argv_, consumed);
+            if (status == RequestParser::Status::INCOMPLETE) break;
+            if (status == RequestParser::Status::ERROR) {
+                output += ResponseFormatter::error("Protocol error: " + parser_.error());
+                input.clear();
+                return false;
+            }
+            pos += consumed;
+            if (argv_.empty()) continue;
+
+            CommandParser::assign(cmd_, argv_);
+            std::string response = handler_.handle_command(cmd_);
+            if (response == "QUIT") {
+                keep_open = false;
+                break;
+            }
+            output += response;
+        }
+
+        input.erase(0, pos);
+        return keep_open;
+    }
+
+private:
+    static std::atomic<uint64_t> next_id_;
+    uint64_t id_;
+    PubSubManager* pubsub_;
+    EnhancedCommandHandler handler_;
+    RequestParser parser_;
+    std::vector<std::string_view> argv_;
+    CommandParser::Command cmd_;
+};
+
+std::atomic<uint64_t> ClientSession::next_id_(0);
+
+// Blocking socket of a thread-per-connection client. Replies and messages
+// posted by other threads are sent under one mutex so they never
+// interleave, and nothing is sent once the connection has closed.
+struct BlockingClient {
+    int fd;
+    std::mutex mutex;
+    bool open = true;
+    
+    explicit BlockingClient(int client_sock) : fd(client_sock) {}
+    
+    // Call with `mutex` held.
+    void send_all(const std::string& data) {
+        size_t sent = 0;
+        while (open && sent < data.size()) {
+            int n = send(fd, data.data() + sent, data.size() - sent, 0);
+            if (n <= 0) break;
+            sent += n;
+        }
+    }
+    
+    Outbox outbox(const std::shared_ptr<BlockingClient>& self) {
+        return [self](std::string data) {
+            std::lock_guard<std::mutex> lock(self->mutex);
+            self->send_all(data);
+        };
     }
 };
 
-void handle_client(int client_sock, DB* db, PubSubManager* pubsub, const std::string& password) {
-    EnhancedCommandHandler handler(db, pubsub, password);
+// Thread-per-connection fallback (io_mode "threads" and non-Linux builds).
+void handle_client(std::shared_ptr<BlockingClient> client, std::unique_ptr<Session> session) {
     char buffer[BUFFER_SIZE];
+    std::string input;
+    std::string output;
     
     while (true) {
-        int bytes = recv(client_sock, buffer, BUFFER_SIZE - 1, 0);
+        int bytes = recv(client->fd, buffer, BUFFER_SIZE, 0);
         if (bytes <= 0) break;
         
-        buffer[bytes] = '\0';
-        std::string input(buffer);
+        input.append(buffer, bytes);
+        bool keep_open = session->on_data(input, output);
         
-        // Remove trailing \r\n
-        while (!input.empty() && (input.back() == '\r' || input.back() == '\n')) {
-            input.pop_back();
+        {
+            std::lock_guard<std::mutex> lock(client->mutex);
+            client->send_all(output);
         }
+        output.clear();
         
-        if (input.empty()) continue;
-        
-        std::string response = handler.handle_command(input, client_sock);
-        
-        if (response == "QUIT") break;
-        
-        send(client_sock, response.c_str(), response.size(), 0);
+        if (!keep_open) break;
     }
     
+    // Unsubscribe before the socket can be reused by another connection.
+    session.reset();
+    std::lock_guard<std::mutex> lock(client->mutex);
+    client->open = false;
 #ifdef _WIN32
-    closesocket(client_sock);
+    closesocket(client->fd);
 #else
-    close(client_sock);
+    close(client->fd);
 #endif
 }
 
@@ -590,9 +1187,9 @@ std::string get_db_stats(DB* db) {
     if (auto enhanced = dynamic_cast<EnhancedDB*>(db)) {
         oss << "hits: " << enhanced->get_hits() << ", misses: " << enhanced->get_misses() << ", size: " << enhanced->dbsize();
     } else if (auto lru = dynamic_cast<LRUDB*>(db)) {
-        oss << "hits: " << lru->cache_->get_hits() << ", misses: " << lru->cache_->get_misses();
+        oss << "hits: " << lru->get_hits() << ", misses: " << lru->get_misses();
     } else if (auto lfu = dynamic_cast<LFUDB*>(db)) {
-        oss << "hits: " << lfu->cache_->get_hits() << ", misses: " << lfu->cache_->get_misses();
+        oss << "hits: " << lfu->get_hits() << ", misses: " << lfu->get_misses();
     }
     return oss.str();
 }
@@ -604,10 +1201,10 @@ size_t curl_write_cb(void* contents, size_t size, size_t nmemb, void* userp) {
 
 std::mutex db_swap_mutex;
 
-void update_config_and_db(const std::string& suggestion, ServerConfig& cfg, std::unique_ptr<DB>& db) {
+void update_config_and_db(const std::string& suggestion, ServerConfig& cfg, std::shared_ptr<DB>& db) {
     bool changed = false;
     std::smatch match;
-    if (std::regex_search(suggestion, match, std::regex("cache_policy to (ENHANCED|LFU|LRU)", std::regex::icase))) {
+    if (std::regex_search(suggestion, match, std::regex("cache_policy to (ENHANCED|ARC|TINYLFU|LFU|LRU)", std::regex::icase))) {
         std::string new_policy = match[1].str();
         if (cfg.cache_policy != new_policy) {
             cfg.cache_policy = new_policy;
@@ -628,13 +1225,57 @@ void update_config_and_db(const std::string& suggestion, ServerConfig& cfg, std:
           << cfg.api_key << "\"\n}";
         f.close();
         
+        std::shared_ptr<DB> fresh(create_configured_db(cfg));
+        // The new DB is rebuilt from the log, so it must hold every write.
+        if (!AOFWriter::instance().flush()) {
+            std::cerr << "[AI] AOF could not be flushed; keeping the current DB" << std::endl;
+            return;
+        }
+        replay_aof(*fresh, AOFWriter::instance().filename(), false);
         std::lock_guard<std::mutex> lock(db_swap_mutex);
-        db.reset(create_db(cfg.cache_policy, cfg.cache_size));
+        db = std::move(fresh);
         std::cout << "[AI] DB reconfigured: policy=" << cfg.cache_policy << ", size=" << cfg.cache_size << std::endl;
     }
 }
 
-void ai_optimize_loop(DB* db, std::atomic<bool>& running, const std::string& api_key, ServerConfig& cfg, std::unique_ptr<DB>& db_ptr) {
+// Slot groups per shard one background rehash step moves
+static const size_t REHASH_STEP_GROUPS = 64;
+
+// Active expiration: `hz` times a second, expire keys whose TTL has
+// passed in steps of `keys_per_step`, repeating while steps come back full
+// but for no more than a quarter of the cycle. What is left of that
+// quarter moves resizing keyspace tables along, as Redis's cron does.
+void expire_cycle_loop(std::shared_ptr<DB>& db_ptr, std::atomic<bool>& running, int hz, size_t keys_per_step) {
+    auto period = std::chrono::microseconds(1000000 / (hz > 0 ? hz : 10));
+    auto rate_start = std::chrono::steady_clock::now();
+    uint64_t rate_base = 0;
+    while (running) {
+        std::this_thread::sleep_for(period);
+        // Own a reference for the cycle so a concurrent swap cannot free it
+        std::shared_ptr<DB> db;
+        {
+            std::lock_guard<std::mutex> lock(db_swap_mutex);
+            db = db_ptr;
+        }
+        auto cycle_end = std::chrono::steady_clock::now() + period / 4;
+        while (db->active_expire(keys_per_step) >= keys_per_step && std::chrono::steady_clock::now() < cycle_end) {
+        }
+        while (std::chrono::steady_clock::now() < cycle_end && db->rehash_step(REHASH_STEP_GROUPS)) {
+        }
+        
+        auto now = std::chrono::steady_clock::now();
+        double elapsed = std::chrono::duration<double>(now - rate_start).count();
+        if (elapsed >= 1.0) {
+            uint64_t expired = db->expiry_stats().expired;
+            // A swapped-in DB starts counting from zero again.
+            expired_keys_per_sec = expired >= rate_base ? (expired - rate_base) / elapsed : 0.0;
+            rate_base = expired;
+            rate_start = now;
+        }
+    }
+}
+
+void ai_optimize_loop(DB* db, std::atomic<bool>& running, const std::string& api_key, ServerConfig& cfg, std::shared_ptr<DB>& db_ptr) {
     while (running) {
         std::this_thread::sleep_for(std::chrono::minutes(5));
         if (!running) break;
@@ -676,11 +1317,29 @@ int main() {
 #endif
 
     ServerConfig cfg = read_config();
-    std::unique_ptr<DB> db(create_db(cfg.cache_policy, cfg.cache_size));
+    encoding_limits = cfg.encoding;
+    AOFWriter::instance().configure(cfg.appendfilename, parse_appendfsync(cfg.appendfsync), cfg.appendonly);
+    std::shared_ptr<DB> db(create_configured_db(cfg));
+    if (cfg.appendonly && replay_aof(*db, cfg.appendfilename) == AOFLoader::Result::CORRUPT) {
+        std::cerr << "Refusing to start with a corrupt AOF; repair or move " << cfg.appendfilename << std::endl;
+        return 1;
+    }
+    AOFWriter::instance().set_rewrite_source([&db](AOFRewriteFile& out) {
+        // Hold a reference for the whole dump; a swap must not free it
+        std::shared_ptr<DB> current;
+        {
+            std::lock_guard<std::mutex> lock(db_swap_mutex);
+            current = db;
+        }
+        current->rewrite_aof(out);
+    });
+    AOFWriter::instance().set_auto_rewrite(cfg.auto_aof_rewrite_percentage, cfg.auto_aof_rewrite_min_size);
     std::unique_ptr<PubSubManager> pubsub(new PubSubManager());
     
     std::atomic<bool> running(true);
     
+    std::thread(expire_cycle_loop, std::ref(db), std::ref(running), cfg.hz, cfg.active_expire_keys).detach();
+    
     // Start AI optimization thread if API key is provided
     std::thread ai_thread;
     if (!cfg.api_key.empty()) {
@@ -704,7 +1363,7 @@ int main() {
         return 1;
     }
     
-    if (listen(server_fd, 5) == -1) {
+    if (listen(server_fd, SOMAXCONN) == -1) {
         std::cerr << "Failed to listen on socket" << std::endl;
         return 1;
     }
@@ -716,12 +1375,31 @@ int main() {
         std::cout << "Authentication required" << std::endl;
     }
     
+    auto make_session = [&](int, Outbox outbox) -> std::unique_ptr<Session> {
+        std::lock_guard<std::mutex> lock(db_swap_mutex);
+        return std::unique_ptr<Session>(new ClientSession(std::move(outbox), db.get(), pubsub.get(), cfg.password));
+    };
+    
+#ifdef __linux__
+    if (cfg.io_mode != "threads") {
+        size_t io_threads = cfg.io_threads > 0 ? cfg.io_threads : std::thread::hardware_concurrency();
+        std::cout << "I/O mode: epoll, reactor threads: " << io_threads << std::endl;
+        Reactor reactor(server_fd, io_threads, make_session);
+        reactor.start();
+        reactor.join();
+        close(server_fd);
+        running = false;
+        return 0;
+    }
+#endif
+    std::cout << "I/O mode: thread per connection" << std::endl;
+    
     while (true) {
         int client_sock = accept(server_fd, nullptr, nullptr);
         if (client_sock == -1) continue;
         
-        std::lock_guard<std::mutex> lock(db_swap_mutex);
-        std::thread(handle_client, client_sock, db.get(), pubsub.get(), cfg.password).detach();
+        auto client = std::make_shared<BlockingClient>(client_sock);
+        std::thread(handle_client, client, make_session(client_sock, client->outbox(client))).detach();
     }
 
 #ifdef _WIN32
@@ -0,0 +1,141 @@
+/*
+ * glob.cpp
+ * Glob matching with one backtrack point: on a mismatch the last `*`
+ * takes one more character and matching resumes after it. Earlier stars
+ * never need to be revisited, since the last one can absorb anything
+ * they would have, so a match costs O(pattern x text) at worst and
+ * usually one pass.
+ */
+
+#include "glob.h"
+#include <cstring>
+#include <utility>
+
+namespace {
+
+// Appends the unescaped literal text of pattern[pos, end) to `out`; false,
+// leaving `out` partly filled, if it holds a wildcard.
+bool unescape(const std::string& pattern, size_t pos, size_t end, std::string& out) {
+    for (; pos < end; ++pos) {
+        char c = pattern[pos];
+        if (c == '*' || c == '?' || c == '[') return false;
+        if (c == '\\' && pos + 1 < end) c = pattern[++pos];
+        out += c;
+    }
+    return true;
+}
+
+}
+
+GlobPattern::GlobPattern(const std::string& pattern) : pattern_(pattern), rest_(0), end_(pattern.size()) {
+    const size_t size = pattern_.size();
+    while (rest_ < size) {
+        char c = pattern_[rest_];
+        if (c == '*' || c == '?' || c == '[') break;
+        if (c == '\\' && rest_ + 1 < size) c = pattern_[++rest_];
+        prefix_ += c;
+        ++rest_;
+    }
+    literal_ = rest_ == size;
+    all_ = size && pattern_.find_first_not_of('*') == std::string::npos;
+
+    // Find the last `*` outside an escape or class.
+    size_t star_end = std::string::npos;
+    for (size_t pos = rest_; pos < size; ++pos) {
+        if (pattern_[pos] == '\\') {
+            ++pos;
+        } else if (pattern_[pos] == '*') {
+            star_end = pos + 1;
+        } else if (pattern_[pos] == '[') {
+            for (++pos; pos < size && pattern_[pos] != ']'; ++pos) {
+                if (pattern_[pos] == '\\') ++pos;
+            }
+        }
+    }
+    if (star_end != std::string::npos && !unescape(pattern_, star_end, size, suffix_)) suffix_.clear();
+    if (!suffix_.empty()) end_ = star_end;
+}
+
+bool GlobPattern::matches(std::string_view text) const {
+    if (all_) return true;
+    if (text.size() < prefix_.size() || std::memcmp(text.data(), prefix_.data(), prefix_.size()) != 0) {
+        return false;
+    }
+    if (literal_) return text.size() == prefix_.size();
+    text.remove_prefix(prefix_.size());
+    if (!suffix_.empty()) {
+        if (text.size() < suffix_.size() ||
+            std::memcmp(text.data() + text.size() - suffix_.size(), suffix_.data(), suffix_.size()) != 0) {
+            return false;
+        }
+        text.remove_suffix(suffix_.size());
+    }
+    return match_from(rest_, text);
+}
+
+bool GlobPattern::match_from(size_t pos, std::string_view text) const {
+    const size_t end = end_;
+    size_t t = 0;
+    size_t star = std::string::npos;  // pattern position after the last `*`
+    size_t star_text = 0;             // text position that `*` resumes from
+    while (t < text.size()) {
+        if (pos < end && pattern_[pos] == '*') {
+            while (pos < end && pattern_[pos] == '*') ++pos;
+            if (pos == end) return true;
+            star = pos;
+            star_text = t;
+            continue;
+        }
+        size_t next;
+        if (pos < end && match_char(pos, text[t], next)) {
+            pos = next;
+            ++t;
+            continue;
+        }
+        if (star == std::string::npos) return false;
+        pos = star;
+        t = ++star_text;
+    }
+    while (pos < end && pattern_[pos] == '*') ++pos;
+    return pos == end;
+}
+
+bool GlobPattern::match_char(size_t pos, char c, size_t& next) const {
+    const size_t end = pattern_.size();
+    switch (pattern_[pos]) {
+    case '?':
+        next = pos + 1;
+        return true;
+    case '\\':
+        if (pos + 1 < end) {
+            next = pos + 2;
+            return pattern_[pos + 1] == c;
+        }
+        next = pos + 1;
+        return c == '\\';
+    case '[': {
+        // An unterminated class runs to the end of the pattern, as in Redis.
+        ++pos;
+        bool negate = pos < end && pattern_[pos] == '^';
+        if (negate) ++pos;
+        bool found = false;
+        for (; pos < end && pattern_[pos] != ']'; ++pos) {
+            if (pattern_[pos] == '\\' && pos + 1 < end) {
+                found |= pattern_[++pos] == c;
+            } else if (pos + 2 < end && pattern_[pos + 1] == '-' && pattern_[pos + 2] != ']') {
+                unsigned char lo = pattern_[pos], hi = pattern_[pos + 2];
+                if (lo > hi) std::swap(lo, hi);
+                found |= static_cast<unsigned char>(c) >= lo && static_cast<unsigned char>(c) <= hi;
+                pos += 2;
+            } else {
+                found |= pattern_[pos] == c;
+            }
+        }
+        next = pos < end ? pos + 1 : pos;
+        return found != negate;
+    }
+    default:
+        next = pos + 1;
+        return pattern_[pos] == c;
+    }
+}
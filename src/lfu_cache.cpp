@@ -1,66 +1,189 @@
 #include "lfu_cache.h"
 #include <algorithm>
 
-LFUCache::LFUCache(size_t capacity) : capacity_(capacity) {}
+// Keys a write expires in passing, so memory is reclaimed even when
+// nothing calls expire_due().
+static const size_t PUT_EXPIRE_BUDGET = 4;
+
+LFUCache::LFUCache(size_t capacity, size_t max_memory) : capacity_(capacity), max_memory_(max_memory) {}
+
+LFUCache::~LFUCache() {
+    table_.clear();
+    while (Bucket* bucket = buckets_.front()) delete bucket;
+}
 
 void LFUCache::put(const std::string& key, const std::string& value) {
-    auto it = map_.find(key);
-    if (it != map_.end()) {
-        items_.erase(it->second);
-        map_.erase(it);
-        expiry_.erase(key);
-        freq_list_[freq_[key]].remove(key);
-        freq_.erase(key);
-    }
-    items_.push_front({key, value});
-    map_[key] = items_.begin();
-    freq_[key] = 1;
-    freq_list_[1].push_back(key);
-    if (map_.size() > capacity_) {
-        int min_freq = freq_list_.begin()->first;
-        std::string evict_key = freq_list_[min_freq].front();
-        freq_list_[min_freq].pop_front();
-        erase(evict_key);
+    auto inserted = table_.try_emplace(key);
+    Entry& entry = inserted.first->second;
+    if (inserted.second) {
+        entry.key = &inserted.first->first;
+        link_new(entry);
+    } else {
+        used_memory_ -= entry_bytes(key, entry.value);
+        static_cast<ListHook<TimerTag>&>(entry).unlink();
+        promote(entry);
     }
+    entry.value = value;
+    used_memory_ += entry_bytes(key, entry.value);
+    evict_if_needed(entry);
+    expire_due(PUT_EXPIRE_BUDGET);
 }
 
 bool LFUCache::get(const std::string& key, std::string& value) {
-    auto it = map_.find(key);
-    if (it == map_.end()) { misses_++; return false; }
-    auto eit = expiry_.find(key);
-    if (eit != expiry_.end() && std::chrono::steady_clock::now() > eit->second) {
-        erase(key);
-        expiry_.erase(key);
+    auto it = table_.find(key);
+    if (it == table_.end() || drop_if_expired(it)) {
         misses_++;
         return false;
     }
-    update_freq(key);
-    value = it->second->second;
+    promote(it->second);
+    value = it->second.value;
     hits_++;
     return true;
 }
 
 void LFUCache::erase(const std::string& key) {
-    auto it = map_.find(key);
-    if (it != map_.end()) {
-        items_.erase(it->second);
-        map_.erase(it);
-        expiry_.erase(key);
-        int f = freq_[key];
-        freq_list_[f].remove(key);
-        if (freq_list_[f].empty()) freq_list_.erase(f);
-        freq_.erase(key);
+    auto it = table_.find(key);
+    if (it != table_.end()) erase(it);
+}
+
+void LFUCache::erase(Table::iterator it) {
+    used_memory_ -= entry_bytes(it->first, it->second.value);
+    unlink(it->second);
+    table_.erase(it);
+}
+
+LFUCache::Bucket* LFUCache::new_bucket(uint64_t priority, Bucket* after) {
+    Bucket* bucket = new Bucket(priority);
+    if (after) {
+        buckets_.insert_after(*after, *bucket);
+    } else {
+        buckets_.push_front(*bucket);
+    }
+    used_memory_ += sizeof(Bucket);
+    return bucket;
+}
+
+void LFUCache::unlink(Entry& entry) {
+    Bucket* bucket = entry.bucket;
+    static_cast<ListHook<EntryTag>&>(entry).unlink();
+    entry.bucket = nullptr;
+    if (bucket->entries.empty()) {
+        used_memory_ -= sizeof(Bucket);
+        delete bucket;
+    }
+}
+
+void LFUCache::link_new(Entry& entry) {
+    // Every key's priority is at least age_, so at most the first bucket
+    // is below age_ + 1 and the loop stops within two steps.
+    uint64_t priority = age_ + 1;
+    Bucket* before = nullptr;
+    Bucket* next = buckets_.front();
+    while (next && next->priority < priority) {
+        before = next;
+        next = buckets_.next(next);
+    }
+    Bucket* bucket = next && next->priority == priority ? next : new_bucket(priority, before);
+    bucket->entries.push_back(entry);
+    entry.bucket = bucket;
+}
+
+void LFUCache::promote(Entry& entry) {
+    Bucket* current = entry.bucket;
+    uint64_t priority = current->priority + 1;
+    Bucket* next = buckets_.next(current);
+    Bucket* bucket = next && next->priority == priority ? next : new_bucket(priority, current);
+    bucket->entries.push_back(entry);  // moves it out of `current`
+    entry.bucket = bucket;
+    if (current->entries.empty()) {
+        used_memory_ -= sizeof(Bucket);
+        delete current;
+    }
+}
+
+void LFUCache::evict_if_needed(const Entry& written) {
+    while (over_limit()) {
+        // The oldest key of the lowest bucket, or the next one if that is
+        // the key just written.
+        Bucket* bucket = buckets_.front();
+        Entry* victim = bucket ? bucket->entries.front() : nullptr;
+        if (victim == &written) {
+            victim = bucket->entries.next(victim);
+            if (!victim && buckets_.next(bucket)) victim = buckets_.next(bucket)->entries.front();
+        }
+        if (!victim) break;
+        // Not past the spared key: when it sits alone in the first bucket
+        // the victim comes from the next one, and an age above the spared
+        // key would let new keys link below it.
+        age_ = std::min(victim->bucket->priority, written.bucket->priority);
+        erase(table_.find(*victim->key));
+        evicted_keys_++;
+    }
+}
+
+bool LFUCache::set_expiry(const std::string& key, int seconds) {
+    return set_expiry_at(key, std::chrono::steady_clock::now() + std::chrono::seconds(seconds));
+}
+
+bool LFUCache::set_expiry_at(const std::string& key, std::chrono::steady_clock::time_point when) {
+    auto it = table_.find(key);
+    if (it == table_.end()) return false;
+    it->second.expires_at = when;
+    expiry_wheel_.schedule(it->second);
+    return true;
+}
+
+size_t LFUCache::expire_due(size_t max_keys) {
+    auto now = std::chrono::steady_clock::now();
+    return expiry_wheel_.advance(now, max_keys, [&](KeyTimer& timer) {
+        auto lag = std::chrono::duration_cast<std::chrono::nanoseconds>(now - timer.expires_at);
+        if (lag.count() < 0) lag = std::chrono::nanoseconds(0);
+        expiry_stats_.expired++;
+        expiry_stats_.active_expired++;
+        expiry_stats_.total_lag += lag;
+        expiry_stats_.max_lag = std::max(expiry_stats_.max_lag, lag);
+        erase(table_.find(*timer.key));
+    });
+}
+
+bool LFUCache::drop_if_expired(Table::iterator it) {
+    const Entry& entry = it->second;
+    if (!static_cast<const ListHook<TimerTag>&>(entry).is_linked() ||
+        std::chrono::steady_clock::now() <= entry.expires_at) {
+        return false;
+    }
+    expiry_stats_.expired++;
+    erase(it);
+    return true;
+}
+
+bool LFUCache::get_expiry(const std::string& key, std::chrono::steady_clock::time_point& when) const {
+    auto it = table_.find(key);
+    if (it == table_.end() || !static_cast<const ListHook<TimerTag>&>(it->second).is_linked()) return false;
+    when = it->second.expires_at;
+    return true;
+}
+
+bool LFUCache::over_limit() const {
+    return table_.size() > capacity_ || (max_memory_ && used_memory_ > max_memory_);
+}
+
+std::vector<uint64_t> LFUCache::bucket_priorities() const {
+    std::vector<uint64_t> priorities;
+    for (const Bucket* bucket = buckets_.front(); bucket; bucket = buckets_.next(bucket)) {
+        priorities.push_back(bucket->priority);
     }
+    return priorities;
 }
 
-void LFUCache::set_expiry(const std::string& key, int seconds) {
-    expiry_[key] = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+MemoryStats LFUCache::memory_stats() const {
+    MemoryStats stats;
+    stats.used_memory = used_memory_ + table_.bucket_count() * sizeof(void*);
+    stats.max_memory = max_memory_;
+    stats.evicted_keys = evicted_keys_;
+    return stats;
 }
 
-void LFUCache::update_freq(const std::string& key) {
-    int f = freq_[key];
-    freq_list_[f].remove(key);
-    if (freq_list_[f].empty()) freq_list_.erase(f);
-    freq_[key] = f + 1;
-    freq_list_[f + 1].push_back(key);
+size_t LFUCache::entry_bytes(const std::string& key, const std::string& value) {
+    return hash_node_bytes<Table::value_type>() + heap_bytes(key) + heap_bytes(value);
 }
@@ -1,34 +1,31 @@
 #include "lru_cache.h"
 #include <chrono>
+#include <algorithm>
 
-LRUCache::LRUCache(size_t capacity) : capacity_(capacity) {}
+// Keys a write expires in passing, so memory is reclaimed even when
+// nothing calls expire_due().
+static const size_t PUT_EXPIRE_BUDGET = 4;
+
+LRUCache::LRUCache(size_t capacity, size_t max_memory) : capacity_(capacity), max_memory_(max_memory) {}
 
 void LRUCache::put(const std::string& key, const std::string& value) {
-    auto it = map_.find(key);
-    if (it != map_.end()) {
-        items_.erase(it->second);
-        map_.erase(it);
-        expiry_.erase(key);
-    }
+    erase(key);
     items_.push_front({key, value});
     map_[key] = items_.begin();
-    if (map_.size() > capacity_) {
-        auto last = items_.end();
-        --last;
-        expiry_.erase(last->first);
-        map_.erase(last->first);
-        items_.pop_back();
+    used_memory_ += entry_bytes(key, value);
+    // The entry just written stays even if it alone is over the limit.
+    while (over_limit() && items_.size() > 1) {
+        std::string evict_key = items_.back().first;
+        erase(evict_key);
+        evicted_keys_++;
     }
+    expire_due(PUT_EXPIRE_BUDGET);
 }
 
 bool LRUCache::get(const std::string& key, std::string& value) {
     auto it = map_.find(key);
     if (it == map_.end()) { misses_++; return false; }
-    // TTL check
-    auto eit = expiry_.find(key);
-    if (eit != expiry_.end() && std::chrono::steady_clock::now() > eit->second) {
-        erase(key);
-        expiry_.erase(key);
+    if (drop_if_expired(key)) {
         misses_++;
         return false;
     }
@@ -41,12 +38,82 @@ bool LRUCache::get(const std::string& key, std::string& value) {
 void LRUCache::erase(const std::string& key) {
     auto it = map_.find(key);
     if (it != map_.end()) {
+        used_memory_ -= entry_bytes(key, it->second->second);
         items_.erase(it->second);
         map_.erase(it);
-        expiry_.erase(key);
+        erase_expiry(key);
     }
 }
 
-void LRUCache::set_expiry(const std::string& key, int seconds) {
-    expiry_[key] = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+bool LRUCache::set_expiry(const std::string& key, int seconds) {
+    return set_expiry_at(key, std::chrono::steady_clock::now() + std::chrono::seconds(seconds));
+}
+
+bool LRUCache::set_expiry_at(const std::string& key, std::chrono::steady_clock::time_point when) {
+    if (map_.find(key) == map_.end()) return false;
+    auto inserted = expiry_.try_emplace(key);
+    if (inserted.second) used_memory_ += timer_bytes(key);
+    auto it = inserted.first;
+    it->second.key = &it->first;
+    it->second.expires_at = when;
+    expiry_wheel_.schedule(it->second);
+    return true;
+}
+
+size_t LRUCache::expire_due(size_t max_keys) {
+    auto now = std::chrono::steady_clock::now();
+    return expiry_wheel_.advance(now, max_keys, [&](KeyTimer& timer) {
+        auto lag = std::chrono::duration_cast<std::chrono::nanoseconds>(now - timer.expires_at);
+        if (lag.count() < 0) lag = std::chrono::nanoseconds(0);
+        expiry_stats_.expired++;
+        expiry_stats_.active_expired++;
+        expiry_stats_.total_lag += lag;
+        expiry_stats_.max_lag = std::max(expiry_stats_.max_lag, lag);
+        std::string key = *timer.key;  // erase() destroys the timer and its key
+        erase(key);
+    });
+}
+
+bool LRUCache::drop_if_expired(const std::string& key) {
+    auto it = expiry_.find(key);
+    if (it == expiry_.end() || std::chrono::steady_clock::now() <= it->second.expires_at) return false;
+    expiry_stats_.expired++;
+    erase(key);
+    return true;
+}
+
+bool LRUCache::get_expiry(const std::string& key, std::chrono::steady_clock::time_point& when) const {
+    auto it = expiry_.find(key);
+    if (it == expiry_.end()) return false;
+    when = it->second.expires_at;
+    return true;
+}
+
+void LRUCache::erase_expiry(const std::string& key) {
+    auto it = expiry_.find(key);
+    if (it == expiry_.end()) return;
+    used_memory_ -= timer_bytes(key);
+    expiry_.erase(it);
+}
+
+size_t LRUCache::timer_bytes(const std::string& key) {
+    return hash_node_bytes<std::pair<const std::string, KeyTimer>>() + heap_bytes(key);
+}
+
+bool LRUCache::over_limit() const {
+    return map_.size() > capacity_ || (max_memory_ && used_memory_ > max_memory_);
+}
+
+MemoryStats LRUCache::memory_stats() const {
+    MemoryStats stats;
+    stats.used_memory = used_memory_ + (map_.bucket_count() + expiry_.bucket_count()) * sizeof(void*);
+    stats.max_memory = max_memory_;
+    stats.evicted_keys = evicted_keys_;
+    return stats;
+}
+
+size_t LRUCache::entry_bytes(const std::string& key, const std::string& value) {
+    using Item = std::pair<std::string, std::string>;
+    return list_node_bytes<Item>() + hash_node_bytes<std::pair<const std::string, std::list<Item>::iterator>>() +
+           2 * heap_bytes(key) + heap_bytes(value);
 }
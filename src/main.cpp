@@ -15,6 +15,7 @@ bool is_integer(const std::string& s) {
 
 int main() {
     std::unique_ptr<DB> db(new LRUDB(100));
+    replay_aof(*db, AOFWriter::instance().filename());
     std::cout << "Welcome to MyDB! Type HELP for commands.\n";
     std::string line;
     while (std::cout << "> " && std::getline(std::cin, line)) {
@@ -52,10 +53,10 @@ int main() {
             db->del(key);
             std::cout << "+OK\n";
         } else if (cmd == "SAVE") {
-            db->save("db.json");
+            db->save("db.rdb");
             std::cout << "+SAVED\n";
         } else if (cmd == "LOAD") {
-            db->load("db.json");
+            db->load("db.rdb");
             std::cout << "+LOADED\n";
         } else if (cmd == "EXIT" || cmd == "QUIT") {
             break;
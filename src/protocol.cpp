@@ -1,6 +1,40 @@
 #include "protocol.h"
 #include <algorithm>
 #include <cstdint>
+#include <cstring>
+
+namespace {
+const size_t MAX_INLINE_SIZE = 64 * 1024;
+const int64_t MAX_MULTIBULK_LEN = 1024 * 1024;
+const int64_t MAX_BULK_LEN = 512LL * 1024 * 1024;
+
+// Parse a decimal integer occupying exactly [begin, end).
+bool parse_length(const char* begin, const char* end, int64_t& value) {
+    if (begin == end) return false;
+    bool negative = false;
+    if (*begin == '-') {
+        negative = true;
+        if (++begin == end) return false;
+    }
+    int64_t result = 0;
+    for (const char* p = begin; p != end; ++p) {
+        if (*p < '0' || *p > '9') return false;
+        result = result * 10 + (*p - '0');
+        if (result > MAX_BULK_LEN) return false;
+    }
+    value = negative ? -result : result;
+    return true;
+}
+
+// End of the line starting at `begin`, excluding the "\r\n" (or bare "\n").
+const char* line_end(const char* newline, const char* begin) {
+    return (newline > begin && newline[-1] == '\r') ? newline - 1 : newline;
+}
+
+bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+}
 
 CommandParser::Command CommandParser::parse(const std::string& input) {
     Command cmd;
@@ -10,7 +44,6 @@ CommandParser::Command CommandParser::parse(const std::string& input) {
     // Parse command and arguments
     if (iss >> token) {
         cmd.name = token;
-        std::transform(cmd.name.begin(), cmd.name.end(), cmd.name.begin(), ::toupper);
         
         // Parse remaining arguments
         while (iss >> token) {
@@ -21,6 +54,20 @@ CommandParser::Command CommandParser::parse(const std::string& input) {
     return cmd;
 }
 
+void CommandParser::assign(Command& cmd, const std::vector<std::string_view>& argv) {
+    if (argv.empty()) {
+        cmd.name.clear();
+        cmd.args.clear();
+        return;
+    }
+    cmd.name.assign(argv[0].data(), argv[0].size());
+    
+    cmd.args.resize(argv.size() - 1);
+    for (size_t i = 1; i < argv.size(); ++i) {
+        cmd.args[i - 1].assign(argv[i].data(), argv[i].size());
+    }
+}
+
 std::string CommandParser::format_response(const std::string& response) {
     return response + "\r\n";
 }
@@ -59,3 +106,124 @@ std::string ResponseFormatter::array(const std::vector<std::string>& items) {
     }
     return result;
 }
+
+// RequestParser implementations
+RequestParser::Status RequestParser::parse(const char* data, size_t len,
+                                           std::vector<std::string_view>& args, size_t& consumed) {
+    args.clear();
+    consumed = 0;
+    if (len == 0) return Status::INCOMPLETE;
+    
+    if (data[0] == '*') {
+        return parse_multibulk(data, len, args, consumed);
+    }
+    return parse_inline(data, len, args, consumed);
+}
+
+void RequestParser::reset() {
+    pos_ = 0;
+    multibulk_len_ = -1;
+    spans_.clear();
+}
+
+RequestParser::Status RequestParser::fail(const std::string& message) {
+    error_ = message;
+    reset();
+    return Status::ERROR;
+}
+
+RequestParser::Status RequestParser::parse_multibulk(const char* data, size_t len,
+                                                     std::vector<std::string_view>& args, size_t& consumed) {
+    if (multibulk_len_ < 0) {
+        const char* newline = static_cast<const char*>(memchr(data, '\n', len));
+        if (newline == nullptr) {
+            if (len > MAX_INLINE_SIZE) return fail("too big mbulk count string");
+            return Status::INCOMPLETE;
+        }
+        
+        int64_t count;
+        if (!parse_length(data + 1, line_end(newline, data), count) || count > MAX_MULTIBULK_LEN) {
+            return fail("invalid multibulk length");
+        }
+        
+        pos_ = newline - data + 1;
+        spans_.clear();
+        if (count <= 0) {
+            consumed = pos_;
+            reset();
+            return Status::OK;
+        }
+        multibulk_len_ = count;
+        // The count is client-supplied; larger arrays grow as arguments arrive
+        spans_.reserve(std::min<size_t>(static_cast<size_t>(count), 1024));
+    }
+    
+    while (spans_.size() < static_cast<size_t>(multibulk_len_)) {
+        if (pos_ >= len) return Status::INCOMPLETE;
+        
+        const char* header = data + pos_;
+        if (*header != '$') {
+            return fail(std::string("expected '$', got '") + *header + "'");
+        }
+        
+        const char* newline = static_cast<const char*>(memchr(header, '\n', len - pos_));
+        if (newline == nullptr) {
+            if (len - pos_ > MAX_INLINE_SIZE) return fail("too big bulk count string");
+            return Status::INCOMPLETE;
+        }
+        
+        int64_t bulk_len;
+        if (!parse_length(header + 1, line_end(newline, header), bulk_len) || bulk_len < 0) {
+            return fail("invalid bulk length");
+        }
+        
+        size_t start = newline - data + 1;
+        size_t size = static_cast<size_t>(bulk_len);
+        if (start + size + 2 > len) return Status::INCOMPLETE;
+        if (data[start + size] != '\r' || data[start + size + 1] != '\n') {
+            return fail("bulk string not terminated by CRLF");
+        }
+        
+        spans_.emplace_back(start, size);
+        pos_ = start + size + 2;
+    }
+    
+    for (const auto& span : spans_) {
+        args.emplace_back(data + span.first, span.second);
+    }
+    consumed = pos_;
+    reset();
+    return Status::OK;
+}
+
+RequestParser::Status RequestParser::parse_inline(const char* data, size_t len,
+                                                  std::vector<std::string_view>& args, size_t& consumed) {
+    const char* newline = static_cast<const char*>(memchr(data, '\n', len));
+    if (newline == nullptr) {
+        if (len > MAX_INLINE_SIZE) return fail("too big inline request");
+        return Status::INCOMPLETE;
+    }
+    
+    const char* p = data;
+    const char* end = line_end(newline, data);
+    while (p < end) {
+        while (p < end && is_space(*p)) ++p;
+        if (p == end) break;
+        
+        if (*p == '"' || *p == '\'') {
+            // Quoted argument: may contain spaces, taken verbatim.
+            char quote = *p++;
+            const char* close = static_cast<const char*>(memchr(p, quote, end - p));
+            if (close == nullptr) return fail("unbalanced quotes in request");
+            args.emplace_back(p, close - p);
+            p = close + 1;
+        } else {
+            const char* start = p;
+            while (p < end && !is_space(*p)) ++p;
+            args.emplace_back(start, p - start);
+        }
+    }
+    
+    consumed = newline - data + 1;
+    return Status::OK;
+}
@@ -1,14 +1,7 @@
 #include "pubsub.h"
+#include "protocol.h"
 #include <iostream>
 
-#ifdef _WIN32
-#include <winsock2.h>
-#pragma comment(lib, "ws2_32.lib")
-#else
-#include <sys/socket.h>
-#include <unistd.h>
-#endif
-
 PubSubManager::PubSubManager() {
     // Constructor: Initialize any necessary resources
 }
@@ -17,41 +10,54 @@ PubSubManager::~PubSubManager() {
     // Destructor: Clean up resources if necessary
 }
 
-void PubSubManager::subscribe(const std::string& channel, int client_socket) {
+void PubSubManager::subscribe(const std::string& channel, uint64_t subscriber, MessageSink sink) {
     std::lock_guard<std::mutex> lock(mutex_);
-    subscriptions_[channel].insert(client_socket);
-    std::cout << "Client " << client_socket << " subscribed to channel: " << channel << std::endl;
+    subscriptions_[channel][subscriber] = std::move(sink);
+    channels_[subscriber].insert(channel);
+    std::cout << "Client " << subscriber << " subscribed to channel: " << channel << std::endl;
 }
 
-void PubSubManager::unsubscribe(const std::string& channel, int client_socket) {
+void PubSubManager::unsubscribe(const std::string& channel, uint64_t subscriber) {
     std::lock_guard<std::mutex> lock(mutex_);
     auto it = subscriptions_.find(channel);
     if (it != subscriptions_.end()) {
-        it->second.erase(client_socket);
+        it->second.erase(subscriber);
         if (it->second.empty()) {
             subscriptions_.erase(it);
         }
     }
-    std::cout << "Client " << client_socket << " unsubscribed from channel: " << channel << std::endl;
+    auto own = channels_.find(subscriber);
+    if (own != channels_.end()) {
+        own->second.erase(channel);
+        if (own->second.empty()) {
+            channels_.erase(own);
+        }
+    }
+    std::cout << "Client " << subscriber << " unsubscribed from channel: " << channel << std::endl;
 }
 
-void PubSubManager::publish(const std::string& channel, const std::string& message) {
+void PubSubManager::unsubscribe_all(uint64_t subscriber) {
     std::lock_guard<std::mutex> lock(mutex_);
-    auto it = subscriptions_.find(channel);
-    if (it != subscriptions_.end()) {
-        std::string full_message = "*PUBLISH " + channel + " " + message + "\n";
-        for (int client_socket : it->second) {
-            send_message_to_client(client_socket, full_message);
+    auto own = channels_.find(subscriber);
+    if (own == channels_.end()) return;
+    for (const auto& channel : own->second) {
+        auto it = subscriptions_.find(channel);
+        if (it == subscriptions_.end()) continue;
+        it->second.erase(subscriber);
+        if (it->second.empty()) {
+            subscriptions_.erase(it);
         }
     }
+    channels_.erase(own);
 }
 
-void PubSubManager::send_message_to_client(int client_socket, const std::string& message) {
-    // This function assumes non-blocking sockets or handles potential blocking. 
-    // For simplicity, using blocking send here. Consider threading/async for real-world.
-    int bytes_sent = send(client_socket, message.c_str(), message.length(), 0);
-    if (bytes_sent == -1) {
-        std::cerr << "Error sending message to client " << client_socket << std::endl;
-        // Potentially handle error (e.g., client disconnected) and remove from subscriptions
+size_t PubSubManager::publish(const std::string& channel, const std::string& message) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = subscriptions_.find(channel);
+    if (it == subscriptions_.end()) return 0;
+    std::string full_message = ResponseFormatter::array({"message", channel, message});
+    for (auto& subscriber : it->second) {
+        subscriber.second(full_message);
     }
-} 
\ No newline at end of file
+    return it->second.size();
+}
@@ -0,0 +1,253 @@
+#include "quicklist.h"
+#include <cstring>
+
+namespace {
+
+size_t varint_size(uint64_t v) {
+    size_t n = 1;
+    while (v >= 0x80) {
+        v >>= 7;
+        ++n;
+    }
+    return n;
+}
+
+// Decodes the varint at `p`, storing its width in `width`.
+uint64_t read_varint(const char* p, size_t& width) {
+    uint64_t v = 0;
+    unsigned shift = 0;
+    size_t i = 0;
+    for (;;) {
+        uint8_t b = static_cast<uint8_t>(p[i++]);
+        v |= uint64_t(b & 0x7f) << shift;
+        if (!(b & 0x80)) break;
+        shift += 7;
+    }
+    width = i;
+    return v;
+}
+
+// Total encoded size of the element starting at `p`.
+size_t element_size(const char* p) {
+    size_t width = 0;
+    uint64_t len = read_varint(p, width);
+    size_t body = width + static_cast<size_t>(len);
+    return body + varint_size(body);
+}
+
+// Offset of the element that ends at `end` within `buf`.
+size_t element_before(const std::string& buf, size_t end) {
+    size_t i = end - 1;
+    uint8_t b = static_cast<uint8_t>(buf[i]);
+    uint64_t body = b & 0x7f;
+    unsigned shift = 7;
+    while (b & 0x80) {
+        b = static_cast<uint8_t>(buf[--i]);
+        body |= uint64_t(b & 0x7f) << shift;
+        shift += 7;
+    }
+    return i - static_cast<size_t>(body);
+}
+
+std::string_view element_value(const char* p) {
+    size_t width = 0;
+    uint64_t len = read_varint(p, width);
+    return std::string_view(p + width, static_cast<size_t>(len));
+}
+
+}
+
+std::string_view QuickList::const_iterator::operator*() const {
+    return element_value(node_->buf.data() + offset_);
+}
+
+QuickList::const_iterator& QuickList::const_iterator::operator++() {
+    offset_ += element_size(node_->buf.data() + offset_);
+    if (offset_ == node_->buf.size()) {
+        node_ = node_->next;
+        offset_ = node_ ? node_->start : 0;
+    }
+    return *this;
+}
+
+QuickList::QuickList(const std::vector<std::string>& items) : QuickList() {
+    for (const auto& item : items) push_back(item);
+}
+
+QuickList::QuickList(const QuickList& other) : QuickList() {
+    for (auto it = other.begin(); it != other.end(); ++it) push_back(*it);
+}
+
+QuickList::QuickList(QuickList&& other) noexcept
+    : head_(other.head_), tail_(other.tail_), size_(other.size_), nodes_(other.nodes_), bytes_(other.bytes_) {
+    other.head_ = other.tail_ = nullptr;
+    other.size_ = other.nodes_ = other.bytes_ = 0;
+}
+
+QuickList& QuickList::operator=(const QuickList& other) {
+    if (this != &other) {
+        QuickList copy(other);
+        *this = std::move(copy);
+    }
+    return *this;
+}
+
+QuickList& QuickList::operator=(QuickList&& other) noexcept {
+    if (this != &other) {
+        clear();
+        head_ = other.head_;
+        tail_ = other.tail_;
+        size_ = other.size_;
+        nodes_ = other.nodes_;
+        bytes_ = other.bytes_;
+        other.head_ = other.tail_ = nullptr;
+        other.size_ = other.nodes_ = other.bytes_ = 0;
+    }
+    return *this;
+}
+
+size_t QuickList::encoded_size(size_t len) {
+    size_t body = varint_size(len) + len;
+    return body + varint_size(body);
+}
+
+void QuickList::encode(std::string_view value, char* out) {
+    uint64_t v = value.size();
+    while (v >= 0x80) {
+        *out++ = static_cast<char>((v & 0x7f) | 0x80);
+        v >>= 7;
+    }
+    *out++ = static_cast<char>(v);
+    std::memcpy(out, value.data(), value.size());
+    out += value.size();
+
+    // backlen: most significant group first; every byte but the first has
+    // the high bit set, so a reader starting at the end knows to go on.
+    uint64_t body = varint_size(value.size()) + value.size();
+    size_t n = varint_size(body);
+    for (size_t i = n; i-- > 0;) {
+        out[i] = static_cast<char>((body & 0x7f) | (i > 0 ? 0x80 : 0));
+        body >>= 7;
+    }
+}
+
+QuickList::Node* QuickList::new_node(Node* prev, Node* next) {
+    Node* node = new Node;
+    node->prev = prev;
+    node->next = next;
+    if (prev) prev->next = node; else head_ = node;
+    if (next) next->prev = node; else tail_ = node;
+    ++nodes_;
+    bytes_ += sizeof(Node) + node->buf.capacity();
+    return node;
+}
+
+void QuickList::unlink_node(Node* node) {
+    if (node->prev) node->prev->next = node->next; else head_ = node->next;
+    if (node->next) node->next->prev = node->prev; else tail_ = node->prev;
+    bytes_ -= sizeof(Node) + node->buf.capacity();
+    delete node;
+    --nodes_;
+}
+
+void QuickList::push_front(std::string_view value) {
+    size_t need = encoded_size(value.size());
+    Node* node = head_;
+    if (!node || node->buf.size() - node->start + need > NODE_BYTES) {
+        node = new_node(nullptr, head_);
+    }
+    size_t capacity = node->buf.capacity();
+    if (node->start >= need) {
+        // Reuse the space left by earlier pops from the front.
+        node->start -= need;
+    } else {
+        node->buf.erase(0, node->start);
+        node->buf.insert(0, need, '\0');
+        node->start = 0;
+    }
+    encode(value, &node->buf[node->start]);
+    bytes_ += node->buf.capacity() - capacity;
+    ++node->count;
+    ++size_;
+}
+
+void QuickList::push_back(std::string_view value) {
+    size_t need = encoded_size(value.size());
+    Node* node = tail_;
+    if (!node || node->buf.size() - node->start + need > NODE_BYTES) {
+        node = new_node(tail_, nullptr);
+    }
+    size_t capacity = node->buf.capacity();
+    if (node->start > 0 && node->buf.size() + need > NODE_BYTES) {
+        node->buf.erase(0, node->start);
+        node->start = 0;
+    }
+    size_t offset = node->buf.size();
+    node->buf.resize(offset + need);
+    encode(value, &node->buf[offset]);
+    bytes_ += node->buf.capacity() - capacity;
+    ++node->count;
+    ++size_;
+}
+
+bool QuickList::pop_front(std::string& value) {
+    Node* node = head_;
+    if (!node) return false;
+    const char* p = node->buf.data() + node->start;
+    value.assign(element_value(p));
+    node->start += element_size(p);
+    --size_;
+    if (--node->count == 0) {
+        unlink_node(node);
+    } else if (node->start > node->buf.size() - node->start) {
+        size_t capacity = node->buf.capacity();
+        node->buf.erase(0, node->start);
+        node->start = 0;
+        bytes_ += node->buf.capacity() - capacity;
+    }
+    return true;
+}
+
+bool QuickList::pop_back(std::string& value) {
+    Node* node = tail_;
+    if (!node) return false;
+    size_t offset = element_before(node->buf, node->buf.size());
+    value.assign(element_value(node->buf.data() + offset));
+    node->buf.resize(offset);
+    --size_;
+    if (--node->count == 0) unlink_node(node);
+    return true;
+}
+
+void QuickList::clear() {
+    while (head_) {
+        Node* next = head_->next;
+        delete head_;
+        head_ = next;
+    }
+    tail_ = nullptr;
+    size_ = nodes_ = bytes_ = 0;
+}
+
+QuickList::const_iterator QuickList::at(size_t index) const {
+    if (index >= size_) return end();
+    const Node* node;
+    if (index < size_ / 2) {
+        node = head_;
+        while (index >= node->count) {
+            index -= node->count;
+            node = node->next;
+        }
+    } else {
+        size_t from_end = size_ - 1 - index;
+        node = tail_;
+        while (from_end >= node->count) {
+            from_end -= node->count;
+            node = node->prev;
+        }
+        index = node->count - 1 - from_end;
+    }
+    size_t offset = node->start;
+    while (index-- > 0) offset += element_size(node->buf.data() + offset);
+    return const_iterator(node, offset);
+}
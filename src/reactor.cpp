@@ -0,0 +1,349 @@
+/*
+ * reactor.cpp
+ * Implements the epoll reactor used by the enhanced server.
+ */
+
+#include "reactor.h"
+
+#ifdef __linux__
+
+#include <iostream>
+#include <unordered_map>
+#include <mutex>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#ifndef EPOLLEXCLUSIVE
+#define EPOLLEXCLUSIVE 0
+#endif
+
+namespace {
+const size_t READ_CHUNK = 16 * 1024;
+const int MAX_EVENTS = 256;
+// Stop reading from a client whose replies are not being consumed.
+const size_t MAX_PENDING_OUTPUT = 4 * 1024 * 1024;
+// Buffers that grew for a large request are released once they are empty.
+const size_t IDLE_BUFFER_LIMIT = 64 * 1024;
+// A connection that lets this much posted data pile up unread is closed,
+// like Redis's pubsub client output buffer limit.
+const size_t MAX_POSTED_OUTPUT = 32 * 1024 * 1024;
+
+void release_if_large(std::string& buffer) {
+    if (buffer.empty() && buffer.capacity() > IDLE_BUFFER_LIMIT) {
+        std::string().swap(buffer);
+    }
+}
+}
+
+struct Reactor::Connection {
+    int fd;
+    uint64_t id;  // unique within the loop, so posts to a reused fd are dropped
+    std::unique_ptr<Session> session;
+    std::string input;
+    std::string output;
+    size_t output_offset = 0;
+    bool closing = false;
+    bool read_paused = false;
+
+    size_t pending_output() const { return output.size() - output_offset; }
+};
+
+struct Reactor::Loop {
+    // Data posted from other threads for one connection.
+    struct Mail {
+        int fd;
+        uint64_t id;
+        std::string data;
+    };
+
+    int epoll_fd = -1;
+    int wake_fd = -1;
+    // Held open so a connection can still be accepted and dropped when the
+    // process runs out of descriptors.
+    int spare_fd = -1;
+    std::unordered_map<int, std::unique_ptr<Connection>> connections;
+    uint64_t next_id = 0;
+
+    std::mutex mailbox_mutex;
+    std::vector<Mail> mailbox;
+};
+
+Reactor::Reactor(int listen_fd, size_t num_threads, SessionFactory factory)
+    : listen_fd_(listen_fd), factory_(std::move(factory)), running_(false), connections_(0), accepted_(0) {
+    if (num_threads == 0) num_threads = 1;
+
+    int flags = fcntl(listen_fd_, F_GETFL, 0);
+    fcntl(listen_fd_, F_SETFL, flags | O_NONBLOCK);
+
+    for (size_t i = 0; i < num_threads; ++i) {
+        std::unique_ptr<Loop> loop(new Loop());
+        loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        loop->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        loop->spare_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+
+        // The listening socket stays level-triggered; EPOLLEXCLUSIVE wakes a
+        // single reactor per incoming connection instead of all of them.
+        epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLEXCLUSIVE;
+        ev.data.ptr = nullptr;
+        epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, listen_fd_, &ev);
+
+        epoll_event wake{};
+        wake.events = EPOLLIN;
+        wake.data.ptr = loop.get();
+        epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, loop->wake_fd, &wake);
+
+        loops_.push_back(std::move(loop));
+    }
+}
+
+Reactor::~Reactor() {
+    stop();
+    join();
+    for (auto& loop : loops_) {
+        for (auto& item : loop->connections) {
+            close(item.first);
+        }
+        loop->connections.clear();
+        if (loop->spare_fd >= 0) close(loop->spare_fd);
+        close(loop->wake_fd);
+        close(loop->epoll_fd);
+    }
+}
+
+void Reactor::start() {
+    running_ = true;
+    for (auto& loop : loops_) {
+        Loop* l = loop.get();
+        threads_.emplace_back([this, l]() { run_loop(*l); });
+    }
+}
+
+void Reactor::stop() {
+    running_ = false;
+    for (auto& loop : loops_) {
+        uint64_t one = 1;
+        ssize_t ignored = write(loop->wake_fd, &one, sizeof(one));
+        (void)ignored;
+    }
+}
+
+void Reactor::join() {
+    for (auto& t : threads_) {
+        if (t.joinable()) t.join();
+    }
+    threads_.clear();
+}
+
+void Reactor::run_loop(Loop& loop) {
+    epoll_event events[MAX_EVENTS];
+
+    while (running_) {
+        bool mail = false;
+        int n = epoll_wait(loop.epoll_fd, events, MAX_EVENTS, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "epoll_wait failed: errno " << errno << std::endl;
+            break;
+        }
+
+        for (int i = 0; i < n; ++i) {
+            void* tag = events[i].data.ptr;
+            if (tag == nullptr) {
+                accept_connections(loop);
+                continue;
+            }
+            if (tag == &loop) {
+                uint64_t value;
+                ssize_t ignored = read(loop.wake_fd, &value, sizeof(value));
+                (void)ignored;
+                mail = true;
+                continue;
+            }
+
+            Connection* conn = static_cast<Connection*>(tag);
+            uint32_t ev = events[i].events;
+
+            if ((ev & EPOLLERR) || ((ev & EPOLLHUP) && !(ev & EPOLLIN))) {
+                close_connection(loop, conn);
+                continue;
+            }
+
+            if (ev & EPOLLOUT) {
+                if (!flush(conn)) {
+                    close_connection(loop, conn);
+                    continue;
+                }
+                if (conn->pending_output() == 0) {
+                    if (conn->closing) {
+                        close_connection(loop, conn);
+                        continue;
+                    }
+                    if (conn->read_paused) {
+                        conn->read_paused = false;
+                        handle_read(loop, conn);
+                        continue;
+                    }
+                }
+            }
+
+            if (ev & (EPOLLIN | EPOLLRDHUP)) {
+                handle_read(loop, conn);
+            }
+        }
+        // After the events, since delivery may close connections they name.
+        if (mail) deliver_mail(loop);
+    }
+}
+
+void Reactor::accept_connections(Loop& loop) {
+    while (true) {
+        int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            // Out of descriptors: the level-triggered listener would wake us
+            // again at once, so free the spare to take the connection off
+            // the backlog and close it.
+            if ((errno == EMFILE || errno == ENFILE) && loop.spare_fd >= 0) {
+                close(loop.spare_fd);
+                int dropped = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+                if (dropped >= 0) close(dropped);
+                loop.spare_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+                if (dropped >= 0) continue;
+            }
+            // EAGAIN: another reactor took it or the backlog is drained.
+            return;
+        }
+
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        std::unique_ptr<Connection> conn(new Connection());
+        conn->fd = fd;
+        conn->id = ++loop.next_id;
+        Loop* owner = &loop;
+        uint64_t id = conn->id;
+        conn->session = factory_(fd, [owner, fd, id](std::string data) { post(*owner, fd, id, std::move(data)); });
+
+        epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        ev.data.ptr = conn.get();
+        if (epoll_ctl(loop.epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            close(fd);
+            continue;
+        }
+
+        loop.connections[fd] = std::move(conn);
+        connections_++;
+        accepted_++;
+    }
+}
+
+void Reactor::handle_read(Loop& loop, Connection* conn) {
+    char chunk[READ_CHUNK];
+
+    // Edge-triggered: keep reading until the socket reports EAGAIN.
+    while (!conn->closing) {
+        if (conn->pending_output() > MAX_PENDING_OUTPUT) {
+            conn->read_paused = true;
+            return;
+        }
+
+        ssize_t bytes = read(conn->fd, chunk, sizeof(chunk));
+        if (bytes > 0) {
+            conn->input.append(chunk, static_cast<size_t>(bytes));
+            if (!conn->session->on_data(conn->input, conn->output)) {
+                conn->closing = true;
+            }
+            release_if_large(conn->input);
+            if (!flush(conn)) {
+                close_connection(loop, conn);
+                return;
+            }
+            continue;
+        }
+        if (bytes == 0) {
+            close_connection(loop, conn);
+            return;
+        }
+        if (errno == EINTR) continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+
+        close_connection(loop, conn);
+        return;
+    }
+
+    if (conn->closing && conn->pending_output() == 0) {
+        close_connection(loop, conn);
+    }
+}
+
+void Reactor::post(Loop& loop, int fd, uint64_t id, std::string data) {
+    bool was_empty;
+    {
+        std::lock_guard<std::mutex> lock(loop.mailbox_mutex);
+        was_empty = loop.mailbox.empty();
+        loop.mailbox.push_back(Loop::Mail{fd, id, std::move(data)});
+    }
+    if (was_empty) {
+        uint64_t one = 1;
+        ssize_t ignored = write(loop.wake_fd, &one, sizeof(one));
+        (void)ignored;
+    }
+}
+
+void Reactor::deliver_mail(Loop& loop) {
+    std::vector<Loop::Mail> mail;
+    {
+        std::lock_guard<std::mutex> lock(loop.mailbox_mutex);
+        mail.swap(loop.mailbox);
+    }
+    for (auto& item : mail) {
+        auto it = loop.connections.find(item.fd);
+        if (it == loop.connections.end() || it->second->id != item.id) continue;  // closed meanwhile
+        Connection* conn = it->second.get();
+        if (conn->closing) continue;
+        conn->output += item.data;
+        if (conn->pending_output() > MAX_POSTED_OUTPUT || !flush(conn)) {
+            close_connection(loop, conn);
+        }
+    }
+}
+
+bool Reactor::flush(Connection* conn) {
+    while (conn->pending_output() > 0) {
+        ssize_t sent = send(conn->fd, conn->output.data() + conn->output_offset,
+                            conn->pending_output(), MSG_NOSIGNAL);
+        if (sent > 0) {
+            conn->output_offset += static_cast<size_t>(sent);
+            continue;
+        }
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            // EPOLLOUT will fire once the socket drains.
+            return true;
+        }
+        return false;
+    }
+
+    conn->output.clear();
+    conn->output_offset = 0;
+    release_if_large(conn->output);
+    return true;
+}
+
+void Reactor::close_connection(Loop& loop, Connection* conn) {
+    int fd = conn->fd;
+    epoll_ctl(loop.epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    loop.connections.erase(fd);
+    connections_--;
+}
+
+#endif // __linux__
@@ -98,9 +98,9 @@ std::string get_db_stats(DB* db) {
     // For demo: only LRUDB/LFUDB, dynamic_cast to get stats
     std::ostringstream oss;
     if (auto lru = dynamic_cast<LRUDB*>(db)) {
-        oss << "hits: " << lru->cache_->get_hits() << ", misses: " << lru->cache_->get_misses();
+        oss << "hits: " << lru->get_hits() << ", misses: " << lru->get_misses();
     } else if (auto lfu = dynamic_cast<LFUDB*>(db)) {
-        oss << "hits: " << lfu->cache_->get_hits() << ", misses: " << lfu->cache_->get_misses();
+        oss << "hits: " << lfu->get_hits() << ", misses: " << lfu->get_misses();
     }
     return oss.str();
 }
@@ -135,8 +135,15 @@ void update_config_and_db(const std::string& suggestion, ServerConfig& cfg, std:
         f << "{\n  \"port\": " << cfg.port << ",\n  \"cache_size\": " << cfg.cache_size << ",\n  \"cache_policy\": \"" << cfg.cache_policy << "\",\n  \"api_key\": \"" << cfg.api_key << "\"\n}";
         f.close();
         // Swap DB
+        std::unique_ptr<DB> fresh(create_db(cfg.cache_policy, cfg.cache_size));
+        // The new DB is rebuilt from the log, so it must hold every write.
+        if (!AOFWriter::instance().flush()) {
+            std::cerr << "[AI] AOF could not be flushed; keeping the current DB" << std::endl;
+            return;
+        }
+        replay_aof(*fresh, AOFWriter::instance().filename(), false);
         std::lock_guard<std::mutex> lock(db_swap_mutex);
-        db.reset(create_db(cfg.cache_policy, cfg.cache_size));
+        db = std::move(fresh);
         std::cout << "[AI] DB reconfigured: policy=" << cfg.cache_policy << ", size=" << cfg.cache_size << std::endl;
     }
 }
@@ -174,6 +181,7 @@ int main() {
 #endif
     ServerConfig cfg = read_config();
     std::unique_ptr<DB> db(create_db(cfg.cache_policy, cfg.cache_size));
+    if (replay_aof(*db, AOFWriter::instance().filename()) == AOFLoader::Result::CORRUPT) return 1;
     std::atomic<bool> running(true);
     std::thread(ai_optimize_loop, db.get(), std::ref(running), cfg.api_key, std::ref(cfg), std::ref(db)).detach();
     int server_fd = socket(AF_INET, SOCK_STREAM, 0);
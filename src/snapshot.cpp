@@ -0,0 +1,511 @@
+/*
+ * snapshot.cpp
+ * Streaming binary snapshot writer and reader.
+ */
+
+#include "snapshot.h"
+#include "crc32.h"
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <chrono>
+
+#ifdef HAVE_LZ4
+#include <lz4.h>
+#endif
+
+#ifdef _WIN32
+#include <io.h>
+#define snapshot_fsync(f) _commit(_fileno(f))
+#else
+#include <unistd.h>
+#define snapshot_fsync(f) fsync(fileno(f))
+#endif
+
+namespace {
+
+const char MAGIC[] = "MYDBSNAP";
+const size_t MAGIC_LEN = 8;
+const uint8_t VERSION = 1;
+
+const size_t CHUNK_SIZE = 64 * 1024;
+const size_t IO_BUFFER = 1024 * 1024;
+const size_t MAX_CHUNK = 1u << 30;
+const size_t MAX_STRING = 512u * 1024 * 1024;
+
+const uint8_t FLAG_LZ4 = 0x01;
+const uint8_t TAG_EXPIRE = 0xFE;
+const uint8_t TAG_EOF = 0xFF;
+
+uint8_t type_tag(DataType type) {
+    return static_cast<uint8_t>(type);
+}
+
+void append_varint(std::string& out, uint64_t v) {
+    while (v >= 0x80) {
+        out += static_cast<char>((v & 0x7F) | 0x80);
+        v >>= 7;
+    }
+    out += static_cast<char>(v);
+}
+
+void append_u32(std::string& out, uint32_t v) {
+    for (int i = 0; i < 4; ++i) out += static_cast<char>(v >> (8 * i));
+}
+
+uint32_t load_u32(const unsigned char* p) {
+    return uint32_t(p[0]) | uint32_t(p[1]) << 8 | uint32_t(p[2]) << 16 | uint32_t(p[3]) << 24;
+}
+
+// Hands out the decompressed chunk stream as one continuous byte sequence.
+class ChunkInput {
+public:
+    explicit ChunkInput(std::FILE* file) : file_(file), pos_(0), trailer_(false), corrupt_(false) {}
+
+    bool corrupt() const { return corrupt_; }
+    bool at_trailer() const { return trailer_; }
+    uint64_t trailer_keys() const { return trailer_keys_; }
+
+    // True while there are entry bytes left; false at the trailer or on error.
+    bool more() {
+        while (pos_ == raw_.size()) {
+            if (trailer_ || corrupt_ || !next_chunk()) return false;
+        }
+        return true;
+    }
+
+    bool get_byte(uint8_t& b) {
+        if (!more()) return fail();
+        b = static_cast<uint8_t>(raw_[pos_++]);
+        return true;
+    }
+
+    bool get_varint(uint64_t& v) {
+        v = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            uint8_t b;
+            if (!get_byte(b)) return false;
+            v |= uint64_t(b & 0x7F) << shift;
+            if (!(b & 0x80)) return true;
+        }
+        return fail();
+    }
+
+    bool get_bytes(char* out, size_t n) {
+        while (n > 0) {
+            if (!more()) return fail();
+            size_t take = std::min(n, raw_.size() - pos_);
+            std::memcpy(out, raw_.data() + pos_, take);
+            pos_ += take;
+            out += take;
+            n -= take;
+        }
+        return true;
+    }
+
+    bool get_string(std::string& s) {
+        uint64_t len;
+        if (!get_varint(len) || len > MAX_STRING) return fail();
+        s.resize(static_cast<size_t>(len));
+        return len == 0 || get_bytes(&s[0], s.size());
+    }
+
+    bool fail() {
+        corrupt_ = true;
+        return false;
+    }
+
+private:
+    int getc_byte() { return std::fgetc(file_); }
+
+    bool file_varint(uint64_t& v) {
+        v = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            int c = getc_byte();
+            if (c == EOF) return false;
+            v |= uint64_t(c & 0x7F) << shift;
+            if (!(c & 0x80)) return true;
+        }
+        return false;
+    }
+
+    bool next_chunk() {
+        int flags = getc_byte();
+        if (flags == EOF) return fail();
+        if (flags == TAG_EOF) {
+            // Trailer: key count and its checksum.
+            std::string count;
+            uint64_t keys;
+            unsigned char crc[4];
+            if (!file_varint(keys) || std::fread(crc, 1, 4, file_) != 4) return fail();
+            append_varint(count, keys);
+            if (crc32(count.data(), count.size()) != load_u32(crc)) return fail();
+            trailer_ = true;
+            trailer_keys_ = keys;
+            return false;
+        }
+
+        uint64_t raw_len, stored_len;
+        unsigned char crc[4];
+        if (!file_varint(raw_len) || !file_varint(stored_len) || raw_len > MAX_CHUNK ||
+            stored_len > MAX_CHUNK || std::fread(crc, 1, 4, file_) != 4) {
+            return fail();
+        }
+        packed_.resize(static_cast<size_t>(stored_len));
+        if (std::fread(&packed_[0], 1, packed_.size(), file_) != packed_.size() ||
+            crc32(packed_.data(), packed_.size()) != load_u32(crc)) {
+            return fail();
+        }
+
+        pos_ = 0;
+        if (flags & FLAG_LZ4) {
+#ifdef HAVE_LZ4
+            raw_.resize(static_cast<size_t>(raw_len));
+            int n = LZ4_decompress_safe(packed_.data(), &raw_[0], static_cast<int>(packed_.size()),
+                                        static_cast<int>(raw_.size()));
+            if (n < 0 || static_cast<uint64_t>(n) != raw_len) return fail();
+#else
+            std::cerr << "Snapshot uses LZ4 compression, but this build has no LZ4 support" << std::endl;
+            return fail();
+#endif
+        } else {
+            if (raw_len != stored_len) return fail();
+            raw_.swap(packed_);
+        }
+        return true;
+    }
+
+    std::FILE* file_;
+    std::string raw_;
+    std::string packed_;
+    size_t pos_;
+    bool trailer_;
+    bool corrupt_;
+    uint64_t trailer_keys_ = 0;
+};
+
+} // namespace
+
+SnapshotWriter::SnapshotWriter(const std::string& path, bool compress)
+    : path_(path), temp_path_(path + ".tmp"), file_(std::fopen(temp_path_.c_str(), "wb")),
+#ifdef HAVE_LZ4
+      compress_(compress),
+#else
+      compress_(false),
+#endif
+      ok_(true), keys_(0), bytes_written_(0) {
+    if (!file_) {
+        std::cerr << "Failed to create snapshot " << temp_path_ << ": " << strerror(errno) << std::endl;
+        return;
+    }
+    std::setvbuf(file_, nullptr, _IOFBF, IO_BUFFER);
+    write_raw(MAGIC, MAGIC_LEN);
+    write_raw(&VERSION, 1);
+    chunk_.reserve(CHUNK_SIZE + 1024);
+}
+
+SnapshotWriter::~SnapshotWriter() {
+    if (file_) {
+        std::fclose(file_);
+        std::remove(temp_path_.c_str());
+    }
+}
+
+void SnapshotWriter::begin_entry(DataType type, const std::string& key, int64_t expire_unix_ms) {
+    if (expire_unix_ms > 0) {
+        chunk_ += static_cast<char>(TAG_EXPIRE);
+        put_varint(static_cast<uint64_t>(expire_unix_ms));
+    }
+    chunk_ += static_cast<char>(type_tag(type));
+    put_string(key);
+    ++keys_;
+}
+
+void SnapshotWriter::write_string(const std::string& key, std::string_view value, int64_t expire_unix_ms) {
+    if (!ok()) return;
+    begin_entry(DataType::STRING, key, expire_unix_ms);
+    put_string(value);
+}
+
+void SnapshotWriter::write(const std::string& key, const DataValue& value, int64_t expire_unix_ms) {
+    if (!ok()) return;
+    switch (value.type) {
+        case DataType::STRING: {
+            char buf[StringValue::INT_CHARS];
+            write_string(key, std::get<StringValue>(value.data).view(buf), expire_unix_ms);
+            break;
+        }
+        case DataType::LIST: {
+            const auto& list = std::get<QuickList>(value.data);
+            begin_entry(value.type, key, expire_unix_ms);
+            put_varint(list.size());
+            for (auto item : list) put_string(item);
+            break;
+        }
+        case DataType::SET: {
+            const auto& set = std::get<SetValue>(value.data);
+            begin_entry(value.type, key, expire_unix_ms);
+            put_varint(set.size());
+            for (auto member : set) put_string(member);
+            break;
+        }
+        case DataType::HASH: {
+            const auto& hash = std::get<HashValue>(value.data);
+            begin_entry(value.type, key, expire_unix_ms);
+            put_varint(hash.size());
+            for (auto field : hash) {
+                put_string(field.first);
+                put_string(field.second);
+            }
+            break;
+        }
+        case DataType::ZSET: {
+            const auto& zset = std::get<SortedSet>(value.data);
+            begin_entry(value.type, key, expire_unix_ms);
+            put_varint(zset.size());
+            for (const auto& node : zset) {
+                put_string(node.member);
+                uint64_t bits;
+                std::memcpy(&bits, &node.score, sizeof(bits));
+                append_u32(chunk_, static_cast<uint32_t>(bits));
+                append_u32(chunk_, static_cast<uint32_t>(bits >> 32));
+            }
+            break;
+        }
+    }
+    maybe_flush();
+}
+
+bool SnapshotWriter::finish() {
+    if (!file_) return false;
+    flush_chunk();
+
+    std::string trailer(1, static_cast<char>(TAG_EOF));
+    std::string count;
+    append_varint(count, keys_);
+    trailer += count;
+    append_u32(trailer, crc32(count.data(), count.size()));
+    write_raw(trailer.data(), trailer.size());
+
+    if (std::fflush(file_) != 0 || snapshot_fsync(file_) != 0) ok_ = false;
+    if (std::fclose(file_) != 0) ok_ = false;
+    file_ = nullptr;
+    if (!ok_) {
+        std::cerr << "Failed to write snapshot " << temp_path_ << std::endl;
+        std::remove(temp_path_.c_str());
+        return false;
+    }
+#ifdef _WIN32
+    std::remove(path_.c_str());
+#endif
+    if (std::rename(temp_path_.c_str(), path_.c_str()) != 0) {
+        std::cerr << "Failed to install snapshot " << path_ << ": " << strerror(errno) << std::endl;
+        std::remove(temp_path_.c_str());
+        return false;
+    }
+    return true;
+}
+
+void SnapshotWriter::put_varint(uint64_t v) {
+    append_varint(chunk_, v);
+}
+
+void SnapshotWriter::put_string(std::string_view s) {
+    append_varint(chunk_, s.size());
+    chunk_ += s;
+    maybe_flush();
+}
+
+void SnapshotWriter::maybe_flush() {
+    if (chunk_.size() >= CHUNK_SIZE) flush_chunk();
+}
+
+void SnapshotWriter::flush_chunk() {
+    if (chunk_.empty() || !ok()) return;
+
+    uint8_t flags = 0;
+    const std::string* stored = &chunk_;
+#ifdef HAVE_LZ4
+    if (compress_) {
+        int bound = LZ4_compressBound(static_cast<int>(chunk_.size()));
+        packed_.resize(static_cast<size_t>(bound));
+        int n = LZ4_compress_default(chunk_.data(), &packed_[0], static_cast<int>(chunk_.size()), bound);
+        if (n > 0 && static_cast<size_t>(n) < chunk_.size()) {
+            packed_.resize(static_cast<size_t>(n));
+            stored = &packed_;
+            flags |= FLAG_LZ4;
+        }
+    }
+#endif
+
+    std::string header(1, static_cast<char>(flags));
+    append_varint(header, chunk_.size());
+    append_varint(header, stored->size());
+    append_u32(header, crc32(stored->data(), stored->size()));
+    write_raw(header.data(), header.size());
+    write_raw(stored->data(), stored->size());
+    chunk_.clear();
+}
+
+void SnapshotWriter::write_raw(const void* data, size_t len) {
+    if (!ok()) return;
+    if (std::fwrite(data, 1, len, file_) != len) {
+        std::cerr << "Snapshot write failed: " << strerror(errno) << std::endl;
+        ok_ = false;
+        return;
+    }
+    bytes_written_ += len;
+}
+
+SnapshotReader::Result SnapshotReader::load(const std::string& path, const Apply& apply, size_t* keys) {
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) return Result::NOT_FOUND;
+    std::setvbuf(file, nullptr, _IOFBF, IO_BUFFER);
+
+    char header[MAGIC_LEN + 1];
+    if (std::fread(header, 1, sizeof(header), file) != sizeof(header) ||
+        std::memcmp(header, MAGIC, MAGIC_LEN) != 0) {
+        std::fclose(file);
+        return Result::NOT_SNAPSHOT;
+    }
+    if (static_cast<uint8_t>(header[MAGIC_LEN]) != VERSION) {
+        std::cerr << "Unsupported snapshot version " << int(static_cast<uint8_t>(header[MAGIC_LEN])) << std::endl;
+        std::fclose(file);
+        return Result::CORRUPT;
+    }
+
+    ChunkInput in(file);
+    size_t loaded = 0;
+    std::string key;
+    while (in.more()) {
+        uint8_t tag;
+        uint64_t expire = 0;
+        if (!in.get_byte(tag)) break;
+        if (tag == TAG_EXPIRE && (!in.get_varint(expire) || !in.get_byte(tag))) break;
+        if (!in.get_string(key)) break;
+
+        DataValue value;
+        uint64_t count = 0;
+        bool ok = true;
+        switch (tag) {
+            case uint8_t(DataType::STRING): {
+                std::string s;
+                ok = in.get_string(s);
+                value.type = DataType::STRING;
+                value.data = StringValue(s);
+                break;
+            }
+            case uint8_t(DataType::LIST): {
+                QuickList list;
+                std::string item;
+                ok = in.get_varint(count);
+                for (uint64_t i = 0; ok && i < count; ++i) {
+                    ok = in.get_string(item);
+                    if (ok) list.push_back(item);
+                }
+                value.type = DataType::LIST;
+                value.data = std::move(list);
+                break;
+            }
+            case uint8_t(DataType::SET): {
+                SetValue set;
+                std::string member;
+                ok = in.get_varint(count);
+                for (uint64_t i = 0; ok && i < count; ++i) {
+                    ok = in.get_string(member);
+                    if (ok) set.insert(member);
+                }
+                value.type = DataType::SET;
+                value.data = std::move(set);
+                break;
+            }
+            case uint8_t(DataType::HASH): {
+                HashValue hash;
+                std::string field, v;
+                ok = in.get_varint(count);
+                for (uint64_t i = 0; ok && i < count; ++i) {
+                    ok = in.get_string(field) && in.get_string(v);
+                    if (ok) hash.set(field, v);
+                }
+                value.type = DataType::HASH;
+                value.data = std::move(hash);
+                break;
+            }
+            case uint8_t(DataType::ZSET): {
+                SortedSet zset;
+                std::string member;
+                ok = in.get_varint(count);
+                for (uint64_t i = 0; ok && i < count; ++i) {
+                    unsigned char raw[8];
+                    ok = in.get_string(member) && in.get_bytes(reinterpret_cast<char*>(raw), 8);
+                    if (!ok) break;
+                    uint64_t bits = uint64_t(load_u32(raw)) | uint64_t(load_u32(raw + 4)) << 32;
+                    double score;
+                    std::memcpy(&score, &bits, sizeof(score));
+                    zset.add(member, score);
+                }
+                value.type = DataType::ZSET;
+                value.data = std::move(zset);
+                break;
+            }
+            default:
+                ok = in.fail();
+                break;
+        }
+        if (!ok) break;
+        apply(key, value, static_cast<int64_t>(expire));
+        ++loaded;
+    }
+    std::fclose(file);
+
+    if (keys) *keys = loaded;
+    if (in.corrupt() || !in.at_trailer() || in.trailer_keys() != loaded) return Result::CORRUPT;
+    return Result::OK;
+}
+
+BackgroundSave::~BackgroundSave() {
+    cancel_ = true;
+    if (thread_.joinable()) thread_.join();
+}
+
+bool BackgroundSave::start(const std::string& path, size_t keys_total, Job job, std::function<void()> abandon) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (status_.in_progress) return false;
+    if (thread_.joinable()) thread_.join();  // previous save, already finished
+    status_.in_progress = true;
+    status_.keys_saved = 0;
+    status_.keys_total = keys_total;
+
+    thread_ = std::thread([this, path, job, abandon]() {
+        auto start = std::chrono::steady_clock::now();
+        bool ok;
+        {
+            SnapshotWriter out(path);
+            ok = out.ok() && job(out) && out.finish();
+        }
+        if (!ok && !cancelled()) std::cerr << "Background save to " << path << " failed" << std::endl;
+        if (!ok && abandon) abandon();
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        status_.in_progress = false;
+        status_.last_ok = ok;
+        status_.last_duration = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (ok) {
+            status_.saves++;
+            status_.last_save_time = std::chrono::duration_cast<std::chrono::seconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+        }
+    });
+    return true;
+}
+
+void BackgroundSave::progress(size_t keys_saved) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    status_.keys_saved = keys_saved;
+}
+
+BackgroundSave::Status BackgroundSave::status() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return status_;
+}
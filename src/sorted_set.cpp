@@ -0,0 +1,297 @@
+#include "sorted_set.h"
+#include "memory_usage.h"
+#include <cmath>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <utility>
+
+namespace {
+
+// True if `node` sorts before (score, member).
+bool less(const SortedSet::Node* node, double score, const std::string& member) {
+    return node->score < score || (node->score == score && node->member < member);
+}
+
+}
+
+SortedSet::SortedSet() : header_(new_node(MAX_HEIGHT, std::string(), 0)), tail_(nullptr), height_(1), bytes_(0) {}
+
+SortedSet::SortedSet(const SortedSet& other) : SortedSet() {
+    index_.reserve(other.size());
+    for (const Node& node : other) {
+        std::string member = node.member;
+        Node* inserted = insert(std::move(member), node.score);
+        index_.try_emplace(inserted->member, inserted);
+    }
+}
+
+SortedSet::SortedSet(SortedSet&& other) noexcept : SortedSet() {
+    *this = std::move(other);
+}
+
+SortedSet& SortedSet::operator=(const SortedSet& other) {
+    if (this != &other) {
+        SortedSet copy(other);
+        *this = std::move(copy);
+    }
+    return *this;
+}
+
+SortedSet& SortedSet::operator=(SortedSet&& other) noexcept {
+    if (this != &other) {
+        std::swap(header_, other.header_);
+        std::swap(tail_, other.tail_);
+        std::swap(height_, other.height_);
+        std::swap(bytes_, other.bytes_);
+        index_.swap(other.index_);
+        other.clear();
+    }
+    return *this;
+}
+
+SortedSet::~SortedSet() {
+    clear();
+    free_node(header_);
+}
+
+void SortedSet::clear() {
+    Node* node = header_->level()[0].forward;
+    while (node) {
+        Node* next = node->level()[0].forward;
+        free_node(node);
+        node = next;
+    }
+    for (int i = 0; i < MAX_HEIGHT; ++i) header_->level()[i] = Level{nullptr, 0};
+    tail_ = nullptr;
+    height_ = 1;
+    bytes_ = 0;
+    index_.clear();
+}
+
+size_t SortedSet::node_bytes(const Node* node) {
+    return sizeof(Node) + node->height * sizeof(Level) + heap_bytes(node->member) +
+           Index::node_bytes();
+}
+
+size_t SortedSet::memory_usage() const {
+    return sizeof(Node) + MAX_HEIGHT * sizeof(Level) + bytes_ + index_.table_bytes();
+}
+
+SortedSet::Node* SortedSet::new_node(int height, std::string&& member, double score) {
+    void* memory = ::operator new(sizeof(Node) + height * sizeof(Level));
+    Node* node = new (memory) Node{std::move(member), score, nullptr, static_cast<uint8_t>(height)};
+    for (int i = 0; i < height; ++i) node->level()[i] = Level{nullptr, 0};
+    return node;
+}
+
+void SortedSet::free_node(Node* node) {
+    node->~Node();
+    ::operator delete(node);
+}
+
+// Each level is kept with probability 1/4, as in Redis.
+int SortedSet::random_height() {
+    thread_local uint64_t state = 0x9E3779B97F4A7C15ull ^ reinterpret_cast<uintptr_t>(&state);
+    int height = 1;
+    for (;;) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        if ((state & 3) != 0 || height == MAX_HEIGHT) break;
+        ++height;
+    }
+    return height;
+}
+
+SortedSet::Node* SortedSet::insert(std::string&& member, double score) {
+    Node* update[MAX_HEIGHT];
+    size_t rank[MAX_HEIGHT];
+    Node* x = header_;
+    for (int i = height_ - 1; i >= 0; --i) {
+        rank[i] = i == height_ - 1 ? 0 : rank[i + 1];
+        while (x->level()[i].forward && less(x->level()[i].forward, score, member)) {
+            rank[i] += x->level()[i].span;
+            x = x->level()[i].forward;
+        }
+        update[i] = x;
+    }
+
+    // The index is updated after the skiplist, so size() is still the old length.
+    int height = random_height();
+    if (height > height_) {
+        for (int i = height_; i < height; ++i) {
+            rank[i] = 0;
+            update[i] = header_;
+            header_->level()[i].span = size();
+        }
+        height_ = height;
+    }
+
+    x = new_node(height, std::move(member), score);
+    bytes_ += node_bytes(x);
+    for (int i = 0; i < height; ++i) {
+        x->level()[i].forward = update[i]->level()[i].forward;
+        update[i]->level()[i].forward = x;
+        x->level()[i].span = update[i]->level()[i].span - (rank[0] - rank[i]);
+        update[i]->level()[i].span = (rank[0] - rank[i]) + 1;
+    }
+    for (int i = height; i < height_; ++i) ++update[i]->level()[i].span;
+
+    x->backward = update[0] == header_ ? nullptr : update[0];
+    if (x->level()[0].forward) {
+        x->level()[0].forward->backward = x;
+    } else {
+        tail_ = x;
+    }
+    return x;
+}
+
+void SortedSet::unlink(Node* node, Node** update) {
+    for (int i = 0; i < height_; ++i) {
+        if (update[i]->level()[i].forward == node) {
+            update[i]->level()[i].span += node->level()[i].span - 1;
+            update[i]->level()[i].forward = node->level()[i].forward;
+        } else {
+            --update[i]->level()[i].span;
+        }
+    }
+    if (node->level()[0].forward) {
+        node->level()[0].forward->backward = node->backward;
+    } else {
+        tail_ = node->backward;
+    }
+    while (height_ > 1 && header_->level()[height_ - 1].forward == nullptr) --height_;
+}
+
+std::string SortedSet::erase(Node* node) {
+    Node* update[MAX_HEIGHT];
+    Node* x = header_;
+    for (int i = height_ - 1; i >= 0; --i) {
+        while (x->level()[i].forward && less(x->level()[i].forward, node->score, node->member)) {
+            x = x->level()[i].forward;
+        }
+        update[i] = x;
+    }
+    unlink(node, update);
+    bytes_ -= node_bytes(node);
+    std::string member = std::move(node->member);
+    free_node(node);
+    return member;
+}
+
+bool SortedSet::add(const std::string& member, double score) {
+    auto it = index_.find(member);
+    if (it == index_.end()) {
+        Node* node = insert(std::string(member), score);
+        index_.try_emplace(node->member, node);
+        return true;
+    }
+
+    Node* node = it->second;
+    if (node->score == score) return false;
+    // Still between its neighbours: only the score changes.
+    const Node* next = node->level()[0].forward;
+    if ((!node->backward || less(node->backward, score, member)) && (!next || !less(next, score, member))) {
+        node->score = score;
+        return false;
+    }
+    index_.erase(it);
+    Node* moved = insert(erase(node), score);
+    index_.try_emplace(moved->member, moved);
+    return false;
+}
+
+bool SortedSet::incr(const std::string& member, double delta, double& score) {
+    auto it = index_.find(member);
+    score = it == index_.end() ? delta : it->second->score + delta;
+    if (std::isnan(score)) return false;
+    add(member, score);
+    return true;
+}
+
+bool SortedSet::remove(const std::string& member) {
+    auto it = index_.find(member);
+    if (it == index_.end()) return false;
+    Node* node = it->second;
+    index_.erase(it);
+    erase(node);
+    return true;
+}
+
+bool SortedSet::score(const std::string& member, double& score) const {
+    auto it = index_.find(member);
+    if (it == index_.end()) return false;
+    score = it->second->score;
+    return true;
+}
+
+bool SortedSet::rank(const std::string& member, bool reverse, size_t& rank) const {
+    auto it = index_.find(member);
+    if (it == index_.end()) return false;
+    const Node* node = it->second;
+
+    size_t traversed = 0;
+    const Node* x = header_;
+    for (int i = height_ - 1; i >= 0; --i) {
+        while (x->level()[i].forward &&
+               (less(x->level()[i].forward, node->score, node->member) || x->level()[i].forward == node)) {
+            traversed += x->level()[i].span;
+            x = x->level()[i].forward;
+        }
+        if (x == node) break;
+    }
+    rank = reverse ? size() - traversed : traversed - 1;
+    return true;
+}
+
+const SortedSet::Node* SortedSet::by_rank(size_t rank) const {
+    size_t traversed = 0;
+    const Node* x = header_;
+    for (int i = height_ - 1; i >= 0; --i) {
+        while (x->level()[i].forward && traversed + x->level()[i].span <= rank) {
+            traversed += x->level()[i].span;
+            x = x->level()[i].forward;
+        }
+        if (traversed == rank) return x;
+    }
+    return nullptr;
+}
+
+const SortedSet::Node* SortedSet::first_in_range(const ScoreRange& range) const {
+    if (range.min > range.max || (range.min == range.max && (range.min_exclusive || range.max_exclusive))) {
+        return nullptr;
+    }
+    const Node* x = header_;
+    for (int i = height_ - 1; i >= 0; --i) {
+        while (x->level()[i].forward && !range.above_min(x->level()[i].forward->score)) {
+            x = x->level()[i].forward;
+        }
+    }
+    return x->level()[0].forward;
+}
+
+bool SortedSet::parse_score(const std::string& text, double& score) {
+    if (text.empty() || std::isspace(static_cast<unsigned char>(text[0]))) return false;
+    char* end = nullptr;
+    score = std::strtod(text.c_str(), &end);
+    return end == text.c_str() + text.size() && !std::isnan(score);
+}
+
+bool SortedSet::parse_range(const std::string& min, const std::string& max, ScoreRange& range) {
+    auto parse_bound = [](const std::string& text, double& value, bool& exclusive) {
+        exclusive = !text.empty() && text[0] == '(';
+        return parse_score(exclusive ? text.substr(1) : text, value);
+    };
+    return parse_bound(min, range.min, range.min_exclusive) && parse_bound(max, range.max, range.max_exclusive);
+}
+
+std::string SortedSet::format_score(double score) {
+    char buf[32];
+    for (int precision = 15; precision <= 17; ++precision) {
+        std::snprintf(buf, sizeof(buf), "%.*g", precision, score);
+        if (std::strtod(buf, nullptr) == score) break;
+    }
+    return buf;
+}
@@ -0,0 +1,147 @@
+/*
+ * tiny_lfu.cpp
+ * Implements the W-TinyLFU admission and eviction policy.
+ */
+
+#include "tiny_lfu.h"
+#include <functional>
+
+namespace {
+
+const uint64_t SEEDS[] = {0xc3a5c85c97cb3127ULL, 0xb492b66fbe98f273ULL, 0x9ae16a3b2f90404fULL, 0xcbf29ce484222325ULL};
+const size_t MIN_WIDTH = 64;
+const size_t MAX_WIDTH = size_t(1) << 24;
+// Accesses counted between halvings, per counter in a row.
+const size_t SAMPLE_FACTOR = 10;
+
+}
+
+// FrequencySketch
+
+void FrequencySketch::ensure_capacity(size_t keys) {
+    if (keys <= width_ || width_ == MAX_WIDTH) return;
+    size_t width = MIN_WIDTH;
+    while (width < keys && width < MAX_WIDTH) width <<= 1;
+    width_ = width;
+    table_.assign(DEPTH * width_ / 16, 0);
+    additions_ = 0;
+    sample_size_ = SAMPLE_FACTOR * width_;
+}
+
+size_t FrequencySketch::slot(uint64_t hash, int row) const {
+    uint64_t h = (hash + SEEDS[row]) * SEEDS[row];
+    h ^= h >> 32;
+    return row * width_ + (h & (width_ - 1));
+}
+
+void FrequencySketch::increment(const std::string& key) {
+    if (!width_) return;
+    uint64_t hash = std::hash<std::string>{}(key);
+    bool added = false;
+    for (int row = 0; row < DEPTH; ++row) {
+        size_t index = slot(hash, row);
+        uint64_t& word = table_[index / 16];
+        unsigned shift = (index % 16) * 4;
+        if (((word >> shift) & 0xF) != 0xF) {
+            word += uint64_t(1) << shift;
+            added = true;
+        }
+    }
+    if (added && ++additions_ >= sample_size_) halve();
+}
+
+uint32_t FrequencySketch::frequency(const std::string& key) const {
+    if (!width_) return 0;
+    uint64_t hash = std::hash<std::string>{}(key);
+    uint32_t frequency = 0xF;
+    for (int row = 0; row < DEPTH; ++row) {
+        size_t index = slot(hash, row);
+        uint32_t count = static_cast<uint32_t>((table_[index / 16] >> ((index % 16) * 4)) & 0xF);
+        frequency = std::min(frequency, count);
+    }
+    return frequency;
+}
+
+void FrequencySketch::halve() {
+    for (uint64_t& word : table_) word = (word >> 1) & 0x7777777777777777ULL;
+    additions_ /= 2;
+}
+
+// TinyLFUCache
+
+TinyLFUCache::~TinyLFUCache() {
+    // The table outlives the cache; its entries must not credit our counts.
+    for (KeyEntry* entry = window_.front(); entry; entry = window_.next(entry)) entry->segment.detach();
+    for (KeyEntry* entry = protected_.front(); entry; entry = protected_.next(entry)) entry->segment.detach();
+}
+
+void TinyLFUCache::insert(KeyEntry& entry, size_t resident) {
+    sketch_.ensure_capacity(resident);
+    sketch_.increment(*entry.key);
+    window_.push_front(entry);
+    entry.segment.charge(window_size_, 1);
+    // The window's oldest keys move on to probation, where they compete
+    // for a place in the main space at the next eviction.
+    while (window_size_ > window_limit(resident)) {
+        KeyEntry* oldest = window_.back();
+        oldest->segment.release();
+        probation_.push_front(*oldest);
+    }
+}
+
+void TinyLFUCache::hit(KeyEntry& entry, size_t resident) {
+    sketch_.increment(*entry.key);
+    if (entry.segment.charged_to(window_size_)) {
+        window_.push_front(entry);
+    } else if (entry.segment.charged_to(protected_size_)) {
+        protected_.push_front(entry);
+    } else {
+        // Second use on probation: promote, demoting protected keys past
+        // their share of the main space.
+        protected_.push_front(entry);
+        entry.segment.charge(protected_size_, 1);
+        size_t main = resident - std::min(resident, window_size_);
+        size_t protected_limit = std::max<size_t>(1, main * 4 / 5);
+        while (protected_size_ > protected_limit) {
+            KeyEntry* oldest = protected_.back();
+            oldest->segment.release();
+            probation_.push_front(*oldest);
+        }
+    }
+}
+
+KeyEntry* TinyLFUCache::victim(const KeyEntry& spare) {
+    KeyEntry* candidate = probation_.front();
+    KeyEntry* incumbent = probation_.back();
+    if (candidate && candidate != incumbent && candidate != &spare && incumbent != &spare) {
+        // Ties go against the newcomer, which keeps one-off keys out.
+        if (sketch_.frequency(*candidate->key) > sketch_.frequency(*incumbent->key)) {
+            admitted_++;
+            return incumbent;
+        }
+        rejected_++;
+        return candidate;
+    }
+    // Probation has at most one key: fall back to protected, then the window.
+    for (KeyEntry* entry : {incumbent, protected_.back(), window_.back()}) {
+        if (entry && entry != &spare) return entry;
+    }
+    return nullptr;
+}
+
+void TinyLFUCache::clear() {
+    for (KeyEntry* entry = window_.front(); entry; entry = window_.next(entry)) entry->segment.release();
+    for (KeyEntry* entry = protected_.front(); entry; entry = protected_.next(entry)) entry->segment.release();
+    window_.clear();
+    probation_.clear();
+    protected_.clear();
+}
+
+TinyLFUStats TinyLFUCache::stats() const {
+    TinyLFUStats stats;
+    stats.window = window_size_;
+    stats.protected_ = protected_size_;
+    stats.admitted = admitted_;
+    stats.rejected = rejected_;
+    return stats;
+}
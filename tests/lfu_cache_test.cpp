@@ -0,0 +1,79 @@
+/*
+ * lfu_cache_test.cpp
+ * Checks that LFUCache keeps its buckets in ascending priority through
+ * evictions, and that hot keys outlive cold ones.
+ */
+
+#include "lfu_cache.h"
+#include <iostream>
+#include <string>
+#include <random>
+
+namespace {
+
+int failures = 0;
+
+void check(bool ok, const char* what) {
+    if (!ok) {
+        std::cerr << "FAILED: " << what << std::endl;
+        failures++;
+    }
+}
+
+bool ascending(const LFUCache& cache) {
+    auto priorities = cache.bucket_priorities();
+    for (size_t i = 1; i < priorities.size(); ++i) {
+        if (priorities[i - 1] >= priorities[i]) return false;
+    }
+    return true;
+}
+
+// The key just written sits alone in the first bucket, so the victim
+// comes from the next one; the next key must not link below the rest.
+void spared_key_in_first_bucket() {
+    LFUCache cache(2);
+    std::string value;
+    cache.put("a", "1");
+    cache.put("b", "1");
+    cache.get("a", value);
+    cache.get("b", value);
+    cache.put("c", "1");
+    cache.put("d", "1");
+    check(ascending(cache), "buckets ascending after evicting past the written key");
+    for (int i = 0; i < 5; ++i) cache.get("d", value);
+    cache.put("e", "1");
+    check(ascending(cache), "buckets ascending after the next insert");
+    check(cache.get("d", value), "hot key survives eviction");
+}
+
+// Random puts and gets over more keys than fit, with a memory limit too.
+void random_workload(size_t capacity, size_t max_memory) {
+    LFUCache cache(capacity, max_memory);
+    std::mt19937 rng(42);
+    std::string value;
+    for (int i = 0; i < 200000; ++i) {
+        std::string key = "key:" + std::to_string(rng() % (capacity * 4));
+        if (rng() % 3) {
+            cache.get(key, value);
+        } else {
+            cache.put(key, std::string(rng() % 64, 'x'));
+        }
+        if (!ascending(cache)) {
+            check(false, "buckets ascending under a random workload");
+            return;
+        }
+    }
+    check(cache.get_items().size() <= capacity, "capacity respected");
+}
+
+}
+
+int main() {
+    spared_key_in_first_bucket();
+    random_workload(2, 0);
+    random_workload(64, 0);
+    random_workload(1000, 16 * 1024);
+    if (failures) return 1;
+    std::cout << "lfu_cache_test passed" << std::endl;
+    return 0;
+}